@@ -0,0 +1,37 @@
+#version 330 core
+
+const int JOINT_COUNT = 25;	// JointType_Count
+const int HAND_LEFT = 7;	// JointType_HandLeft
+const int HAND_RIGHT = 11;	// JointType_HandRight
+
+out vec4 Color;
+
+uniform mat4 gMVP;
+uniform samplerBuffer gMotion;	// JOINT_COUNT texels per frame: position, tracking state
+uniform int gFirstFrame;
+uniform int gFrameStep;
+uniform int gCurrentFrame;
+uniform int gFadeLength;
+uniform bool gTrajectory;
+uniform vec3 gColor;
+
+// Skeleton poses are drawn instanced, one instance per ghost, and the vertex id is the joint.
+// The barbell trajectory is a line strip and the vertex id is the frame.
+void main()
+{
+	int frame;
+	vec3 position;
+	if (gTrajectory) {
+		frame = gl_VertexID;
+		vec3 leftGrip = texelFetch(gMotion, frame * JOINT_COUNT + HAND_LEFT).xyz;
+		vec3 rightGrip = texelFetch(gMotion, frame * JOINT_COUNT + HAND_RIGHT).xyz;
+		position = 0.5 * (leftGrip + rightGrip);
+	}
+	else {
+		frame = gFirstFrame + gl_InstanceID * gFrameStep;
+		position = texelFetch(gMotion, frame * JOINT_COUNT + gl_VertexID).xyz;
+	}
+	float age = float(gCurrentFrame - frame) / float(gFadeLength);
+	gl_Position = gMVP * vec4(position, 1.0);
+	Color = vec4(gColor, 0.6 * (1.0 - age));
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 2) in vec3 inJointPosition;		// per instance
+layout (location = 3) in vec3 inJointColor;			// per instance
+layout (location = 4) in float inJointTrackingState;	// per instance
+
+out vec4 Color;
+
+uniform mat4 gMVP;
+uniform mat4 gSpecific;
+
+const float TRACKING_STATE_INFERRED = 1.0;
+
+void main()
+{
+	vec4 posLocal = gSpecific * vec4(inPosition, 1.0);
+	gl_Position = gMVP * vec4(posLocal.xyz + inJointPosition, 1.0);
+	Color = vec4(inJointColor, 1);
+	if (inJointTrackingState == TRACKING_STATE_INFERRED) Color.b = 1.0;
+}
@@ -11,15 +11,25 @@ out vec3 Normal0;
 out vec3 WorldPos0;                                                                 
 out float ToBeDiscarded;
 
-const int MAX_BONES = 100;
+const int MAX_BONES = 256;
 const mat4 ZeroMat4 = mat4(0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0);
 
 uniform mat4 gWVP;
 uniform mat4 gWorld;
-uniform mat4 gBones[MAX_BONES];
-uniform bool visible[MAX_BONES];
+// whole palette uploaded at once, one bit per bone for the visibility
+layout (std140) uniform BonePalette {
+	mat4 gBones[MAX_BONES];
+};
+layout (std140) uniform BoneVisibility {
+	uvec4 visibleBits[MAX_BONES / 128];
+};
 uniform bool skinningOn;
 
+bool visible(int bone)
+{
+	return (visibleBits[bone / 128][(bone / 32) % 4] & (1u << uint(bone % 32))) != 0u;
+}
+
 void main()
 {
 	mat4 BoneTransform;
@@ -28,7 +38,7 @@ void main()
 	ToBeDiscarded = 1;
 	for (int i = 0; i < 4 ; i++){
 		FinalTransforms[i] = gBones[BoneIDs[i]];
-		if (visible[BoneIDs[i]]) ToBeDiscarded = 0;
+		if (visible(BoneIDs[i])) ToBeDiscarded = 0;
 	}
 	// skinning?
 	if (!skinningOn){
@@ -0,0 +1,144 @@
+// Own
+#include "asset_loader.h"
+
+// Project
+#include "mesh_registry.h"
+#include "skinned_mesh.h"
+
+// Qt
+#include <QtCore\QRunnable>
+
+class ImageJob : public QRunnable
+{
+public:
+	ImageJob(AssetLoader* loader, int id, const QString& fileName, bool compress)
+		:
+		m_loader(loader),
+		m_id(id),
+		m_fileName(fileName),
+		m_compress(compress)
+	{
+	}
+	void run() override
+	{
+		if (m_compress && loadCompressed()) {
+			return;
+		}
+		QImage image(m_fileName);
+		if (image.isNull()) {
+			cout << "Could not decode image " << m_fileName.toStdString() << endl;
+		}
+		else if (image.format() != QImage::Format_RGBA8888) {
+			image = image.convertToFormat(QImage::Format_RGBA8888);
+		}
+		emit m_loader->imageLoaded(m_id, image); // queued to the loader's thread
+	}
+private:
+	// False if the image could not be decoded, so that it is reported through imageLoaded
+	bool loadCompressed()
+	{
+		const QString cachePath = TextureCache::cachePath(m_fileName);
+		const QByteArray hash = TextureCache::hashFile(m_fileName);
+		CompressedTexture texture;
+		if (hash.isEmpty()) {
+			return false;
+		}
+		if (!TextureCache::read(cachePath, hash, texture)) {
+			QImage image(m_fileName);
+			if (image.isNull()) {
+				return false;
+			}
+			texture = TextureCache::compress(image);
+			if (!TextureCache::write(cachePath, hash, texture)) {
+				cout << "Could not write texture cache " << cachePath.toStdString() << endl;
+			}
+		}
+		emit m_loader->compressedTextureLoaded(m_id, texture); // queued to the loader's thread
+		return true;
+	}
+
+	AssetLoader* m_loader;
+	int m_id;
+	QString m_fileName;
+	bool m_compress;
+};
+
+class SkinnedMeshJob : public QRunnable
+{
+public:
+	SkinnedMeshJob(AssetLoader* loader, int id, SkinnedMesh* mesh, const string& fileName)
+		:
+		m_loader(loader),
+		m_id(id),
+		m_mesh(mesh),
+		m_fileName(fileName)
+	{
+	}
+	void run() override
+	{
+		m_mesh->loadFromFile(m_fileName);
+		emit m_loader->meshLoaded(m_id); // queued to the loader's thread
+	}
+private:
+	AssetLoader* m_loader;
+	int m_id;
+	SkinnedMesh* m_mesh;
+	string m_fileName;
+};
+
+// The props share the registry's arena, so they are imported by one job
+class PropsJob : public QRunnable
+{
+public:
+	PropsJob(AssetLoader* loader, int id, MeshRegistry* registry, const vector<string>& fileNames)
+		:
+		m_loader(loader),
+		m_id(id),
+		m_registry(registry),
+		m_fileNames(fileNames)
+	{
+	}
+	void run() override
+	{
+		for (const string& fileName : m_fileNames) {
+			m_registry->load(fileName);
+		}
+		emit m_loader->meshLoaded(m_id); // queued to the loader's thread
+	}
+private:
+	AssetLoader* m_loader;
+	int m_id;
+	MeshRegistry* m_registry;
+	vector<string> m_fileNames;
+};
+
+AssetLoader::AssetLoader(QObject* parent)
+	:
+	QObject(parent)
+{
+	qRegisterMetaType<CompressedTexture>("CompressedTexture");
+}
+AssetLoader::~AssetLoader()
+{
+	m_pool.waitForDone();
+}
+bool AssetLoader::textureCompression() const
+{
+	return m_textureCompression;
+}
+void AssetLoader::setTextureCompression(bool enabled)
+{
+	m_textureCompression = enabled;
+}
+void AssetLoader::loadImage(int id, const QString& fileName)
+{
+	m_pool.start(new ImageJob(this, id, fileName, m_textureCompression));
+}
+void AssetLoader::loadSkinnedMesh(int id, SkinnedMesh* mesh, const string& fileName)
+{
+	m_pool.start(new SkinnedMeshJob(this, id, mesh, fileName));
+}
+void AssetLoader::loadProps(int id, MeshRegistry* registry, const vector<string>& fileNames)
+{
+	m_pool.start(new PropsJob(this, id, registry, fileNames));
+}
@@ -0,0 +1,49 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+// Project
+#include "texture_cache.h"
+#include "util.h"
+
+// Qt
+#include <QtCore\QObject>
+#include <QtCore\QThreadPool>
+#include <QtGui\QImage>
+
+// Standard C/C++
+#include <string>
+#include <vector>
+
+class MeshRegistry;
+class SkinnedMesh;
+
+// Loads assets on its own thread pool, so that only the OpenGL uploads are left to the GUI thread.
+// Decoded images arrive one at a time through imageLoaded, on the thread the loader lives in.
+// With texture compression on, images arrive instead as block compressed mip chains through
+// compressedTextureLoaded, read from their texture cache files or compressed and cached on a miss.
+// Models are imported on the pool as well and announced through meshLoaded, until then the
+// mesh or registry that is being filled must not be touched.
+class AssetLoader : public QObject
+{
+	Q_OBJECT
+public:
+	explicit AssetLoader(QObject* parent = Q_NULLPTR);
+	~AssetLoader(); // waits for the running jobs
+
+	bool textureCompression() const;
+	void setTextureCompression(bool enabled); // applies to the images requested afterwards
+	void loadImage(int id, const QString& fileName); // id is passed back with the image
+	void loadSkinnedMesh(int id, SkinnedMesh* mesh, const string& fileName); // id is passed back with meshLoaded
+	void loadProps(int id, MeshRegistry* registry, const vector<string>& fileNames); // one after another, one meshLoaded
+
+signals:
+	void imageLoaded(int id, const QImage& image); // Format_RGBA8888, null if the file could not be decoded
+	void compressedTextureLoaded(int id, const CompressedTexture& texture);
+	void meshLoaded(int id); // also if the import failed, the mesh tells
+
+private:
+	QThreadPool m_pool;
+	bool m_textureCompression = false;
+};
+
+#endif
@@ -0,0 +1,470 @@
+// Project
+#include "kmotion_generator.h"
+#include "kreplay_source.h"
+#include "kskeleton.h"
+#include "ksynthetic_source.h"
+#include "log.h"
+#include "stage_cache.h"
+
+// Qt
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QTextStream>
+#include <QtCore/QThreadPool>
+
+// Standard C/C++
+#include <atomic>
+#include <climits>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+// Reprocesses archived sessions (sequences.txt files) with the current pipeline, one session per worker.
+// Every session gets a directory in the output directory with athlete.trc, trainer.trc and the
+// processed sequences.txt, and report.csv lists the stage timings and phase indices of all of them.
+// Body streams (--replay) and synthetic motions (--synthetic) are captured instead, frame by frame
+// through KSkeleton::addFrame as recorded by the sensor, and then processed like the archived sessions.
+// Their load time is the capture time, with the streaming filter running on every recorded frame.
+
+// Discards the processing output of the sessions unless --verbose is given
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override
+	{
+		return c;
+	}
+};
+
+struct Session
+{
+	enum Source
+	{
+		ARCHIVE,	// input is a sequences.txt file
+		REPLAY,		// input is a body stream file
+		SYNTHETIC	// the motion is generated for syntheticDuration seconds
+	};
+	Source source = ARCHIVE;
+	QString input;
+	double syntheticDuration = 0.;
+	quint32 seed = 1;
+	QString outputDir;
+	bool ok = false;
+	QString error;
+	int athleteFrames = 0;
+	int trainerFrames = 0;
+	double loadTime = 0.;
+	KProcessingTimes processingTimes;
+	double exportTime = 0.;
+	double totalTime = 0.;
+	array<uint, NUM_PHASES> athletePhases;
+	array<uint, NUM_PHASES> trainerPhases;
+};
+
+static const int sessionInterpolationStart = INT_MIN; // each session is processed with its own
+static std::mutex s_progressMutex;
+static std::atomic<int> s_finishedSessions(0);
+
+class SessionJob : public QRunnable
+{
+public:
+	SessionJob(Session& session, int interpolationStart, bool compress, const QString& stageCacheDir, int sessionCount)
+		:
+		m_session(session),
+		m_interpolationStart(interpolationStart),
+		m_compress(compress),
+		m_stageCacheDir(stageCacheDir),
+		m_sessionCount(sessionCount)
+	{
+	}
+	void run() override
+	{
+		QElapsedTimer total;
+		total.start();
+		process();
+		m_session.totalTime = total.nsecsElapsed() / 1e6;
+
+		int finished = ++s_finishedSessions;
+		std::lock_guard<std::mutex> lock(s_progressMutex);
+		cerr << "[" << finished << "/" << m_sessionCount << "] "
+			<< m_session.input.toStdString() << ": "
+			<< (m_session.ok ? "done" : m_session.error.toStdString())
+			<< " (" << (int)m_session.totalTime << " ms)" << endl;
+	}
+private:
+	void process()
+	{
+		const QString noFile;
+		KSkeleton skeleton(noFile, noFile); // a skeleton per session, processing changes its limbs
+		skeleton.stageCache()->setDiskDirectory(m_stageCacheDir);
+
+		QElapsedTimer timer;
+		timer.start();
+		if (m_session.source == Session::ARCHIVE && !skeleton.loadMotion(m_session.input)) {
+			m_session.error = "could not load";
+			return;
+		}
+		if (m_session.source != Session::ARCHIVE && !capture(skeleton)) {
+			return;
+		}
+		m_session.loadTime = timer.nsecsElapsed() / 1e6;
+		m_session.athleteFrames = skeleton.m_athleteRawMotion.size();
+		m_session.trainerFrames = skeleton.m_trainerRawMotion.size();
+		if (m_session.athleteFrames == 0 && m_session.trainerFrames == 0) {
+			m_session.error = "no raw motion";
+			return;
+		}
+
+		skeleton.m_athleteRecording = m_session.athleteFrames > 0;
+		skeleton.m_trainerRecording = m_session.trainerFrames > 0;
+		if (m_session.source == Session::ARCHIVE) {
+			int interpolationStart = m_interpolationStart;
+			if (interpolationStart == sessionInterpolationStart) {
+				interpolationStart = skeleton.interpolationStart(m_session.athleteFrames > 0 ? SESSION_ATHLETE : SESSION_TRAINER);
+			}
+			skeleton.processMotions(interpolationStart); // a capture is processed when it finishes
+		}
+		m_session.athletePhases = skeleton.m_athletePhases;
+		m_session.trainerPhases = skeleton.m_trainerPhases;
+
+		timer.start();
+		if (!QDir().mkpath(m_session.outputDir)) {
+			m_session.error = "could not create " + m_session.outputDir;
+			return;
+		}
+		// exportToTRC writes the athlete's rescaled motion while recording the athlete, or the adjusted one
+		// without a trainer, else the trainer's adjusted one
+		bool exported = true;
+		if (m_session.athleteFrames > 0) {
+			skeleton.m_athleteRecording = true;
+			exported &= skeleton.exportToTRC(m_session.outputDir + "/athlete.trc");
+		}
+		if (m_session.trainerFrames > 0) {
+			skeleton.m_athleteRecording = false;
+			exported &= skeleton.exportToTRC(m_session.outputDir + "/trainer.trc");
+		}
+		exported &= skeleton.saveFrameSequences(m_session.outputDir + "/sequences.txt", m_compress);
+		// the athlete's rescale is derived by its export
+		m_session.processingTimes = skeleton.processingTimes();
+		m_session.exportTime = timer.nsecsElapsed() / 1e6 - m_session.processingTimes.rescale;
+		if (!exported) {
+			m_session.error = "could not write the output";
+			return;
+		}
+		m_session.ok = true;
+	}
+
+	// Records the athlete from the session's body source as KSensor does, the recording starts after
+	// a pre-roll and stops before the last frames, which finish the filter. Frames not tracking exactly
+	// one person or following a gap are discarded, during the recording they abort it.
+	bool capture(KSkeleton& skeleton)
+	{
+		std::unique_ptr<KBodySource> source;
+		if (m_session.source == Session::REPLAY) {
+			source.reset(new KReplaySource(m_session.input, 0.));
+		}
+		else {
+			KMotionGeneratorSettings settings;
+			settings.duration = m_session.syntheticDuration;
+			settings.seed = m_session.seed;
+			source.reset(new KSyntheticSource(KMotionGenerator(skeleton.nodes(), skeleton.limbs(), settings), 0.));
+		}
+		if (!source->open()) {
+			m_session.error = "could not open the body source";
+			return false;
+		}
+
+		const uint preRoll = 30; // frames, longer than the filter's delay
+		const uint postRoll = 30;
+		skeleton.m_athleteRecording = true;
+		skeleton.m_trainerRecording = false;
+		uint addedFrames = 0;
+		bool started = false;
+		bool aborted = false;
+		double lastTimestamp = -1.;
+		std::deque<KFrame> lookahead; // the post-roll, added once the source is exhausted
+		auto add = [&](const KFrame& frame) {
+			if (addedFrames == preRoll) {
+				skeleton.record(false);
+				started = true;
+			}
+			skeleton.addFrame(frame);
+			addedFrames++;
+		};
+		KBodyFrame bodyFrame;
+		while (source->acquireFrame(bodyFrame)) {
+			bool discarded = bodyFrame.personsTracked != 1 || (lastTimestamp >= 0. && bodyFrame.timestamp - lastTimestamp > 0.1);
+			lastTimestamp = bodyFrame.timestamp;
+			if (discarded) {
+				aborted |= started;
+				continue;
+			}
+			KFrame frame;
+			frame.setJoints(bodyFrame.joints, bodyFrame.orientations);
+			frame.timestamp = bodyFrame.timestamp;
+			lookahead.push_back(frame);
+			if (lookahead.size() > postRoll) {
+				add(lookahead.front());
+				lookahead.pop_front();
+			}
+		}
+		source->close();
+		if (aborted) {
+			m_session.error = "discarded frame during the recording";
+			return false;
+		}
+		if (!started || lookahead.size() < postRoll) {
+			m_session.error = "too few frames to record";
+			return false;
+		}
+		skeleton.record(false);
+		for (const KFrame& frame : lookahead) {
+			skeleton.addFrame(frame);
+		}
+		if (skeleton.m_isFinalizing) {
+			m_session.error = "the recording did not finish";
+			return false;
+		}
+		return true;
+	}
+
+	Session& m_session;
+	int m_interpolationStart;
+	bool m_compress;
+	QString m_stageCacheDir;
+	int m_sessionCount;
+};
+
+// Session files of a file or directory argument, directories are searched recursively for sequences.txt
+static QStringList findSessions(const QString& path)
+{
+	QStringList sessions;
+	QFileInfo info(path);
+	if (info.isFile()) {
+		sessions << info.absoluteFilePath();
+	}
+	else if (info.isDir()) {
+		QDirIterator it(path, QStringList() << "sequences.txt", QDir::Files, QDirIterator::Subdirectories);
+		while (it.hasNext()) {
+			sessions << QFileInfo(it.next()).absoluteFilePath();
+		}
+		sessions.sort();
+	}
+	else {
+		cerr << "No such file or directory: " << path.toStdString() << endl;
+	}
+	return sessions;
+}
+// Manifest lines are session files or directories, relative to the manifest, # starts a comment
+static bool readManifest(const QString& fileName, QStringList& paths)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		cerr << "Could not read manifest " << fileName.toStdString() << endl;
+		return false;
+	}
+	QDir base = QFileInfo(fileName).absoluteDir();
+	QTextStream in(&file);
+	while (!in.atEnd()) {
+		QString line = in.readLine().section('#', 0, 0).trimmed();
+		if (!line.isEmpty()) {
+			paths << QDir::cleanPath(base.absoluteFilePath(line));
+		}
+	}
+	return true;
+}
+// Session directory name in the output, from the directory of its sequences.txt
+static QString outputName(const QString& session, QSet<QString>& usedNames)
+{
+	QFileInfo info(session);
+	QString name = info.fileName() == "sequences.txt" ? info.absoluteDir().dirName() : info.completeBaseName();
+	if (name.isEmpty()) {
+		name = "session";
+	}
+	QString unique = name;
+	for (int i = 2; usedNames.contains(unique); i++) {
+		unique = QString("%1_%2").arg(name).arg(i);
+	}
+	usedNames.insert(unique);
+	return unique;
+}
+static QString phasesToString(const array<uint, NUM_PHASES>& phases)
+{
+	QStringList list;
+	for (uint i = 0; i < NUM_PHASES; i++) {
+		list << (phases[i] == (uint)INVALID_JOINT_ID ? QString("-") : QString::number(phases[i]));
+	}
+	return list.join(' ');
+}
+static bool writeReport(const QString& fileName, const vector<Session>& sessions)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		return false;
+	}
+	QTextStream out(&file);
+	out << "session,status,athlete_frames,trainer_frames,"
+		"load_ms,interpolate_ms,filter_ms,adjust_ms,phases_ms,rescale_ms,export_ms,total_ms,"
+		"athlete_phases,trainer_phases\n";
+	for (uint i = 0; i < sessions.size(); i++) {
+		const Session& s = sessions[i];
+		const KProcessingTimes& t = s.processingTimes;
+		out << "\"" << s.input << "\"," << (s.ok ? QString("ok") : "\"" + s.error + "\"") << ","
+			<< s.athleteFrames << "," << s.trainerFrames << ","
+			<< s.loadTime << "," << t.interpolate << "," << t.filter << "," << t.adjust << ","
+			<< t.phases << "," << t.rescale << "," << s.exportTime << "," << s.totalTime << ","
+			<< (s.ok ? phasesToString(s.athletePhases) : QString()) << ","
+			<< (s.ok ? phasesToString(s.trainerPhases) : QString()) << "\n";
+	}
+	out.flush();
+	return out.status() == QTextStream::Ok;
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("DiplomaBatch");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Reprocesses archived sessions with the motion processing pipeline.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("sessions", "sequences.txt files or directories searched for them.", "[sessions...]");
+	QCommandLineOption manifestOption(QStringList() << "m" << "manifest", "File with a session file or directory per line.", "file");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Output directory, batch_output by default.", "directory", "batch_output");
+	QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Sessions processed at once, one per core by default.", "count");
+	QCommandLineOption startOption("interpolation-start", "Counter of the first interpolated frame, the session's own by default.", "counter");
+	QCommandLineOption compressOption(QStringList() << "c" << "compress", "Write compressed session files for the archive.");
+	QCommandLineOption stageCacheOption("stage-cache", "Directory keeping the derived stages between runs.", "directory");
+	QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print the processing output of every session.");
+	QCommandLineOption logLevelOption("log-level", "trace, debug, info, warning, error or off.", "level");
+	QCommandLineOption replayOption("replay", "Body stream file captured and processed as a session, can be repeated.", "file");
+	QCommandLineOption syntheticOption("synthetic", "Synthetic motion of that length captured and processed as a session, can be repeated.", "seconds");
+	parser.addOption(manifestOption);
+	parser.addOption(outputOption);
+	parser.addOption(jobsOption);
+	parser.addOption(startOption);
+	parser.addOption(compressOption);
+	parser.addOption(stageCacheOption);
+	parser.addOption(verboseOption);
+	parser.addOption(logLevelOption);
+	parser.addOption(replayOption);
+	parser.addOption(syntheticOption);
+	parser.process(app);
+
+	if (parser.isSet(logLevelOption)) {
+		int level;
+		if (!Log::parseLevel(parser.value(logLevelOption).toStdString(), level)) {
+			cerr << "Unknown log level " << parser.value(logLevelOption).toStdString() << endl;
+			return 2;
+		}
+		Log::setLevel(level);
+	}
+
+	QStringList paths = parser.positionalArguments();
+	if (parser.isSet(manifestOption) && !readManifest(parser.value(manifestOption), paths)) {
+		return 2;
+	}
+	QStringList sessionFiles;
+	for (int i = 0; i < paths.size(); i++) {
+		sessionFiles << findSessions(paths[i]);
+	}
+	sessionFiles.removeDuplicates();
+	const QStringList replayFiles = parser.values(replayOption);
+	const QStringList syntheticDurations = parser.values(syntheticOption);
+	if (sessionFiles.isEmpty() && replayFiles.isEmpty() && syntheticDurations.isEmpty()) {
+		cerr << "No sessions to process." << endl;
+		parser.showHelp(2);
+	}
+
+	const QDir outputDir(parser.value(outputOption));
+	if (!QDir().mkpath(outputDir.absolutePath())) {
+		cerr << "Could not create " << outputDir.absolutePath().toStdString() << endl;
+		return 2;
+	}
+	vector<Session> sessions(sessionFiles.size() + replayFiles.size() + syntheticDurations.size());
+	QSet<QString> usedNames;
+	uint s = 0;
+	for (int i = 0; i < sessionFiles.size(); i++, s++) {
+		sessions[s].input = sessionFiles[i];
+		sessions[s].outputDir = outputDir.absoluteFilePath(outputName(sessionFiles[i], usedNames));
+	}
+	for (int i = 0; i < replayFiles.size(); i++, s++) {
+		sessions[s].source = Session::REPLAY;
+		sessions[s].input = QFileInfo(replayFiles[i]).absoluteFilePath();
+		sessions[s].outputDir = outputDir.absoluteFilePath(outputName(replayFiles[i], usedNames));
+	}
+	for (int i = 0; i < syntheticDurations.size(); i++, s++) {
+		bool ok;
+		sessions[s].syntheticDuration = syntheticDurations[i].toDouble(&ok);
+		if (!ok || sessions[s].syntheticDuration <= 0.) {
+			cerr << "Invalid synthetic duration " << syntheticDurations[i].toStdString() << endl;
+			return 2;
+		}
+		sessions[s].source = Session::SYNTHETIC;
+		sessions[s].input = QString("synthetic %1 s").arg(syntheticDurations[i]);
+		sessions[s].seed = i + 1;
+		sessions[s].outputDir = outputDir.absoluteFilePath(outputName("synthetic", usedNames));
+	}
+
+	QThreadPool pool;
+	if (parser.isSet(jobsOption)) {
+		int jobs = parser.value(jobsOption).toInt();
+		if (jobs < 1) {
+			cerr << "Invalid job count " << parser.value(jobsOption).toStdString() << endl;
+			return 2;
+		}
+		pool.setMaxThreadCount(jobs);
+	}
+	int interpolationStart = sessionInterpolationStart;
+	if (parser.isSet(startOption)) {
+		bool ok;
+		interpolationStart = parser.value(startOption).toInt(&ok);
+		if (!ok || interpolationStart == sessionInterpolationStart) {
+			cerr << "Invalid interpolation start " << parser.value(startOption).toStdString() << endl;
+			return 2;
+		}
+	}
+
+	NullBuffer nullBuffer;
+	std::streambuf* coutBuffer = cout.rdbuf();
+	if (!parser.isSet(verboseOption)) {
+		cout.rdbuf(&nullBuffer);
+	}
+
+	cerr << "Processing " << sessions.size() << " sessions on " << pool.maxThreadCount() << " threads" << endl;
+	QElapsedTimer wallTime;
+	wallTime.start();
+	for (uint i = 0; i < sessions.size(); i++) {
+		pool.start(new SessionJob(
+			sessions[i],
+			interpolationStart,
+			parser.isSet(compressOption),
+			parser.value(stageCacheOption),
+			sessions.size()));
+	}
+	pool.waitForDone();
+	cout.rdbuf(coutBuffer);
+
+	int failed = 0;
+	for (uint i = 0; i < sessions.size(); i++) {
+		if (!sessions[i].ok) failed++;
+	}
+	const QString reportFile = outputDir.absoluteFilePath("report.csv");
+	if (!writeReport(reportFile, sessions)) {
+		cerr << "Could not write " << reportFile.toStdString() << endl;
+		return 1;
+	}
+	cout << "Processed " << sessions.size() - failed << " of " << sessions.size() << " sessions in "
+		<< wallTime.elapsed() << " ms, report in " << reportFile.toStdString() << endl;
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,659 @@
+// Project
+#include "kmotion_generator.h"
+#include "kresampler.h"
+#include "kskeleton.h"
+#include "motion_codec.h"
+#include "motion_view.h"
+#include "session_file.h"
+#include "sg_filter.h"
+#include "stage_cache.h"
+
+// Qt
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QTemporaryDir>
+
+// Standard C/C++
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <streambuf>
+
+// Checks of what the processing core promises about its results, run by ctest.
+// Every check prints its failures to cerr, the processing output is discarded.
+
+// Discards the processing output
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override
+	{
+		return c;
+	}
+};
+
+static int s_failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+static bool check(bool condition, const char* expression, const char* file, int line)
+{
+	if (!condition) {
+		cerr << file << ":" << line << ": check failed: " << expression << endl;
+		s_failures++;
+	}
+	return condition;
+}
+
+static bool sameJoint(const KJoint& a, const KJoint& b)
+{
+	return a.position == b.position && a.trackingState == b.trackingState &&
+		a.orientation.scalar() == b.orientation.scalar() && a.orientation.vector() == b.orientation.vector();
+}
+// bitwise equal frames, apart from the serials
+static bool sameFrames(const QVector<KFrame>& a, const QVector<KFrame>& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (int i = 0; i < a.size(); i++) {
+		if (a[i].timestamp != b[i].timestamp) {
+			return false;
+		}
+		for (uint j = 0; j < JointType_Count; j++) {
+			if (!sameJoint(a[i].joints[j], b[i].joints[j])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+static bool sameSerials(const QVector<KFrame>& a, const QVector<KFrame>& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (int i = 0; i < a.size(); i++) {
+		if (a[i].serial != b[i].serial) {
+			return false;
+		}
+	}
+	return true;
+}
+static QVector<KFrame> generateMotion(const KSkeleton& skeleton, double duration, quint32 seed)
+{
+	KMotionGeneratorSettings settings;
+	settings.duration = duration;
+	settings.seed = seed;
+	settings.inferredRatio = 0.05;
+	KMotionGenerator generator(skeleton.nodes(), skeleton.limbs(), settings);
+	return generator.generate();
+}
+
+// degrees between the rotations, q and -q are the same rotation
+static double rotationAngle(const QQuaternion& a, const QQuaternion& b)
+{
+	const double qa[4] = { a.scalar(), a.x(), a.y(), a.z() };
+	const double qb[4] = { b.scalar(), b.x(), b.y(), b.z() };
+	double dot = 0., lengthA = 0., lengthB = 0.;
+	for (int c = 0; c < 4; c++) {
+		dot += qa[c] * qb[c];
+		lengthA += qa[c] * qa[c];
+		lengthB += qb[c] * qb[c];
+	}
+	double cosine = min(1., fabs(dot) / sqrt(lengthA * lengthB));
+	return 2. * acos(cosine) * 180. / PI;
+}
+
+static const SavitzkyGolayFilter::InstructionSet instructionSets[] = {
+	SavitzkyGolayFilter::InstructionSet::SCALAR,
+	SavitzkyGolayFilter::InstructionSet::SSE2,
+	SavitzkyGolayFilter::InstructionSet::AVX2
+};
+static const char* instructionSetNames[] = { "scalar", "SSE2", "AVX2" };
+
+// Every kernel gives the scalar kernel's results, for sizes that leave a tail after the vectors
+static void testFilterKernels()
+{
+	const SavitzkyGolayFilter::InstructionSet supported = SavitzkyGolayFilter::instructionSet();
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> uniform(-2.f, 2.f);
+	const int taps = 25;
+	vector<float> coefficients(taps);
+	for (int k = 0; k < taps; k++) {
+		coefficients[k] = uniform(random);
+	}
+	SavitzkyGolayFilter filter(coefficients.data(), taps, 1 / 5175.f);
+	const int maxSize = 203;
+	vector<float> in(maxSize + taps - 1);
+	for (uint i = 0; i < in.size(); i++) {
+		in[i] = uniform(random);
+	}
+
+	for (int size = 1; size <= maxSize; size += (size < 40 ? 1 : 27)) {
+		vector<float> expected(size);
+		SavitzkyGolayFilter::setInstructionSet(SavitzkyGolayFilter::InstructionSet::SCALAR);
+		filter.convolve(in.data(), expected.data(), size);
+		for (uint s = 1; s < ARRAY_SIZE_IN_ELEMENTS(instructionSets); s++) {
+			SavitzkyGolayFilter::setInstructionSet(instructionSets[s]);
+			if (SavitzkyGolayFilter::instructionSet() != instructionSets[s]) {
+				continue; // not supported by the cpu
+			}
+			vector<float> out(size);
+			filter.convolve(in.data(), out.data(), size);
+			if (!CHECK(memcmp(out.data(), expected.data(), size * sizeof(float)) == 0)) {
+				cerr << "  " << instructionSetNames[s] << " kernel, size " << size << endl;
+			}
+		}
+	}
+
+	// and the filtered motions of every kernel are the same
+	KSkeleton skeleton("", "");
+	const QVector<KFrame> raw = generateMotion(skeleton, 4., 3);
+	const QVector<KFrame> interpolated = skeleton.interpolateMotion(raw, 0, raw.size());
+	SavitzkyGolayFilter::setInstructionSet(SavitzkyGolayFilter::InstructionSet::SCALAR);
+	const QVector<KFrame> expected = skeleton.filterMotion(interpolated);
+	CHECK(!expected.empty());
+	for (uint s = 1; s < ARRAY_SIZE_IN_ELEMENTS(instructionSets); s++) {
+		SavitzkyGolayFilter::setInstructionSet(instructionSets[s]);
+		if (SavitzkyGolayFilter::instructionSet() != instructionSets[s]) {
+			cerr << "Skipping the " << instructionSetNames[s] << " kernel, the cpu does not support it" << endl;
+			continue;
+		}
+		if (!CHECK(sameFrames(skeleton.filterMotion(interpolated), expected))) {
+			cerr << "  filterMotion with the " << instructionSetNames[s] << " kernel" << endl;
+		}
+	}
+	SavitzkyGolayFilter::setInstructionSet(supported);
+}
+
+// The frame by frame interpolation the resampler replaced: frame i at interval * (counterStart + i)
+// between the frames around it, or extrapolated from the first or last two frames
+static QVector<KFrame> referenceInterpolation(const QVector<KFrame>& motion, double interval, int counterStart, int desiredSize)
+{
+	QVector<KFrame> interpolatedMotion;
+	int index = 1;
+	for (int counter = counterStart; counter < counterStart + desiredSize; counter++) {
+		const double time = interval * counter;
+		while (index < motion.size() && motion[index].timestamp <= time) {
+			index++;
+		}
+		if (index > motion.size() - 1) index = motion.size() - 1;
+		const KFrame& previous = motion[index - 1];
+		const KFrame& next = motion[index];
+		const double percentDistance = (time - previous.timestamp) / (next.timestamp - previous.timestamp);
+		KFrame frame;
+		frame.serial = counter;
+		frame.timestamp = time;
+		for (uint j = 0; j < JointType_Count; j++) {
+			const KJoint& a = previous.joints[j];
+			const KJoint& b = next.joints[j];
+			frame.joints[j].position.setX(a.position.x() + percentDistance * (b.position.x() - a.position.x()));
+			frame.joints[j].position.setY(a.position.y() + percentDistance * (b.position.y() - a.position.y()));
+			frame.joints[j].position.setZ(a.position.z() + percentDistance * (b.position.z() - a.position.z()));
+			frame.joints[j].orientation = QQuaternion::nlerp(a.orientation, b.orientation, percentDistance);
+			const bool inferred = a.trackingState == TrackingState_Inferred || b.trackingState == TrackingState_Inferred;
+			frame.joints[j].trackingState = inferred ? TrackingState_Inferred : TrackingState_Tracked;
+		}
+		interpolatedMotion.push_back(frame);
+	}
+	return interpolatedMotion;
+}
+
+// The resampler gives the frame by frame interpolation's results, and slerp and squad pass through
+// the recorded orientations without jumping between them, squad more smoothly than slerp
+static void testResampler()
+{
+	KSkeleton skeleton("", "");
+	const QVector<KFrame> jittered = generateMotion(skeleton, 4., 9);
+	// recorded at exactly 30 Hz, so that every recorded frame is also resampled
+	QVector<KFrame> motion = jittered;
+	for (int i = 0; i < motion.size(); i++) {
+		motion[i].timestamp = i / 30.;
+	}
+	const double rates[] = { 60., 120. };
+	for (uint r = 0; r < ARRAY_SIZE_IN_ELEMENTS(rates); r++) {
+		KResampler resampler(1. / rates[r]);
+		// the frames before and after the motion are extrapolated
+		const int counterStart = -5;
+		const int size = (int)(rates[r] * jittered.back().timestamp) + 10;
+		const QVector<KFrame> resampled = resampler.resample(MotionBuffer(jittered), counterStart, size).toFrames();
+		if (!CHECK(sameFrames(resampled, referenceInterpolation(jittered, resampler.interval(), counterStart, size)))) {
+			cerr << "  nlerp at " << rates[r] << " Hz" << endl;
+		}
+
+		const KResampler::Orientation orientations[] = { KResampler::Orientation::SLERP, KResampler::Orientation::SQUAD };
+		const char* orientationNames[] = { "slerp", "squad" };
+		const int step = (int)rates[r] / 30; // resampled frames per recorded frame
+		double slerpKink = 0.;
+		for (uint o = 0; o < ARRAY_SIZE_IN_ELEMENTS(orientations); o++) {
+			resampler.setOrientation(orientations[o]);
+			const QVector<KFrame> frames = resampler.resample(MotionBuffer(motion)).toFrames();
+			if (!CHECK(frames.size() == (motion.size() - 1) * step + 1)) {
+				continue;
+			}
+			double endpointError = 0.; // degrees
+			double largestStep = 0.; // of the resampled orientations, relative to the recorded ones
+			double kinkSum = 0.; // change of the steps at the recorded frames, relative to the steps
+			int kinks = 0;
+			for (uint j = 0; j < JointType_Count; j++) {
+				double recordedStep = 0.;
+				for (int i = 0; i + 1 < motion.size(); i++) {
+					recordedStep = max(recordedStep, rotationAngle(motion[i].joints[j].orientation, motion[i + 1].joints[j].orientation));
+				}
+				for (int i = 0; i < motion.size(); i++) {
+					endpointError = max(endpointError, rotationAngle(frames[i * step].joints[j].orientation, motion[i].joints[j].orientation));
+				}
+				for (int i = 0; i + 1 < frames.size() && recordedStep > 0.; i++) {
+					const double angle = rotationAngle(frames[i].joints[j].orientation, frames[i + 1].joints[j].orientation);
+					largestStep = max(largestStep, angle / recordedStep);
+				}
+				for (int i = step; i + step < frames.size(); i += step) {
+					const double before = rotationAngle(frames[i - 1].joints[j].orientation, frames[i].joints[j].orientation);
+					const double after = rotationAngle(frames[i].joints[j].orientation, frames[i + 1].joints[j].orientation);
+					if (before + after > 1e-3) {
+						kinkSum += fabs(after - before) / (before + after);
+						kinks++;
+					}
+				}
+			}
+			if (!CHECK(endpointError < 0.01)) {
+				cerr << "  " << orientationNames[o] << " at " << rates[r] << " Hz is " << endpointError <<
+					" degrees off a recorded orientation" << endl;
+			}
+			// a resampled frame is a fraction of a recorded frame apart, unless the curve jumps
+			if (!CHECK(largestStep <= 1.)) {
+				cerr << "  " << orientationNames[o] << " at " << rates[r] << " Hz steps " << largestStep <<
+					" times the largest recorded step" << endl;
+			}
+			// slerp turns at every recorded frame, squad's tangents smooth the turns
+			const double kink = kinks > 0 ? kinkSum / kinks : 0.;
+			if (orientations[o] == KResampler::Orientation::SLERP) {
+				slerpKink = kink;
+			}
+			else if (!CHECK(kink < slerpKink)) {
+				cerr << "  squad at " << rates[r] << " Hz turns by " << kink << " at the recorded frames, slerp by " <<
+					slerpKink << endl;
+			}
+		}
+	}
+}
+
+// A recording is interpolated and filtered while it is captured, exactly like afterwards
+static void testStreamingFilter()
+{
+	KSkeleton skeleton("", "");
+	const QVector<KFrame> frames = generateMotion(skeleton, 6., 5);
+	const int preRoll = 20; // frames before the recording, more than the filter's delay
+	const int postRoll = 20; // frames after it, the recording is finished once the delay passed
+	CHECK(frames.size() > preRoll + postRoll + 50);
+
+	skeleton.m_athleteRecording = true;
+	skeleton.m_trainerRecording = false;
+	int i = 0;
+	for (; i < preRoll; i++) {
+		skeleton.addFrame(frames[i]);
+	}
+	skeleton.record(false);
+	for (; i < frames.size() - postRoll; i++) {
+		skeleton.addFrame(frames[i]);
+	}
+	skeleton.record(false);
+	for (; i < frames.size(); i++) {
+		skeleton.addFrame(frames[i]);
+	}
+	if (!CHECK(!skeleton.m_isRecording && !skeleton.m_isFinalizing)) {
+		return;
+	}
+
+	const QVector<KFrame>& raw = skeleton.m_athleteRawMotion;
+	const int delay = (raw.size() - skeleton.motionView(SESSION_ATHLETE, SESSION_FILTERED).size()) / 2;
+	// the delay's frames before and after the recording are kept for the filter
+	CHECK(delay > 0 && raw.size() == frames.size() - preRoll - postRoll + 2 * delay);
+	const QVector<KFrame> interpolated = skeleton.interpolateMotion(raw, -delay, raw.size());
+	const QVector<KFrame> filtered = skeleton.filterMotion(interpolated);
+	CHECK(!filtered.empty());
+	CHECK(sameFrames(skeleton.motionView(SESSION_ATHLETE, SESSION_FILTERED).toFrames(), filtered));
+	CHECK(sameFrames(
+		skeleton.motionView(SESSION_ATHLETE, SESSION_INTERPOLATED).toFrames(),
+		interpolated.mid(delay, interpolated.size() - 2 * delay)));
+}
+
+// Both persons processed concurrently get exactly the stages, phases and limbs of the serial chain
+static void testConcurrentProcessing()
+{
+	KSkeleton skeleton("", "");
+	skeleton.m_athleteRawMotion = generateMotion(skeleton, 6., 21);
+	skeleton.m_trainerRawMotion = generateMotion(skeleton, 7., 23);
+	skeleton.m_athleteRecording = true;
+	skeleton.m_trainerRecording = true;
+
+	// the athlete first, the adjustment changes the skeleton's limbs
+	KSkeleton serial("", "");
+	array<QVector<KFrame>, NUM_SESSION_PERSONS> interpolated;
+	array<QVector<KFrame>, NUM_SESSION_PERSONS> filtered;
+	array<QVector<KFrame>, NUM_SESSION_PERSONS> adjusted;
+	array<array<uint, NUM_PHASES>, NUM_SESSION_PERSONS> phases;
+	const QVector<KFrame>* raw[NUM_SESSION_PERSONS] = { &skeleton.m_athleteRawMotion, &skeleton.m_trainerRawMotion };
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		interpolated[p] = serial.interpolateMotion(*raw[p], 0, raw[p]->size());
+		filtered[p] = serial.filterMotion(interpolated[p]);
+		adjusted[p] = serial.adjustMotion(filtered[p]);
+		phases[p] = serial.identifyPhases(adjusted[p]);
+	}
+
+	// a few times, the tasks finish in a different order every time
+	for (int run = 0; run < 4; run++) {
+		skeleton.stageCache()->clear();
+		skeleton.processMotions(0);
+		const array<uint, NUM_PHASES>* processedPhases[NUM_SESSION_PERSONS] = { &skeleton.m_athletePhases, &skeleton.m_trainerPhases };
+		for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+			const SessionPerson person = (SessionPerson)p;
+			const int crop = (interpolated[p].size() - filtered[p].size()) / 2;
+			bool same = CHECK(!filtered[p].empty());
+			same &= CHECK(sameFrames(
+				skeleton.motionView(person, SESSION_INTERPOLATED).toFrames(),
+				interpolated[p].mid(crop, filtered[p].size())));
+			same &= CHECK(sameFrames(skeleton.motionView(person, SESSION_FILTERED).toFrames(), filtered[p]));
+			same &= CHECK(sameFrames(skeleton.motionView(person, SESSION_ADJUSTED).toFrames(), adjusted[p]));
+			same &= CHECK(*processedPhases[p] == phases[p]);
+			if (!same) {
+				cerr << "  " << (p == SESSION_ATHLETE ? "athlete" : "trainer") << ", run " << run << endl;
+			}
+		}
+		bool sameLimbs = true;
+		for (uint i = 0; i < NUM_LIMBS; i++) {
+			const KLimb& a = skeleton.limbs()[i];
+			const KLimb& b = serial.limbs()[i];
+			sameLimbs &= a.averageLength == b.averageLength && a.desiredLength == b.desiredLength &&
+				a.minLength == b.minLength && a.maxLength == b.maxLength;
+		}
+		CHECK(sameLimbs);
+	}
+}
+
+// The cropped stages view the uncropped ones, and edits of a processed motion outlive the stage cache
+static void testDerivedStages()
+{
+	KSkeleton skeleton("", "");
+	skeleton.m_athleteRawMotion = generateMotion(skeleton, 6., 13);
+	skeleton.m_athleteRecording = true;
+	skeleton.m_trainerRecording = false;
+	skeleton.processMotions(0);
+
+	const QVector<KFrame> raw = skeleton.m_athleteRawMotion;
+	const int filteredSize = skeleton.motionView(SESSION_ATHLETE, SESSION_FILTERED).size();
+	const int crop = (raw.size() - filteredSize) / 2;
+	CHECK(crop > 0);
+	CHECK(sameFrames(skeleton.motionView(SESSION_ATHLETE, SESSION_RAW).toFrames(), raw.mid(crop, filteredSize)));
+	CHECK(skeleton.motion(SESSION_ATHLETE, SESSION_INTERPOLATED).size() == filteredSize);
+	CHECK(skeleton.stageCache()->size() <= skeleton.stageCache()->capacity());
+
+	const quint64 id = skeleton.motionId(SESSION_ATHLETE, SESSION_ADJUSTED);
+	const QVector<KFrame> adjusted = skeleton.motion(SESSION_ATHLETE, SESSION_ADJUSTED);
+	QVector<KFrame>& edited = skeleton.editableMotion(SESSION_ATHLETE, SESSION_ADJUSTED);
+	edited[0].joints[JointType_Head].position += QVector3D(0.f, 1.f, 0.f);
+	CHECK(skeleton.motionId(SESSION_ATHLETE, SESSION_ADJUSTED) != id);
+	skeleton.stageCache()->clear();
+	const QVector<KFrame> kept = skeleton.motion(SESSION_ATHLETE, SESSION_ADJUSTED);
+	CHECK(kept.size() == adjusted.size() &&
+		kept[0].joints[JointType_Head].position == adjusted[0].joints[JointType_Head].position + QVector3D(0.f, 1.f, 0.f));
+	// the other stages are stored as they were shown
+	CHECK(sameFrames(skeleton.motion(SESSION_ATHLETE, SESSION_RAW), raw.mid(crop, filteredSize)));
+	CHECK(skeleton.motion(SESSION_ATHLETE, SESSION_FILTERED).size() == filteredSize);
+}
+
+// Changing the adjustment's parameters adjusts again without interpolating and filtering again, and
+// a session saved with them stores only the raw motions and derives the same stages when it is loaded
+static void testParameterChanges()
+{
+	KSkeleton skeleton("", "");
+	skeleton.m_athleteRawMotion = generateMotion(skeleton, 6., 13);
+	skeleton.m_trainerRawMotion = generateMotion(skeleton, 6., 17);
+	skeleton.m_athleteRecording = true;
+	skeleton.m_trainerRecording = true;
+	skeleton.processMotions(0);
+	const int rawSize = skeleton.m_athleteRawMotion.size();
+	const int adjustedSize = skeleton.motionView(SESSION_ATHLETE, SESSION_ADJUSTED).size();
+
+	// even when the cache holds less than the stages derived after each change
+	skeleton.stageCache()->setCapacity(2);
+	KProcessingParameters parameters = skeleton.processingParameters();
+	for (int i = 0; i < 3; i++) {
+		parameters.adjustmentStrength = 0.5f + 0.1f * i;
+		parameters.desiredLengths[0] = 0.3f + 0.01f * i;
+		CHECK(skeleton.setProcessingParameters(parameters));
+		for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+			CHECK(skeleton.motion((SessionPerson)p, SESSION_ADJUSTED).size() == adjustedSize);
+			skeleton.motion((SessionPerson)p, SESSION_RESCALED);
+		}
+		const KProcessingTimes& times = skeleton.processingTimes();
+		if (!CHECK(times.interpolate == 0. && times.filter == 0. && times.adjust > 0.)) {
+			cerr << "  change " << i << " interpolated for " << times.interpolate << " ms, filtered for " <<
+				times.filter << " ms" << endl;
+		}
+	}
+
+	const QVector<KFrame> adjusted = skeleton.motion(SESSION_ATHLETE, SESSION_ADJUSTED);
+	QTemporaryDir directory;
+	const QString fileName = directory.filePath("sequences.txt");
+	if (!CHECK(skeleton.saveFrameSequences(fileName))) {
+		return;
+	}
+	SessionFile session;
+	if (CHECK(session.open(fileName))) {
+		CHECK(session.header().flags & SESSION_DERIVED_ATHLETE);
+		CHECK(session.frameCount(SESSION_ATHLETE, SESSION_RAW) == rawSize);
+		CHECK(session.frameCount(SESSION_ATHLETE, SESSION_ADJUSTED) == 0);
+	}
+
+	// into a skeleton with the default parameters
+	KSkeleton loaded("", "");
+	if (!CHECK(loaded.loadMotion(fileName))) {
+		return;
+	}
+	CHECK(loaded.processingParameters() == parameters);
+	CHECK(loaded.m_athleteRawMotion.size() == rawSize);
+	for (uint s = SESSION_RAW; s <= SESSION_ADJUSTED; s++) {
+		if (!CHECK(loaded.motionView(SESSION_ATHLETE, (SessionStage)s).size() == adjustedSize)) {
+			cerr << "  stage " << s << " has " << loaded.motionView(SESSION_ATHLETE, (SessionStage)s).size() <<
+				" frames" << endl;
+		}
+	}
+	CHECK(loaded.m_bigMotionSize == adjustedSize);
+	CHECK(sameFrames(loaded.motion(SESSION_ATHLETE, SESSION_ADJUSTED), adjusted));
+}
+
+// Archived motions keep their joints within the quantisation and everything else exactly
+static void testMotionCodec()
+{
+	KSkeleton skeleton("", "");
+	const QVector<KFrame> motion = generateMotion(skeleton, 8., 11);
+	const QByteArray encoded = MotionCodec::encode(MotionView(motion));
+	QVector<KFrame> decoded;
+	if (!CHECK(MotionCodec::decode(encoded.constData(), encoded.size(), decoded)) ||
+		!CHECK(decoded.size() == motion.size())) {
+		return;
+	}
+
+	bool sameTimestamps = true;
+	bool sameSerials = true;
+	bool sameStates = true;
+	double positionError = 0.;
+	double orientationError = 0.; // degrees
+	for (int i = 0; i < motion.size(); i++) {
+		sameTimestamps &= decoded[i].timestamp == motion[i].timestamp;
+		sameSerials &= decoded[i].serial == motion[i].serial;
+		for (uint j = 0; j < JointType_Count; j++) {
+			const KJoint& a = motion[i].joints[j];
+			const KJoint& b = decoded[i].joints[j];
+			sameStates &= a.trackingState == b.trackingState;
+			for (int c = 0; c < 3; c++) {
+				positionError = max(positionError, fabs((double)a.position[c] - b.position[c]));
+			}
+			orientationError = max(orientationError, rotationAngle(a.orientation, b.orientation));
+		}
+	}
+	CHECK(sameTimestamps);
+	CHECK(sameSerials);
+	CHECK(sameStates);
+	if (!CHECK(positionError <= MOTION_CODEC_POSITION_STEP / 2. + 1e-6)) {
+		cerr << "  position error " << positionError << " m" << endl;
+	}
+	if (!CHECK(orientationError <= 0.1)) {
+		cerr << "  orientation error " << orientationError << " degrees" << endl;
+	}
+
+	// truncated streams are rejected, not decoded in part
+	const int cuts[] = { 0, 4, 8, 40, encoded.size() / 2, encoded.size() - 1 };
+	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(cuts); i++) {
+		QVector<KFrame> truncated;
+		if (!CHECK(!MotionCodec::decode(encoded.constData(), cuts[i], truncated) && truncated.empty())) {
+			cerr << "  truncated to " << cuts[i] << " of " << encoded.size() << " bytes" << endl;
+		}
+	}
+}
+
+// The mapped sections read back as they were written, viewed in place or copied, and section tables
+// pointing outside the file are rejected
+static void testSessionFile()
+{
+	KSkeleton skeleton("", "");
+	QVector<KFrame> motions[NUM_SESSION_PERSONS][NUM_SESSION_STAGES];
+	const QVector<KFrame>* sections[NUM_SESSION_PERSONS][NUM_SESSION_STAGES];
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			motions[p][s] = generateMotion(skeleton, 1. + 0.5 * s, 31 + p * NUM_SESSION_STAGES + s);
+			sections[p][s] = &motions[p][s];
+		}
+	}
+	sections[SESSION_TRAINER][SESSION_RESCALED] = nullptr; // written empty
+	motions[SESSION_TRAINER][SESSION_RESCALED].clear();
+	SessionHeader metadata;
+	memset(&metadata, 0, sizeof(metadata));
+	metadata.interpolationInterval = skeleton.processingParameters().interpolationInterval;
+
+	QTemporaryDir directory;
+	const QString fileName = directory.filePath("session.txt");
+	SessionFile session;
+	if (!CHECK(SessionFile::write(fileName, metadata, sections)) || !CHECK(session.open(fileName))) {
+		return;
+	}
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			const QVector<KFrame>& motion = motions[p][s];
+			const QVector<KFrame> viewed = session.view((SessionPerson)p, (SessionStage)s).toFrames();
+			const QVector<KFrame> read = session.readFrames((SessionPerson)p, (SessionStage)s);
+			const QVector<KFrame> range = session.readFrames((SessionPerson)p, (SessionStage)s, 10, 20);
+			if (!CHECK(sameFrames(viewed, motion) && sameSerials(viewed, motion)) ||
+				!CHECK(sameFrames(read, motion) && sameSerials(read, motion)) ||
+				!CHECK(motion.empty() || sameFrames(range, motion.mid(10, 20)))) {
+				cerr << "  person " << p << ", stage " << s << endl;
+			}
+		}
+	}
+	session.close();
+
+	QFile file(fileName);
+	if (!CHECK(file.open(QIODevice::ReadOnly))) {
+		return;
+	}
+	const QByteArray data = file.readAll();
+	file.close();
+	SessionHeader header;
+	memcpy(&header, data.constData(), sizeof(header));
+	const SessionSection section = header.sections[SESSION_ATHLETE][SESSION_FILTERED];
+	const quint64 fileFrames = data.size() / sizeof(SessionFrameRecord);
+	const char* corruptions[] = { "misaligned offset", "offset beyond the file", "size beyond the file" };
+	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(corruptions); i++) {
+		SessionHeader corrupt = header;
+		SessionSection& corruptSection = corrupt.sections[SESSION_ATHLETE][SESSION_FILTERED];
+		switch (i) {
+		case 0:
+			corruptSection.offset = section.offset + 4;
+			break;
+		case 1:
+			corruptSection.offset = (data.size() + 16) / 16 * 16;
+			break;
+		case 2:
+			corruptSection.frameCount = fileFrames + 1;
+			corrupt.sectionSizes[SESSION_ATHLETE][SESSION_FILTERED] = corruptSection.frameCount * sizeof(SessionFrameRecord);
+			break;
+		}
+		QByteArray corruptData = data;
+		memcpy(corruptData.data(), &corrupt, sizeof(corrupt));
+		const QString corruptName = directory.filePath(QString("corrupt%1.txt").arg(i));
+		QFile corruptFile(corruptName);
+		if (!CHECK(corruptFile.open(QIODevice::WriteOnly) && corruptFile.write(corruptData) == corruptData.size())) {
+			continue;
+		}
+		corruptFile.close();
+		if (!CHECK(!session.open(corruptName))) {
+			cerr << "  " << corruptions[i] << " accepted" << endl;
+		}
+	}
+}
+
+// A mapped session shows the motions a loaded one does, the derived stages computed from the mapped
+// raw motions, without loading them
+static void testMappedSessions()
+{
+	KSkeleton skeleton("", "");
+	skeleton.m_athleteRawMotion = generateMotion(skeleton, 6., 41);
+	skeleton.m_trainerRawMotion = generateMotion(skeleton, 5., 43);
+	skeleton.m_athleteRecording = true;
+	skeleton.m_trainerRecording = true;
+	skeleton.processMotions(0);
+	// the trainer's stages are stored once one of them is edited, the athlete's stay derived
+	skeleton.editableMotion(SESSION_TRAINER, SESSION_ADJUSTED)[0].joints[JointType_Head].position += QVector3D(0.f, 0.1f, 0.f);
+
+	QTemporaryDir directory;
+	const QString fileName = directory.filePath("sequences.txt");
+	if (!CHECK(skeleton.saveFrameSequences(fileName))) {
+		return;
+	}
+	KSkeleton loaded("", "");
+	KSkeleton mapped("", "");
+	if (!CHECK(loaded.loadMotion(fileName)) || !CHECK(mapped.openSession(fileName)) || !CHECK(mapped.isSessionMapped())) {
+		return;
+	}
+	CHECK(mapped.m_bigMotionSize == loaded.m_bigMotionSize);
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			const QVector<KFrame> expected = loaded.motionView((SessionPerson)p, (SessionStage)s).toFrames();
+			const QVector<KFrame> viewed = mapped.motionView((SessionPerson)p, (SessionStage)s).toFrames();
+			if (!CHECK(!expected.empty() && sameFrames(viewed, expected) && sameSerials(viewed, expected))) {
+				cerr << "  person " << p << ", stage " << s << ": " << viewed.size() << " of " << expected.size() <<
+					" frames" << endl;
+			}
+		}
+	}
+	CHECK(mapped.isSessionMapped());
+	CHECK(mapped.m_athleteRawMotion.empty() && mapped.m_trainerAdjustedMotion.empty());
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	NullBuffer nullBuffer;
+	std::streambuf* coutBuffer = cout.rdbuf(&nullBuffer);
+	testFilterKernels();
+	testResampler();
+	testStreamingFilter();
+	testConcurrentProcessing();
+	testMotionCodec();
+	testSessionFile();
+	testDerivedStages();
+	testParameterChanges();
+	testMappedSessions();
+	cout.rdbuf(coutBuffer);
+
+	if (s_failures > 0) {
+		cerr << s_failures << " checks failed" << endl;
+		return 1;
+	}
+	cerr << "All checks passed" << endl;
+	return 0;
+}
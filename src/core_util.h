@@ -0,0 +1,72 @@
+#ifndef CORE_UTIL_H
+#define CORE_UTIL_H
+
+// Qt
+#include <QtCore/QString>
+#include <QtCore/QTextStream>
+#include <QtGui/QGenericMatrix>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QQuaternion>
+#include <QtGui/QVector3D>
+
+// Standard C/C++
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Helpers without OpenGL or Assimp, shared by the motion processing core and the GUI
+
+#define ZERO_MEM(a) memset(a, 0, sizeof(a))
+#define ZERO_MEM_VAR(var) memset(&var, 0, sizeof(var))
+#define ARRAY_SIZE_IN_ELEMENTS(a) (sizeof(a)/sizeof(a[0]))
+#define SAFE_DELETE(p) if (p) { delete p; p = NULL; }
+
+#ifdef _MSC_VER
+#define SNPRINTF _snprintf_s
+#define VSNPRINTF vsnprintf_s
+#else
+#define SNPRINTF snprintf
+#define VSNPRINTF vsnprintf
+#endif
+#define RANDOM rand
+#define SRANDOM srand((unsigned)time(NULL))
+#define PI 3.141592653589
+#define ToRadians(x) (float)(((x) * PI / 180.f))
+#define ToDegrees(x) (float)(((x) * 180.f / PI))
+
+bool readFile(const char* fileName, std::string& outFile);
+inline bool getBit(int number, int position)
+{
+	return (number >> position) & 0;
+}
+float wrapAngle(float angle, float limit);
+
+QString toStringCartesian(const QVector3D& v);
+QString toStringSpherical(const QVector3D& v);
+QString toString(const QQuaternion& q);
+QString toStringEulerAngles(const QQuaternion& q);
+QString toStringAxisAngle(const QQuaternion& q);
+QString toString(const QMatrix4x4& m);
+
+double ticksToMilliseconds(clock_t ticks);
+std::ostream& operator<<(std::ostream& out, const QVector3D& v);
+QTextStream& operator<<(QTextStream& out, const QVector3D& v);
+QQuaternion extractQuaternion(const QMatrix4x4& m);
+QMatrix4x4 fromScaling(const QVector3D& scaling);
+QMatrix4x4 fromScaling(float xScaling, float yScaling, float zScaling);
+QMatrix4x4 fromRotation(const QQuaternion& q);
+QMatrix4x4 fromRotation(float xRotation, float yRotation, float zRotation); // Euler angles in degrees
+QMatrix4x4 fromTranslation(const QVector3D& v);
+QMatrix4x4 fromTranslation(float xTranslation, float yTranslation, float zTranslation);
+QMatrix4x4 getScalingPart(const QMatrix4x4& m);
+QMatrix4x4 getRotationPart(const QMatrix4x4& m);
+QMatrix4x4 getTranslationPart(const QMatrix4x4& m);
+
+#endif
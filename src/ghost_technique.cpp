@@ -0,0 +1,128 @@
+// Own
+#include "ghost_technique.h"
+
+GhostTechnique::GhostTechnique()
+{
+}
+GhostTechnique::~GhostTechnique()
+{
+	for (uint i = 0; i < NUM_MOTIONS; i++) {
+		if (m_motions[i].texture != 0) glDeleteTextures(1, &m_motions[i].texture);
+		if (m_motions[i].buffer != 0) glDeleteBuffers(1, &m_motions[i].buffer);
+	}
+}
+bool GhostTechnique::Init()
+{
+	if (!Technique::Init()) {
+		printf("Cannot init technique base class\n");
+		return false;
+	}
+
+	if (!AddShader(GL_VERTEX_SHADER, "shaders/ghost.vert")) {
+		printf("Cannot add ghost vertex shader\n");
+		return false;
+	}
+
+	if (!AddShader(GL_FRAGMENT_SHADER, "shaders/simple.frag")) {
+		printf("Cannot add simple fragment shader\n");
+		return false;
+	}
+
+	if (!Finalize()) {
+		printf("Cannot finalize ghost shaders\n");
+		return false;
+	}
+
+	m_locationMVP = GetUniformLocation("gMVP");
+	m_firstFrameLocation = GetUniformLocation("gFirstFrame");
+	m_frameStepLocation = GetUniformLocation("gFrameStep");
+	m_currentFrameLocation = GetUniformLocation("gCurrentFrame");
+	m_fadeLengthLocation = GetUniformLocation("gFadeLength");
+	m_trajectoryLocation = GetUniformLocation("gTrajectory");
+	m_colorLocation = GetUniformLocation("gColor");
+	m_motionLocation = GetUniformLocation("gMotion");
+
+	if (m_locationMVP == INVALID_UNIFORM_LOCATION ||
+		m_firstFrameLocation == INVALID_UNIFORM_LOCATION ||
+		m_frameStepLocation == INVALID_UNIFORM_LOCATION ||
+		m_currentFrameLocation == INVALID_UNIFORM_LOCATION ||
+		m_fadeLengthLocation == INVALID_UNIFORM_LOCATION ||
+		m_trajectoryLocation == INVALID_UNIFORM_LOCATION ||
+		m_colorLocation == INVALID_UNIFORM_LOCATION ||
+		m_motionLocation == INVALID_UNIFORM_LOCATION) {
+		printf("Invalid uniform location(ghost)\n");
+		return false;
+	}
+
+	for (uint i = 0; i < NUM_MOTIONS; i++) {
+		glGenBuffers(1, &m_motions[i].buffer);
+		glGenTextures(1, &m_motions[i].texture);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_motions[i].buffer);
+		glBufferData(GL_TEXTURE_BUFFER, 4 * sizeof(float) * JointType_Count, NULL, GL_STATIC_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, m_motions[i].texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_motions[i].buffer); // RGB32F buffers need OpenGL 4.0
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	enable();
+	glUniform1i(m_motionLocation, MOTION_TEXTURE_UNIT);
+	glUniform1i(m_trajectoryLocation, 0);
+
+	return true;
+}
+void GhostTechnique::setMotion(uint slot, const MotionView& motion, quint64 motionId)
+{
+	MotionSlot& m = m_motions[slot];
+	if (m.motionId == motionId) {
+		return;
+	}
+
+	m_texels.resize(4 * JointType_Count * motion.size());
+	float* texel = m_texels.data();
+	for (int i = 0; i < motion.size(); i++) {
+		for (uint j = 0; j < JointType_Count; j++) {
+			QVector3D position = motion.position(i, j);
+			texel[0] = position.x();
+			texel[1] = position.y();
+			texel[2] = position.z();
+			texel[3] = (float)motion.trackingState(i, j);
+			texel += 4;
+		}
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m.buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * m_texels.size(), m_texels.constData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	m.motionId = motionId;
+	cout << "GhostTechnique: uploaded " << motion.size() << " frames to slot " << slot << endl;
+}
+void GhostTechnique::invalidateMotions()
+{
+	for (uint i = 0; i < NUM_MOTIONS; i++) {
+		m_motions[i].motionId = 0;
+	}
+}
+void GhostTechnique::bindMotion(uint slot)
+{
+	glActiveTexture(GL_TEXTURE0 + MOTION_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_motions[slot].texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+// The ghosts are at firstFrame + i * frameStep, the oldest one is the faintest
+void GhostTechnique::setFrames(int firstFrame, int frameStep, int currentFrame)
+{
+	glUniform1i(m_firstFrameLocation, firstFrame);
+	glUniform1i(m_frameStepLocation, frameStep);
+	glUniform1i(m_currentFrameLocation, currentFrame);
+	glUniform1i(m_fadeLengthLocation, currentFrame - firstFrame + frameStep);
+}
+void GhostTechnique::setTrajectory(bool trajectory)
+{
+	glUniform1i(m_trajectoryLocation, trajectory ? 1 : 0);
+}
+void GhostTechnique::setColor(const QVector3D& color)
+{
+	glUniform3f(m_colorLocation, color.x(), color.y(), color.z());
+}
@@ -0,0 +1,53 @@
+#ifndef GHOST_TECHNIQUE_H
+#define	GHOST_TECHNIQUE_H
+
+// Project
+#include "technique.h"
+#include "kskeleton.h"
+#include "motion_view.h"
+
+// Qt
+#include <QtCore\QVector>
+#include <QtGui\QVector3D>
+
+// Draws earlier poses of a motion and its barbell trajectory from a texture buffer,
+// which holds JointType_Count texels (position, tracking state) per frame.
+// A motion is uploaded once and stays on the GPU until it changes.
+class GhostTechnique : public Technique
+{
+public:
+	static const uint NUM_MOTIONS = 2; // athlete and trainer
+	static const uint MOTION_TEXTURE_UNIT = 1; // unit 0 holds the color maps
+
+	GhostTechnique();
+	~GhostTechnique();
+
+	virtual bool Init();
+
+	void setMotion(uint slot, const MotionView& motion, quint64 motionId); // uploads only when the id changed
+	void invalidateMotions(); // the next setMotion uploads again
+	void bindMotion(uint slot);
+	void setFrames(int firstFrame, int frameStep, int currentFrame);
+	void setTrajectory(bool trajectory); // barbell trajectory instead of skeleton poses
+	void setColor(const QVector3D& color);
+
+private:
+	GLuint m_firstFrameLocation;
+	GLuint m_frameStepLocation;
+	GLuint m_currentFrameLocation;
+	GLuint m_fadeLengthLocation;
+	GLuint m_trajectoryLocation;
+	GLuint m_colorLocation;
+	GLuint m_motionLocation;
+
+	struct MotionSlot
+	{
+		GLuint buffer = 0;
+		GLuint texture = 0;
+		quint64 motionId = 0; // KSkeleton::motionId of the uploaded motion, 0 if none
+	};
+	array<MotionSlot, NUM_MOTIONS> m_motions;
+	QVector<float> m_texels;
+};
+
+#endif	/* GHOST_TECHNIQUE_H */
@@ -0,0 +1,39 @@
+#ifndef KBODY_SOURCE_H
+#define KBODY_SOURCE_H
+
+// Project
+#include "core_util.h"
+#include "kjoints.h"
+
+// Qt
+#include <QtCore/QString>
+
+// Raw body data of a single sensor frame
+struct KBodyFrame
+{
+	double timestamp;		// relative time in seconds
+	uint personsTracked;	// joints below belong to the last tracked person
+	Joint joints[JointType_Count];
+	JointOrientation orientations[JointType_Count];
+};
+
+// Interface of the body frame sources polled by the KSensor capture thread
+class KBodySource
+{
+public:
+	virtual ~KBodySource() {}
+	virtual bool open() = 0;
+	virtual void close() = 0;
+	virtual bool isOpen() = 0;
+
+	// Returns false if no new frame is available yet
+	virtual bool acquireFrame(KBodyFrame& bodyFrame) = 0;
+
+	// Live sources can not be paused, frames that do not fit in the capture buffer are dropped.
+	// The capture thread waits for free space instead when reading from a non-live source.
+	virtual bool isLive() const = 0;
+
+	virtual QString name() const = 0;
+};
+
+#endif
@@ -0,0 +1,119 @@
+// Own
+#include "kbody_stream.h"
+
+// Standard C/C++
+#include <cmath>
+#include <iostream>
+
+static void setupStream(QDataStream& stream)
+{
+	stream.setVersion(QDataStream::Qt_5_9);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+}
+bool KBodyStreamWriter::open(const QString& fileName)
+{
+	close();
+	m_file.setFileName(fileName);
+	if (!m_file.open(QIODevice::WriteOnly)) {
+		cout << "Could not create body stream " << fileName.toStdString() << endl;
+		return false;
+	}
+	m_stream.setDevice(&m_file);
+	setupStream(m_stream);
+	m_stream << (quint32)BODY_STREAM_MAGIC << (quint32)BODY_STREAM_VERSION;
+	return m_stream.status() == QDataStream::Ok;
+}
+void KBodyStreamWriter::close()
+{
+	if (m_file.isOpen()) {
+		m_stream.setDevice(nullptr);
+		m_file.close();
+	}
+}
+bool KBodyStreamWriter::isOpen() const
+{
+	return m_file.isOpen();
+}
+bool KBodyStreamWriter::write(const KBodyFrame& bodyFrame)
+{
+	if (!m_file.isOpen()) {
+		return false;
+	}
+	m_stream << (qint64)llround(bodyFrame.timestamp * 10000000.);
+	m_stream << (quint32)bodyFrame.personsTracked;
+	for (uint i = 0; i < JointType_Count; i++) {
+		const Joint& jt = bodyFrame.joints[i];
+		const JointOrientation& jo = bodyFrame.orientations[i];
+		m_stream << jt.Position.X << jt.Position.Y << jt.Position.Z << (qint32)jt.TrackingState;
+		m_stream << jo.Orientation.w << jo.Orientation.x << jo.Orientation.y << jo.Orientation.z;
+	}
+	return m_stream.status() == QDataStream::Ok;
+}
+bool KBodyStreamReader::open(const QString& fileName)
+{
+	close();
+	m_file.setFileName(fileName);
+	if (!m_file.open(QIODevice::ReadOnly)) {
+		cout << "Could not open body stream " << fileName.toStdString() << endl;
+		return false;
+	}
+	m_stream.setDevice(&m_file);
+	setupStream(m_stream);
+
+	quint32 magic, version;
+	m_stream >> magic >> version;
+	if (magic != BODY_STREAM_MAGIC) {
+		cout << fileName.toStdString() << " is not a body stream." << endl;
+		close();
+		return false;
+	}
+	if (version != BODY_STREAM_VERSION) {
+		cout << "Unsupported body stream version " << version << endl;
+		close();
+		return false;
+	}
+	m_firstFrameOffset = m_file.pos();
+	return true;
+}
+void KBodyStreamReader::close()
+{
+	if (m_file.isOpen()) {
+		m_stream.setDevice(nullptr);
+		m_file.close();
+	}
+}
+bool KBodyStreamReader::isOpen() const
+{
+	return m_file.isOpen();
+}
+bool KBodyStreamReader::rewind()
+{
+	if (!m_file.isOpen()) {
+		return false;
+	}
+	m_stream.resetStatus();
+	return m_file.seek(m_firstFrameOffset);
+}
+bool KBodyStreamReader::readFrame(KBodyFrame& bodyFrame)
+{
+	if (!m_file.isOpen() || m_stream.atEnd()) {
+		return false;
+	}
+	qint64 relativeTime;
+	quint32 personsTracked;
+	m_stream >> relativeTime >> personsTracked;
+	bodyFrame.timestamp = (double)relativeTime / 10000000.;
+	bodyFrame.personsTracked = personsTracked;
+	for (uint i = 0; i < JointType_Count; i++) {
+		Joint& jt = bodyFrame.joints[i];
+		JointOrientation& jo = bodyFrame.orientations[i];
+		qint32 trackingState;
+		m_stream >> jt.Position.X >> jt.Position.Y >> jt.Position.Z >> trackingState;
+		m_stream >> jo.Orientation.w >> jo.Orientation.x >> jo.Orientation.y >> jo.Orientation.z;
+		jt.JointType = (JointType)i;
+		jt.TrackingState = (TrackingState)trackingState;
+		jo.JointType = (JointType)i;
+	}
+	return m_stream.status() == QDataStream::Ok;
+}
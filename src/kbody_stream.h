@@ -0,0 +1,43 @@
+#ifndef KBODY_STREAM_H
+#define KBODY_STREAM_H
+
+// Project
+#include "kbody_source.h"
+
+// Qt
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+
+// Body stream files hold the raw frames of a capture session in acquisition order:
+// header: magic, version
+// frame: relative time (100 ns ticks), persons tracked, 25 x (position, tracking state, orientation)
+#define BODY_STREAM_MAGIC 0x4B425354 // "KBST"
+#define BODY_STREAM_VERSION 1
+
+class KBodyStreamWriter
+{
+public:
+	bool open(const QString& fileName);
+	void close();
+	bool isOpen() const;
+	bool write(const KBodyFrame& bodyFrame);
+private:
+	QFile m_file;
+	QDataStream m_stream;
+};
+
+class KBodyStreamReader
+{
+public:
+	bool open(const QString& fileName);
+	void close();
+	bool isOpen() const;
+	bool rewind();
+	bool readFrame(KBodyFrame& bodyFrame); // returns false at the end of the stream
+private:
+	QFile m_file;
+	QDataStream m_stream;
+	qint64 m_firstFrameOffset = 0;
+};
+
+#endif
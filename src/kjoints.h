@@ -0,0 +1,94 @@
+#ifndef KJOINTS_H
+#define KJOINTS_H
+
+// Joint types, tracking states and joint structs with the values and layout of the Kinect v2 SDK,
+// so that motions can be processed without Kinect.h. Each definition is skipped when Kinect.h
+// has already made it, and its guard makes Kinect.h skip it when this header comes first.
+
+#ifndef _JointType_
+#define _JointType_
+enum _JointType
+{
+	JointType_SpineBase = 0,
+	JointType_SpineMid = 1,
+	JointType_Neck = 2,
+	JointType_Head = 3,
+	JointType_ShoulderLeft = 4,
+	JointType_ElbowLeft = 5,
+	JointType_WristLeft = 6,
+	JointType_HandLeft = 7,
+	JointType_ShoulderRight = 8,
+	JointType_ElbowRight = 9,
+	JointType_WristRight = 10,
+	JointType_HandRight = 11,
+	JointType_HipLeft = 12,
+	JointType_KneeLeft = 13,
+	JointType_AnkleLeft = 14,
+	JointType_FootLeft = 15,
+	JointType_HipRight = 16,
+	JointType_KneeRight = 17,
+	JointType_AnkleRight = 18,
+	JointType_FootRight = 19,
+	JointType_SpineShoulder = 20,
+	JointType_HandTipLeft = 21,
+	JointType_ThumbLeft = 22,
+	JointType_HandTipRight = 23,
+	JointType_ThumbRight = 24,
+	JointType_Count = (JointType_ThumbRight + 1)
+};
+typedef enum _JointType JointType;
+#endif
+
+#ifndef _TrackingState_
+#define _TrackingState_
+enum _TrackingState
+{
+	TrackingState_NotTracked = 0,
+	TrackingState_Inferred = 1,
+	TrackingState_Tracked = 2
+};
+typedef enum _TrackingState TrackingState;
+#endif
+
+#ifndef _Vector4_
+#define _Vector4_
+typedef struct _Vector4
+{
+	float x;
+	float y;
+	float z;
+	float w;
+} Vector4;
+#endif
+
+#ifndef _CameraSpacePoint_
+#define _CameraSpacePoint_
+typedef struct _CameraSpacePoint
+{
+	float X;
+	float Y;
+	float Z;
+} CameraSpacePoint;
+#endif
+
+// the members are named like their types, as in the SDK
+#ifndef _Joint_
+#define _Joint_
+typedef struct _Joint
+{
+	enum _JointType JointType;
+	CameraSpacePoint Position;
+	enum _TrackingState TrackingState;
+} Joint;
+#endif
+
+#ifndef _JointOrientation_
+#define _JointOrientation_
+typedef struct _JointOrientation
+{
+	enum _JointType JointType;
+	Vector4 Orientation;
+} JointOrientation;
+#endif
+
+#endif
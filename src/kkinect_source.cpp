@@ -0,0 +1,174 @@
+// Own
+#include "kkinect_source.h"
+
+// Windows
+#include <Windows.h>
+
+// Standard C/C++
+#include <iostream>
+
+template <class T> void safeRelease(T **ppT)
+{
+	if (*ppT) {
+		(*ppT)->Release();
+		*ppT = NULL;
+	}
+}
+
+KKinectSource::KKinectSource()
+{
+}
+KKinectSource::~KKinectSource()
+{
+	close();
+}
+bool KKinectSource::open()
+{
+	HRESULT hr;
+
+	// Get sensor
+	hr = GetDefaultKinectSensor(&m_sensor);
+	if (FAILED(hr)) {
+		cout << "Could not get kinect sensor. hr = " <<  hr << endl;
+		return false;
+	}
+
+	// Open sensor
+	hr = m_sensor->Open();
+	if (FAILED(hr)) {
+		cout << hr << "Could not open sensor. hr = " << hr << endl;
+		return false;
+	}
+	
+	// Get source
+	hr = m_sensor->get_BodyFrameSource(&m_source);
+	if (FAILED(hr)) {
+		cout << hr << "Could not get frame source. hr = " << hr << endl;
+		return false;
+	}
+
+	// Open reader
+	hr = m_source->OpenReader(&m_reader);
+	if (FAILED(hr)) {
+		cout << hr << "Could not open reader.  hr = " << hr << endl;
+		return false;
+	}
+
+	return true;
+}
+void KKinectSource::close()
+{
+	safeRelease(&m_reader);
+	safeRelease(&m_source);
+	if (m_sensor) {
+		m_sensor->Close();
+	}
+	safeRelease(&m_sensor);
+}
+bool KKinectSource::isOpen()
+{
+	HRESULT hr;
+
+	if (!m_sensor) {
+		cout << "m_sensor = NULL" << endl;
+		return false;
+	}
+
+	BOOLEAN isOpen = false;
+	hr = m_sensor->get_IsOpen(&isOpen);
+	if (SUCCEEDED(hr)) {
+		if (!isOpen) {
+			cout << "Sensor is not open." << endl;
+			return false;
+		}
+	}
+	else {
+		cout << "Could not specify if sensor is open. hr = " << hr << endl;
+	}
+
+	if (!m_source) {
+		cout << "m_source = NULL" << endl;
+		return false;
+	}
+
+	if (!m_reader) {
+		cout << "m_reader = NULL" << endl;
+		return false;
+	}
+
+	BOOLEAN isPaused = false;
+	hr = m_reader->get_IsPaused(&isPaused);
+	if (SUCCEEDED(hr)) {
+		if (isPaused) {
+			cout << "Reader is paused." << endl;
+			return false;
+		}
+	}
+	else {
+		cout << "Could not specify if reader is paused hr = " << hr << endl;
+	}
+
+	return true;
+}
+bool KKinectSource::acquireFrame(KBodyFrame& bodyFrame)
+{
+	HRESULT hr;
+
+	if (!m_reader) {
+		return false;
+	}
+
+	// get frame
+	IBodyFrame* frame = NULL;
+	hr = m_reader->AcquireLatestFrame(&frame);
+	if (FAILED(hr)) {
+		return false;
+	}
+
+	// get relative time
+	INT64 relativeTime;
+	hr = frame->get_RelativeTime(&relativeTime);
+	if (FAILED(hr)) {
+		cout << "Could not get relative time. hr = " << hr << endl;
+		safeRelease(&frame);
+		return false;
+	}
+	bodyFrame.timestamp = (double)relativeTime / 10000000.;
+
+	// get bodies
+	IBody* bodies[BODY_COUNT] = { 0 };
+	hr = frame->GetAndRefreshBodyData(BODY_COUNT, bodies);
+	if (FAILED(hr)) {
+		cout << "Could not get and refresh body data. hr = " << hr << endl;
+		safeRelease(&frame);
+		return false;
+	} 
+
+	// get data from bodies
+	bodyFrame.personsTracked = 0;
+	BOOLEAN bodyTracked;
+	for (int i = 0; i < BODY_COUNT; i++) {
+		bodies[i]->get_IsTracked(&bodyTracked);
+		if (bodyTracked) {
+			bodyFrame.personsTracked++;
+			bodies[i]->GetJoints(JointType_Count, bodyFrame.joints);
+			bodies[i]->GetJointOrientations(JointType_Count, bodyFrame.orientations);
+		}
+	}
+
+	// release resources
+	for (int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(bodies); ++i) {
+		safeRelease(&bodies[i]);
+	}
+	safeRelease(&frame);
+
+	return true;
+}
+bool KKinectSource::isLive() const
+{
+	return true;
+}
+QString KKinectSource::name() const
+{
+	return "Kinect";
+}
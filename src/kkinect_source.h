@@ -0,0 +1,28 @@
+#ifndef KKINECT_SOURCE_H
+#define KKINECT_SOURCE_H
+
+// Project
+#include "kbody_source.h"
+
+// Kinect
+#include <Kinect.h>
+
+// Body frames acquired from the default Kinect v2 sensor
+class KKinectSource : public KBodySource
+{
+public:
+	KKinectSource();
+	~KKinectSource();
+	bool open() override;
+	void close() override;
+	bool isOpen() override;
+	bool acquireFrame(KBodyFrame& bodyFrame) override;
+	bool isLive() const override;
+	QString name() const override;
+private:
+	IKinectSensor *m_sensor = nullptr;
+	IBodyFrameSource *m_source = nullptr;
+	IBodyFrameReader *m_reader = nullptr;
+};
+
+#endif
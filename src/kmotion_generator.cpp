@@ -0,0 +1,244 @@
+// Own
+#include "kmotion_generator.h"
+
+// Standard C/C++
+#include <algorithm>
+#include <cmath>
+
+// Typical adult distances of each joint to its parent in meters
+static const array<float, JointType_Count> defaultBoneLengths = {
+	0.00f, // SpineBase
+	0.27f, // SpineMid
+	0.08f, // Neck
+	0.14f, // Head
+	0.17f, // ShoulderLeft
+	0.27f, // ElbowLeft
+	0.24f, // WristLeft
+	0.07f, // HandLeft
+	0.17f, // ShoulderRight
+	0.27f, // ElbowRight
+	0.24f, // WristRight
+	0.07f, // HandRight
+	0.08f, // HipLeft
+	0.40f, // KneeLeft
+	0.39f, // AnkleLeft
+	0.12f, // FootLeft
+	0.08f, // HipRight
+	0.40f, // KneeRight
+	0.39f, // AnkleRight
+	0.12f, // FootRight
+	0.22f, // SpineShoulder
+	0.08f, // HandTipLeft
+	0.05f, // ThumbLeft
+	0.08f, // HandTipRight
+	0.05f  // ThumbRight
+};
+
+// Key poses of one clean repetition
+struct KKeyPose
+{
+	double time;	 // fraction of the repetition
+	float lean;		 // forward torso lean in radians
+	float knee;		 // knee flexion in radians
+	float rack;		 // 0: arms hanging, 1: front rack
+	float ankleLift; // heels off the ground in meters
+};
+static const array<KKeyPose, 10> keyPoses = {{
+	{ 0.00, 0.75f, 1.45f, 0.f, 0.00f },	// set up
+	{ 0.10, 0.75f, 1.45f, 0.f, 0.00f },	// bar at ground
+	{ 0.22, 0.65f, 0.55f, 0.f, 0.00f },	// bar at knee height
+	{ 0.30, 0.20f, 0.75f, 0.f, 0.00f },	// power position
+	{ 0.36, -0.08f, 0.05f, 0.f, 0.08f },// triple extension
+	{ 0.46, 0.15f, 2.00f, 1.f, 0.00f },	// catch
+	{ 0.70, 0.00f, 0.00f, 1.f, 0.00f },	// stand up
+	{ 0.82, 0.00f, 0.00f, 1.f, 0.00f },	// hold
+	{ 0.92, 0.00f, 0.00f, 0.f, 0.00f },	// bar dropped
+	{ 1.00, 0.75f, 1.45f, 0.f, 0.00f }	// set up
+}};
+
+KMotionGenerator::KMotionGenerator(
+	const array<KNode, JointType_Count>& nodes,
+	const array<KLimb, NUM_LIMBS>& limbs,
+	const KMotionGeneratorSettings& settings)
+	:
+	m_nodes(nodes),
+	m_settings(settings)
+{
+	calculateBoneLengths(limbs);
+	reset();
+}
+void KMotionGenerator::reset()
+{
+	m_random.seed(m_settings.seed);
+	m_frameIndex = 0;
+	m_serial = 0;
+}
+bool KMotionGenerator::nextFrame(KFrame& frame)
+{
+	const double nominalInterval = 1. / m_settings.frameRate;
+	while (true) {
+		double time = m_frameIndex * nominalInterval;
+		if (time >= m_settings.duration) {
+			return false;
+		}
+		m_frameIndex++;
+
+		// random numbers are drawn in the same order for every frame, dropped or not,
+		// so frames at the same time are identical for any dropout rate
+		bool dropped = uniform() < m_settings.dropoutRate;
+		double jitter = gaussian() * m_settings.timestampJitter;
+		jitter = std::max(-0.4 * nominalInterval, std::min(0.4 * nominalInterval, jitter));
+		array<bool, JointType_Count> inferred;
+		array<QVector3D, JointType_Count> noise;
+		for (uint j = 0; j < JointType_Count; j++) {
+			inferred[j] = uniform() < m_settings.inferredRatio;
+			float x = (float)gaussian();
+			float y = (float)gaussian();
+			float z = (float)gaussian();
+			noise[j] = QVector3D(x, y, z) * m_settings.positionNoise;
+		}
+		if (dropped) {
+			continue;
+		}
+
+		calculatePose(time, frame);
+		calculateOrientations(frame);
+		for (uint j = 0; j < JointType_Count; j++) {
+			KJoint& joint = frame.joints[j];
+			joint.trackingState = inferred[j] ? TrackingState_Inferred : TrackingState_Tracked;
+			joint.position += inferred[j] ? noise[j] * 3.f : noise[j]; // inferred joints are noisier
+		}
+		frame.serial = ++m_serial;
+		frame.timestamp = time + jitter;
+		return true;
+	}
+}
+QVector<KFrame> KMotionGenerator::generate()
+{
+	reset();
+	QVector<KFrame> motion;
+	motion.reserve(nominalFrameCount());
+	KFrame frame;
+	while (nextFrame(frame)) {
+		motion.push_back(frame);
+	}
+	return motion;
+}
+int KMotionGenerator::nominalFrameCount() const
+{
+	return (int)ceil(m_settings.duration * m_settings.frameRate);
+}
+const KMotionGeneratorSettings& KMotionGenerator::settings() const
+{
+	return m_settings;
+}
+void KMotionGenerator::calculateBoneLengths(const array<KLimb, NUM_LIMBS>& limbs)
+{
+	m_boneLengths = defaultBoneLengths;
+	for (uint l = 0; l < limbs.size(); l++) {
+		const KLimb& limb = limbs[l];
+		if (limb.end == INVALID_JOINT_ID || limb.desiredLength <= 0.f) continue;
+		if (m_nodes[limb.end].parentId == limb.start) {
+			m_boneLengths[limb.end] = limb.desiredLength;
+		}
+		else if (limb.start == JointType_SpineBase && limb.end == JointType_SpineShoulder) {
+			float scale = limb.desiredLength /
+				(defaultBoneLengths[JointType_SpineMid] + defaultBoneLengths[JointType_SpineShoulder]);
+			m_boneLengths[JointType_SpineMid] = defaultBoneLengths[JointType_SpineMid] * scale;
+			m_boneLengths[JointType_SpineShoulder] = defaultBoneLengths[JointType_SpineShoulder] * scale;
+		}
+	}
+}
+// Person faces the sensor: front is -z, left is -x
+void KMotionGenerator::calculatePose(double time, KFrame& frame) const
+{
+	// interpolate key poses
+	double cycle = fmod(time / m_settings.repetitionDuration, 1.);
+	uint k = 1;
+	while (k < keyPoses.size() - 1 && keyPoses[k].time <= cycle) k++;
+	const KKeyPose& a = keyPoses[k - 1];
+	const KKeyPose& b = keyPoses[k];
+	float s = (float)((cycle - a.time) / (b.time - a.time));
+	s = s * s * (3.f - 2.f * s); // smoothstep
+	float lean = a.lean + s * (b.lean - a.lean);
+	float knee = a.knee + s * (b.knee - a.knee);
+	float rack = a.rack + s * (b.rack - a.rack);
+	float ankleLift = a.ankleLift + s * (b.ankleLift - a.ankleLift);
+
+	const array<float, JointType_Count>& length = m_boneLengths;
+	array<KJoint, JointType_Count>& joints = frame.joints;
+	auto place = [&](uint joint, const QVector3D& direction) {
+		joints[joint].position = joints[m_nodes[joint].parentId].position + direction.normalized() * length[joint];
+	};
+	auto legDirection = [](float side, float angle) {
+		return QVector3D(side * 0.1f, -cos(angle), -sin(angle));
+	};
+
+	// core
+	QVector3D spineDirection(0.f, cos(lean), -sin(lean));
+	joints[JointType_SpineBase].position = QVector3D(0.f, 0.f, 0.f);
+	place(JointType_SpineMid, spineDirection);
+	place(JointType_SpineShoulder, spineDirection);
+	place(JointType_Neck, spineDirection);
+	place(JointType_Head, spineDirection);
+
+	// legs
+	float thighAngle = knee * 0.55f + lean * 0.35f;
+	float shinAngle = thighAngle - knee;
+	for (int side = -1; side <= 1; side += 2) {
+		bool left = side < 0;
+		place(left ? JointType_HipLeft : JointType_HipRight, QVector3D((float)side, -0.3f, 0.f));
+		place(left ? JointType_KneeLeft : JointType_KneeRight, legDirection((float)side, thighAngle));
+		place(left ? JointType_AnkleLeft : JointType_AnkleRight, legDirection((float)side, shinAngle));
+		place(left ? JointType_FootLeft : JointType_FootRight, QVector3D(side * 0.2f, -0.3f, -1.f));
+	}
+
+	// arms
+	QVector3D upperArmHanging(0.f, -1.f, 0.f);
+	QVector3D upperArmRack(0.f, -0.1f, -1.f);
+	QVector3D forearmHanging(0.f, -1.f, 0.f);
+	QVector3D forearmRack(0.f, 0.6f, 0.8f);
+	for (int side = -1; side <= 1; side += 2) {
+		bool left = side < 0;
+		QVector3D grip((float)side * 0.12f, 0.f, 0.f);
+		QVector3D upperArm = (upperArmHanging * (1.f - rack) + upperArmRack * rack + grip).normalized();
+		QVector3D forearm = (forearmHanging * (1.f - rack) + forearmRack * rack).normalized();
+		place(left ? JointType_ShoulderLeft : JointType_ShoulderRight, QVector3D((float)side, -0.1f, 0.f));
+		place(left ? JointType_ElbowLeft : JointType_ElbowRight, upperArm);
+		place(left ? JointType_WristLeft : JointType_WristRight, forearm);
+		place(left ? JointType_HandLeft : JointType_HandRight, forearm);
+		place(left ? JointType_HandTipLeft : JointType_HandTipRight, forearm);
+		place(left ? JointType_ThumbLeft : JointType_ThumbRight, QVector3D(-(float)side, 0.f, -0.5f));
+	}
+
+	// stand on the floor 2.6 m in front of a sensor mounted 0.9 m high
+	QVector3D ankles =
+		joints[JointType_AnkleLeft].position * 0.5f +
+		joints[JointType_AnkleRight].position * 0.5f;
+	QVector3D offset(0.f, -0.9f + 0.08f + ankleLift - ankles.y(), 2.6f - ankles.z());
+	for (uint j = 0; j < JointType_Count; j++) {
+		joints[j].position += offset;
+	}
+}
+// Kinect convention: the y axis of a joint points along the bone from its parent
+void KMotionGenerator::calculateOrientations(KFrame& frame) const
+{
+	const QVector3D yAxis(0.f, 1.f, 0.f);
+	for (uint j = 0; j < JointType_Count; j++) {
+		uint parent = m_nodes[j].parentId;
+		QVector3D bone = (parent == INVALID_JOINT_ID) ?
+			frame.joints[JointType_SpineMid].position - frame.joints[j].position :
+			frame.joints[j].position - frame.joints[parent].position;
+		frame.joints[j].orientation = QQuaternion::rotationTo(yAxis, bone);
+	}
+}
+double KMotionGenerator::uniform()
+{
+	return m_random() / 4294967296.;
+}
+double KMotionGenerator::gaussian()
+{
+	double u1 = 1. - uniform();
+	double u2 = uniform();
+	return sqrt(-2. * log(u1)) * cos(2. * PI * u2);
+}
@@ -0,0 +1,57 @@
+#ifndef KMOTION_GENERATOR_H
+#define KMOTION_GENERATOR_H
+
+// Project
+#include "kskeleton.h"
+
+// Standard C/C++
+#include <array>
+#include <random>
+
+struct KMotionGeneratorSettings
+{
+	double duration = 3.;			// seconds of motion to generate
+	double frameRate = 30.;			// nominal frames per second
+	double repetitionDuration = 4.;	// seconds per clean repetition, rest included
+	double timestampJitter = 0.002;	// standard deviation of the frame timestamps in seconds
+	float positionNoise = 0.004f;	// standard deviation of the joint positions in meters
+	double dropoutRate = 0.;		// probability of a frame not being delivered
+	double inferredRatio = 0.;		// probability of a joint being TrackingState_Inferred
+	quint32 seed = 1;
+};
+
+// Synthesises 25-joint clean-like lifts for benchmarks and stress tests without a sensor.
+// Poses are built by forward kinematics over the KSkeleton joint hierarchy with the bone
+// lengths taken from the KSkeleton limbs (typical adult lengths are used for limbs that
+// have not been measured yet). Output is fully determined by the settings.
+class KMotionGenerator
+{
+public:
+	KMotionGenerator(
+		const array<KNode, JointType_Count>& nodes,
+		const array<KLimb, NUM_LIMBS>& limbs,
+		const KMotionGeneratorSettings& settings = KMotionGeneratorSettings());
+
+	void reset();
+	bool nextFrame(KFrame& frame); // returns false after settings.duration
+	QVector<KFrame> generate();	   // whole motion from the start
+
+	int nominalFrameCount() const;
+	const KMotionGeneratorSettings& settings() const;
+private:
+	array<KNode, JointType_Count> m_nodes;
+	array<float, JointType_Count> m_boneLengths; // distance of each joint to its parent
+	KMotionGeneratorSettings m_settings;
+
+	std::mt19937 m_random;
+	int m_frameIndex = 0;
+	int m_serial = 0;
+
+	void calculateBoneLengths(const array<KLimb, NUM_LIMBS>& limbs);
+	void calculatePose(double time, KFrame& frame) const;
+	void calculateOrientations(KFrame& frame) const;
+	double uniform();  // [0, 1)
+	double gaussian(); // standard normal distribution
+};
+
+#endif
@@ -0,0 +1,96 @@
+// Own
+#include "kreplay_source.h"
+
+// Standard C/C++
+#include <iostream>
+
+KReplaySource::KReplaySource(const QString& fileName, double speed, bool loop)
+	:
+	m_fileName(fileName),
+	m_speed(speed),
+	m_loop(loop)
+{
+}
+bool KReplaySource::open()
+{
+	if (!m_reader.open(m_fileName)) {
+		return false;
+	}
+	m_hasNextFrame = m_reader.readFrame(m_nextFrame);
+	if (!m_hasNextFrame) {
+		cout << "Body stream " << m_fileName.toStdString() << " is empty." << endl;
+		return false;
+	}
+	m_lastTimestamp = m_nextFrame.timestamp;
+	m_timeOffset = 0.;
+	m_clock.invalidate();
+	cout << "Replaying " << m_fileName.toStdString() << " at ";
+	if (m_speed > 0.) cout << m_speed << "x speed" << endl;
+	else cout << "maximum speed" << endl;
+	return true;
+}
+void KReplaySource::close()
+{
+	m_reader.close();
+	m_hasNextFrame = false;
+}
+bool KReplaySource::isOpen()
+{
+	return m_reader.isOpen();
+}
+bool KReplaySource::acquireFrame(KBodyFrame& bodyFrame)
+{
+	if (!m_hasNextFrame) {
+		if (!m_loop || !m_reader.rewind()) {
+			return false;
+		}
+		m_hasNextFrame = m_reader.readFrame(m_nextFrame);
+		if (!m_hasNextFrame) {
+			return false;
+		}
+		// continue the timeline one nominal frame after the last looped frame
+		m_timeOffset = m_lastTimestamp - m_nextFrame.timestamp + 1. / 30.;
+		m_nextFrame.timestamp += m_timeOffset;
+	}
+
+	// pace the frames with their original relative timestamps
+	if (m_speed > 0.) {
+		if (!m_clock.isValid()) {
+			m_clock.start();
+			m_clockStart = m_nextFrame.timestamp;
+		}
+		double streamTime = m_clockStart + m_clock.nsecsElapsed() / 1000000000. * m_speed;
+		if (streamTime < m_nextFrame.timestamp) {
+			return false;
+		}
+	}
+
+	bodyFrame = m_nextFrame;
+	m_lastTimestamp = bodyFrame.timestamp;
+	m_hasNextFrame = m_reader.readFrame(m_nextFrame);
+	if (m_hasNextFrame) {
+		m_nextFrame.timestamp += m_timeOffset;
+	}
+	return true;
+}
+bool KReplaySource::isLive() const
+{
+	return false;
+}
+QString KReplaySource::name() const
+{
+	return "Replay of " + m_fileName;
+}
+bool KReplaySource::atEnd() const
+{
+	return !m_hasNextFrame && !m_loop;
+}
+void KReplaySource::setSpeed(double speed)
+{
+	m_speed = speed;
+	m_clock.invalidate();
+}
+double KReplaySource::speed() const
+{
+	return m_speed;
+}
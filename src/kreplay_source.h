@@ -0,0 +1,42 @@
+#ifndef KREPLAY_SOURCE_H
+#define KREPLAY_SOURCE_H
+
+// Project
+#include "kbody_source.h"
+#include "kbody_stream.h"
+
+// Qt
+#include <QtCore/QElapsedTimer>
+
+// Body frames read back from a body stream file recorded by KSensor.
+// Frames keep their original relative timestamps and are delivered
+// at speed times the recorded rate, or as fast as possible when speed <= 0.
+class KReplaySource : public KBodySource
+{
+public:
+	KReplaySource(const QString& fileName, double speed = 1.0, bool loop = false);
+	bool open() override;
+	void close() override;
+	bool isOpen() override;
+	bool acquireFrame(KBodyFrame& bodyFrame) override;
+	bool isLive() const override;
+	QString name() const override;
+
+	bool atEnd() const;
+	void setSpeed(double speed);
+	double speed() const;
+private:
+	QString m_fileName;
+	double m_speed;
+	bool m_loop;
+
+	KBodyStreamReader m_reader;
+	KBodyFrame m_nextFrame;
+	bool m_hasNextFrame = false;
+	double m_lastTimestamp = 0.; // timestamp of the last delivered frame
+	double m_timeOffset = 0.; // added to the timestamps of looped frames
+	QElapsedTimer m_clock;
+	double m_clockStart = 0.; // stream time when m_clock was started
+};
+
+#endif
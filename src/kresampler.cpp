@@ -0,0 +1,192 @@
+// Own
+#include "kresampler.h"
+
+// Standard C/C++
+#include <cmath>
+
+// First frame after time at or after cursor, or size if there is none
+static int advanceCursor(const double* timestamps, int size, int cursor, double time)
+{
+	if (cursor >= size || timestamps[cursor] > time) {
+		return cursor;
+	}
+	int low = cursor; // timestamps[low] <= time
+	int step = 1;
+	int high = low + step;
+	while (high < size && timestamps[high] <= time) {
+		low = high;
+		step *= 2;
+		high = low + step;
+	}
+	if (high > size) high = size;
+	low++;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (timestamps[middle] <= time) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+static QQuaternion logarithm(const QQuaternion& q)
+{
+	float sine = q.vector().length();
+	if (sine < 1e-6f) {
+		return QQuaternion(0.f, q.vector());
+	}
+	float angle = atan2(sine, q.scalar());
+	return QQuaternion(0.f, q.vector() * (angle / sine));
+}
+static QQuaternion exponential(const QQuaternion& q)
+{
+	float angle = q.vector().length();
+	if (angle < 1e-6f) {
+		return QQuaternion(1.f, q.vector()).normalized();
+	}
+	return QQuaternion(cos(angle), q.vector() * (sin(angle) / angle));
+}
+// Squad control point of q between previous and next
+static QQuaternion squadTangent(const QQuaternion& previous, const QQuaternion& q, const QQuaternion& next)
+{
+	QQuaternion inverse = q.conjugated();
+	QQuaternion toPrevious = inverse * (QQuaternion::dotProduct(q, previous) < 0.f ? -previous : previous);
+	QQuaternion toNext = inverse * (QQuaternion::dotProduct(q, next) < 0.f ? -next : next);
+	QQuaternion sum = logarithm(toNext) + logarithm(toPrevious);
+	return q * exponential(sum * -0.25f);
+}
+
+KResampler::KResampler(double interval, Orientation orientation)
+	:
+	m_interval(interval),
+	m_orientation(orientation)
+{
+}
+double KResampler::interval() const
+{
+	return m_interval;
+}
+void KResampler::setInterval(double interval)
+{
+	m_interval = interval;
+}
+double KResampler::rate() const
+{
+	return 1. / m_interval;
+}
+void KResampler::setRate(double rate)
+{
+	m_interval = 1. / rate;
+}
+KResampler::Orientation KResampler::orientation() const
+{
+	return m_orientation;
+}
+void KResampler::setOrientation(Orientation orientation)
+{
+	m_orientation = orientation;
+}
+MotionBuffer KResampler::resample(const MotionBuffer& motion) const
+{
+	if (motion.size() < 2) {
+		return MotionBuffer();
+	}
+	int counterStart = (int)ceil(motion.timestamps()[0] / m_interval);
+	int counterEnd = (int)floor(motion.timestamps()[motion.size() - 1] / m_interval);
+	return resample(motion, counterStart, counterEnd - counterStart + 1);
+}
+MotionBuffer KResampler::resample(const MotionBuffer& motion, int counterStart, int desiredSize) const
+{
+	MotionBuffer resampledMotion;
+	if (motion.size() < 2 || desiredSize <= 0) {
+		return resampledMotion;
+	}
+	resampledMotion.resize(desiredSize);
+
+	// find the frames around every time: next is the first frame after it
+	const double* timestamps = motion.timestamps();
+	QVector<int> nextIndices(desiredSize);
+	QVector<double> percentDistances(desiredSize);
+	int cursor = 1;
+	for (int i = 0; i < desiredSize; i++) {
+		int counter = counterStart + i;
+		double time = m_interval * counter;
+		cursor = advanceCursor(timestamps, motion.size(), cursor, time);
+		int next = (cursor > motion.size() - 1) ? motion.size() - 1 : cursor;
+		nextIndices[i] = next;
+		percentDistances[i] = (time - timestamps[next - 1]) / (timestamps[next] - timestamps[next - 1]);
+		resampledMotion.serials()[i] = counter;
+		resampledMotion.timestamps()[i] = time;
+	}
+
+	QVector<QQuaternion> tangents;
+	if (m_orientation == Orientation::SQUAD) {
+		tangents.resize(motion.size());
+	}
+	for (uint j = 0; j < JointType_Count; j++) {
+		for (int c = MotionBuffer::PX; c <= MotionBuffer::PZ; c++) {
+			const float* in = motion.channel(j, (MotionBuffer::Channel)c);
+			float* out = resampledMotion.channel(j, (MotionBuffer::Channel)c);
+			for (int i = 0; i < desiredSize; i++) {
+				float previous = in[nextIndices[i] - 1];
+				float next = in[nextIndices[i]];
+				out[i] = previous + percentDistances[i] * (next - previous);
+			}
+		}
+
+		const float* inW = motion.channel(j, MotionBuffer::QW);
+		const float* inX = motion.channel(j, MotionBuffer::QX);
+		const float* inY = motion.channel(j, MotionBuffer::QY);
+		const float* inZ = motion.channel(j, MotionBuffer::QZ);
+		float* outW = resampledMotion.channel(j, MotionBuffer::QW);
+		float* outX = resampledMotion.channel(j, MotionBuffer::QX);
+		float* outY = resampledMotion.channel(j, MotionBuffer::QY);
+		float* outZ = resampledMotion.channel(j, MotionBuffer::QZ);
+		if (m_orientation == Orientation::SQUAD) {
+			int last = motion.size() - 1;
+			tangents[0] = QQuaternion(inW[0], inX[0], inY[0], inZ[0]);
+			tangents[last] = QQuaternion(inW[last], inX[last], inY[last], inZ[last]);
+			for (int k = 1; k < last; k++) {
+				tangents[k] = squadTangent(
+					QQuaternion(inW[k - 1], inX[k - 1], inY[k - 1], inZ[k - 1]),
+					QQuaternion(inW[k], inX[k], inY[k], inZ[k]),
+					QQuaternion(inW[k + 1], inX[k + 1], inY[k + 1], inZ[k + 1]));
+			}
+		}
+		for (int i = 0; i < desiredSize; i++) {
+			int p = nextIndices[i] - 1;
+			int n = nextIndices[i];
+			QQuaternion previous(inW[p], inX[p], inY[p], inZ[p]);
+			QQuaternion next(inW[n], inX[n], inY[n], inZ[n]);
+			QQuaternion q;
+			if (m_orientation == Orientation::NLERP) {
+				q = QQuaternion::nlerp(previous, next, percentDistances[i]);
+			}
+			else if (m_orientation == Orientation::SLERP) {
+				q = QQuaternion::slerp(previous, next, percentDistances[i]);
+			}
+			else {
+				// orientations are held outside the motion, like nlerp and slerp do
+				float t = (float)percentDistances[i];
+				t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+				q = QQuaternion::slerp(
+					QQuaternion::slerp(previous, next, t),
+					QQuaternion::slerp(tangents[p], tangents[n], t),
+					2.f * t * (1.f - t));
+			}
+			outW[i] = q.scalar();
+			outX[i] = q.x();
+			outY[i] = q.y();
+			outZ[i] = q.z();
+		}
+
+		const uchar* inStates = motion.trackingStates(j);
+		uchar* outStates = resampledMotion.trackingStates(j);
+		for (int i = 0; i < desiredSize; i++) {
+			bool inferred =
+				inStates[nextIndices[i] - 1] == TrackingState_Inferred ||
+				inStates[nextIndices[i]] == TrackingState_Inferred;
+			outStates[i] = inferred ? TrackingState_Inferred : TrackingState_Tracked;
+		}
+	}
+
+	return resampledMotion;
+}
@@ -0,0 +1,33 @@
+#ifndef KRESAMPLER_H
+#define KRESAMPLER_H
+
+// Project
+#include "motion_buffer.h"
+
+// Resamples a motion at a fixed interval: frame i is at time interval * (counterStart + i).
+// Positions are interpolated linearly, orientations with nlerp, slerp or squad,
+// and times outside the motion are extrapolated from its first or last two frames.
+// The frames around each time are found with a galloping search from a cursor that only
+// moves forward, so both up and down sampling take linear time.
+class KResampler
+{
+public:
+	enum class Orientation { NLERP, SLERP, SQUAD };
+
+	explicit KResampler(double interval, Orientation orientation = Orientation::NLERP);
+
+	double interval() const;
+	void setInterval(double interval);
+	double rate() const;
+	void setRate(double rate); // frames per second
+	Orientation orientation() const;
+	void setOrientation(Orientation orientation);
+
+	MotionBuffer resample(const MotionBuffer& motion, int counterStart, int desiredSize) const;
+	MotionBuffer resample(const MotionBuffer& motion) const; // every interval within the motion's time span
+private:
+	double m_interval;
+	Orientation m_orientation;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef KRING_BUFFER_H
+#define KRING_BUFFER_H
+
+// Standard C/C++
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Single-producer/single-consumer lock-free ring buffer.
+// push() must only be called from the producer thread and pop()/clear() from the consumer thread.
+template <class T, size_t N>
+class KRingBuffer
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "KRingBuffer capacity must be a power of two");
+public:
+	KRingBuffer()
+		:
+		m_head(0),
+		m_tail(0)
+	{
+	}
+
+	// Returns false if the buffer is full, the item is not stored in that case
+	bool push(const T& item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		m_items[head & (N - 1)] = item;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Returns false if the buffer is empty
+	bool pop(T& item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = m_items[tail & (N - 1)];
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	void clear()
+	{
+		m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+	size_t size() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+	static size_t capacity()
+	{
+		return N;
+	}
+private:
+	std::array<T, N> m_items;
+	alignas(64) std::atomic<size_t> m_head; // written by the producer only
+	alignas(64) std::atomic<size_t> m_tail; // written by the consumer only
+};
+
+#endif
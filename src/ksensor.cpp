@@ -1,220 +1,226 @@
 // Own
 #include "ksensor.h"
 
-// Windows
-#include <Windows.h>
+// Project
+#include "kkinect_source.h"
+#include "kreplay_source.h"
+#include "ksynthetic_source.h"
+
+// Qt
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
 
 // Standard C/C++
+#include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <vector>
 
-template <class T> void safeRelease(T **ppT)
-{
-	if (*ppT) {
-		(*ppT)->Release();
-		*ppT = NULL;
-	}
-}
-
-KSensor::KSensor()
+KSensor::KSensor(KBodySource* bodySource)
+	:
+	m_bodySource(bodySource),
+	m_isCapturing(false),
+	m_droppedFrames(0)
 {
 	cout << "KSensor constructor start." << endl;
+
+	if (!m_bodySource) {
+		QStringList arguments = QCoreApplication::arguments();
+		int replayIndex = arguments.indexOf("--replay");
+		int syntheticIndex = arguments.indexOf("--synthetic");
+		int speedIndex = arguments.indexOf("--replay-speed");
+		double speed = 1.;
+		if (speedIndex >= 0 && speedIndex + 1 < arguments.size()) {
+			speed = arguments[speedIndex + 1].toDouble();
+		}
+		if (replayIndex >= 0 && replayIndex + 1 < arguments.size()) {
+			m_bodySource = new KReplaySource(arguments[replayIndex + 1], speed);
+		}
+		else if (syntheticIndex >= 0 && syntheticIndex + 1 < arguments.size()) {
+			KMotionGeneratorSettings settings;
+			settings.duration = arguments[syntheticIndex + 1].toDouble();
+			m_bodySource = new KSyntheticSource(KMotionGenerator(m_skeleton.nodes(), m_skeleton.limbs(), settings), speed);
+		}
+		else {
+			m_bodySource = new KKinectSource();
+		}
+	}
+	cout << "Body source: " << m_bodySource->name().toStdString() << endl;
 	
-	init();
-	prepare();
+	if (m_bodySource->open()) {
+		startCapture();
+	}
 
-	m_sensorLog.setFileName("sensor.log");
-	if (!m_sensorLog.open(QIODevice::WriteOnly | QIODevice::Text)) {
+	if (!m_sensorLog.open("sensor.log")) {
 		cout << "Could not open capture log file." << endl;
 		return;
 	}
-	m_sensorLogData.setFieldAlignment(QTextStream::AlignLeft);
-	m_sensorLogData.setRealNumberPrecision(10);
-	m_sensorLogData.setDevice(&m_sensorLog);
 
 	cout << "KSensor constructor end.\n" << endl;
 }
 KSensor::~KSensor()
 {
-	m_sensor->Close();
-	safeRelease(&m_sensor);
-	safeRelease(&m_source);
-	safeRelease(&m_reader);
+	stopCapture();
+	stopStreamRecording();
+	delete m_bodySource;
 	m_sensorLog.close();
 }
-bool KSensor::init() {
-	HRESULT hr;
-	hr = GetDefaultKinectSensor(&m_sensor);
-	if (FAILED(hr)) {
-		cout << "Could not get kinect sensor. hr = " <<  hr << endl;
-		return false;
-	}
-
-	return true;	
+bool KSensor::isPrepared()
+{
+	return m_bodySource->isOpen();
 }
-bool KSensor::prepare()
+KBodySource* KSensor::bodySource()
 {
-	HRESULT hr;
-
-	// Safety check
-	if (!m_sensor) {
-		cout << "m_sensor = NULL." << endl;
+	return m_bodySource;
+}
+bool KSensor::startCapture()
+{
+	if (m_isCapturing) {
+		return true;
+	}
+	if (!m_bodySource->isOpen()) {
+		cout << "Could not start capture. " << m_bodySource->name().toStdString() << " is not open." << endl;
 		return false;
 	}
 
-	// Open sensor
-	hr = m_sensor->Open();
-	if (FAILED(hr)) {
-		cout << hr << "Could not open sensor. hr = " << hr << endl;
-		return false;
+	m_frames.clear();
+	m_consecutiveFails = 0;
+	m_lastTimestamp = -1.;
+	m_isCapturing = true;
+	m_captureThread = std::thread(&KSensor::captureLoop, this);
+	cout << "Capture thread started." << endl;
+	return true;
+}
+void KSensor::stopCapture()
+{
+	if (!m_isCapturing.exchange(false)) {
+		return;
 	}
-	
-	// Get source
-	hr = m_sensor->get_BodyFrameSource(&m_source);
-	if (FAILED(hr)) {
-		cout << hr << "Could not get frame source. hr = " << hr << endl;
-		return false;
+	if (m_captureThread.joinable()) {
+		m_captureThread.join();
 	}
-
-	// Open reader
-	hr = m_source->OpenReader(&m_reader);
-	if (FAILED(hr)) {
-		cout << hr << "Could not open reader.  hr = " << hr << endl;
-		return false;
+	cout << "Capture thread stopped." << endl;
+}
+bool KSensor::isCapturing() const
+{
+	return m_isCapturing;
+}
+void KSensor::captureLoop()
+{
+	while (m_isCapturing) {
+		KSensorFrame sensorFrame;
+		if (!acquireFrame(sensorFrame)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+		while (!m_frames.push(sensorFrame)) {
+			if (m_bodySource->isLive()) {
+				m_droppedFrames++;
+				break;
+			}
+			// replayed frames are never dropped, wait for the consumer instead
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			if (!m_isCapturing) {
+				return;
+			}
+		}
 	}
-
-	return true;
 }
-bool KSensor::isPrepared()
+// runs on the capture thread
+bool KSensor::acquireFrame(KSensorFrame& sensorFrame)
 {
-	HRESULT hr;
-
-	if (!m_sensor) {
-		cout << "m_sensor = NULL" << endl;
+	KBodyFrame bodyFrame;
+	if (!m_bodySource->acquireFrame(bodyFrame)) {
+		m_consecutiveFails++;
 		return false;
 	}
 
-	BOOLEAN isOpen = false;
-	hr = m_sensor->get_IsOpen(&isOpen);
-	if (SUCCEEDED(hr)) {
-		if (!isOpen) {
-			cout << "Sensor is not open." << endl;
-			return false;
+	{
+		std::lock_guard<std::mutex> lock(m_streamMutex);
+		if (m_streamWriter.isOpen()) {
+			m_streamWriter.write(bodyFrame);
 		}
 	}
-	else {
-		cout << "Could not specify if sensor is open. hr = " << hr << endl;
-	}
 
-	if (!m_source) {
-		cout << "m_source = NULL" << endl;
-		return false;
-	}
+	// discard if persons tracked != 1
+	sensorFrame.discarded = (bodyFrame.personsTracked != 1);
 
-	if (!m_reader) {
-		cout << "m_reader = NULL" << endl;
-		return false;
+	// discard if interval > 0.1
+	if (m_lastTimestamp < 0.) m_lastTimestamp = bodyFrame.timestamp;
+	sensorFrame.interval = bodyFrame.timestamp - m_lastTimestamp;
+	m_lastTimestamp = bodyFrame.timestamp;
+	if (sensorFrame.interval > 0.1) {
+		sensorFrame.discarded = true;
 	}
 
-	BOOLEAN isPaused = false;
-	hr = m_reader->get_IsPaused(&isPaused);
-	if (SUCCEEDED(hr)) {
-		if (isPaused) {
-			cout << "Reader is paused." << endl;
-			return false;
-		}
-	}
-	else {
-		cout << "Could not specify if reader is paused hr = " << hr << endl;
+	if (!sensorFrame.discarded) {
+		sensorFrame.frame.setJoints(bodyFrame.joints, bodyFrame.orientations);
 	}
+	sensorFrame.frame.timestamp = bodyFrame.timestamp;
+	sensorFrame.fps = calculateFPS();
+	sensorFrame.consecutiveFails = m_consecutiveFails;
+	m_consecutiveFails = 0;
 
 	return true;
 }
 bool KSensor::getBodyFrame(KFrame& destination)
 {
-	HRESULT hr;
-
-	// get frame
-	static uint consecutiveFails = 0;
-	IBodyFrame* frame = NULL;
-	hr = m_reader->AcquireLatestFrame(&frame);
-	if (FAILED(hr)) {
-		consecutiveFails++;
-		return false;
-	}
-
-	// get relative time
-	INT64 relativeTime;
-	hr = frame->get_RelativeTime(&relativeTime);
-	if (FAILED(hr)) {
-		m_sensorLogData << "Could not get relative time. hr = " << hr << endl;
-		return false;
-	}
-	double timestamp = (double)relativeTime / 10000000.;
-
-	// get bodies
-	IBody* bodies[BODY_COUNT] = { 0 };
-	hr = frame->GetAndRefreshBodyData(BODY_COUNT, bodies);
-	if (FAILED(hr)) {
-		m_sensorLogData << "Could not get and refresh body data. hr = " << hr << endl;
-		return false;
-	} 
-
-	// get data from bodies
-	bool discardFrame = false;
-	uint personsTracked = 0;
-	BOOLEAN bodyTracked;
-	Joint joints[JointType_Count];
-	JointOrientation orientations[JointType_Count];
-	for (int i = 0; i < BODY_COUNT; i++) {
-		bodies[i]->get_IsTracked(&bodyTracked);
-		if (bodyTracked) {
-			personsTracked++;
-			bodies[i]->GetJoints(JointType_Count, joints);
-			bodies[i]->GetJointOrientations(JointType_Count, orientations);
-		}
-	}
-
-	// discard if persons tracked != 1
-	if (personsTracked != 1) {
-		discardFrame = true;
-	}
-
-	// discard if interval > 0.1
-	static double lastTimestamp = timestamp;
-	double interval = timestamp - lastTimestamp;
-	lastTimestamp = timestamp;
-	if (interval > 0.1) {
-		discardFrame = true;
-	}
-		
-	if (discardFrame) {
-		m_sensorLogData << "Status=Discarded ";
+	uint droppedFrames = m_droppedFrames.exchange(0);
+	if (droppedFrames > 0) {
+		LOG_FILE(m_sensorLog, LOG_LEVEL_WARNING, "Dropped " << droppedFrames << " frames, capture buffer is full.");
 		if (m_skeleton.m_isRecording) {
-			cout << "Discarded frame during recording. Recording stopped." << endl;
+			cout << "Dropped frames during recording. Recording stopped." << endl;
 			m_skeleton.m_isRecording = false; // stop recording
 		}
 	}
-	else {
-		destination = m_skeleton.addFrame(joints, orientations, timestamp);
-		m_sensorLogData << (m_skeleton.m_isRecording ? "Status=Recorded  " : "Status=Captured  ") << qSetFieldWidth(4);
-	}
-	
-	m_sensorLogData << " RelativeTime=" << qSetFieldWidth(10) << timestamp;
-	m_sensorLogData << " Interval=" << qSetFieldWidth(10) << interval;
-	m_sensorLogData << " FPS=" << calculateFPS();
-	m_sensorLogData << " ConsecutiveFails=" << qSetFieldWidth(5) << consecutiveFails << endl;
-	consecutiveFails = 0;
 
-	// release resources
-	for (int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(bodies); ++i) {
-		safeRelease(&bodies[i]);
+	bool newFrame = false;
+	KSensorFrame sensorFrame;
+	while (m_frames.pop(sensorFrame)) {
+		if (sensorFrame.discarded) {
+			if (m_skeleton.m_isRecording) {
+				cout << "Discarded frame during recording. Recording stopped." << endl;
+				m_skeleton.m_isRecording = false; // stop recording
+			}
+		}
+		else {
+			destination = m_skeleton.addFrame(sensorFrame.frame);
+			newFrame = true;
+		}
+
+		LOG_FILE(m_sensorLog, LOG_LEVEL_DEBUG,
+			left << setprecision(10) <<
+			"Status=" << setw(9) << (sensorFrame.discarded ? "Discarded" : (m_skeleton.m_isRecording ? "Recorded" : "Captured")) <<
+			" RelativeTime=" << setw(10) << sensorFrame.frame.timestamp <<
+			" Interval=" << setw(10) << sensorFrame.interval <<
+			" FPS=" << sensorFrame.fps <<
+			" ConsecutiveFails=" << setw(5) << sensorFrame.consecutiveFails);
 	}
-	safeRelease(&frame);
 
+	return newFrame;
+}
+bool KSensor::startStreamRecording(const QString& fileName)
+{
+	std::lock_guard<std::mutex> lock(m_streamMutex);
+	if (!m_streamWriter.open(fileName)) {
+		return false;
+	}
+	cout << "Body stream recording to " << fileName.toStdString() << " started." << endl;
 	return true;
 }
+void KSensor::stopStreamRecording()
+{
+	std::lock_guard<std::mutex> lock(m_streamMutex);
+	if (m_streamWriter.isOpen()) {
+		m_streamWriter.close();
+		cout << "Body stream recording stopped." << endl;
+	}
+}
+bool KSensor::isStreamRecording()
+{
+	std::lock_guard<std::mutex> lock(m_streamMutex);
+	return m_streamWriter.isOpen();
+}
 double KSensor::calculateFPS() 
 {
 	static clock_t ticksThisTime;
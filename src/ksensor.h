@@ -4,37 +4,75 @@
 // Project
 #include "util.h"
 #include "kskeleton.h"
-
-// Kinect
-#include <Kinect.h>
-
-// Qt
-#include <QtCore/QFile>
+#include "kring_buffer.h"
+#include "kbody_source.h"
+#include "kbody_stream.h"
+#include "log.h"
 
 // Standard C/C++
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Body frame as acquired by the capture thread
+struct KSensorFrame
+{
+	KFrame frame;
+	bool discarded;			// persons tracked != 1 or interval > 0.1
+	double interval;		// time passed since the previous acquired frame
+	double fps;
+	uint consecutiveFails;	// failed acquisitions before this frame
+};
+
 class KSensor
 {
 public:
-	KSensor();
+	// Takes ownership of bodySource. Without a source the command line is checked for
+	// "--replay <file>" or "--synthetic <seconds>" (and optionally "--replay-speed <x>",
+	// 0 replays as fast as possible), otherwise the Kinect sensor is used.
+	KSensor(KBodySource* bodySource = nullptr);
 	~KSensor();
-	bool init();
-	bool prepare();
 	bool isPrepared();
+	KBodySource* bodySource();
+
+	// Capture thread polls the body source and pushes every acquired frame to m_frames
+	bool startCapture();
+	void stopCapture();
+	bool isCapturing() const;
+
+	// Drains all frames captured since the last call into the skeleton (recording included)
+	// and copies the newest one to destination. Returns false if no new frame was captured.
 	bool getBodyFrame(KFrame& destination);
 
+	// Raw body frames acquired by the capture thread are also written to a body stream file
+	bool startStreamRecording(const QString& fileName);
+	void stopStreamRecording();
+	bool isStreamRecording();
+
 	double calculateFPS();
 
 	KSkeleton *skeleton();
 private:
-	IKinectSensor *m_sensor = nullptr;
-	IBodyFrameSource *m_source = nullptr;
-	IBodyFrameReader *m_reader = nullptr;
+	KBodySource *m_bodySource = nullptr; // used by the capture thread only while capturing
+
+	// capture thread
+	static const size_t m_frameCapacity = 256; // ~8.5 sec of frames at 30 Hz
+	KRingBuffer<KSensorFrame, m_frameCapacity> m_frames;
+	std::thread m_captureThread;
+	std::atomic<bool> m_isCapturing;
+	std::atomic<uint> m_droppedFrames;
+	uint m_consecutiveFails = 0;
+	double m_lastTimestamp = -1.;
+	void captureLoop();
+	bool acquireFrame(KSensorFrame& sensorFrame);
+
+	// body stream recording
+	KBodyStreamWriter m_streamWriter;
+	std::mutex m_streamMutex;
 
-	QFile m_sensorLog;
-	QTextStream m_sensorLogData;
+	LogFile m_sensorLog; // one line per frame at debug level
 
 	KSkeleton m_skeleton;
 };
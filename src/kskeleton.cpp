@@ -1,12 +1,28 @@
 // Own
 #include "kskeleton.h"
 
+// Project
+#include "kresampler.h"
+#include "kstreaming_filter.h"
+#include "log.h"
+#include "motion_buffer.h"
+#include "motion_view.h"
+#include "session_file.h"
+#include "sg_filter.h"
+#include "stage_cache.h"
+#include "task_graph.h"
+
 // Qt
+#include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 
 // Standard C/C++
 #include <iomanip>
 
+static const quint32 derivedStagesFlags[NUM_SESSION_PERSONS] = { SESSION_DERIVED_ATHLETE, SESSION_DERIVED_TRAINER };
+
 QDataStream& operator<<(QDataStream& out, const KJoint& joint)
 {
 	out << joint.position << joint.orientation << joint.trackingState;
@@ -34,29 +50,46 @@ QDataStream& operator>>(QDataStream& in, KFrame& frame)
 	return in;
 }
 
-KSkeleton::KSkeleton() 
+KSkeleton::KSkeleton(const QString& sessionFile, const QString& logFile)
 {
 	cout << "KSkeleton constructor start." << endl;
 	
-	m_sequenceLog.setFileName("motions.log");
-	if (!m_sequenceLog.open(QIODevice::WriteOnly | QIODevice::Text)) {
-		cout << "Could not open sequences log file." << endl;
-		return;
+	if (!logFile.isEmpty()) {
+		m_sequenceLog.setFileName(logFile);
+		if (!m_sequenceLog.open(QIODevice::WriteOnly | QIODevice::Text)) {
+			cout << "Could not open sequences log file." << endl;
+		}
+		else {
+			m_sequenceLogData.setFieldAlignment(QTextStream::AlignLeft);
+			m_sequenceLogData.setRealNumberPrecision(6);
+			m_sequenceLogData.setDevice(&m_sequenceLog);
+		}
 	}
-	m_sequenceLogData.setFieldAlignment(QTextStream::AlignLeft);
-	m_sequenceLogData.setRealNumberPrecision(6);
-	m_sequenceLogData.setDevice(&m_sequenceLog);
 
 	initJoints();
 	printJointHierarchy();
 	initLimbs();
 
-	loadMotion();
+	m_streamingFilter = new KStreamingFilter(
+		m_parameters.interpolationInterval,
+		m_sgCoefficients.data(),
+		2 * m_framesDelayed + 1,
+		m_sgCoefficients.back());
+	// each person's filtered motion, pinned, and one more derived stage, the one shown
+	m_stageCache = new StageCache(2 * NUM_SESSION_PERSONS);
+	resetDerivedStages();
+
+	if (!sessionFile.isEmpty()) {
+		openSession(sessionFile);
+	}
 	
 	cout << "KSkeleton constructor end.\n" << endl;
 }
 KSkeleton::~KSkeleton()
 {
+	delete m_streamingFilter;
+	delete m_stageCache;
+	closeSession();
 	m_sequenceLog.close();
 }
 void KSkeleton::initJoints()
@@ -154,9 +187,11 @@ void KSkeleton::initLimbs()
 }
 void KSkeleton::record(bool trainerRecording)
 {
+	loadMappedMotions(); // the motion of the person not recorded is kept
 	if (!m_isRecording) {
 		cout << "Recording started." << endl;
 		m_recordedMotion.clear();
+		m_streamingFilter->start(-m_framesDelayed);
 		m_isRecording = true;
 	}
 	else {
@@ -167,34 +202,33 @@ void KSkeleton::record(bool trainerRecording)
 }
 KFrame KSkeleton::addFrame(const Joint* joints, const JointOrientation* jointOrientations, double time)
 {
-	static uint addedFrames = 0;
-	addedFrames++;
-
 	KFrame kframe;
-
-	for (uint i = 0; i < JointType_Count; i++) {
-		const Joint& jt = joints[i];
-		const JointOrientation& or = jointOrientations[i];
-		kframe.joints[i].position = QVector3D(jt.Position.X, jt.Position.Y, jt.Position.Z);
-		kframe.joints[i].orientation = QQuaternion(or.Orientation.w, or.Orientation.x, or.Orientation.y, or.Orientation.z);
-		kframe.joints[i].trackingState = jt.TrackingState;
-	}
+	kframe.setJoints(joints, jointOrientations);
 	kframe.timestamp = time;
-	kframe.serial = addedFrames; 
+	return addFrame(kframe);
+}
+KFrame KSkeleton::addFrame(const KFrame& frame)
+{
+	m_addedFrames++;
+
+	KFrame kframe = frame;
+	kframe.serial = m_addedFrames;
 
 	if (m_isRecording) {
+		streamFrame(kframe);
 		m_recordedMotion.push_back(kframe);
 	} 
 	else if (m_isFinalizing) {
-		static uint counter = 0;
-		if (counter < m_framesDelayed) {
-			counter++;
-			uint index = (m_firstFrameIndex - counter + m_framesDelayed) % m_framesDelayed;
+		if (m_finalizedFrames < m_framesDelayed) {
+			m_finalizedFrames++;
+			uint index = (m_firstFrameIndex - m_finalizedFrames + m_framesDelayed) % m_framesDelayed;
 			m_recordedMotion.push_front(m_firstRawFrames[index]);
 			m_recordedMotion.push_back(kframe);
+			streamFrame(kframe);
 		}
 		else {
 			cout << "Recording finished." << endl;
+			m_streamingFilter->finish(m_recordedMotion.size());
 			double timeOffset = m_recordedMotion[m_framesDelayed].timestamp;
 			int serialOffset = m_recordedMotion[m_framesDelayed].serial;
 			for (uint i = 0; i < m_recordedMotion.size(); i++) {
@@ -210,181 +244,440 @@ KFrame KSkeleton::addFrame(const Joint* joints, const JointOrientation* jointOri
 				cout << "Recorded trainer motion size: " << m_recordedMotion.size() << endl;
 			}
 			processMotions(-m_framesDelayed);
-			counter = 0;
-			addedFrames = 0;
+			m_streamingFilter->reset();
+			m_finalizedFrames = 0;
+			m_addedFrames = 0;
 			m_firstFrameIndex = 0;
 			m_isFinalizing = false;
 		}
 	}
 	else {
-		if (addedFrames <= m_framesDelayed) {
-			m_firstRawFrames[addedFrames - 1] = kframe;
+		if (m_addedFrames <= m_framesDelayed) {
+			m_firstRawFrames[m_addedFrames - 1] = kframe;
 		}
 		else {
 			m_firstRawFrames[m_firstFrameIndex] = kframe;
-			m_firstFrameIndex = addedFrames % m_framesDelayed;
+			m_firstFrameIndex = m_addedFrames % m_framesDelayed;
 		}
 	}
 
 	return kframe;
 }
+// The first recorded frame is the time origin, the pre-roll frames are streamed before it
+void KSkeleton::streamFrame(const KFrame& kframe)
+{
+	if (m_streamingFilter->rawFrameCount() == 0) {
+		m_streamTimeOffset = kframe.timestamp;
+		for (uint k = 0; k < m_framesDelayed; k++) {
+			KFrame preRollFrame = m_firstRawFrames[(m_firstFrameIndex + k) % m_framesDelayed];
+			preRollFrame.timestamp -= m_streamTimeOffset;
+			m_streamingFilter->addFrame(preRollFrame);
+		}
+	}
+	KFrame streamedFrame = kframe;
+	streamedFrame.timestamp -= m_streamTimeOffset;
+	m_streamingFilter->addFrame(streamedFrame);
+}
+bool KSkeleton::latestFilteredFrame(KFrame& frame) const
+{
+	if (!m_isRecording && !m_isFinalizing) {
+		return false;
+	}
+	return m_streamingFilter->latestFilteredFrame(frame);
+}
 void KSkeleton::processMotions(int interpolationStart)
 {
-	if (m_athleteRecording) {
-		cout << "Processing athlete motion" << endl;
-		m_athleteInterpolatedMotion = interpolateMotion(m_athleteRawMotion, interpolationStart, m_athleteRawMotion.size());
-		m_athleteFilteredMotion = filterMotion(m_athleteInterpolatedMotion);
-		m_athleteAdjustedMotion = adjustMotion(m_athleteFilteredMotion);
-		
+	loadMappedMotions();
+
+	// a recording was already interpolated and filtered while it was captured
+	bool streamed = m_streamingFilter->isFinished() && !m_streamingFilter->filteredMotion().empty();
+	if (streamed) {
+		cout << "Using the motion filtered during capture" << endl;
 	}
-	if (m_trainerRecording) {
-		cout << "Processing trainer motion" << endl;
-		m_trainerInterpolatedMotion = interpolateMotion(m_trainerRawMotion, interpolationStart, m_trainerRawMotion.size());
-		m_trainerFilteredMotion = filterMotion(m_trainerInterpolatedMotion);
-		m_trainerAdjustedMotion = adjustMotion(m_trainerFilteredMotion);
+
+	// Every recorded person's stages form a chain ending with the phases, the chains run in parallel.
+	// Each stage writes only its own person's motions, limbs and times, so the tasks share no state.
+	// The chain starts after the last stage still cached for the raw motion and the parameters.
+	// The rescales are derived when they are asked for, they need both persons' phases.
+	struct Person
+	{
+		const char* name;
+		bool recording;
+		SessionStage firstComputed; // the stages before it are cached
+		const QVector<KFrame>* rawMotion;
+		array<uint, NUM_PHASES>* phases;
+		MotionBuffer interpolated;
+		MotionBuffer filtered;
+		QVector<KFrame> interpolatedFrames;
+		QVector<KFrame> filteredFrames;
+		QVector<KFrame> adjusted;
+		array<KLimb, NUM_LIMBS> limbs;
+		float gapAverage;
+		KProcessingTimes times;
+	};
+	array<Person, NUM_SESSION_PERSONS> persons;
+	persons[SESSION_ATHLETE].name = "athlete";
+	persons[SESSION_ATHLETE].recording = m_athleteRecording;
+	persons[SESSION_ATHLETE].phases = &m_athletePhases;
+	persons[SESSION_TRAINER].name = "trainer";
+	persons[SESSION_TRAINER].recording = m_trainerRecording;
+	persons[SESSION_TRAINER].phases = &m_trainerPhases;
+
+	TaskGraph graph;
+	for (uint p = 0; p < persons.size(); p++) {
+		Person& person = persons[p];
+		person.rawMotion = memberMotion((SessionPerson)p, SESSION_RAW);
+		person.limbs = m_limbs;
+		person.gapAverage = m_gapAverage;
+		vector<TaskGraph::TaskId> adjustTask; // the phases wait for it, if the person was recorded
+		if (person.recording) {
+			for (uint s = SESSION_INTERPOLATED; s < NUM_SESSION_STAGES; s++) {
+				memberMotion((SessionPerson)p, (SessionStage)s)->clear();
+			}
+			m_stagesDerived[p] = true;
+			m_interpolationStarts[p] = interpolationStart;
+			m_rawHashes[p] = hashMotion(MotionView(*person.rawMotion));
+			person.firstComputed = SESSION_INTERPOLATED;
+			if (QVector<KFrame>* adjusted = m_stageCache->find(stageKey((SessionPerson)p, SESSION_ADJUSTED))) {
+				person.adjusted = *adjusted;
+				person.firstComputed = NUM_SESSION_STAGES;
+			}
+			else if (QVector<KFrame>* filtered = m_stageCache->find(stageKey((SessionPerson)p, SESSION_FILTERED))) {
+				person.filteredFrames = *filtered;
+				person.filtered = MotionBuffer(person.filteredFrames);
+				person.firstComputed = SESSION_ADJUSTED;
+			}
+		}
+		if (person.recording && person.firstComputed == NUM_SESSION_STAGES) {
+			// the limbs as the adjustment leaves them
+			adjustTask.push_back(graph.addTask([this, &person]() {
+				calculateLimbLengths(MotionBuffer(person.adjusted), person.limbs, person.gapAverage);
+			}));
+		}
+		else if (person.recording) {
+			vector<TaskGraph::TaskId> filterTask;
+			if (person.firstComputed == SESSION_INTERPOLATED) {
+				TaskGraph::TaskId interpolate = graph.addTask([this, &person, streamed, interpolationStart]() {
+					cout << "Processing " << person.name << " motion" << endl;
+					QElapsedTimer timer;
+					timer.start();
+					person.interpolated = streamed ?
+						m_streamingFilter->interpolatedMotion() :
+						interpolateMotion(MotionBuffer(*person.rawMotion), interpolationStart, person.rawMotion->size());
+					person.times.interpolate = timer.nsecsElapsed() / 1e6;
+					person.interpolatedFrames = person.interpolated.toFrames();
+				});
+				filterTask.push_back(graph.addTask([this, &person, streamed]() {
+					QElapsedTimer timer;
+					timer.start();
+					person.filtered = streamed ?
+						m_streamingFilter->filteredMotion() :
+						filterMotion(person.interpolated);
+					person.times.filter = timer.nsecsElapsed() / 1e6;
+					person.filteredFrames = person.filtered.toFrames();
+				}, { interpolate }));
+			}
+			adjustTask.push_back(graph.addTask([this, &person]() {
+				QElapsedTimer timer;
+				timer.start();
+				person.adjusted = adjustMotion(person.filtered, person.limbs, person.gapAverage).toFrames();
+				person.times.adjust = timer.nsecsElapsed() / 1e6;
+			}, filterTask));
+		}
+		else {
+			person.adjusted = motion((SessionPerson)p, SESSION_ADJUSTED); // derived here, the tasks must not
+		}
+		graph.addTask([this, &person]() {
+			QElapsedTimer timer;
+			timer.start();
+			*person.phases = identifyPhases(person.adjusted);
+			person.times.phases = timer.nsecsElapsed() / 1e6;
+		}, adjustTask);
+	}
+	graph.run();
+
+	m_processingTimes = KProcessingTimes();
+	for (uint p = 0; p < persons.size(); p++) {
+		m_processingTimes.interpolate += persons[p].times.interpolate;
+		m_processingTimes.filter += persons[p].times.filter;
+		m_processingTimes.adjust += persons[p].times.adjust;
+		m_processingTimes.phases += persons[p].times.phases;
 	}
 
-	m_athletePhases = identifyPhases(m_athleteAdjustedMotion);
-	m_trainerPhases = identifyPhases(m_trainerAdjustedMotion);
-	m_athleteRescaledMotion = rescaleMotion(
-		m_athleteAdjustedMotion,
-		m_trainerAdjustedMotion,
-		m_athletePhases,
-		m_trainerPhases);
-	m_trainerRescaledMotion = rescaleMotion(
-		m_trainerAdjustedMotion,
-		m_athleteAdjustedMotion,
-		m_trainerPhases,
-		m_athletePhases);
+	// the recorded persons' stages are derived from now on, the cache is seeded with the computed ones,
+	// the filtered ones pinned first and the adjusted ones last so they stay cached longest; every
+	// rescale is derived again with the new phases
+	updatePinnedStages();
+	for (uint p = 0; p < persons.size(); p++) {
+		const SessionPerson person = (SessionPerson)p;
+		if (persons[p].recording && persons[p].firstComputed == SESSION_INTERPOLATED) {
+			m_stageCache->insert(stageKey(person, UNCROPPED_INTERPOLATED), persons[p].interpolatedFrames);
+			m_stageCache->insert(stageKey(person, SESSION_FILTERED), persons[p].filteredFrames);
+		}
+		memberMotion(person, SESSION_RESCALED)->clear();
+	}
+	for (uint p = 0; p < persons.size(); p++) {
+		if (persons[p].recording && persons[p].firstComputed <= SESSION_ADJUSTED) {
+			m_stageCache->insert(stageKey((SessionPerson)p, SESSION_ADJUSTED), persons[p].adjusted);
+		}
+	}
+	// the limbs are left as the last adjustment of the serial order would leave them
+	for (int p = persons.size() - 1; p >= 0; p--) {
+		if (persons[p].recording && !persons[p].adjusted.empty()) {
+			m_limbs = persons[p].limbs;
+			m_gapAverage = persons[p].gapAverage;
+			break;
+		}
+	}
 
-	cropMotions();
-	if (m_trainerRawMotion.size() > m_bigMotionSize) m_bigMotionSize = m_trainerRawMotion.size();
-	else m_bigMotionSize = m_athleteRawMotion.size();
+	m_motionsRevision++;
+	updateBigMotionSize();
 	calculateOffsets();
 	printMotionsToLog();
 }
+int KSkeleton::interpolationStart(SessionPerson person) const
+{
+	if (m_stagesDerived[person]) {
+		return m_interpolationStarts[person];
+	}
+	// the stored interpolated stage is cropped by the filter's delay
+	const MotionView interpolated = motionView(person, SESSION_INTERPOLATED);
+	if (interpolated.size() > 0) {
+		return interpolated.frame(0).serial - m_framesDelayed;
+	}
+	return -m_framesDelayed; // as recorded
+}
+const KProcessingTimes& KSkeleton::processingTimes() const
+{
+	return m_processingTimes;
+}
+bool KSkeleton::setProcessingParameters(const KProcessingParameters& parameters)
+{
+	if (m_isRecording || m_isFinalizing) {
+		cout << "Cannot change the processing parameters while recording." << endl;
+		return false;
+	}
+	setParameters(parameters);
+	m_motionsRevision++;
+	m_processingTimes = KProcessingTimes();
+	updatePinnedStages();
+	// the keys of the stages reading a changed parameter change with it, the others stay cached
+	array<uint, NUM_PHASES>* phases[NUM_SESSION_PERSONS] = { &m_athletePhases, &m_trainerPhases };
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		if (m_stagesDerived[p]) {
+			*phases[p] = identifyPhases(motion((SessionPerson)p, SESSION_ADJUSTED));
+		}
+	}
+	updateBigMotionSize();
+	calculateOffsets();
+	return true;
+}
+const KProcessingParameters& KSkeleton::processingParameters() const
+{
+	return m_parameters;
+}
+void KSkeleton::setParameters(const KProcessingParameters& parameters)
+{
+	if (parameters.interpolationInterval != m_parameters.interpolationInterval) {
+		delete m_streamingFilter;
+		m_streamingFilter = new KStreamingFilter(
+			parameters.interpolationInterval,
+			m_sgCoefficients.data(),
+			2 * m_framesDelayed + 1,
+			m_sgCoefficients.back());
+	}
+	m_parameters = parameters;
+}
 QVector<KFrame> KSkeleton::interpolateMotion(
 	const QVector<KFrame>& motion,
 	int counterStart,
-	int desiredSize)
+	int desiredSize) const
+{
+	return interpolateMotion(MotionBuffer(motion), counterStart, desiredSize).toFrames();
+}
+MotionBuffer KSkeleton::interpolateMotion(
+	const MotionBuffer& motion,
+	int counterStart,
+	int desiredSize) const
 {
-	QVector<KFrame> interpolatedMotion;
+	MotionBuffer interpolatedMotion;
 
-	if (motion.empty()) {
-		cout << "interpolateMotion: empty input motion!" << endl;
+	if (motion.size() < 2) {
+		cout << "interpolateMotion: input motion has less than 2 frames!" << endl;
 		return interpolatedMotion;
 	}
 
 	cout << "Interpolating recorded frames." << endl;
-	cout << "Interpolation interval: " << m_interpolationInterval << endl;
-	int index = 1;
-	int counter = counterStart;
-	while (counter < desiredSize + counterStart) {
-		KFrame interpolatedFrame;
-		double interpolationTime = m_interpolationInterval * counter;
-		while (motion[index].timestamp <= interpolationTime && index < motion.size()) {
-			index++;
-		}
-		if (index > motion.size() - 2) index = motion.size() - 2;
-		interpolatedFrame.serial = counter;
-		interpolatedFrame.timestamp = interpolationTime;
-		interpolatedFrame.interpolateJoints(motion[--index], motion[index + 1], interpolationTime);
-		interpolatedMotion.push_back(interpolatedFrame);
-		counter++;
-	}
+	cout << "Interpolation interval: " << m_parameters.interpolationInterval << endl;
+	KResampler resampler(m_parameters.interpolationInterval, KResampler::Orientation::NLERP);
+	interpolatedMotion = resampler.resample(motion, counterStart, desiredSize);
 
 	cout << "Interpolated motion size: " << interpolatedMotion.size() << endl;
 	return interpolatedMotion;
 }
-QVector<KFrame> KSkeleton::filterMotion(const QVector<KFrame>& motion)
+QVector<KFrame> KSkeleton::filterMotion(const QVector<KFrame>& motion) const
 {
-	QVector<KFrame> filteredMotion;
+	return filterMotion(MotionBuffer(motion)).toFrames();
+}
+MotionBuffer KSkeleton::filterMotion(const MotionBuffer& motion) const
+{
+	MotionBuffer filteredMotion;
 
 	if (motion.empty()) {
 		cout << "filterMotion: empty input motion!" << endl;
 		return filteredMotion;
 	}
+	const int taps = 2 * m_framesDelayed + 1;
+	const int size = motion.size() - 2 * m_framesDelayed;
+	if (size <= 0) {
+		cout << "filterMotion: input motion is shorter than the filter!" << endl;
+		return filteredMotion;
+	}
 
 	cout << "Filtering motion" << endl;
-	uint np = m_sgCoefficients.size() - 1; // number of points used
-	for (uint i = m_framesDelayed; i < motion.size() - m_framesDelayed; i++) {
-		KFrame filteredFrame;
-		for (uint j = 0; j < JointType_Count; j++) {
-			filteredFrame.joints[j].position = QVector3D(0.f, 0.f, 0.f);
-			QMatrix3x3 newOrientation;
-			newOrientation.fill(0);
-			for (uint k = 0; k < 2 * m_framesDelayed + 1; k++) {
-				filteredFrame.joints[j].position +=
-					motion[i + k - np / 2].joints[j].position *
-					m_sgCoefficients[k] *
-					m_sgCoefficients.back();
-
-				float x, y, z;
-				QMatrix3x3 rot = motion[i + k - np / 2].joints[j].orientation.toRotationMatrix();
-				QVector3D eulerOrientations(x, y, z);
-				newOrientation +=
-					rot *
-					m_sgCoefficients[k] *
-					m_sgCoefficients.back();
+	filteredMotion.resize(size);
+	for (int i = 0; i < size; i++) {
+		filteredMotion.serials()[i] = motion.serials()[i + m_framesDelayed];
+		filteredMotion.timestamps()[i] = motion.timestamps()[i + m_framesDelayed];
+	}
+
+	SavitzkyGolayFilter filter(m_sgCoefficients.data(), taps, m_sgCoefficients.back());
+	cout << "Filter kernel: " << SavitzkyGolayFilter::instructionSetName() << endl;
+
+	// positions: x, y, z channels of a joint are consecutive
+	const int stride = motion.stride();
+	const int filteredStride = filteredMotion.stride();
+	for (uint j = 0; j < JointType_Count; j++) {
+		filter.convolve(
+			motion.channel(j, MotionBuffer::PX), stride,
+			filteredMotion.channel(j, MotionBuffer::PX), filteredStride,
+			3, size);
+	}
+
+	// orientations are filtered as rotation matrices, 9 channels per joint
+	const int numRotationChannels = 9 * JointType_Count;
+	QVector<float> rotations(numRotationChannels * stride);
+	QVector<float> filteredRotations(numRotationChannels * filteredStride);
+	for (uint j = 0; j < JointType_Count; j++) {
+		const float* w = motion.channel(j, MotionBuffer::QW);
+		const float* x = motion.channel(j, MotionBuffer::QX);
+		const float* y = motion.channel(j, MotionBuffer::QY);
+		const float* z = motion.channel(j, MotionBuffer::QZ);
+		float* r = rotations.data() + 9 * j * stride;
+		for (int i = 0; i < motion.size(); i++) {
+			const float x2 = x[i] + x[i], y2 = y[i] + y[i], z2 = z[i] + z[i];
+			r[0 * stride + i] = 1.f - (y2 * y[i] + z2 * z[i]);
+			r[1 * stride + i] = x2 * y[i] - z2 * w[i];
+			r[2 * stride + i] = x2 * z[i] + y2 * w[i];
+			r[3 * stride + i] = x2 * y[i] + z2 * w[i];
+			r[4 * stride + i] = 1.f - (x2 * x[i] + z2 * z[i]);
+			r[5 * stride + i] = y2 * z[i] - x2 * w[i];
+			r[6 * stride + i] = x2 * z[i] - y2 * w[i];
+			r[7 * stride + i] = y2 * z[i] + x2 * w[i];
+			r[8 * stride + i] = 1.f - (x2 * x[i] + y2 * y[i]);
+		}
+	}
+	filter.convolve(rotations.constData(), stride, filteredRotations.data(), filteredStride, numRotationChannels, size);
+	for (uint j = 0; j < JointType_Count; j++) {
+		float* outW = filteredMotion.channel(j, MotionBuffer::QW);
+		float* outX = filteredMotion.channel(j, MotionBuffer::QX);
+		float* outY = filteredMotion.channel(j, MotionBuffer::QY);
+		float* outZ = filteredMotion.channel(j, MotionBuffer::QZ);
+		const float* fr = filteredRotations.constData() + 9 * j * filteredStride;
+		for (int i = 0; i < size; i++) {
+			QMatrix3x3 rotation;
+			for (int e = 0; e < 9; e++) {
+				rotation(e / 3, e % 3) = fr[e * filteredStride + i];
 			}
-			filteredFrame.joints[j].orientation = QQuaternion::fromRotationMatrix(newOrientation);
+			QQuaternion q = QQuaternion::fromRotationMatrix(rotation);
+			outW[i] = q.scalar();
+			outX[i] = q.x();
+			outY[i] = q.y();
+			outZ[i] = q.z();
 		}
-		filteredFrame.serial = motion[i].serial;
-		filteredFrame.timestamp = motion[i].timestamp;
-		filteredMotion.push_back(filteredFrame);
 	}
 
 	cout << "Filtered motion size: " << filteredMotion.size() << endl;
 	return filteredMotion;
 }
-float KLimb::gapAverage = 0.f;
 void KSkeleton::calculateLimbLengths(const QVector<KFrame>& sequence)
 {
-	if (m_limbs.empty()) {
+	calculateLimbLengths(MotionBuffer(sequence));
+}
+void KSkeleton::calculateLimbLengths(const MotionBuffer& motion)
+{
+	calculateLimbLengths(motion, m_limbs, m_gapAverage);
+}
+void KSkeleton::calculateLimbLengths(const MotionBuffer& motion, array<KLimb, NUM_LIMBS>& limbs, float& gapAverage) const
+{
+	if (limbs.empty()) {
 		cout << "Limbs array is empty! Returning." << endl;
 		return;
 	}
-	if (sequence.empty()) {
+	if (motion.empty()) {
 		cout << "Frame sequence is empty! Returning." << endl;
 		return;
 	}
 
-	KLimb::gapAverage = 0.f;
-	for (uint l = 0; l < m_limbs.size(); l++) {
-		if (m_limbs[l].end == INVALID_JOINT_ID) continue;
-		m_limbs[l].maxLength = FLT_MIN;
-		m_limbs[l].minLength = FLT_MAX;
-		m_limbs[l].averageLength = 0;
-		for (uint i = 0; i < sequence.size(); i++) {
-			const QVector3D& startPosition = sequence[i].joints[m_limbs[l].start].position;
-			const QVector3D& endPosition = sequence[i].joints[m_limbs[l].end].position;
-			float length = startPosition.distanceToPoint(endPosition);
-			if (length > m_limbs[l].maxLength) {
-				m_limbs[l].maxLength = length;
-				m_limbs[l].serialMax = sequence[i].serial;
+	QVector<float> lengths(motion.size());
+	gapAverage = 0.f;
+	for (uint l = 0; l < limbs.size(); l++) {
+		if (limbs[l].end == INVALID_JOINT_ID) continue;
+		const float* sx = motion.channel(limbs[l].start, MotionBuffer::PX);
+		const float* sy = motion.channel(limbs[l].start, MotionBuffer::PY);
+		const float* sz = motion.channel(limbs[l].start, MotionBuffer::PZ);
+		const float* ex = motion.channel(limbs[l].end, MotionBuffer::PX);
+		const float* ey = motion.channel(limbs[l].end, MotionBuffer::PY);
+		const float* ez = motion.channel(limbs[l].end, MotionBuffer::PZ);
+		float* length = lengths.data();
+		for (int i = 0; i < motion.size(); i++) {
+			length[i] = QVector3D(ex[i] - sx[i], ey[i] - sy[i], ez[i] - sz[i]).length();
+		}
+
+		limbs[l].maxLength = FLT_MIN;
+		limbs[l].minLength = FLT_MAX;
+		limbs[l].averageLength = 0;
+		for (int i = 0; i < motion.size(); i++) {
+			if (length[i] > limbs[l].maxLength) {
+				limbs[l].maxLength = length[i];
+				limbs[l].serialMax = motion.serials()[i];
 			}
-			if (length < m_limbs[l].minLength) {
-				m_limbs[l].minLength = length;
-				m_limbs[l].serialMin = sequence[i].serial;
+			if (length[i] < limbs[l].minLength) {
+				limbs[l].minLength = length[i];
+				limbs[l].serialMin = motion.serials()[i];
 			}
-			m_limbs[l].averageLength += length;
+			limbs[l].averageLength += length[i];
 		}
-		m_limbs[l].averageLength /= sequence.size();
-		KLimb::gapAverage += m_limbs[l].maxLength - m_limbs[l].minLength;
+		limbs[l].averageLength /= motion.size();
+		gapAverage += limbs[l].maxLength - limbs[l].minLength;
 	}
-	KLimb::gapAverage /= (m_limbs.size() - 1);
+	gapAverage /= (limbs.size() - 1);
 
-	for (uint l = 0; l < m_limbs.size(); l++) {
-		m_limbs[l].desiredLength = (
-			m_limbs[l].sibling == INVALID_JOINT_ID ?
-			m_limbs[l].averageLength :
-			(m_limbs[l].averageLength + m_limbs[m_limbs[l].sibling].averageLength) / 2.f
-			);
+	for (uint l = 0; l < limbs.size(); l++) {
+		limbs[l].desiredLength = desiredLength(limbs, l);
 	}
 }
+// the parameters' length if it is set, else the average length of the limb and its sibling
+float KSkeleton::desiredLength(const array<KLimb, NUM_LIMBS>& limbs, uint limb) const
+{
+	if (m_parameters.desiredLengths[limb] > 0.f) {
+		return m_parameters.desiredLengths[limb];
+	}
+	return limbs[limb].sibling == INVALID_JOINT_ID ?
+		limbs[limb].averageLength :
+		(limbs[limb].averageLength + limbs[limbs[limb].sibling].averageLength) / 2.f;
+}
 QVector<KFrame> KSkeleton::adjustMotion(const QVector<KFrame>& motion)
 {
-	QVector<KFrame> adjustedMotion;
+	return adjustMotion(MotionBuffer(motion)).toFrames();
+}
+MotionBuffer KSkeleton::adjustMotion(const MotionBuffer& motion)
+{
+	return adjustMotion(motion, m_limbs, m_gapAverage);
+}
+MotionBuffer KSkeleton::adjustMotion(const MotionBuffer& motion, array<KLimb, NUM_LIMBS>& limbs, float& gapAverage) const
+{
+	MotionBuffer adjustedMotion;
 
 	if (motion.empty()) {
 		cout << "adjustMotion: empty input motion" << endl;
@@ -393,31 +686,35 @@ QVector<KFrame> KSkeleton::adjustMotion(const QVector<KFrame>& motion)
 
 	cout << "Adjusting motion" << endl;
 	cout << "Before adjustments:" << endl;
-	calculateLimbLengths(motion);
-	printLimbLengths();
+	calculateLimbLengths(motion, limbs, gapAverage);
+	printLimbLengths(limbs, gapAverage);
 
+	adjustedMotion.resize(motion.size());
+	KFrame frame;
 	for (uint i = 0; i < motion.size(); i++) {
-		m_leftFootOffset = QVector3D();
-		m_rightFootOffset = QVector3D();
-		KFrame adjustedFrame = motion[i];
-		for (uint l = 0; l < m_limbs.size(); l++) {
-			KLimb& limb = m_limbs[l];
-			const QVector3D& startPosition = motion[i].joints[limb.start].position;
-			const QVector3D& endPosition = motion[i].joints[limb.end].position;
+		QVector3D leftFootOffset;
+		QVector3D rightFootOffset;
+		motion.getFrame(i, frame);
+		KFrame adjustedFrame = frame;
+		for (uint l = 0; l < limbs.size(); l++) {
+			KLimb& limb = limbs[l];
+			const QVector3D& startPosition = frame.joints[limb.start].position;
+			const QVector3D& endPosition = frame.joints[limb.end].position;
 			QVector3D direction = endPosition - startPosition;
 			float limbCurrentLength = startPosition.distanceToPoint(endPosition);
-			limb.desiredLength =
-				m_limbs[l].sibling == INVALID_JOINT_ID ?
-				m_limbs[l].averageLength :
-				(m_limbs[l].averageLength + m_limbs[m_limbs[l].sibling].averageLength) / 2.f;;
+			limb.desiredLength = desiredLength(limbs, l);
 			float adjustmentFactor = limb.desiredLength / limbCurrentLength;
+			if (m_parameters.adjustmentStrength != 1.f) {
+				adjustmentFactor = 1.f + m_parameters.adjustmentStrength * (adjustmentFactor - 1.f);
+			}
 			if (i == 0) {
-				cout << "Limb=" << limb.name.toStdString();
-				cout << " DesiredLength=" << limb.desiredLength;
-				cout << " CurrentLength=" << limbCurrentLength;
-				cout << " CurrentFactor=" << adjustmentFactor << endl;
+				LOG_DEBUG(
+					"Limb=" << limb.name.toStdString() <<
+					" DesiredLength=" << limb.desiredLength <<
+					" CurrentLength=" << limbCurrentLength <<
+					" CurrentFactor=" << adjustmentFactor);
 			}
-			adjustLimbLength(adjustedFrame, limb.end, direction, adjustmentFactor);
+			adjustLimbLength(adjustedFrame, limb.end, direction, adjustmentFactor, leftFootOffset, rightFootOffset);
 		}
 
 		// Point thumbs towards opposite hand
@@ -426,46 +723,57 @@ QVector<KFrame> KSkeleton::adjustMotion(const QVector<KFrame>& motion)
 			adjustedFrame.joints[JointType_HandRight].position;
 		adjustedFrame.joints[JointType_ThumbLeft].position =
 			adjustedFrame.joints[JointType_HandLeft].position -
-			handRightToLeft.normalized()*m_limbs[21].desiredLength;
+			handRightToLeft.normalized()*limbs[21].desiredLength;
 		adjustedFrame.joints[JointType_ThumbRight].position =
 			adjustedFrame.joints[JointType_HandRight].position +
-			handRightToLeft.normalized()*m_limbs[22].desiredLength;
+			handRightToLeft.normalized()*limbs[22].desiredLength;
 
 		// Move all joints towards the ground
 		for (uint j = 0; j < JointType_Count; j++) {
 			adjustedFrame.joints[j].position.setY(
 				adjustedFrame.joints[j].position.y() -
-				(m_leftFootOffset.y() + m_rightFootOffset.y()) / 2.f
+				(leftFootOffset.y() + rightFootOffset.y()) / 2.f
 			);
 		}
 
-		adjustedMotion.push_back(adjustedFrame);
+		adjustedMotion.setFrame(i, adjustedFrame);
 	}
 
-	calculateLimbLengths(adjustedMotion);
+	calculateLimbLengths(adjustedMotion, limbs, gapAverage);
 	cout << "After adjustments: " << endl;
-	printLimbLengths();
+	printLimbLengths(limbs, gapAverage);
 
 	cout << "Adjusted motion size: " << adjustedMotion.size() << endl;
 	return adjustedMotion;
 }
-void KSkeleton::adjustLimbLength(KFrame& kframe, uint jointId, const QVector3D& direction, float factor)
+void KSkeleton::adjustLimbLength(
+	KFrame& kframe,
+	uint jointId,
+	const QVector3D& direction,
+	float factor,
+	QVector3D& leftFootOffset,
+	QVector3D& rightFootOffset) const
 {
 	QVector3D& end = kframe.joints[jointId].position;
 	QVector3D deltaEnd = -(1 - factor) * direction;
 	end = end + deltaEnd;
-	if (jointId == JointType_FootLeft) m_leftFootOffset += deltaEnd;
-	if (jointId == JointType_FootRight) m_rightFootOffset += deltaEnd;
-	if (kframe.serial == 0) cout << m_nodes[jointId].name.toStdString() << " ";
+	if (jointId == JointType_FootLeft) leftFootOffset += deltaEnd;
+	if (jointId == JointType_FootRight) rightFootOffset += deltaEnd;
+	if (kframe.serial == 0) LOG_TRACE("Adjusted joint " << m_nodes[jointId].name.toStdString());
 	for (uint i = 0; i < m_nodes[jointId].childrenId.size(); i++) {
 		uint childId = m_nodes[jointId].childrenId[i];
-		adjustLimbLength(kframe, childId, direction, factor);
+		adjustLimbLength(kframe, childId, direction, factor, leftFootOffset, rightFootOffset);
 	}
 }
-array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion) {
+array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion) const {
 	cout << "Identifying motion phases" << endl;
 
 	array<uint, NUM_PHASES> ret;
+	ret.fill(INVALID_JOINT_ID); // the phases after one that is not found stay invalid
+	if (motion.size() < 3) {
+		cout << "Motion is too short to identify phases" << endl;
+		return ret;
+	}
 
 	uint i = 0;
 	QVector3D barbellPosition;
@@ -477,7 +785,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 2) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		barbellPosition =
@@ -498,7 +805,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 1) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		barbellPosition =
@@ -516,7 +822,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 1) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		barbellPosition =
@@ -534,7 +839,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 2) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		headPosition = motion[i].joints[JointType_Head].position;
@@ -550,7 +854,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 2) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		headPosition = motion[i].joints[JointType_Head].position;
@@ -566,7 +869,6 @@ array<uint, NUM_PHASES> KSkeleton::identifyPhases(const QVector<KFrame>& motion)
 		i++;
 		if (i > motion.size() - 2) {
 			cout << "Could not identify position" << endl;
-			ret[i] = INVALID_JOINT_ID;
 			return ret;
 		}
 		headPosition = motion[i].joints[JointType_Head].position;
@@ -588,6 +890,16 @@ QVector<KFrame> KSkeleton::rescaleMotion(
 	const QVector<KFrame>& prototype,
 	const array<uint, NUM_PHASES>& originalPhases,
 	const array<uint, NUM_PHASES>& prototypePhases)
+{
+	return rescaleMotion(original, prototype, originalPhases, prototypePhases, m_limbs, m_gapAverage);
+}
+QVector<KFrame> KSkeleton::rescaleMotion(
+	const QVector<KFrame>& original,
+	const QVector<KFrame>& prototype,
+	const array<uint, NUM_PHASES>& originalPhases,
+	const array<uint, NUM_PHASES>& prototypePhases,
+	array<KLimb, NUM_LIMBS>& limbs,
+	float& gapAverage) const
 {
 	cout << "Rescaling motion" << endl;
 
@@ -643,7 +955,7 @@ QVector<KFrame> KSkeleton::rescaleMotion(
 	}
 
 	rescaledMotion = interpolateMotion(rescaledMotion, 0, prototype.size());
-	rescaledMotion = adjustMotion(rescaledMotion);
+	rescaledMotion = adjustMotion(MotionBuffer(rescaledMotion), limbs, gapAverage).toFrames();
 
 	return rescaledMotion;
 }
@@ -655,13 +967,15 @@ void KSkeleton::calculateJointOrientations(QVector<KFrame>& motion)
 			uint parent = m_nodes[j].parentId;
 			uint helper = m_nodes[j].helperId;
 			if (parent == INVALID_JOINT_ID || helper == INVALID_JOINT_ID) {
-				if (i == 0) cout << "Invalid joint id " << parent << " " << helper << endl;
+				if (i == 0) LOG_DEBUG("Invalid joint id " << parent << " " << helper);
 				continue;
 			}
-			if (i == 0) cout << "Child=" << m_nodes[child].name.toStdString();
-			if (i == 0) cout << " Parent=" << m_nodes[parent].name.toStdString();
-			if (i == 0) cout << " Helper=" << m_nodes[helper].name.toStdString();
-			if (i == 0) cout << endl;
+			if (i == 0) {
+				LOG_TRACE(
+					"Child=" << m_nodes[child].name.toStdString() <<
+					" Parent=" << m_nodes[parent].name.toStdString() <<
+					" Helper=" << m_nodes[helper].name.toStdString());
+			}
 
 			QVector3D childToOrigin =
 				motion[i].joints[parent].position -
@@ -717,106 +1031,73 @@ void KSkeleton::calculateJointOrientations(QVector<KFrame>& motion)
 			QQuaternion q;
 			float angle = ToDegrees(acos(QVector3D::dotProduct(childToOrigin, childToHelper)));
 			if (angle < 0.001) {
-				if (i == 0) cout << "AngleBetweenDirections=" << angle << endl;
+				if (i == 0) LOG_DEBUG("AngleBetweenDirections=" << angle);
 			}
 			q = QQuaternion::fromDirection(frontDirection, upDirection);
-			if (i == 0) cout << "Hand-made quat: " << toString(q).toStdString() << toStringEulerAngles(q).toStdString() << toStringAxisAngle(q).toStdString() << endl;
+			if (i == 0) LOG_TRACE("Hand-made quat: " << toString(q).toStdString() << toStringEulerAngles(q).toStdString() << toStringAxisAngle(q).toStdString());
 
 			QQuaternion absQ = motion[i].joints[child].orientation;
-			if (i == 0) cout << "Original  quat: " << toString(absQ).toStdString() << toStringEulerAngles(absQ).toStdString() << toStringAxisAngle(absQ).toStdString() << endl;
+			if (i == 0) LOG_TRACE("Original  quat: " << toString(absQ).toStdString() << toStringEulerAngles(absQ).toStdString() << toStringAxisAngle(absQ).toStdString());
 			
 			motion[i].joints[child].orientation = q;
 		}
 	}
 }
-void KSkeleton::cropMotions()
-{
-	if (m_athleteRawMotion.size() != m_athleteFilteredMotion.size()) {
-		cout << "Athlete raw motion size before crop:" << m_athleteRawMotion.size() << endl;
-		for (uint i = 0; i < m_framesDelayed; i++) {
-			m_athleteRawMotion.removeFirst();
-			m_athleteRawMotion.removeLast();
-		}
-		cout << "Athlete raw motion size after crop:" << m_athleteRawMotion.size() << endl;
-	}
-	if (m_athleteInterpolatedMotion.size() != m_athleteFilteredMotion.size()) {
-		cout << "Athlete raw motion size before crop:" << m_athleteRawMotion.size() << endl;
-		for (uint i = 0; i < m_framesDelayed; i++) {
-			m_athleteInterpolatedMotion.removeFirst();
-			m_athleteInterpolatedMotion.removeLast();
-			
-		}
-		cout << "Athlete Interpolated motion size after crop:" << m_athleteInterpolatedMotion.size() << endl;
-	}
-	if (m_trainerRawMotion.size() != m_trainerFilteredMotion.size()) {
-		cout << "Trainer raw motion size before crop:" << m_trainerRawMotion.size() << endl;
-		for (uint i = 0; i < m_framesDelayed; i++) {
-			m_trainerRawMotion.removeFirst();
-			m_trainerRawMotion.removeLast();
-			
-		}
-		cout << "Trainer raw motion size after crop:" << m_trainerRawMotion.size() << endl;
-	}
-	if (m_trainerInterpolatedMotion.size() != m_trainerFilteredMotion.size()) {
-		cout << "Trainer raw motion size before crop:" << m_trainerRawMotion.size() << endl;
-		for (uint i = 0; i < m_framesDelayed; i++) {
-			m_trainerInterpolatedMotion.removeFirst();
-			m_trainerInterpolatedMotion.removeLast();
-		}
-		cout << "Trainer Interpolated motion size after crop:" << m_trainerInterpolatedMotion.size() << endl;
-	}
-}
 void KSkeleton::calculateOffsets()
 {
 	cout << "Calculating athlete offsets" << endl;
-	if (m_athleteAdjustedMotion.size() > 0) {
-		m_athletePelvisOffset = m_athleteAdjustedMotion.front().joints[JointType_SpineBase].position;
+	MotionView athleteAdjustedMotion = motionView(SESSION_ATHLETE, SESSION_ADJUSTED);
+	if (athleteAdjustedMotion.size() > 0) {
+		const KFrame first = athleteAdjustedMotion.frame(0);
+		m_athletePelvisOffset = first.joints[JointType_SpineBase].position;
 		cout << "Pelvis: " << toStringCartesian(m_athletePelvisOffset).toStdString() << endl;
 		
 		m_athleteFeetOffset =
-			m_athleteAdjustedMotion.front().joints[JointType_AnkleLeft].position / 2.f +
-			m_athleteAdjustedMotion.front().joints[JointType_AnkleRight].position / 2.f;
+			first.joints[JointType_AnkleLeft].position / 2.f +
+			first.joints[JointType_AnkleRight].position / 2.f;
 		cout << "Feet: " << m_athleteFeetOffset << endl;
 		
 		m_athleteHandsOffset =
-			m_athleteAdjustedMotion.front().joints[JointType_HandLeft].position / 2.f +
-			m_athleteAdjustedMotion.front().joints[JointType_HandRight].position / 2.f;
+			first.joints[JointType_HandLeft].position / 2.f +
+			first.joints[JointType_HandRight].position / 2.f;
 		cout << "Hands: " << m_athleteHandsOffset << endl;
 
 		m_athleteInitialBarbellDirection =
-			m_athleteAdjustedMotion.front().joints[JointType_HandLeft].position -
-			m_athleteAdjustedMotion.front().joints[JointType_HandRight].position;
+			first.joints[JointType_HandLeft].position -
+			first.joints[JointType_HandRight].position;
 		cout << "Initial barbell direction: " << toStringCartesian(m_athleteInitialBarbellDirection).toStdString() << endl;
 
 		m_athleteInitialFeetDirection =
-			m_athleteAdjustedMotion.front().joints[JointType_FootLeft].position -
-			m_athleteAdjustedMotion.front().joints[JointType_FootRight].position;
+			first.joints[JointType_FootLeft].position -
+			first.joints[JointType_FootRight].position;
 		cout << "Initial feet direction: " << toStringCartesian(m_athleteInitialFeetDirection).toStdString() << endl;
 	}
 
 	cout << "Calculating trainer offsets" << endl;
-	if (m_trainerAdjustedMotion.size() > 0) {
-		m_trainerPelvisOffset = m_trainerAdjustedMotion.front().joints[JointType_SpineBase].position;
+	MotionView trainerAdjustedMotion = motionView(SESSION_TRAINER, SESSION_ADJUSTED);
+	if (trainerAdjustedMotion.size() > 0) {
+		const KFrame first = trainerAdjustedMotion.frame(0);
+		m_trainerPelvisOffset = first.joints[JointType_SpineBase].position;
 		cout << "Pelvis: " << toStringCartesian(m_trainerPelvisOffset).toStdString() << endl;
 		
 		m_trainerFeetOffset =
-			m_trainerAdjustedMotion.front().joints[JointType_AnkleLeft].position / 2.f +
-			m_trainerAdjustedMotion.front().joints[JointType_AnkleRight].position / 2.f;
+			first.joints[JointType_AnkleLeft].position / 2.f +
+			first.joints[JointType_AnkleRight].position / 2.f;
 		cout << "Feet: " << m_trainerFeetOffset << endl;
 		
 		m_trainerHandsOffset =
-			m_trainerAdjustedMotion.front().joints[JointType_HandLeft].position / 2.f +
-			m_trainerAdjustedMotion.front().joints[JointType_HandRight].position / 2.f;
+			first.joints[JointType_HandLeft].position / 2.f +
+			first.joints[JointType_HandRight].position / 2.f;
 		cout << "Hands: " << m_trainerHandsOffset << endl;
 
 		m_trainerInitialBarbellDirection =
-			m_trainerAdjustedMotion.front().joints[JointType_HandLeft].position -
-			m_trainerAdjustedMotion.front().joints[JointType_HandRight].position;
+			first.joints[JointType_HandLeft].position -
+			first.joints[JointType_HandRight].position;
 		cout << "Initial barbell direction: " << toStringCartesian(m_trainerInitialBarbellDirection).toStdString() << endl;
 
 		m_trainerInitialFeetDirection =
-			m_trainerAdjustedMotion.front().joints[JointType_FootLeft].position -
-			m_trainerAdjustedMotion.front().joints[JointType_FootRight].position;
+			first.joints[JointType_FootLeft].position -
+			first.joints[JointType_FootRight].position;
 		cout << "Initial feet direction: " << toStringCartesian(m_trainerInitialFeetDirection).toStdString() << endl;
 	}
 }
@@ -825,18 +1106,22 @@ const array<KNode, JointType_Count>& KSkeleton::nodes() const
 	return m_nodes;
 }
 void KSkeleton::printLimbLengths() const
+{
+	printLimbLengths(m_limbs, m_gapAverage);
+}
+void KSkeleton::printLimbLengths(const array<KLimb, NUM_LIMBS>& limbs, float gapAverage) const
 {
 	cout << "Limb lengths: " << endl;
-	for (uint l = 0; l < m_limbs.size(); l++) {
-		if (m_limbs[l].end == INVALID_JOINT_ID) continue;
-		cout << setw(30) << left << m_limbs[l].name.toStdString() << " ";
-		cout << "Min=" << setw(10) << m_limbs[l].minLength << " (" << setw(5) << m_limbs[l].serialMin;
-		cout << ") Max=" << setw(10) << m_limbs[l].maxLength << " (" << setw(5) << m_limbs[l].serialMax;
-		cout << ") Avg=" << setw(10) << m_limbs[l].averageLength << " ";
-		cout << " Des=" << setw(10) << m_limbs[l].desiredLength << " ";
-		cout << "Gap=" << setw(10) << m_limbs[l].maxLength - m_limbs[l].minLength << endl;
+	for (uint l = 0; l < limbs.size(); l++) {
+		if (limbs[l].end == INVALID_JOINT_ID) continue;
+		cout << setw(30) << left << limbs[l].name.toStdString() << " ";
+		cout << "Min=" << setw(10) << limbs[l].minLength << " (" << setw(5) << limbs[l].serialMin;
+		cout << ") Max=" << setw(10) << limbs[l].maxLength << " (" << setw(5) << limbs[l].serialMax;
+		cout << ") Avg=" << setw(10) << limbs[l].averageLength << " ";
+		cout << " Des=" << setw(10) << limbs[l].desiredLength << " ";
+		cout << "Gap=" << setw(10) << limbs[l].maxLength - limbs[l].minLength << endl;
 	}
-	cout << "GapAverage=" << KLimb::gapAverage << endl;
+	cout << "GapAverage=" << gapAverage << endl;
 }
 void KSkeleton::printJointHierarchy() const
 {
@@ -853,24 +1138,33 @@ void KSkeleton::printJointHierarchy() const
 	}
 }
 // saves filtered frame sequence to trc
-bool KSkeleton::exportToTRC()
+bool KSkeleton::exportToTRC(const QString& fileName)
 {
-	QString fileName("joint_positions.trc");
+	loadMappedMotions();
+	QVector<KFrame> exportedMotion = m_athleteRecording ?
+		motion(SESSION_ATHLETE, SESSION_RESCALED) :
+		motion(SESSION_TRAINER, SESSION_ADJUSTED);
+	if (m_athleteRecording && exportedMotion.empty()) {
+		exportedMotion = motion(SESSION_ATHLETE, SESSION_ADJUSTED); // no trainer to rescale to
+	}
+	if (exportedMotion.empty()) {
+		cout << "No " << (m_athleteRecording ? "athlete" : "trainer") << " motion to export." << endl;
+		return false;
+	}
+
 	QFile qf(fileName);
 	if (!qf.open(QIODevice::WriteOnly | QIODevice::Text)) {
 		cout << "Could not create " << fileName.toStdString() << endl;
 		return false;
 	}
 	QTextStream out(&qf);
-
-	QVector<KFrame>& exportedMotion = m_athleteRecording ? m_athleteRescaledMotion : m_trainerAdjustedMotion;
 	cout << "Exporting " << (m_athleteRecording ? "athlete" : "trainer") << " motion to .trc" << endl;
 
 	// Line 1
 	out << "PathFileType\t";
 	out << "4\t";
 	out << "(X / Y / Z)\t";
-	out << "joint_positions.trc\n";
+	out << QFileInfo(fileName).fileName() << "\n";
 	// Line 2
 	out << "DataRate\t";
 	out << "CameraRate\t";
@@ -938,54 +1232,122 @@ void KSkeleton::processSpecific()
 	m_trainerAdjustedMotion = adjustMotion(m_trainerFilteredMotion);
 	m_trainerPhases = identifyPhases(m_trainerAdjustedMotion);*/
 
-	m_athletePhases = identifyPhases(m_athleteAdjustedMotion);
-	m_trainerPhases = identifyPhases(m_trainerAdjustedMotion);
+	const QVector<KFrame> athleteAdjustedMotion = motion(SESSION_ATHLETE, SESSION_ADJUSTED);
+	const QVector<KFrame> trainerAdjustedMotion = motion(SESSION_TRAINER, SESSION_ADJUSTED);
+	m_athletePhases = identifyPhases(athleteAdjustedMotion);
+	m_trainerPhases = identifyPhases(trainerAdjustedMotion);
+	// stored, so they take the place of the derived ones
 	m_athleteRescaledMotion = rescaleMotion(
-		m_athleteAdjustedMotion,
-		m_trainerAdjustedMotion,
+		athleteAdjustedMotion,
+		trainerAdjustedMotion,
 		m_athletePhases,
 		m_trainerPhases);
 	m_trainerRescaledMotion = rescaleMotion(
-		m_trainerAdjustedMotion,
-		m_athleteAdjustedMotion,
+		trainerAdjustedMotion,
+		athleteAdjustedMotion,
 		m_trainerPhases,
 		m_athletePhases);
+	m_motionsRevision++;
 }
-void KSkeleton::saveFrameSequences()
+bool KSkeleton::saveFrameSequences(const QString& fileName, bool compress)
 {
-	QFile qf("sequences.txt");
-	if (!qf.open(QIODevice::WriteOnly)) {
-		cout << "Cannot write to sequences.txt binary file." << endl;
-		return;
+	loadMappedMotions(); // also unmaps the file, which may be the one overwritten
+	cout << "Saving to " << fileName.toStdString() << " session file" << endl;
+
+	SessionHeader metadata;
+	memset(&metadata, 0, sizeof(metadata));
+	metadata.creationTime = QDateTime::currentMSecsSinceEpoch();
+	// derived stages are left out, the raw motion is stored uncropped to derive them again with the
+	// same parameters
+	metadata.interpolationInterval = m_parameters.interpolationInterval;
+	metadata.adjustmentStrength = m_parameters.adjustmentStrength;
+	for (uint l = 0; l < NUM_LIMBS; l++) {
+		metadata.desiredLengths[l] = m_parameters.desiredLengths[l];
 	}
-	else {
-		cout << "Saving to sequences.txt binary file" << endl;
-	}
-
-	QDataStream out(&qf);
-	//out.setVersion(QDataStream::Qt_5_9);
-	out << m_athleteRawMotion;
-	out << m_athleteInterpolatedMotion;
-	out << m_athleteFilteredMotion;
-	out << m_athleteAdjustedMotion;
-	out << m_athleteRescaledMotion;
-	out << m_trainerRawMotion;
-	out << m_trainerInterpolatedMotion;
-	out << m_trainerFilteredMotion;
-	out << m_trainerAdjustedMotion;
-	out << m_trainerRescaledMotion;
-	qf.close();
+	const QVector<KFrame>* motions[NUM_SESSION_PERSONS][NUM_SESSION_STAGES];
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			const bool derived = s != SESSION_RAW && isStageDerived((SessionPerson)p, (SessionStage)s);
+			motions[p][s] = derived ? nullptr : memberMotion((SessionPerson)p, (SessionStage)s);
+		}
+		if (m_stagesDerived[p]) {
+			metadata.flags |= derivedStagesFlags[p];
+			metadata.interpolationStarts[p] = m_interpolationStarts[p];
+		}
+	}
+	const array<uint, NUM_PHASES>* phases[NUM_SESSION_PERSONS] = { &m_athletePhases, &m_trainerPhases };
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		const QVector<KFrame>& raw = *motions[p][SESSION_RAW];
+		if (raw.size() > 1 && raw.back().timestamp > raw.front().timestamp) {
+			metadata.rawFrameRates[p] = (raw.size() - 1) / (raw.back().timestamp - raw.front().timestamp);
+		}
+		for (uint i = 0; i < NUM_PHASES; i++) {
+			metadata.phases[p][i] = (*phases[p])[i];
+		}
+		const QVector<KFrame> adjusted = motion((SessionPerson)p, SESSION_ADJUSTED);
+		if (!adjusted.empty()) {
+			array<KLimb, NUM_LIMBS> limbs = m_limbs;
+			float gapAverage;
+			calculateLimbLengths(MotionBuffer(adjusted), limbs, gapAverage);
+			for (uint l = 0; l < NUM_LIMBS; l++) {
+				metadata.limbLengths[p][l] = limbs[l].desiredLength;
+			}
+		}
+	}
+
+	if (!SessionFile::write(fileName, metadata, motions, compress)) {
+		cout << "Cannot write to " << fileName.toStdString() << " session file." << endl;
+		return false;
+	}
+	return true;
 }
-void KSkeleton::loadMotion()
+bool KSkeleton::loadMotion(const QString& fileName)
 {
-	QFile qf("sequences.txt");
+	closeSession();
+	if (!SessionFile::isSessionFile(fileName)) {
+		return loadLegacyMotion(fileName);
+	}
+	SessionFile session;
+	if (!session.open(fileName)) {
+		cout << "Cannot read from " << fileName.toStdString() << " session file." << endl;
+		return false;
+	}
+	cout << "Loading from " << fileName.toStdString() << " session file." << endl;
+
+	resetDerivedStages();
+	const SessionHeader& header = session.header();
+	setSessionParameters(header);
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			*memberMotion((SessionPerson)p, (SessionStage)s) = session.readFrames((SessionPerson)p, (SessionStage)s);
+		}
+		if (header.flags & derivedStagesFlags[p]) {
+			m_stagesDerived[p] = true;
+			m_interpolationStarts[p] = header.interpolationStarts[p];
+			m_rawHashes[p] = hashMotion(MotionView(*memberMotion((SessionPerson)p, SESSION_RAW)));
+		}
+	}
+	updatePinnedStages();
+	setSessionPhases(header);
+	updateBigMotionSize();
+
+	calculateOffsets();
+
+	printMotionsToLog();
+	return true;
+}
+// Sessions saved before the session file format: the ten motions streamed with QDataStream
+bool KSkeleton::loadLegacyMotion(const QString& fileName)
+{
+	QFile qf(fileName);
 	if (!qf.open(QIODevice::ReadOnly)) {
-		cout << "Cannot read from sequences.txt binary file." << endl;
-		return;
+		cout << "Cannot read from " << fileName.toStdString() << " binary file." << endl;
+		return false;
 	}
 	else {
-		cout << "Loading from sequences.txt binary file." << endl;
+		cout << "Loading from " << fileName.toStdString() << " legacy binary file." << endl;
 	}
+	resetDerivedStages();
 
 	m_athleteRawMotion.clear();
 	m_athleteInterpolatedMotion.clear();
@@ -999,7 +1361,6 @@ void KSkeleton::loadMotion()
 	m_trainerRescaledMotion.clear();
 
 	QDataStream in(&qf);
-	//in.setVersion(QDataStream::Qt_5_9);
 	in >> m_athleteRawMotion;
 	in >> m_athleteInterpolatedMotion;
 	in >> m_athleteFilteredMotion;
@@ -1011,10 +1372,11 @@ void KSkeleton::loadMotion()
 	in >> m_trainerAdjustedMotion;
 	in >> m_trainerRescaledMotion;
 	qf.close();
-
-	if (m_athleteRawMotion.size() > m_trainerRawMotion.size()) m_bigMotionSize = m_athleteRawMotion.size();
-	else m_bigMotionSize = m_trainerRawMotion.size();
-	cout << "Big motion size: " << m_bigMotionSize << endl;
+	if (in.status() != QDataStream::Ok) {
+		cout << "Corrupt or truncated " << fileName.toStdString() << " binary file." << endl;
+		return false;
+	}
+	updateBigMotionSize();
 
 	m_athletePhases = identifyPhases(m_athleteAdjustedMotion);
 	m_trainerPhases = identifyPhases(m_trainerAdjustedMotion);
@@ -1022,9 +1384,334 @@ void KSkeleton::loadMotion()
 	calculateOffsets();
 
 	printMotionsToLog();
+	return true;
+}
+bool KSkeleton::openSession(const QString& fileName)
+{
+	closeSession();
+	if (!SessionFile::isSessionFile(fileName)) {
+		return loadLegacyMotion(fileName);
+	}
+	m_session = new SessionFile;
+	if (!m_session->open(fileName)) {
+		cout << "Cannot read from " << fileName.toStdString() << " session file." << endl;
+		closeSession();
+		return false;
+	}
+	if (m_session->isCompressed()) {
+		return loadMotion(fileName); // compressed sections cannot be viewed in place
+	}
+	cout << "Mapped " << fileName.toStdString() << " session file." << endl;
+	resetDerivedStages();
+
+	const SessionHeader& header = m_session->header();
+	setSessionParameters(header);
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			memberMotion((SessionPerson)p, (SessionStage)s)->clear();
+		}
+		// the derived stages are computed from the mapped raw motion
+		if (header.flags & derivedStagesFlags[p]) {
+			m_stagesDerived[p] = true;
+			m_interpolationStarts[p] = header.interpolationStarts[p];
+			m_rawHashes[p] = hashMotion(m_session->view((SessionPerson)p, SESSION_RAW));
+		}
+	}
+	updatePinnedStages();
+	setSessionPhases(header);
+	updateBigMotionSize();
+
+	calculateOffsets();
+	return true;
+}
+void KSkeleton::loadMappedMotions()
+{
+	if (!m_session) {
+		return;
+	}
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			QVector<KFrame>* motion = memberMotion((SessionPerson)p, (SessionStage)s);
+			if (motion->empty()) {
+				*motion = m_session->readFrames((SessionPerson)p, (SessionStage)s);
+			}
+		}
+	}
+	closeSession();
+}
+bool KSkeleton::isSessionMapped() const
+{
+	return m_session != nullptr;
+}
+void KSkeleton::closeSession()
+{
+	delete m_session;
+	m_session = nullptr;
+}
+MotionView KSkeleton::motionView(SessionPerson person, SessionStage stage) const
+{
+	KSkeleton* self = const_cast<KSkeleton*>(this); // the derived stages are computed on demand
+	if (isStageDerived(person, stage)) {
+		return self->derivedView(person, stage);
+	}
+	const QVector<KFrame>* motion = self->memberMotion(person, stage);
+	if (motion->empty() && m_session) {
+		return m_session->view(person, stage);
+	}
+	return MotionView(*motion);
+}
+QVector<KFrame> KSkeleton::motion(SessionPerson person, SessionStage stage)
+{
+	loadMappedMotions();
+	if (!isStageDerived(person, stage)) {
+		return *memberMotion(person, stage);
+	}
+	if (stage == SESSION_RAW || stage == SESSION_INTERPOLATED) {
+		return derivedView(person, stage).toFrames();
+	}
+	return *derivedMotion(person, stage);
+}
+QVector<KFrame>& KSkeleton::editableMotion(SessionPerson person, SessionStage stage)
+{
+	loadMappedMotions();
+	if (m_stagesDerived[person]) {
+		// the raw motion last, the others are derived from it uncropped
+		for (int s = SESSION_ADJUSTED; s >= SESSION_RAW; s--) {
+			*memberMotion(person, (SessionStage)s) = motion(person, (SessionStage)s);
+		}
+		m_stagesDerived[person] = false;
+		m_rawHashes[person] = 0;
+		updatePinnedStages();
+	}
+	if (isStageDerived(person, stage)) {
+		*memberMotion(person, stage) = motion(person, stage); // the rescale
+	}
+	m_storedAdjustedHashes[person] = 0; // the caller changes it
+	m_motionsRevision++;
+	return *memberMotion(person, stage);
+}
+quint64 KSkeleton::motionId(SessionPerson person, SessionStage stage) const
+{
+	return (m_motionsRevision * NUM_SESSION_PERSONS + person) * NUM_SESSION_STAGES + stage + 1;
+}
+StageCache* KSkeleton::stageCache()
+{
+	return m_stageCache;
+}
+QVector<KFrame>* KSkeleton::memberMotion(SessionPerson person, SessionStage stage)
+{
+	QVector<KFrame>* motions[NUM_SESSION_PERSONS][NUM_SESSION_STAGES] = {
+		{ &m_athleteRawMotion, &m_athleteInterpolatedMotion, &m_athleteFilteredMotion, &m_athleteAdjustedMotion, &m_athleteRescaledMotion },
+		{ &m_trainerRawMotion, &m_trainerInterpolatedMotion, &m_trainerFilteredMotion, &m_trainerAdjustedMotion, &m_trainerRescaledMotion }
+	};
+	return motions[person][stage];
+}
+// Raw motions and the stages stored in a session are kept as they are, a stored rescaled motion takes
+// the place of the derived one
+bool KSkeleton::isStageDerived(SessionPerson person, SessionStage stage) const
+{
+	if (stage != SESSION_RESCALED) {
+		return m_stagesDerived[person];
+	}
+	if (!const_cast<KSkeleton*>(this)->memberMotion(person, stage)->empty() ||
+		(m_session && m_session->frameCount(person, stage) > 0)) {
+		return false;
+	}
+	return hasAdjustedMotion(SESSION_ATHLETE) && hasAdjustedMotion(SESSION_TRAINER);
+}
+bool KSkeleton::hasAdjustedMotion(SessionPerson person) const
+{
+	if (m_stagesDerived[person]) {
+		return !rawView(person).empty();
+	}
+	return !const_cast<KSkeleton*>(this)->memberMotion(person, SESSION_ADJUSTED)->empty() ||
+		(m_session && m_session->frameCount(person, SESSION_ADJUSTED) > 0);
+}
+// The chain's stages are keyed by the raw motion, a rescale by both adjusted motions
+StageKey KSkeleton::stageKey(SessionPerson person, uint stage)
+{
+	StageKey key;
+	key.stage = stage;
+	key.parameters = parametersHash(stage);
+	if (stage == SESSION_RESCALED) {
+		const SessionPerson prototype = person == SESSION_ATHLETE ? SESSION_TRAINER : SESSION_ATHLETE;
+		const array<uint, NUM_PHASES>* phases[NUM_SESSION_PERSONS] = { &m_athletePhases, &m_trainerPhases };
+		key.inputs[0] = adjustedHash(person);
+		key.inputs[1] = adjustedHash(prototype);
+		key.interpolationStart = 0;
+		// the rescale aligns the phases, which may be identified again
+		key.parameters = hashData(phases[person]->data(), sizeof(uint) * NUM_PHASES, key.parameters);
+		key.parameters = hashData(phases[prototype]->data(), sizeof(uint) * NUM_PHASES, key.parameters);
+	}
+	else {
+		key.inputs[0] = m_rawHashes[person];
+		key.inputs[1] = 0;
+		key.interpolationStart = m_interpolationStarts[person];
+	}
+	return key;
+}
+// The crop reads none, the interpolation and the filter the interval, the adjustment and the rescale
+// (which interpolates and adjusts again) the interval and the adjustment's
+quint64 KSkeleton::parametersHash(uint stage) const
+{
+	if (stage == SESSION_RAW) {
+		return 0;
+	}
+	quint64 hash = hashData(&m_parameters.interpolationInterval, sizeof(m_parameters.interpolationInterval));
+	if (stage == SESSION_ADJUSTED || stage == SESSION_RESCALED) {
+		hash = hashData(&m_parameters.adjustmentStrength, sizeof(m_parameters.adjustmentStrength), hash);
+		hash = hashData(m_parameters.desiredLengths.data(), sizeof(float) * NUM_LIMBS, hash);
+	}
+	return hash;
+}
+quint64 KSkeleton::adjustedHash(SessionPerson person)
+{
+	if (m_stagesDerived[person]) {
+		return stageKey(person, SESSION_ADJUSTED).hash();
+	}
+	if (m_storedAdjustedHashes[person] == 0) {
+		m_storedAdjustedHashes[person] = hashMotion(motionView(person, SESSION_ADJUSTED));
+	}
+	return m_storedAdjustedHashes[person];
+}
+QVector<KFrame>* KSkeleton::derivedMotion(SessionPerson person, uint stage)
+{
+	const StageKey key = stageKey(person, stage);
+	QVector<KFrame>* cached = m_stageCache->find(key);
+	if (cached) {
+		return cached;
+	}
+
+	// the inputs are copied, asking for them may evict each other
+	const MotionView raw = rawView(person);
+	QVector<KFrame> motion;
+	switch (stage) {
+	case UNCROPPED_INTERPOLATED: {
+		QElapsedTimer timer;
+		timer.start();
+		motion = interpolateMotion(MotionBuffer(raw), m_interpolationStarts[person], raw.size()).toFrames();
+		m_processingTimes.interpolate += timer.nsecsElapsed() / 1e6;
+		break;
+	}
+	case SESSION_FILTERED: {
+		const QVector<KFrame> interpolated = *derivedMotion(person, UNCROPPED_INTERPOLATED);
+		QElapsedTimer timer;
+		timer.start();
+		motion = filterMotion(MotionBuffer(interpolated)).toFrames();
+		m_processingTimes.filter += timer.nsecsElapsed() / 1e6;
+		break;
+	}
+	case SESSION_ADJUSTED: {
+		const QVector<KFrame> filtered = *derivedMotion(person, SESSION_FILTERED);
+		array<KLimb, NUM_LIMBS> limbs = m_limbs;
+		float gapAverage = m_gapAverage;
+		QElapsedTimer timer;
+		timer.start();
+		motion = adjustMotion(MotionBuffer(filtered), limbs, gapAverage).toFrames();
+		m_processingTimes.adjust += timer.nsecsElapsed() / 1e6;
+		break;
+	}
+	case SESSION_RESCALED: {
+		const SessionPerson prototype = person == SESSION_ATHLETE ? SESSION_TRAINER : SESSION_ATHLETE;
+		const array<uint, NUM_PHASES>* phases[NUM_SESSION_PERSONS] = { &m_athletePhases, &m_trainerPhases };
+		const QVector<KFrame> original = motionView(person, SESSION_ADJUSTED).toFrames();
+		const QVector<KFrame> prototypeMotion = motionView(prototype, SESSION_ADJUSTED).toFrames();
+		array<KLimb, NUM_LIMBS> limbs = m_limbs;
+		float gapAverage = m_gapAverage;
+		QElapsedTimer timer;
+		timer.start();
+		motion = rescaleMotion(original, prototypeMotion, *phases[person], *phases[prototype], limbs, gapAverage);
+		m_processingTimes.rescale += timer.nsecsElapsed() / 1e6;
+		break;
+	}
+	}
+	return &m_stageCache->insert(key, motion);
+}
+// The cropped stages view the raw motion and the cached uncropped interpolation, they take no cache entry
+MotionView KSkeleton::derivedView(SessionPerson person, SessionStage stage)
+{
+	if (stage != SESSION_RAW && stage != SESSION_INTERPOLATED) {
+		return MotionView(*derivedMotion(person, stage));
+	}
+	const MotionView uncropped = stage == SESSION_RAW ?
+		rawView(person) :
+		MotionView(*derivedMotion(person, UNCROPPED_INTERPOLATED));
+	const int size = croppedSize(uncropped.size());
+	return uncropped.mid((uncropped.size() - size) / 2, size);
+}
+// the raw motion of a processed person is the member one, or the mapped one while the session is mapped
+MotionView KSkeleton::rawView(SessionPerson person) const
+{
+	const QVector<KFrame>* raw = const_cast<KSkeleton*>(this)->memberMotion(person, SESSION_RAW);
+	if (raw->empty() && m_session) {
+		return m_session->view(person, SESSION_RAW);
+	}
+	return MotionView(*raw);
+}
+// the filter drops the frames it has no full window for, the raw and interpolated stages are cropped to match
+int KSkeleton::croppedSize(int size) const
+{
+	return size > 2 * m_framesDelayed ? size - 2 * m_framesDelayed : size;
+}
+void KSkeleton::resetDerivedStages()
+{
+	m_motionsRevision++;
+	m_stagesDerived.fill(false);
+	m_interpolationStarts.fill(0);
+	m_rawHashes.fill(0);
+	m_storedAdjustedHashes.fill(0);
+	updatePinnedStages();
+}
+// The filtered motions stay in memory, the adjustment's parameters change without interpolating
+// and filtering again
+void KSkeleton::updatePinnedStages()
+{
+	QVector<StageKey> keys;
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		if (m_stagesDerived[p]) {
+			keys.push_back(stageKey((SessionPerson)p, SESSION_FILTERED));
+		}
+	}
+	m_stageCache->setPinned(keys);
+}
+void KSkeleton::updateBigMotionSize()
+{
+	m_bigMotionSize = 0;
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		int size = m_stagesDerived[p] ?
+			croppedSize(rawView((SessionPerson)p).size()) :
+			motionView((SessionPerson)p, SESSION_RAW).size();
+		if (size > m_bigMotionSize) m_bigMotionSize = size;
+	}
+	cout << "Big motion size: " << m_bigMotionSize << endl;
+}
+// the derived stages are derived again with the parameters they were saved with
+void KSkeleton::setSessionParameters(const SessionHeader& header)
+{
+	if (!(header.flags & (SESSION_DERIVED_ATHLETE | SESSION_DERIVED_TRAINER))) {
+		return;
+	}
+	KProcessingParameters parameters;
+	parameters.interpolationInterval = header.interpolationInterval;
+	parameters.adjustmentStrength = header.adjustmentStrength;
+	for (uint l = 0; l < NUM_LIMBS; l++) {
+		parameters.desiredLengths[l] = header.desiredLengths[l];
+	}
+	setParameters(parameters);
+}
+// the phases were identified when the session was saved
+void KSkeleton::setSessionPhases(const SessionHeader& header)
+{
+	for (uint i = 0; i < NUM_PHASES; i++) {
+		m_athletePhases[i] = header.phases[SESSION_ATHLETE][i];
+		m_trainerPhases[i] = header.phases[SESSION_TRAINER][i];
+	}
 }
 void KSkeleton::printMotionsToLog()
 {
+	if (!m_sequenceLog.isOpen()) {
+		return;
+	}
 	m_sequenceLog.resize(0);
 
 	// headers
@@ -1033,114 +1720,48 @@ void KSkeleton::printMotionsToLog()
 	m_sequenceLogData << qSetFieldWidth(20) << "Trainer";
 	m_sequenceLogData << endl;
 
-	// motion type
-	m_sequenceLogData << qSetFieldWidth(10) << "Raw" << endl;
-	// motion size
-	m_sequenceLogData << qSetFieldWidth(10) << "Size:";
-	m_sequenceLogData << qSetFieldWidth(20) << m_athleteRawMotion.size();
-	m_sequenceLogData << qSetFieldWidth(20) << m_trainerRawMotion.size();
-	m_sequenceLogData << endl;
-	// motion duration
-	m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
-	m_sequenceLogData << qSetFieldWidth(20) << (m_athleteRawMotion.size() > 0 ? m_athleteRawMotion.back().timestamp : 0);
-	m_sequenceLogData << qSetFieldWidth(20) << (m_trainerRawMotion.size() > 0 ? m_trainerRawMotion.back().timestamp : 0);
-	m_sequenceLogData << endl;
-	// motion serials, timestamps
-	for (uint i = 0; i < m_bigMotionSize; i++) {
-		m_sequenceLogData << qSetFieldWidth(10) << i;
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_athleteRawMotion.size() ? m_athleteRawMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_athleteRawMotion.size() ? m_athleteRawMotion[i].timestamp : 0);
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_trainerRawMotion.size() ? m_trainerRawMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_trainerRawMotion.size() ? m_trainerRawMotion[i].timestamp : 0);
-		m_sequenceLogData << endl;
-	}
-	
-	// motion type
-	m_sequenceLogData << qSetFieldWidth(10) << "Interpolated" << endl;
-	// motion size
-	m_sequenceLogData << qSetFieldWidth(10) << "Size:";
-	m_sequenceLogData << qSetFieldWidth(20) << m_athleteInterpolatedMotion.size();
-	m_sequenceLogData << qSetFieldWidth(20) << m_trainerInterpolatedMotion.size();
-	m_sequenceLogData << endl;
-	// motion duration
-	m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
-	m_sequenceLogData << qSetFieldWidth(20) << (m_athleteInterpolatedMotion.size() > 0 ? m_athleteInterpolatedMotion.back().timestamp : 0);
-	m_sequenceLogData << qSetFieldWidth(20) << (m_trainerInterpolatedMotion.size() > 0 ? m_trainerInterpolatedMotion.back().timestamp : 0);
-	m_sequenceLogData << endl;
-	// motion serials, timestamps
-	for (uint i = 0; i < m_bigMotionSize; i++) {
-		m_sequenceLogData << qSetFieldWidth(10) << i;
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_athleteInterpolatedMotion.size() ? m_athleteInterpolatedMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_athleteInterpolatedMotion.size() ? m_athleteInterpolatedMotion[i].timestamp : 0);
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_trainerInterpolatedMotion.size() ? m_trainerInterpolatedMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_trainerInterpolatedMotion.size() ? m_trainerInterpolatedMotion[i].timestamp : 0);
-		m_sequenceLogData << endl;
-	}
-
-	// motion type
-	m_sequenceLogData << qSetFieldWidth(10) << "Filtered" << endl;
-	// motion size
-	m_sequenceLogData << qSetFieldWidth(10) << "Size:";
-	m_sequenceLogData << qSetFieldWidth(20) << m_athleteFilteredMotion.size();
-	m_sequenceLogData << qSetFieldWidth(20) << m_trainerFilteredMotion.size();
-	m_sequenceLogData << endl;
-	// motion duration
-	m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
-	m_sequenceLogData << qSetFieldWidth(20) << (m_athleteFilteredMotion.size() > 0 ? m_athleteFilteredMotion.back().timestamp : 0);
-	m_sequenceLogData << qSetFieldWidth(20) << (m_trainerFilteredMotion.size() > 0 ? m_trainerFilteredMotion.back().timestamp : 0);
-	m_sequenceLogData << endl;
-	// motion serials, timestamps
-	for (uint i = 0; i < m_bigMotionSize; i++) {
-		m_sequenceLogData << qSetFieldWidth(10) << i;
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_athleteFilteredMotion.size() ? m_athleteFilteredMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_athleteFilteredMotion.size() ? m_athleteFilteredMotion[i].timestamp : 0);
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_trainerFilteredMotion.size() ? m_trainerFilteredMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_trainerFilteredMotion.size() ? m_trainerFilteredMotion[i].timestamp : 0);
-		m_sequenceLogData << endl;
-	}
-
-	// motion type
-	m_sequenceLogData << qSetFieldWidth(10) << "Adjusted" << endl;
-	// motion size
-	m_sequenceLogData << qSetFieldWidth(10) << "Size:";
-	m_sequenceLogData << qSetFieldWidth(20) << m_athleteAdjustedMotion.size();
-	m_sequenceLogData << qSetFieldWidth(20) << m_trainerAdjustedMotion.size();
-	m_sequenceLogData << endl;
-	// motion duration
-	m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
-	m_sequenceLogData << qSetFieldWidth(20) << (m_athleteAdjustedMotion.size() > 0 ? m_athleteAdjustedMotion.back().timestamp : 0);
-	m_sequenceLogData << qSetFieldWidth(20) << (m_trainerAdjustedMotion.size() > 0 ? m_trainerAdjustedMotion.back().timestamp : 0);
-	m_sequenceLogData << endl;
-	// motion serials, timestamps
-	for (uint i = 0; i < m_bigMotionSize; i++) {
-		m_sequenceLogData << qSetFieldWidth(10) << i;
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_athleteAdjustedMotion.size() ? m_athleteAdjustedMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_athleteAdjustedMotion.size() ? m_athleteAdjustedMotion[i].timestamp : 0);
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_trainerAdjustedMotion.size() ? m_trainerAdjustedMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_trainerAdjustedMotion.size() ? m_trainerAdjustedMotion[i].timestamp : 0);
+	// derived stages are logged if they are cached, the raw motions as they are stored
+	const char* stageNames[NUM_SESSION_STAGES] = { "Raw", "Interpolated", "Filtered", "Adjusted", "Rescaled" };
+	for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+		MotionView motions[NUM_SESSION_PERSONS];
+		for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+			if (s == SESSION_RAW && m_stagesDerived[p]) {
+				motions[p] = rawView((SessionPerson)p);
+			}
+			else if (isStageDerived((SessionPerson)p, (SessionStage)s)) {
+				const bool cropped = s == SESSION_INTERPOLATED;
+				QVector<KFrame>* cached = m_stageCache->find(stageKey((SessionPerson)p, cropped ? UNCROPPED_INTERPOLATED : s));
+				motions[p] = !cached ? MotionView() : (cropped ? derivedView((SessionPerson)p, SESSION_INTERPOLATED) : MotionView(*cached));
+			}
+			else {
+				motions[p] = motionView((SessionPerson)p, (SessionStage)s);
+			}
+		}
+		const MotionView& athlete = motions[SESSION_ATHLETE];
+		const MotionView& trainer = motions[SESSION_TRAINER];
+
+		// motion type
+		m_sequenceLogData << qSetFieldWidth(10) << stageNames[s] << endl;
+		// motion size
+		m_sequenceLogData << qSetFieldWidth(10) << "Size:";
+		m_sequenceLogData << qSetFieldWidth(20) << athlete.size();
+		m_sequenceLogData << qSetFieldWidth(20) << trainer.size();
 		m_sequenceLogData << endl;
-	}
-
-	// motion type
-	m_sequenceLogData << qSetFieldWidth(10) << "Rescaled" << endl;
-	// motion size
-	m_sequenceLogData << qSetFieldWidth(10) << "Size:";
-	m_sequenceLogData << qSetFieldWidth(20) << m_athleteRescaledMotion.size();
-	m_sequenceLogData << qSetFieldWidth(20) << m_trainerRescaledMotion.size();
-	m_sequenceLogData << endl;
-	// motion duration
-	m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
-	m_sequenceLogData << qSetFieldWidth(20) << (m_athleteRescaledMotion.size() > 0 ? m_athleteRescaledMotion.back().timestamp : 0);
-	m_sequenceLogData << qSetFieldWidth(20) << (m_trainerRescaledMotion.size() > 0 ? m_trainerRescaledMotion.back().timestamp : 0);
-	m_sequenceLogData << endl;
-	// motion serials, timestamps
-	for (uint i = 0; i < m_bigMotionSize; i++) {
-		m_sequenceLogData << qSetFieldWidth(10) << i;
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_athleteRescaledMotion.size() ? m_athleteRescaledMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_athleteRescaledMotion.size() ? m_athleteRescaledMotion[i].timestamp : 0);
-		m_sequenceLogData << qSetFieldWidth(5) << (i < m_trainerRescaledMotion.size() ? m_trainerRescaledMotion[i].serial : 0);
-		m_sequenceLogData << qSetFieldWidth(15) << (i < m_trainerRescaledMotion.size() ? m_trainerRescaledMotion[i].timestamp : 0);
+		// motion duration
+		m_sequenceLogData << qSetFieldWidth(10) << "Duration:";
+		m_sequenceLogData << qSetFieldWidth(20) << (athlete.size() > 0 ? athlete.timestamp(athlete.size() - 1) : 0);
+		m_sequenceLogData << qSetFieldWidth(20) << (trainer.size() > 0 ? trainer.timestamp(trainer.size() - 1) : 0);
 		m_sequenceLogData << endl;
+		// motion serials, timestamps
+		const int size = athlete.size() > trainer.size() ? athlete.size() : trainer.size();
+		for (int i = 0; i < size; i++) {
+			m_sequenceLogData << qSetFieldWidth(10) << i;
+			m_sequenceLogData << qSetFieldWidth(5) << (i < athlete.size() ? athlete.serial(i) : 0);
+			m_sequenceLogData << qSetFieldWidth(15) << (i < athlete.size() ? athlete.timestamp(i) : 0);
+			m_sequenceLogData << qSetFieldWidth(5) << (i < trainer.size() ? trainer.serial(i) : 0);
+			m_sequenceLogData << qSetFieldWidth(15) << (i < trainer.size() ? trainer.timestamp(i) : 0);
+			m_sequenceLogData << endl;
+		}
 	}
 }
 const array<KLimb, NUM_LIMBS>& KSkeleton::limbs() const
@@ -2,10 +2,8 @@
 #define KSKELETON_H
 
 // Project
-#include "util.h"
-
-// Kinect
-#include <Kinect.h>
+#include "core_util.h"
+#include "kjoints.h"
 
 // Qt
 #include <QtCore/QFile>
@@ -15,6 +13,14 @@
 #include <iomanip>
 #include <iostream>
 
+class KStreamingFilter;
+class MotionBuffer;
+class MotionView;
+class SessionFile;
+class StageCache;
+struct SessionHeader;
+struct StageKey;
+
 #define INVALID_JOINT_ID -1
 #define NUM_LIMBS 23
 #define NUM_PHASES 7
@@ -54,7 +60,6 @@ struct KLimb
 
 	float minLength = FLT_MAX, maxLength = FLT_MIN, averageLength = 0, desiredLength = 0;
 	int serialMin = -1, serialMax = -1;
-	static float gapAverage;
 	float siblingsLengthAverage = 0;
 
 	KLimb()
@@ -96,39 +101,19 @@ QDataStream& operator>>(QDataStream& in, const KJoint& joint);
 
 struct KFrame
 {
-	int serial;
-	double timestamp;
+	int serial = 0;
+	double timestamp = 0.;
 	array<KJoint, JointType_Count> joints;
 
-	// Interpolation between frames "previous" and "next" at time "interpolationTime"
-	void interpolateJoints(const KFrame& previous, const KFrame& next, double interpolationTime)
+	// Copies the joint data of a Kinect body
+	void setJoints(const Joint* kinectJoints, const JointOrientation* kinectOrientations)
 	{
-		double percentDistance = (interpolationTime - previous.timestamp) / (next.timestamp - previous.timestamp);
-		
-		if (interpolationTime == previous.timestamp) cout << setw(16) << "Coincidence-";
-		else if (interpolationTime == next.timestamp) cout << setw(16) << "Coincidence+";
-		else if (interpolationTime < previous.timestamp) cout << setw(16) << "Extrapolation-";
-		else if (interpolationTime > next.timestamp) cout << setw(16) << "Extrapolation+";
-		else cout << setw(16) << "Interpolation";
-		
-		cout << " " << setw(4) << previous.serial << " " << setw(4) << next.serial << " @" << setw(4) << serial;
-		cout << " " << setw(10) << previous.timestamp << " " << setw(10) << next.timestamp << " @" << setw(10) << interpolationTime;
-		cout << "->" << setw(10) << percentDistance * 100 << " %";
-		cout << " Interval=" << next.timestamp - previous.timestamp;
-		if (next.timestamp <= previous.timestamp) cout << " Error: next.timestamp <= previous.timestamp";
-		cout << endl;
-		
 		for (uint i = 0; i < JointType_Count; i++) {
-			joints[i].position.setX(previous.joints[i].position.x() + percentDistance * (next.joints[i].position.x() - previous.joints[i].position.x()));
-			joints[i].position.setY(previous.joints[i].position.y() + percentDistance * (next.joints[i].position.y() - previous.joints[i].position.y()));
-			joints[i].position.setZ(previous.joints[i].position.z() + percentDistance * (next.joints[i].position.z() - previous.joints[i].position.z()));
-			if (previous.joints[i].trackingState == TrackingState_Inferred || next.joints[i].trackingState == TrackingState_Inferred) {
-				joints[i].trackingState = TrackingState_Inferred;
-			}
-			else {
-				joints[i].trackingState = TrackingState_Tracked;
-			}
-			joints[i].orientation = QQuaternion::nlerp(previous.joints[i].orientation, next.joints[i].orientation, percentDistance);
+			const Joint& jt = kinectJoints[i];
+			const JointOrientation& jo = kinectOrientations[i];
+			joints[i].position = QVector3D(jt.Position.X, jt.Position.Y, jt.Position.Z);
+			joints[i].orientation = QQuaternion(jo.Orientation.w, jo.Orientation.x, jo.Orientation.y, jo.Orientation.z);
+			joints[i].trackingState = jt.TrackingState;
 		}
 	}
 
@@ -163,34 +148,121 @@ struct KFrame
 QDataStream& operator<<(QDataStream& out, const KFrame& frame);
 QDataStream& operator>>(QDataStream& in, const KFrame& frame);
 
+// The persons and processing stages of a session's motions
+enum SessionPerson
+{
+	SESSION_ATHLETE,
+	SESSION_TRAINER,
+	NUM_SESSION_PERSONS
+};
+enum SessionStage
+{
+	SESSION_RAW,
+	SESSION_INTERPOLATED,
+	SESSION_FILTERED,
+	SESSION_ADJUSTED,
+	SESSION_RESCALED,
+	NUM_SESSION_STAGES
+};
+
+// Settings of the processing stages that parameter sweeps tune. Every derived stage is keyed by the
+// parameters it reads, itself or through its inputs, so after a change only the stages from the first
+// one reading it are computed again: the interval from the interpolation on, the others from the
+// adjustment on. Each of them changes every frame of the stages reading it.
+struct KProcessingParameters
+{
+	double interpolationInterval = 0.0333333; // seconds, calculated from trainer's motion
+	float adjustmentStrength = 1.f; // 1 sets the limbs to their desired lengths, 0 keeps them as filtered
+	array<float, NUM_LIMBS> desiredLengths; // metres, 0 for the average of the limb and its sibling
+
+	KProcessingParameters()
+	{
+		desiredLengths.fill(0.f);
+	}
+	bool operator==(const KProcessingParameters& other) const
+	{
+		return interpolationInterval == other.interpolationInterval &&
+			adjustmentStrength == other.adjustmentStrength &&
+			desiredLengths == other.desiredLengths;
+	}
+};
+
+// Time spent in the stages since the last processMotions or setProcessingParameters call in milliseconds,
+// summed over both persons. The persons' stages run concurrently, so the sum can exceed the wall time of
+// the call. Stages derived later are counted when they are first asked for.
+struct KProcessingTimes
+{
+	double interpolate = 0.;
+	double filter = 0.;
+	double adjust = 0.;
+	double phases = 0.;
+	double rescale = 0.;
+};
+
 class KSkeleton
 {
 public:
-	KSkeleton();
+	// An empty sessionFile starts without motions, an empty logFile disables the motions log
+	explicit KSkeleton(const QString& sessionFile = "sequences.txt", const QString& logFile = "motions.log");
 	~KSkeleton();
 	KFrame addFrame(const Joint* joints, const JointOrientation* jointOrientations, double time);
+	KFrame addFrame(const KFrame& frame); // frame's joints and timestamp are used, serial is assigned here
 
+	// Interpolates, filters and adjusts the recorded persons' motions concurrently and identifies the
+	// phases, stages still cached from an earlier call with the same inputs are reused. From then on
+	// their stages are derived from the raw motions, see motionView.
 	void processMotions(int interpolationStart);
+	// Counter of the person's first interpolated frame when it was processed: derived stages keep it,
+	// stored ones tell it by their first serial. Recordings start it the filter's delay early.
+	int interpolationStart(SessionPerson person) const;
+	const KProcessingTimes& processingTimes() const;
+	// The processed persons' phases and offsets are updated, their changed stages are derived when
+	// they are asked for. False while recording, the capture is filtered with the interval.
+	bool setProcessingParameters(const KProcessingParameters& parameters);
+	const KProcessingParameters& processingParameters() const;
+	bool latestFilteredFrame(KFrame& frame) const; // filtered while recording, 12 frames behind
 
 	void printJointHierarchy() const;
 	void printLimbLengths() const;
 	void printMotionsToLog();
 
 	// files
-	bool exportToTRC();
+	bool exportToTRC(const QString& fileName = "joint_positions.trc");
 	void processSpecific();
 
-	void saveFrameSequences();
-	void loadMotion();
+	// session file with the raw motions, the stages that are not derived and the processing parameters
+	// of those that are, see session_file.h. Compress for the archive.
+	bool saveFrameSequences(const QString& fileName = "sequences.txt", bool compress = false);
+	bool loadMotion(const QString& fileName = "sequences.txt"); // also reads the older QDataStream files
+	// Maps a session file for playback instead of loading it: until loadMappedMotions, the motion
+	// members stay empty and motionView reads the mapped frames, the derived stages are computed from
+	// the mapped raw motions. Compressed files are loaded.
+	bool openSession(const QString& fileName = "sequences.txt");
+	void loadMappedMotions(); // copies the mapped motions into the members and unmaps the file
+	bool isSessionMapped() const;
+	// Stages of processed persons, and rescaled motions that were not stored, are derived from the
+	// raw motions when they are first asked for and kept in the stage cache; the raw and interpolated
+	// stages are views of the uncropped ones, cropped to the filtered frames. Other stages are the
+	// member motion, or the mapped one if that is empty. Views are invalidated by the calls that change
+	// the motions (loading, recording, processing, editing, loadMappedMotions) and by asking for
+	// stages that are not cached.
+	MotionView motionView(SessionPerson person, SessionStage stage) const;
+	QVector<KFrame> motion(SessionPerson person, SessionStage stage); // a copy, loads the mapped motions first
+	// To change a motion in place. A processed person's stages are stored as they are first, so that
+	// the person's stages are no longer derived and the changes last.
+	QVector<KFrame>& editableMotion(SessionPerson person, SessionStage stage);
+	// Differs for every stage and changes whenever the motion may have changed, to tell if a frame or
+	// an upload of it is still valid. Never 0.
+	quint64 motionId(SessionPerson person, SessionStage stage) const;
+	StageCache* stageCache(); // to set its capacity and disk directory
 
 	bool m_isRecording = false;
 	bool m_isFinalizing = false;
 
-	const double m_interpolationInterval = 0.0333333; // calculated from trainer's motion
-
 	const array<KLimb, NUM_LIMBS>& limbs() const;
 	const array<KNode, JointType_Count>& nodes() const;
 	void calculateLimbLengths(const QVector<KFrame>& sequence);
+	void calculateLimbLengths(const MotionBuffer& motion);
 
 	void calculateJointOrientations(QVector<KFrame>& motion);
 
@@ -235,16 +307,29 @@ public:
 		STAND_UP = 5,
 		END = 6
 	};
-	array<uint, NUM_PHASES> identifyPhases(const QVector<KFrame>& motion);
+	array<uint, NUM_PHASES> identifyPhases(const QVector<KFrame>& motion) const;
 
+	// Processing stages run on MotionBuffer, the QVector<KFrame> overloads convert
 	QVector<KFrame> interpolateMotion(
 		const QVector<KFrame>& motion,
 		int counterStart,
-		int desiredSize);
-	QVector<KFrame> filterMotion(const QVector<KFrame>& motion);
-	void cropMotions();
+		int desiredSize) const;
+	MotionBuffer interpolateMotion(
+		const MotionBuffer& motion,
+		int counterStart,
+		int desiredSize) const;
+	QVector<KFrame> filterMotion(const QVector<KFrame>& motion) const;
+	MotionBuffer filterMotion(const MotionBuffer& motion) const;
 	QVector<KFrame> adjustMotion(const QVector<KFrame>& motion);
-	void adjustLimbLength(KFrame& kframe, uint jointId, const QVector3D& direction, float factor); // recursively adjust joints
+	MotionBuffer adjustMotion(const MotionBuffer& motion);
+	// recursively adjust joints, the feet's displacements are added to the offsets
+	void adjustLimbLength(
+		KFrame& kframe,
+		uint jointId,
+		const QVector3D& direction,
+		float factor,
+		QVector3D& leftFootOffset,
+		QVector3D& rightFootOffset) const;
 	QVector<KFrame> rescaleMotion(
 		const QVector<KFrame>& original,
 		const QVector<KFrame>& prototype,
@@ -265,14 +350,63 @@ private:
 	const array<float, 2*m_framesDelayed+2> m_sgCoefficients = { -253, -138, -33, 62, 147, 222, 287, 343, 387, 422, 447, 462, 467, 462, 447, 422, 387, 343, 278, 222, 147, 62, -33, -138, -253, 1 / 5175.f };
 	array<KFrame, m_framesDelayed> m_firstRawFrames;
 	uint m_firstFrameIndex = 0;
+	uint m_addedFrames = 0; // since the last recording finished, numbers the frames
+	uint m_finalizedFrames = 0; // frames added after the recording stopped
+
+	// recorded frames are interpolated and filtered as they arrive
+	KStreamingFilter* m_streamingFilter;
+	double m_streamTimeOffset = 0.;
+	void streamFrame(const KFrame& kframe);
 
 	array<KLimb, NUM_LIMBS> m_limbs;
+	float m_gapAverage = 0.f; // of the limb lengths' max - min
+	KProcessingParameters m_parameters;
+	float desiredLength(const array<KLimb, NUM_LIMBS>& limbs, uint limb) const;
+	KProcessingTimes m_processingTimes;
 	void initJoints();
 	void initLimbs();
-
-
-	QVector3D m_leftFootOffset;
-	QVector3D m_rightFootOffset;
+	bool loadLegacyMotion(const QString& fileName);
+	void closeSession();
+	QVector<KFrame>* memberMotion(SessionPerson person, SessionStage stage);
+	void setSessionPhases(const SessionHeader& header);
+	void setSessionParameters(const SessionHeader& header);
+	void setParameters(const KProcessingParameters& parameters); // and the streaming filter's interval
+	SessionFile* m_session = nullptr; // mapped by openSession
+
+	// derived stages, by person
+	enum { UNCROPPED_INTERPOLATED = NUM_SESSION_STAGES }; // intermediate stage the filter reads
+	StageCache* m_stageCache;
+	array<bool, NUM_SESSION_PERSONS> m_stagesDerived; // processed, or loaded with derived stages
+	array<int, NUM_SESSION_PERSONS> m_interpolationStarts;
+	array<quint64, NUM_SESSION_PERSONS> m_rawHashes;
+	array<quint64, NUM_SESSION_PERSONS> m_storedAdjustedHashes; // 0 until needed for a rescale key
+	quint64 m_motionsRevision = 0; // of motionId
+	bool isStageDerived(SessionPerson person, SessionStage stage) const;
+	bool hasAdjustedMotion(SessionPerson person) const;
+	StageKey stageKey(SessionPerson person, uint stage);
+	quint64 adjustedHash(SessionPerson person);
+	quint64 parametersHash(uint stage) const; // of the parameters the stage reads
+	QVector<KFrame>* derivedMotion(SessionPerson person, uint stage); // computed unless cached, not the cropped stages
+	MotionView derivedView(SessionPerson person, SessionStage stage);
+	MotionView rawView(SessionPerson person) const; // uncropped
+	int croppedSize(int size) const; // of the raw and interpolated stages
+	void resetDerivedStages();
+	void updatePinnedStages();
+	void updateBigMotionSize();
+
+	// The stages below only change the limbs they are given, so the processing tasks can run
+	// concurrently on their own copies, the public overloads use m_limbs and m_gapAverage
+	void calculateLimbLengths(const MotionBuffer& motion, array<KLimb, NUM_LIMBS>& limbs, float& gapAverage) const;
+	void printLimbLengths(const array<KLimb, NUM_LIMBS>& limbs, float gapAverage) const;
+	MotionBuffer adjustMotion(const MotionBuffer& motion, array<KLimb, NUM_LIMBS>& limbs, float& gapAverage) const;
+	QVector<KFrame> rescaleMotion(
+		const QVector<KFrame>& original,
+		const QVector<KFrame>& prototype,
+		const array<uint, NUM_PHASES>& originalPhases,
+		const array<uint, NUM_PHASES>& prototypePhases,
+		array<KLimb, NUM_LIMBS>& limbs,
+		float& gapAverage
+	) const;
 
 	void calculateOffsets();
 };
@@ -0,0 +1,195 @@
+// Own
+#include "kstreaming_filter.h"
+
+// Standard C/C++
+#include <cstring>
+
+static const int numRotationChannels = 9 * JointType_Count;
+
+KStreamingFilter::KStreamingFilter(double interpolationInterval, const float* coefficients, int taps, float scale)
+	:
+	m_filter(coefficients, taps, scale),
+	m_interpolationInterval(interpolationInterval),
+	m_windowCapacity(4 * taps)
+{
+	m_rotationWindow.resize(numRotationChannels * m_windowCapacity);
+}
+void KStreamingFilter::start(int counterStart)
+{
+	reset();
+	m_counterStart = counterStart;
+	m_isStarted = true;
+}
+void KStreamingFilter::addFrame(const KFrame& frame)
+{
+	if (!m_isStarted || m_isFinished) {
+		return;
+	}
+	m_previousFrame = m_nextFrame;
+	m_nextFrame = frame;
+	m_rawFrameCount++;
+	if (m_rawFrameCount < 2) {
+		return;
+	}
+
+	// the first two frames also extrapolate the times before them
+	while (m_interpolationInterval * (m_counterStart + m_interpolatedMotion.size()) < m_nextFrame.timestamp) {
+		interpolateFrame();
+	}
+}
+void KStreamingFilter::finish(int desiredSize)
+{
+	if (!m_isStarted || m_isFinished) {
+		return;
+	}
+	if (m_rawFrameCount < 2) {
+		cout << "KStreamingFilter: less than 2 frames were streamed!" << endl;
+	}
+	else {
+		// extrapolate after the last frame
+		while (m_interpolatedMotion.size() < desiredSize) {
+			interpolateFrame();
+		}
+		// a filtered frame only depends on the interpolated frames of its window
+		if (m_interpolatedMotion.size() > desiredSize) {
+			m_interpolatedMotion.resize(desiredSize);
+			int filteredSize = desiredSize - 2 * delay();
+			m_filteredMotion.resize(filteredSize > 0 ? filteredSize : 0);
+		}
+	}
+	m_isFinished = true;
+}
+void KStreamingFilter::reset()
+{
+	m_isStarted = false;
+	m_isFinished = false;
+	m_rawFrameCount = 0;
+	m_interpolatedMotion.clear();
+	m_filteredMotion.clear();
+	m_windowSize = 0;
+}
+bool KStreamingFilter::isStarted() const
+{
+	return m_isStarted;
+}
+bool KStreamingFilter::isFinished() const
+{
+	return m_isFinished;
+}
+int KStreamingFilter::rawFrameCount() const
+{
+	return m_rawFrameCount;
+}
+int KStreamingFilter::delay() const
+{
+	return (m_filter.taps() - 1) / 2;
+}
+const MotionBuffer& KStreamingFilter::interpolatedMotion() const
+{
+	return m_interpolatedMotion;
+}
+const MotionBuffer& KStreamingFilter::filteredMotion() const
+{
+	return m_filteredMotion;
+}
+bool KStreamingFilter::latestFilteredFrame(KFrame& frame) const
+{
+	if (m_filteredMotion.empty()) {
+		return false;
+	}
+	m_filteredMotion.getFrame(m_filteredMotion.size() - 1, frame);
+	return true;
+}
+// Same arithmetic as KSkeleton::interpolateMotion
+void KStreamingFilter::interpolateFrame()
+{
+	int counter = m_counterStart + m_interpolatedMotion.size();
+	double interpolationTime = m_interpolationInterval * counter;
+	double percentDistance =
+		(interpolationTime - m_previousFrame.timestamp) /
+		(m_nextFrame.timestamp - m_previousFrame.timestamp);
+
+	KFrame frame;
+	frame.serial = counter;
+	frame.timestamp = interpolationTime;
+	for (uint j = 0; j < JointType_Count; j++) {
+		const KJoint& previous = m_previousFrame.joints[j];
+		const KJoint& next = m_nextFrame.joints[j];
+		KJoint& joint = frame.joints[j];
+		joint.position.setX(previous.position.x() + percentDistance * (next.position.x() - previous.position.x()));
+		joint.position.setY(previous.position.y() + percentDistance * (next.position.y() - previous.position.y()));
+		joint.position.setZ(previous.position.z() + percentDistance * (next.position.z() - previous.position.z()));
+		joint.orientation = QQuaternion::nlerp(previous.orientation, next.orientation, percentDistance);
+		bool inferred =
+			previous.trackingState == TrackingState_Inferred ||
+			next.trackingState == TrackingState_Inferred;
+		joint.trackingState = inferred ? TrackingState_Inferred : TrackingState_Tracked;
+	}
+	m_interpolatedMotion.append(frame);
+
+	// keep the rotation matrix of the new frame in the window
+	if (m_windowSize == m_windowCapacity) {
+		int kept = m_filter.taps() - 1;
+		for (int c = 0; c < numRotationChannels; c++) {
+			float* channel = m_rotationWindow.data() + c * m_windowCapacity;
+			memmove(channel, channel + m_windowCapacity - kept, sizeof(float) * kept);
+		}
+		m_windowSize = kept;
+	}
+	for (uint j = 0; j < JointType_Count; j++) {
+		const QQuaternion& q = frame.joints[j].orientation;
+		const float w = q.scalar(), x = q.x(), y = q.y(), z = q.z();
+		const float x2 = x + x, y2 = y + y, z2 = z + z;
+		float* r = m_rotationWindow.data() + 9 * j * m_windowCapacity + m_windowSize;
+		r[0 * m_windowCapacity] = 1.f - (y2 * y + z2 * z);
+		r[1 * m_windowCapacity] = x2 * y - z2 * w;
+		r[2 * m_windowCapacity] = x2 * z + y2 * w;
+		r[3 * m_windowCapacity] = x2 * y + z2 * w;
+		r[4 * m_windowCapacity] = 1.f - (x2 * x + z2 * z);
+		r[5 * m_windowCapacity] = y2 * z - x2 * w;
+		r[6 * m_windowCapacity] = x2 * z - y2 * w;
+		r[7 * m_windowCapacity] = y2 * z + x2 * w;
+		r[8 * m_windowCapacity] = 1.f - (x2 * x + y2 * y);
+	}
+	m_windowSize++;
+
+	if (m_windowSize >= m_filter.taps()) {
+		filterFrame();
+	}
+}
+// Same arithmetic as KSkeleton::filterMotion, for the window ending at the newest interpolated frame
+void KStreamingFilter::filterFrame()
+{
+	const int taps = m_filter.taps();
+	const int first = m_interpolatedMotion.size() - taps;
+
+	KFrame frame;
+	m_filteredMotion.append(frame);
+	const int index = m_filteredMotion.size() - 1;
+	m_filteredMotion.serials()[index] = m_interpolatedMotion.serials()[first + delay()];
+	m_filteredMotion.timestamps()[index] = m_interpolatedMotion.timestamps()[first + delay()];
+
+	for (uint j = 0; j < JointType_Count; j++) {
+		m_filter.convolve(
+			m_interpolatedMotion.channel(j, MotionBuffer::PX) + first, m_interpolatedMotion.stride(),
+			m_filteredMotion.channel(j, MotionBuffer::PX) + index, m_filteredMotion.stride(),
+			3, 1);
+	}
+
+	float filteredRotations[numRotationChannels];
+	m_filter.convolve(
+		m_rotationWindow.constData() + m_windowSize - taps, m_windowCapacity,
+		filteredRotations, 1,
+		numRotationChannels, 1);
+	for (uint j = 0; j < JointType_Count; j++) {
+		QMatrix3x3 rotation;
+		for (int e = 0; e < 9; e++) {
+			rotation(e / 3, e % 3) = filteredRotations[9 * j + e];
+		}
+		QQuaternion q = QQuaternion::fromRotationMatrix(rotation);
+		m_filteredMotion.channel(j, MotionBuffer::QW)[index] = q.scalar();
+		m_filteredMotion.channel(j, MotionBuffer::QX)[index] = q.x();
+		m_filteredMotion.channel(j, MotionBuffer::QY)[index] = q.y();
+		m_filteredMotion.channel(j, MotionBuffer::QZ)[index] = q.z();
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef KSTREAMING_FILTER_H
+#define KSTREAMING_FILTER_H
+
+// Project
+#include "kskeleton.h"
+#include "motion_buffer.h"
+#include "sg_filter.h"
+
+// Qt
+#include <QtCore/QVector>
+
+// Interpolates and filters a motion while it is being recorded.
+// Raw frames go in as they arrive. An interpolated frame comes out as soon as the first raw frame
+// after its time is known and its filtered frame (taps - 1) / 2 interpolated frames later.
+// The results are identical to KSkeleton::interpolateMotion followed by KSkeleton::filterMotion.
+class KStreamingFilter
+{
+public:
+	KStreamingFilter(double interpolationInterval, const float* coefficients, int taps, float scale);
+
+	void start(int counterStart); // counter of the first interpolated frame
+	void addFrame(const KFrame& frame); // timestamps relative to the interpolation time origin
+	void finish(int desiredSize); // extrapolates or crops the interpolated motion to desiredSize
+	void reset();
+
+	bool isStarted() const;
+	bool isFinished() const;
+	int rawFrameCount() const;
+	int delay() const; // interpolated frames between the newest and the filtered one
+	const MotionBuffer& interpolatedMotion() const;
+	const MotionBuffer& filteredMotion() const;
+	bool latestFilteredFrame(KFrame& frame) const;
+private:
+	void interpolateFrame();
+	void filterFrame();
+
+	SavitzkyGolayFilter m_filter;
+	double m_interpolationInterval;
+	int m_counterStart = 0;
+	bool m_isStarted = false;
+	bool m_isFinished = false;
+
+	int m_rawFrameCount = 0;
+	KFrame m_previousFrame;
+	KFrame m_nextFrame;
+
+	MotionBuffer m_interpolatedMotion;
+	MotionBuffer m_filteredMotion;
+
+	// rotation matrices of the newest interpolated frames, 9 channels per joint of m_windowCapacity floats,
+	// the last taps - 1 frames are moved to the front whenever the window is full
+	QVector<float> m_rotationWindow;
+	int m_windowCapacity;
+	int m_windowSize = 0;
+};
+
+#endif
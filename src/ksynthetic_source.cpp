@@ -0,0 +1,71 @@
+// Own
+#include "ksynthetic_source.h"
+
+KSyntheticSource::KSyntheticSource(const KMotionGenerator& generator, double speed)
+	:
+	m_generator(generator),
+	m_speed(speed)
+{
+}
+bool KSyntheticSource::open()
+{
+	m_generator.reset();
+	m_hasNextFrame = m_generator.nextFrame(m_nextFrame);
+	m_clock.invalidate();
+	m_isOpen = true;
+	return true;
+}
+void KSyntheticSource::close()
+{
+	m_isOpen = false;
+	m_hasNextFrame = false;
+}
+bool KSyntheticSource::isOpen()
+{
+	return m_isOpen;
+}
+bool KSyntheticSource::acquireFrame(KBodyFrame& bodyFrame)
+{
+	if (!m_hasNextFrame) {
+		return false;
+	}
+
+	if (m_speed > 0.) {
+		if (!m_clock.isValid()) {
+			m_clock.start();
+			m_clockStart = m_nextFrame.timestamp;
+		}
+		double generatorTime = m_clockStart + m_clock.nsecsElapsed() / 1000000000. * m_speed;
+		if (generatorTime < m_nextFrame.timestamp) {
+			return false;
+		}
+	}
+
+	bodyFrame.timestamp = m_nextFrame.timestamp;
+	bodyFrame.personsTracked = 1;
+	for (uint i = 0; i < JointType_Count; i++) {
+		const KJoint& joint = m_nextFrame.joints[i];
+		bodyFrame.joints[i].JointType = (JointType)i;
+		bodyFrame.joints[i].Position.X = joint.position.x();
+		bodyFrame.joints[i].Position.Y = joint.position.y();
+		bodyFrame.joints[i].Position.Z = joint.position.z();
+		bodyFrame.joints[i].TrackingState = (TrackingState)joint.trackingState;
+		bodyFrame.orientations[i].JointType = (JointType)i;
+		bodyFrame.orientations[i].Orientation.w = joint.orientation.scalar();
+		bodyFrame.orientations[i].Orientation.x = joint.orientation.x();
+		bodyFrame.orientations[i].Orientation.y = joint.orientation.y();
+		bodyFrame.orientations[i].Orientation.z = joint.orientation.z();
+	}
+	m_hasNextFrame = m_generator.nextFrame(m_nextFrame);
+	return true;
+}
+bool KSyntheticSource::isLive() const
+{
+	return false;
+}
+QString KSyntheticSource::name() const
+{
+	return QString("Synthetic motion (%1 s at %2 Hz)")
+		.arg(m_generator.settings().duration)
+		.arg(m_generator.settings().frameRate);
+}
@@ -0,0 +1,34 @@
+#ifndef KSYNTHETIC_SOURCE_H
+#define KSYNTHETIC_SOURCE_H
+
+// Project
+#include "kbody_source.h"
+#include "kmotion_generator.h"
+
+// Qt
+#include <QtCore/QElapsedTimer>
+
+// Body frames synthesised by KMotionGenerator, delivered at speed times
+// their nominal rate or as fast as possible when speed <= 0
+class KSyntheticSource : public KBodySource
+{
+public:
+	KSyntheticSource(const KMotionGenerator& generator, double speed = 1.0);
+	bool open() override;
+	void close() override;
+	bool isOpen() override;
+	bool acquireFrame(KBodyFrame& bodyFrame) override;
+	bool isLive() const override;
+	QString name() const override;
+private:
+	KMotionGenerator m_generator;
+	double m_speed;
+	bool m_isOpen = false;
+
+	KFrame m_nextFrame;
+	bool m_hasNextFrame = false;
+	QElapsedTimer m_clock;
+	double m_clockStart = 0.;
+};
+
+#endif
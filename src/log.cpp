@@ -0,0 +1,105 @@
+// Own
+#include "log.h"
+
+// Standard C/C++
+#include <iostream>
+
+std::atomic<int> Log::s_level(LOG_LEVEL_INFO);
+std::mutex Log::s_consoleMutex;
+
+int Log::level()
+{
+	return s_level;
+}
+void Log::setLevel(int level)
+{
+	s_level = level;
+}
+bool Log::isEnabled(int level)
+{
+	return level >= s_level;
+}
+bool Log::parseLevel(const std::string& name, int& level)
+{
+	static const char* names[] = { "trace", "debug", "info", "warning", "error", "off" };
+	for (int l = LOG_LEVEL_TRACE; l <= LOG_LEVEL_OFF; l++) {
+		if (name == names[l]) {
+			level = l;
+			return true;
+		}
+	}
+	return false;
+}
+void Log::write(int level, const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(s_consoleMutex);
+	std::ostream& out = (level >= LOG_LEVEL_WARNING ? std::cerr : std::cout);
+	out << message << std::endl;
+}
+
+LogFile::LogFile()
+{
+}
+LogFile::~LogFile()
+{
+	close();
+}
+bool LogFile::open(const std::string& fileName)
+{
+	close();
+	m_file.open(fileName.c_str(), std::ios::out | std::ios::trunc);
+	if (!m_file.is_open()) {
+		return false;
+	}
+	m_isClosing = false;
+	m_isOpen = true;
+	m_thread = std::thread(&LogFile::run, this);
+	return true;
+}
+void LogFile::close()
+{
+	if (!m_isOpen) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isClosing = true;
+	}
+	m_condition.notify_one();
+	m_thread.join();
+	m_file.close();
+	m_isOpen = false;
+}
+bool LogFile::isOpen() const
+{
+	return m_isOpen;
+}
+void LogFile::write(std::string line)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::move(line));
+	}
+	m_condition.notify_one();
+}
+void LogFile::run()
+{
+	std::vector<std::string> lines;
+	while (true) {
+		bool isClosing;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_isClosing || !m_queue.empty(); });
+			lines.swap(m_queue);
+			isClosing = m_isClosing;
+		}
+		for (size_t i = 0; i < lines.size(); i++) {
+			m_file << lines[i] << '\n';
+		}
+		m_file.flush();
+		lines.clear();
+		if (isClosing) {
+			return;
+		}
+	}
+}
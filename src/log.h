@@ -0,0 +1,97 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Standard C/C++
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Message levels, from the most to the least verbose
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Messages below LOG_COMPILE_LEVEL are removed by the compiler,
+// messages below the runtime level (Log::setLevel, "--log-level <name>") are skipped
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+#define LOG_ENABLED(level) ((level) >= LOG_COMPILE_LEVEL && Log::isEnabled(level))
+
+// The message is a stream expression, e.g. LOG_DEBUG("Frame " << i),
+// and is only evaluated when its level is enabled
+#define LOG(level, message)									\
+	do {													\
+		if (LOG_ENABLED(level)) {							\
+			std::ostringstream logStream;					\
+			logStream << message;							\
+			Log::write(level, logStream.str());				\
+		}													\
+	} while (0)
+#define LOG_TRACE(message) LOG(LOG_LEVEL_TRACE, message)
+#define LOG_DEBUG(message) LOG(LOG_LEVEL_DEBUG, message)
+#define LOG_INFO(message) LOG(LOG_LEVEL_INFO, message)
+#define LOG_WARNING(message) LOG(LOG_LEVEL_WARNING, message)
+#define LOG_ERROR(message) LOG(LOG_LEVEL_ERROR, message)
+
+// Same as LOG but the line goes to a LogFile
+#define LOG_FILE(file, level, message)						\
+	do {													\
+		if (LOG_ENABLED(level) && (file).isOpen()) {		\
+			std::ostringstream logStream;					\
+			logStream << message;							\
+			(file).write(logStream.str());					\
+		}													\
+	} while (0)
+
+// Runtime level and console sink
+class Log
+{
+public:
+	static int level();
+	static void setLevel(int level);
+	static bool isEnabled(int level);
+	static bool parseLevel(const std::string& name, int& level); // trace, debug, info, warning, error or off
+	static void write(int level, const std::string& message);
+private:
+	static std::atomic<int> s_level;
+	static std::mutex s_consoleMutex;
+};
+
+// Text file written by a background thread, write() only queues the line
+class LogFile
+{
+public:
+	LogFile();
+	~LogFile();
+	bool open(const std::string& fileName);
+	void close(); // writes the queued lines first
+	bool isOpen() const;
+	void write(std::string line);
+private:
+	void run();
+
+	std::ofstream m_file;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::string> m_queue;
+	bool m_isClosing = false;
+	bool m_isOpen = false;
+};
+
+#endif
@@ -1,8 +1,10 @@
 // Project
+#include "log.h"
 #include "main_window.h"
 
 // Qt
 #include <QtCore\QDebug>
+#include <QtCore\QStringList>
 #include <QtGui\QSurfaceFormat>
 #include <QtWidgets\QApplication>
 
@@ -15,6 +17,16 @@ int main(int argc, char* argv[])
 	qDebug() << "Requested format:" << format << endl;
 
 	QApplication app(argc, argv);
+
+	// "--log-level trace|debug|info|warning|error|off"
+	QStringList arguments = app.arguments();
+	int logLevelIndex = arguments.indexOf("--log-level");
+	if (logLevelIndex >= 0 && logLevelIndex + 1 < arguments.size()) {
+		int level;
+		if (Log::parseLevel(arguments[logLevelIndex + 1].toStdString(), level)) Log::setLevel(level);
+		else qDebug() << "Unknown log level" << arguments[logLevelIndex + 1];
+	}
+
 	MainWindow mainWindow;
 	mainWindow.show();
 	return app.exec();
@@ -4,6 +4,8 @@
 // Project
 #include "skinned_mesh.h"
 #include "skinning_technique.h"
+#include "ghost_technique.h"
+#include "asset_loader.h"
 #include "pipeline.h"
 #include "camera.h"
 #include "kskeleton.h"
@@ -20,8 +22,14 @@
 
 // Standard C/C++
 #include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
 
+static const string barFileName = "models/barbell empty blendered.obj";
+static const string barbellFileName = "models/barbell blendered.obj";
+static const string pointerFileName = "models/arrow blendered.obj";
+
 MainWidget::MainWidget(QWidget *parent)
 	: 
 	QOpenGLWidget(parent),
@@ -29,15 +37,18 @@ MainWidget::MainWidget(QWidget *parent)
 	m_athlete(new SkinnedMesh()),
 	m_trainer(new SkinnedMesh()),
 	m_camera(new Camera()),
-	m_pipeline(new Pipeline())
+	m_pipeline(new Pipeline()),
+	m_assetLoader(new AssetLoader(this))
 {
 	cout << "MainWidget class constructor start." << endl;
 
-	// Init skinned mesh
-	m_athlete->loadFromFile("athlete.dae");
-	m_athlete->initKBoneMap();
-	m_trainer->loadFromFile("trainer.dae");
-	m_trainer->initKBoneMap();
+	// Import the models and the props in the background, they are set up in meshLoaded
+	connect(m_assetLoader, SIGNAL(meshLoaded(int)), this, SLOT(meshLoaded(int)));
+	m_assetLoader->loadSkinnedMesh(ATHLETE_MESH, m_athlete, "athlete.dae");
+	m_assetLoader->loadSkinnedMesh(TRAINER_MESH, m_trainer, "trainer.dae");
+	m_assetLoader->loadProps(PROP_MESHES, &m_meshRegistry, { barFileName, barbellFileName, pointerFileName });
+	connect(m_assetLoader, SIGNAL(imageLoaded(int, const QImage&)), this, SLOT(uploadTexture(int, const QImage&)));
+	connect(m_assetLoader, SIGNAL(compressedTextureLoaded(int, const CompressedTexture&)), this, SLOT(uploadCompressedTexture(int, const CompressedTexture&)));
 	
 	// Setup timer
 	connect(&m_timer, SIGNAL(timeout()), this, SLOT(intervalPassed()));
@@ -67,6 +78,8 @@ MainWidget::MainWidget(QWidget *parent)
 MainWidget::~MainWidget()
 {
 	// delete class members
+	delete m_assetLoader; // waits for the images and models being loaded
+	m_assetLoader = nullptr;
 	delete m_ksensor;
 	delete m_athlete;
 	delete m_trainer;
@@ -76,29 +89,33 @@ MainWidget::~MainWidget()
 	// Release OpenGL resources
 	makeCurrent();
 
-	// delete skinned mesh
-	unloadAthlete();
-	unloadTrainer();
+	// delete skinned meshes and props
+	unloadCharacter(true);
+	unloadCharacter(false);
+	m_meshRegistry.destroy();
 
 	// delete shaders
 	delete m_technique;
+	delete m_jointsTechnique;
+	delete m_ghostTechnique;
 	delete m_skinningTechnique;
 	delete m_shaderProgram;
 	delete m_lighting;
+	delete m_lightingInstanced;
 
 	// delete VAOs
 	glDeleteVertexArrays(1, &m_axesVAO);
 	glDeleteVertexArrays(1, &m_arrowVAO);
 	glDeleteVertexArrays(1, &m_cubeVAO);
 	glDeleteVertexArrays(1, &m_skeletonVAO);
+	glDeleteVertexArrays(1, &m_ghostVAO);
 	glDeleteVertexArrays(1, &m_skinnedMeshJointsVAO);
 	glDeleteVertexArrays(1, &m_planeVAO);
-	glDeleteVertexArrays(1, &m_barVAO);
-	glDeleteVertexArrays(1, &m_barbellVAO);
 
 	// delete VBOs
+	glDeleteBuffers(1, &m_jointsVBO);
 	glDeleteBuffers(1, &m_cubeVBO);
-	glDeleteBuffers(1, &m_skeletonVBO);
+	glDeleteBuffers(1, &m_texturePBO);
 	glDeleteBuffers(1, &m_skinnedMeshJointsVBO);
 
 	// delete textures
@@ -133,8 +150,6 @@ void MainWidget::initializeGL()
 
 	glPointSize(3.f);
 
-	m_athlete->printInfo();
-
 	// Init technique
 	m_technique = new Technique();
 	m_technique->initDefault();
@@ -142,6 +157,17 @@ void MainWidget::initializeGL()
 	m_technique->setMVP(m_pipeline->getWVPtrans());
 	m_technique->setSpecific(QMatrix4x4());
 
+	// Init joints technique
+	m_jointsTechnique = new Technique();
+	m_jointsTechnique->initJoints();
+	m_jointsTechnique->enable();
+	m_jointsTechnique->setMVP(m_pipeline->getWVPtrans());
+	m_jointsTechnique->setSpecific(QMatrix4x4());
+
+	// Init ghost technique
+	m_ghostTechnique = new GhostTechnique();
+	m_ghostTechnique->Init();
+
 	// Init skinning technique
 	m_skinningTechnique = new SkinningTechnique();
 	m_skinningTechnique->Init();
@@ -156,9 +182,6 @@ void MainWidget::initializeGL()
 	m_skinningTechnique->setMatSpecularIntensity(0.0f);
 	m_skinningTechnique->setMatSpecularPower(0);
 	m_skinningTechnique->setSkinning(true);
-	for (uint i = 0; i < m_athlete->numBones(); i++) {
-		m_skinningTechnique->setBoneVisibility(i, m_athlete->boneVisibility(i));
-	}
 	
 	// Init plane shaders
 	QOpenGLShader planeVS(QOpenGLShader::Vertex);
@@ -179,14 +202,7 @@ void MainWidget::initializeGL()
 	cout << "Locations:" << endl;
 	cout << m_mvpLocation << " ";
 	cout << m_specificLocation << endl;
-	float skinnedMeshFeet;
-	skinnedMeshFeet = m_athlete->boneEndPosition(m_athlete->findBoneId("foot_l")).y();
-	skinnedMeshFeet += m_athlete->boneEndPosition(m_athlete->findBoneId("foot_r")).y();
-	skinnedMeshFeet /= 2;
-	QMatrix4x4 S = fromScaling(QVector3D(2.f, 1.f, 2.f));
-	QMatrix4x4 R = fromRotation(QQuaternion::fromEulerAngles(QVector3D(0.f, 45.f, 0.f)));
-	QMatrix4x4 T = fromTranslation(QVector3D(0, skinnedMeshFeet, 0));
-	m_shaderProgram->setUniformValue(m_specificLocation, T * R * S);
+	placePlane();
 
 	// Init lighting shaders
 	QOpenGLShader lightingVS(QOpenGLShader::Vertex);
@@ -215,17 +231,40 @@ void MainWidget::initializeGL()
 	cout << m_modelViewLocation << " ";
 	cout << m_projectionLocation << endl;
 
-	loadAthlete(); 
-	loadTrainer();
+	// Init instanced lighting shaders
+	QOpenGLShader lightingInstancedVS(QOpenGLShader::Vertex);
+	lightingInstancedVS.compileSourceFile("shaders/lighting_instanced.vert");
+
+	cout << "Initializing instanced lighting shaders" << endl;
+	m_lightingInstanced = new QOpenGLShaderProgram(context());
+	if (!m_lightingInstanced->addShader(&lightingInstancedVS)) cout << "Could not add instanced lighting vertex shader." << endl;
+	if (!m_lightingInstanced->addShader(&lightingFS)) cout << "Could not add lighting fragment shader." << endl;
+	if (!m_lightingInstanced->link()) cout << "Could not link instanced lighting shaders." << endl;
+	cout << "Program id: " << m_lightingInstanced->programId() << endl;
+	m_instancedViewLocation = m_lightingInstanced->uniformLocation("view");
+	m_instancedProjectionLocation = m_lightingInstanced->uniformLocation("projection");
+	m_instancedDiffuseLocation = m_lightingInstanced->uniformLocation("diffuseAlbedo");
+	m_instancedSpecularLocation = m_lightingInstanced->uniformLocation("specularAlbedo");
+	m_instancedAmbientLocation = m_lightingInstanced->uniformLocation("ambient");
+
+	glGenBuffers(1, &m_texturePBO);
+	const bool s3tc = context()->hasExtension("GL_EXT_texture_compression_s3tc");
+	cout << "S3TC texture compression " << (s3tc ? "supported" : "not supported, textures stay uncompressed") << endl;
+	m_assetLoader->setTextureCompression(s3tc);
 	loadAxes();
 	loadArrow();
+	loadJoints(); // before the skeleton and the cube, whose VAOs read it
 	loadSkeleton();
+	loadGhosts();
 	loadSkinnedMeshJoints();
 	loadCube(0.02);
 	loadPlane();
-	loadBar();
-	loadBarbell();
-	loadPointer();
+
+	// the models that arrived before the context
+	m_glInitialized = true;
+	if (m_athleteLoaded) setupCharacter(true);
+	if (m_trainerLoaded) setupCharacter(false);
+	if (m_propsLoaded) setupProps();
 
 	cout << "MainWidget initializeGL end." << endl;
 }
@@ -236,37 +275,36 @@ void MainWidget::paintGL()
 
 	KFrame* activeFrame = (m_athleteEnabled ? &m_activeAthleteFrame : &m_activeTrainerFrame);
 	if (m_activeMode == Mode::CAPTURE) {
+		invalidateActiveFrames();
 		m_ksensor->getBodyFrame(*activeFrame);
+		// while recording, show the frames filtered so far
+		if (m_activeMotionType >= (int)MotionType::FILTERED) {
+			m_ksensor->skeleton()->latestFilteredFrame(*activeFrame);
+		}
 	}
 	else if (m_activeMode == Mode::PLAYBACK){
-		if (m_activeFrameIndex < m_activeAthleteMotion->size()) {
-			m_activeAthleteFrame = m_activeAthleteMotion->operator[](m_activeFrameIndex);
-		}
-		if (m_activeFrameIndex < m_activeTrainerMotion->size()) {
-			m_activeTrainerFrame = m_activeTrainerMotion->operator[](m_activeFrameIndex);
-		}
+		updateActiveFrame(SESSION_ATHLETE);
+		updateActiveFrame(SESSION_TRAINER);
 	}
 	else {
 		cout << "Error: Mode=" << (int)m_activeMode << endl;
 		return;
 	}
 	m_activeFrameTimestamp = activeFrame->timestamp;
+	if (m_ghostMotionsChanged) {
+		m_ghostTechnique->invalidateMotions();
+		m_ghostMotionsChanged = false;
+	}
 
 	// calculate skinned mesh bone transforms (used by barbell as well)
-	m_athlete->calculateBoneTransforms(
-		m_athlete->m_pScene->mRootNode,
-		QMatrix4x4(),
-		m_activeAthleteFrame.joints);
-	m_trainer->calculateBoneTransforms(
-		m_trainer->m_pScene->mRootNode,
-		QMatrix4x4(),
-		m_activeTrainerFrame.joints);
+	if (m_athleteLoaded) m_athlete->calculateBoneTransforms(m_activeAthleteFrame.joints);
+	if (m_trainerLoaded) m_trainer->calculateBoneTransforms(m_activeTrainerFrame.joints);
 
 	// draw humans
 	if (m_skinnedMeshDrawing) {
 
 		// athlete
-		if (m_athleteEnabled && m_athlete->m_successfullyLoaded) {
+		if (m_athleteEnabled && m_athleteLoaded && m_athlete->m_successfullyLoaded) {
 			m_pipeline->setWorldScale(QVector3D(1.f, 1.f, 1.f));
 			m_pipeline->setWorldOrientation(QQuaternion());
 			m_pipeline->setWorldPosition(
@@ -279,10 +317,8 @@ void MainWidget::paintGL()
 			// skinned mesh
 			m_skinningTechnique->enable();
 			m_skinningTechnique->setWVP(m_pipeline->getWVPtrans());
-			for (uint i = 0; i < m_athlete->numBones(); i++) {
-				m_skinningTechnique->setBoneTransform(i, m_athlete->boneInfo(i).combined);
-			}
-			drawAthlete();
+			m_skinningTechnique->setBoneTransforms(m_athlete->boneTransforms());
+			drawCharacter(true);
 
 			// skinned mesh joints
 			m_technique->enable();
@@ -302,7 +338,7 @@ void MainWidget::paintGL()
 		}
 
 		// trainer
-		if (m_trainerEnabled) {
+		if (m_trainerEnabled && m_trainerLoaded && m_trainer->m_successfullyLoaded) {
 			m_pipeline->setWorldScale(QVector3D(1.f, 1.f, 1.f));
 			m_pipeline->setWorldOrientation(QQuaternion());
 			m_pipeline->setWorldPosition(
@@ -314,11 +350,9 @@ void MainWidget::paintGL()
 
 			// skinned mesh
 			m_skinningTechnique->enable();
-			for (uint i = 0; i < m_trainer->numBones(); i++) {
-				m_skinningTechnique->setBoneTransform(i, m_trainer->boneInfo(i).combined);
-			}
+			m_skinningTechnique->setBoneTransforms(m_trainer->boneTransforms());
 			m_skinningTechnique->setWVP(m_pipeline->getWVPtrans());
-			drawTrainer();
+			drawCharacter(false);
 
 			// skinned mesh joints
 			m_technique->enable();
@@ -342,11 +376,11 @@ void MainWidget::paintGL()
 
 	// athlete
 	QVector3D athleteBarbellLeftGrip =
-		m_barbellFromMesh ?
+		m_barbellFromMesh && m_athleteLoaded ?
 		m_activeAthleteFrame.joints[JointType_SpineBase].position + m_athlete->boneEndPosition(m_athlete->findBoneId("thumb_01_l")) :
 		m_activeAthleteFrame.joints[JointType_HandLeft].position;
 	QVector3D athleteBarbellRightGrip =
-		m_barbellFromMesh ?
+		m_barbellFromMesh && m_athleteLoaded ?
 		m_activeAthleteFrame.joints[JointType_SpineBase].position + m_athlete->boneEndPosition(m_athlete->findBoneId("thumb_01_r")) :
 		m_activeAthleteFrame.joints[JointType_HandRight].position;
 
@@ -364,11 +398,11 @@ void MainWidget::paintGL()
 
 	// trainer
 	QVector3D trainerBarbellLeftGrip =
-		m_barbellFromMesh ?
+		m_barbellFromMesh && m_trainerLoaded ?
 		m_activeTrainerFrame.joints[JointType_SpineBase].position + m_trainer->boneEndPosition(m_trainer->findBoneId("thumb_01_l")) :
 		m_activeTrainerFrame.joints[JointType_HandLeft].position;
 	QVector3D trainerBarbellRightGrip =
-		m_barbellFromMesh ?
+		m_barbellFromMesh && m_trainerLoaded ?
 		m_activeTrainerFrame.joints[JointType_SpineBase].position + m_trainer->boneEndPosition(m_trainer->findBoneId("thumb_01_r")) :
 		m_activeTrainerFrame.joints[JointType_HandRight].position;
 
@@ -387,8 +421,9 @@ void MainWidget::paintGL()
 	// draw barbells
 	if (m_barbellDrawing) {
 
-		// bind lighting shaders
+		// bind lighting shaders and the props
 		m_lighting->bind();
+		m_meshRegistry.bind();
 
 		// athlete
 		if (m_athleteEnabled) {
@@ -403,7 +438,7 @@ void MainWidget::paintGL()
 
 			m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans() );
 			m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-			drawBar();
+			drawProp(m_barMesh, true);
 
 			// barbell displacement
 			if (true) {
@@ -423,7 +458,7 @@ void MainWidget::paintGL()
 				);
 				m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
 				m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-				drawPointer();
+				drawProp(m_pointerMesh, false);
 			}
 
 			// barbell velocity
@@ -443,7 +478,7 @@ void MainWidget::paintGL()
 				);
 				m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
 				m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-				drawPointer();
+				drawProp(m_pointerMesh, false);
 			}
 		}
 
@@ -460,7 +495,7 @@ void MainWidget::paintGL()
 
 			m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
 			m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-			drawBarbell();
+			drawProp(m_barbellMesh, true);
 
 			// barbell displacement
 			if (true) {
@@ -480,7 +515,7 @@ void MainWidget::paintGL()
 				);
 				m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
 				m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-				drawPointer();
+				drawProp(m_pointerMesh, false);
 			}
 
 			// barbell velocity
@@ -500,28 +535,32 @@ void MainWidget::paintGL()
 				);
 				m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
 				m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-				drawPointer();
+				drawProp(m_pointerMesh, false);
 			}
 		}
+
+		m_meshRegistry.release();
 	}
 
 	if (m_tipsDrawing) {
 
-		// bind lighting shaders
-		m_lighting->bind();
-		m_lighting->setUniformValue(m_projectionLocation, m_pipeline->GetProjTrans());
-
-		m_lighting->setUniformValue(m_diffuseLocation, QVector3D(0, 0, 0));
-		m_lighting->setUniformValue(m_specularLocation, QVector3D(0, 0, 0));
-		m_lighting->setUniformValue(m_ambientLocation, QVector3D(0, 0, 1));
-
+		// bind instanced lighting shaders
+		m_lightingInstanced->bind();
+		m_lightingInstanced->setUniformValue(m_instancedProjectionLocation, m_pipeline->GetProjTrans());
+		m_lightingInstanced->setUniformValue(m_instancedViewLocation, m_pipeline->GetViewTrans());
+
+		m_lightingInstanced->setUniformValue(m_instancedDiffuseLocation, QVector3D(0, 0, 0));
+		m_lightingInstanced->setUniformValue(m_instancedSpecularLocation, QVector3D(0, 0, 0));
+		m_lightingInstanced->setUniformValue(m_instancedAmbientLocation, QVector3D(0, 0, 1));
+
+		QQuaternion athleteAlign = QQuaternion::fromDirection(
+			QVector3D::crossProduct(-m_ksensor->skeleton()->m_athleteInitialBarbellDirection, QVector3D(0, 1, 0)),
+			QVector3D(0, 1, 0)).inverted();
+		QQuaternion trainerAlign = QQuaternion::fromDirection(
+			QVector3D::crossProduct(-m_ksensor->skeleton()->m_athleteInitialBarbellDirection, QVector3D(0, 1, 0)),
+			QVector3D(0, 1, 0)).inverted();
+		QVector<QMatrix4x4> pointerModels;
 		for (uint i = 0; i < m_comparisonJoints.size(); i++) {
-			QQuaternion athleteAlign = QQuaternion::fromDirection(
-				QVector3D::crossProduct(-m_ksensor->skeleton()->m_athleteInitialBarbellDirection, QVector3D(0, 1, 0)),
-				QVector3D(0, 1, 0)).inverted();
-			QQuaternion trainerAlign = QQuaternion::fromDirection(
-				QVector3D::crossProduct(-m_ksensor->skeleton()->m_athleteInitialBarbellDirection, QVector3D(0, 1, 0)),
-				QVector3D(0, 1, 0)).inverted();
 			const QVector3D& athleteJoint =
 				athleteAlign *(m_activeAthleteFrame.joints[m_comparisonJoints[i]].position
 				- m_ksensor->skeleton()->m_athleteFeetOffset);
@@ -533,10 +572,12 @@ void MainWidget::paintGL()
 			m_pipeline->setWorldScale(scaleFactor / 3, scaleFactor, scaleFactor / 3);
 			m_pipeline->setWorldOrientation(QQuaternion::rotationTo(QVector3D(0.f, 1.f, 0.f), trainerJoint - athleteJoint));
 			m_pipeline->setWorldPosition(athleteJoint + m_generalOffset);
-
-			m_lighting->setUniformValue(m_modelViewLocation, m_pipeline->GetWVTrans());
-			drawPointer();
+			pointerModels.append(m_pipeline->GetWorldTrans());
 		}
+		m_meshRegistry.setInstanceModels(pointerModels);
+		m_meshRegistry.bind();
+		m_meshRegistry.drawInstanced(m_pointerMesh, pointerModels.size());
+		m_meshRegistry.release();
 	}
 
 	// draw kinect skeletons
@@ -557,17 +598,25 @@ void MainWidget::paintGL()
 			m_pipeline->setWorldPosition(m_generalOffset);
 
 			// skeleton bones
+			updateJoints(m_activeAthleteFrame.joints, true);
 			m_technique->setMVP(m_pipeline->getWVPtrans() * athleteSkeletonTransform);
 			m_technique->setSpecific(QMatrix4x4());
-			drawSkeleton(m_activeAthleteFrame.joints, true);
+			drawSkeleton();
 
 			// skeleton joints
 			if (m_kinectSkeletonJointsDrawing) {
-				m_technique->setMVP(m_pipeline->getWVPtrans() * athleteSkeletonTransform);
-				for (uint i = 0; i < JointType_Count; i++) {
-					m_technique->setSpecific(fromTranslation(m_activeAthleteFrame.joints[i].position));
-					drawCube(m_activeAthleteFrame.joints[i], true);
-				}
+				m_jointsTechnique->enable();
+				m_jointsTechnique->setMVP(m_pipeline->getWVPtrans() * athleteSkeletonTransform);
+				drawCubes();
+				m_technique->enable();
+			}
+
+			// ghost trail
+			if (m_ghostMode != GhostMode::OFF && m_activeMode == Mode::PLAYBACK) {
+				m_ghostTechnique->enable();
+				m_ghostTechnique->setMVP(m_pipeline->getWVPtrans() * athleteSkeletonTransform);
+				drawGhosts(0, activeMotion(SESSION_ATHLETE), activeMotionId(SESSION_ATHLETE), m_ksensor->skeleton()->m_athletePhases, QVector3D(1.f, 0.f, 0.f));
+				m_technique->enable();
 			}
 
 			// joint axes
@@ -596,17 +645,25 @@ void MainWidget::paintGL()
 			m_pipeline->setWorldPosition(-m_generalOffset);
 
 			// skeleton bones
+			updateJoints(m_activeTrainerFrame.joints, false);
 			m_technique->setMVP(m_pipeline->getWVPtrans() * trainerSkeletonTransform);
 			m_technique->setSpecific(QMatrix4x4());
-			drawSkeleton(m_activeTrainerFrame.joints, false);
+			drawSkeleton();
 
 			// skeleton joints
 			if (m_kinectSkeletonJointsDrawing) {
-				m_technique->setMVP(m_pipeline->getWVPtrans() * trainerSkeletonTransform);
-				for (uint i = 0; i < JointType_Count; i++) {
-					m_technique->setSpecific(fromTranslation(m_activeTrainerFrame.joints[i].position));
-					drawCube(m_activeTrainerFrame.joints[i], false);
-				}
+				m_jointsTechnique->enable();
+				m_jointsTechnique->setMVP(m_pipeline->getWVPtrans() * trainerSkeletonTransform);
+				drawCubes();
+				m_technique->enable();
+			}
+
+			// ghost trail
+			if (m_ghostMode != GhostMode::OFF && m_activeMode == Mode::PLAYBACK) {
+				m_ghostTechnique->enable();
+				m_ghostTechnique->setMVP(m_pipeline->getWVPtrans() * trainerSkeletonTransform);
+				drawGhosts(1, activeMotion(SESSION_TRAINER), activeMotionId(SESSION_TRAINER), m_ksensor->skeleton()->m_trainerPhases, QVector3D(0.f, 1.f, 0.f));
+				m_technique->enable();
 			}
 
 			// joint axes
@@ -691,36 +748,51 @@ void MainWidget::keyPressEvent(QKeyEvent *event)
 	case Qt::Key_7:
 	case Qt::Key_8:
 	case Qt::Key_9:
-		m_athlete->flipParameter(key - Qt::Key_0);
-		m_trainer->flipParameter(key - Qt::Key_0);
+		// the models are still loading on the thread pool until they are flagged loaded
+		if (m_athleteLoaded) m_athlete->flipParameter(key - Qt::Key_0);
+		if (m_trainerLoaded) m_trainer->flipParameter(key - Qt::Key_0);
+		break;
+	case Qt::Key_B:
+		if (m_ksensor->isStreamRecording()) m_ksensor->stopStreamRecording();
+		else m_ksensor->startStreamRecording("bodystream.kbs");
 		break;
 	case Qt::Key_C:
-		m_ksensor->skeleton()->calculateJointOrientations(*m_activeAthleteMotion);
-		m_ksensor->skeleton()->calculateJointOrientations(*m_activeTrainerMotion);
+		m_ksensor->skeleton()->calculateJointOrientations(m_ksensor->skeleton()->editableMotion(SESSION_ATHLETE, m_activeAthleteStage));
+		m_ksensor->skeleton()->calculateJointOrientations(m_ksensor->skeleton()->editableMotion(SESSION_TRAINER, m_activeTrainerStage));
+		m_ghostMotionsChanged = true;
+		invalidateActiveFrames();
 		break;
 	case Qt::Key_D:
 		m_defaultPose = !m_defaultPose;
 		cout << "Default pause " << (m_defaultPose ? "ON" : "OFF") << endl;
 		break;
+	case Qt::Key_G:
+		if (m_ghostMode == GhostMode::OFF) m_ghostMode = GhostMode::TRAIL;
+		else if (m_ghostMode == GhostMode::TRAIL) m_ghostMode = GhostMode::PHASE;
+		else m_ghostMode = GhostMode::OFF;
+		cout << "Ghost trail " << (m_ghostMode == GhostMode::OFF ? "OFF" : (m_ghostMode == GhostMode::TRAIL ? "TRAIL" : "PHASE")) << endl;
+		break;
 	case Qt::Key_I:
 		if (m_athleteEnabled) {
 			m_ksensor->skeleton()->m_athletePhases = m_ksensor->skeleton()->identifyPhases(
-				m_ksensor->skeleton()->m_athleteAdjustedMotion);
+				m_ksensor->skeleton()->motion(SESSION_ATHLETE, SESSION_ADJUSTED));
 		}
 		if (m_trainerEnabled) {
 			m_ksensor->skeleton()->m_trainerPhases = m_ksensor->skeleton()->identifyPhases(
-				m_ksensor->skeleton()->m_trainerAdjustedMotion);
+				m_ksensor->skeleton()->motion(SESSION_TRAINER, SESSION_ADJUSTED));
 		}
+		m_ghostMotionsChanged = true; // the rescales align the new phases
+		invalidateActiveFrames();
 		break;
 	case Qt::Key_L:
 		if (m_athleteEnabled) {
 			cout << "Athlete limbs" << endl;
-			m_ksensor->skeleton()->calculateLimbLengths(*m_activeAthleteMotion);
+			m_ksensor->skeleton()->calculateLimbLengths(m_ksensor->skeleton()->motion(SESSION_ATHLETE, m_activeAthleteStage));
 			m_ksensor->skeleton()->printLimbLengths();
 		}
 		if (m_trainerEnabled) {
 			cout << "Trainer limbs" << endl;
-			m_ksensor->skeleton()->calculateLimbLengths(*m_activeTrainerMotion);
+			m_ksensor->skeleton()->calculateLimbLengths(m_ksensor->skeleton()->motion(SESSION_TRAINER, m_activeTrainerStage));
 			m_ksensor->skeleton()->printLimbLengths();
 		}
 		break;
@@ -748,6 +820,7 @@ void MainWidget::keyPressEvent(QKeyEvent *event)
 		break;
 	case Qt::Key_Q:
 		m_ksensor->skeleton()->processSpecific();
+		m_ghostMotionsChanged = true;
 		break;
 	case Qt::Key_R:
 		if (m_activeMode==Mode::CAPTURE) m_ksensor->skeleton()->record(m_trainerEnabled);
@@ -768,7 +841,7 @@ void MainWidget::keyPressEvent(QKeyEvent *event)
 					return;
 				}
 			}
-			m_activeFrameIndex = m_activeAthleteMotion->size() - 1;
+			m_activeFrameIndex = activeMotion(SESSION_ATHLETE).size() - 1;
 		}
 		else {
 			for (uint i = 0; i < NUM_PHASES; i++) {
@@ -778,7 +851,7 @@ void MainWidget::keyPressEvent(QKeyEvent *event)
 					return;
 				}
 			}
-			m_activeFrameIndex = m_activeTrainerMotion->size() - 1;
+			m_activeFrameIndex = activeMotion(SESSION_TRAINER).size() - 1;
 		}
 		emit frameChanged(activeMotionProgress());
 		break;
@@ -919,36 +992,12 @@ bool MainWidget::tipsDrawing() const
 }
 QVector3D MainWidget::activeJointVelocity() const
 {
-	QVector3D currentPosition, nextPosition;
-	double currentTime, nextTime;
-	if (m_athleteEnabled) {
-		currentPosition = 
-			m_activeAthleteMotion->operator[](m_activeFrameIndex).joints[m_activeJointId].position;
-		nextPosition =
-			(m_activeFrameIndex == m_activeAthleteMotion->size() - 1) ?
-			QVector3D(0.f, 0.f, 0.f) :
-			m_activeAthleteMotion->operator[](m_activeFrameIndex + 1).joints[m_activeJointId].position;
-		currentTime =
-			m_activeAthleteMotion->operator[](m_activeFrameIndex).timestamp;
-		nextTime =
-			(m_activeFrameIndex == m_activeAthleteMotion->size() - 1) ?
-			0 :
-			m_activeAthleteMotion->operator[](m_activeFrameIndex + 1).timestamp;
-	}
-	else {
-		currentPosition =
-			m_activeTrainerMotion->operator[](m_activeFrameIndex).joints[m_activeJointId].position;
-		nextPosition =
-			(m_activeFrameIndex == m_activeTrainerMotion->size() - 1) ?
-			QVector3D(0.f, 0.f, 0.f) :
-			m_activeTrainerMotion->operator[](m_activeFrameIndex + 1).joints[m_activeJointId].position;
-		currentTime =
-			m_activeTrainerMotion->operator[](m_activeFrameIndex).timestamp;
-		nextTime =
-			(m_activeFrameIndex == m_activeTrainerMotion->size() - 1) ?
-			0 :
-			m_activeTrainerMotion->operator[](m_activeFrameIndex + 1).timestamp;
-	}
+	MotionView motion = activeMotion(m_athleteEnabled ? SESSION_ATHLETE : SESSION_TRAINER);
+	bool last = (m_activeFrameIndex == motion.size() - 1);
+	QVector3D currentPosition = motion.position(m_activeFrameIndex, m_activeJointId);
+	QVector3D nextPosition = last ? QVector3D(0.f, 0.f, 0.f) : motion.position(m_activeFrameIndex + 1, m_activeJointId);
+	double currentTime = motion.timestamp(m_activeFrameIndex);
+	double nextTime = last ? 0 : motion.timestamp(m_activeFrameIndex + 1);
 	return (nextPosition - currentPosition) / (nextTime - currentTime);
 }
 float MainWidget::activeJointAngle() const
@@ -1018,6 +1067,9 @@ QStringList MainWidget::skeletonJointList() const
 QStringList MainWidget::modelBoneList() const
 {
 	QStringList qsl;
+	if (!m_athleteLoaded) {
+		return qsl; // listed again when modelLoaded is emitted
+	}
 	for (const auto& it : m_athlete->boneMap()) qsl << QString(it.first.c_str());
 	return qsl;
 }
@@ -1043,6 +1095,7 @@ void MainWidget::setCaptureEnabled(bool state)
 	else {
 		cout << "Active mode: Playback" << endl;
 		m_activeMode = Mode::PLAYBACK;
+		m_ghostMotionsChanged = true; // the recorded motions were replaced
 		m_timer.setInterval(m_playbackInterval * 1000);
 	}
 }
@@ -1078,34 +1131,44 @@ int MainWidget::activeMotionType() const
 }
 void MainWidget::setActiveMotionType(int motionType)
 {	
-	m_activeMotionType = motionType;
-	if (motionType == 0) {
-		m_activeAthleteMotion = &m_ksensor->skeleton()->m_athleteRawMotion;
-		m_activeTrainerMotion = &m_ksensor->skeleton()->m_trainerRawMotion;
-	}
-	else if (motionType == 1) {
-		m_activeAthleteMotion = &m_ksensor->skeleton()->m_athleteInterpolatedMotion;
-		m_activeTrainerMotion = &m_ksensor->skeleton()->m_trainerInterpolatedMotion;
-	}
-	else if (motionType == 2) {
-		m_activeAthleteMotion = &m_ksensor->skeleton()->m_athleteFilteredMotion;
-		m_activeTrainerMotion = &m_ksensor->skeleton()->m_trainerFilteredMotion;
-	}
-	else if (motionType == 3) {
-		m_activeAthleteMotion = &m_ksensor->skeleton()->m_athleteAdjustedMotion;
-		m_activeTrainerMotion = &m_ksensor->skeleton()->m_trainerAdjustedMotion;
-	}
-	else if (motionType == 4) {
-		m_activeAthleteMotion = &m_ksensor->skeleton()->m_athleteRescaledMotion;
-		m_activeTrainerMotion = &m_ksensor->skeleton()->m_trainerAdjustedMotion;
-	}
-	else {
-		cout << "Error: Motion type = " << m_activeMotionType << endl;
+	if (motionType < 0 || motionType >= NUM_SESSION_STAGES) {
+		cout << "Error: Motion type = " << motionType << endl;
 		return;
 	}
+	m_activeMotionType = motionType;
+	m_activeAthleteStage = (SessionStage)motionType;
+	// the rescaled trainer motion is not shown, the trainer's motion is the prototype
+	m_activeTrainerStage = (motionType == SESSION_RESCALED) ? SESSION_ADJUSTED : (SessionStage)motionType;
 	cout << "Motion type: " << m_motionTypeList[m_activeMotionType].toStdString() << endl;
+	m_ghostMotionsChanged = true;
 	update();
 }
+MotionView MainWidget::activeMotion(SessionPerson person) const
+{
+	return m_ksensor->skeleton()->motionView(person, person == SESSION_ATHLETE ? m_activeAthleteStage : m_activeTrainerStage);
+}
+quint64 MainWidget::activeMotionId(SessionPerson person) const
+{
+	return m_ksensor->skeleton()->motionId(person, person == SESSION_ATHLETE ? m_activeAthleteStage : m_activeTrainerStage);
+}
+void MainWidget::updateActiveFrame(SessionPerson person)
+{
+	MotionView motion = activeMotion(person);
+	if (m_activeFrameIndex >= (uint)motion.size()) {
+		return;
+	}
+	const quint64 motionId = activeMotionId(person);
+	if (m_activeFrameMotionIds[person] == motionId && m_activeFrameIndices[person] == m_activeFrameIndex) {
+		return;
+	}
+	motion.getFrame(m_activeFrameIndex, person == SESSION_ATHLETE ? m_activeAthleteFrame : m_activeTrainerFrame);
+	m_activeFrameMotionIds[person] = motionId;
+	m_activeFrameIndices[person] = m_activeFrameIndex;
+}
+void MainWidget::invalidateActiveFrames()
+{
+	m_activeFrameMotionIds.fill(0);
+}
 void MainWidget::setModelSkinning(bool state)
 {
 	m_skinningTechnique->enable();
@@ -1163,6 +1226,9 @@ void MainWidget::setActiveMotionProgress(int progressPercent)
 }
 void MainWidget::setActiveBone(const QString& boneName)
 {
+	if (!m_athleteLoaded) {
+		return;
+	}
 	m_activeBoneId = m_athlete->findBoneId(boneName);
 	update();
 }
@@ -1170,32 +1236,101 @@ void MainWidget::setActiveJointId(int jointId)
 {
 	m_activeJointId = jointId;
 }
-void MainWidget::unloadAthlete()
+void MainWidget::unloadCharacter(bool athlete)
 {
-	for (uint i = 0; i < m_athleteTextures.size(); i++) {
-		SAFE_DELETE(m_athleteTextures[i]);
+	vector<QOpenGLTexture*>& textures = athlete ? m_athleteTextures : m_trainerTextures;
+	GLuint* VBOs = athlete ? m_athleteVBOs : m_trainerVBOs;
+	GLuint& VAO = athlete ? m_athleteVAO : m_trainerVAO;
+
+	for (uint i = 0; i < textures.size(); i++) {
+		SAFE_DELETE(textures[i]);
 	}
 
-	if (m_athleteVBOs[0] != 0) {
-		glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_athleteVBOs), m_athleteVBOs);
+	if (VBOs[0] != 0) {
+		glDeleteBuffers(NUM_VBs, VBOs);
 	}
 
-	if (m_athleteVAO != 0) {
-		glDeleteVertexArrays(1, &m_athleteVAO);
-		m_athleteVAO = 0;
+	if (VAO != 0) {
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+}
+// Runs on the GUI thread once a model is imported
+void MainWidget::meshLoaded(int id)
+{
+	if (id == PROP_MESHES) {
+		m_propsLoaded = true;
+		if (m_glInitialized) {
+			makeCurrent();
+			setupProps();
+			doneCurrent();
+		}
+	}
+	else {
+		const bool athlete = (id == ATHLETE_MESH);
+		(athlete ? m_athlete : m_trainer)->initKBoneMap();
+		(athlete ? m_athleteLoaded : m_trainerLoaded) = true;
+		if (m_glInitialized) {
+			makeCurrent();
+			setupCharacter(athlete);
+			doneCurrent();
+		}
+		if (athlete) {
+			emit modelLoaded();
+		}
+	}
+	update();
+}
+void MainWidget::setupCharacter(bool athlete)
+{
+	loadCharacter(athlete);
+	if (athlete) {
+		m_athlete->printInfo();
+		m_skinningTechnique->enable();
+		for (uint i = 0; i < m_athlete->numBones(); i++) {
+			m_skinningTechnique->setBoneVisibility(i, m_athlete->boneVisibility(i));
+		}
+		placePlane();
 	}
 }
-void MainWidget::loadAthlete()
+void MainWidget::setupProps()
 {
-	unloadAthlete();
+	m_meshRegistry.upload();
+	m_barMesh = m_meshRegistry.find(barFileName);
+	m_barbellMesh = m_meshRegistry.find(barbellFileName);
+	m_pointerMesh = m_meshRegistry.find(pointerFileName);
+}
+// Under the athlete's feet, at the origin until the athlete's model is loaded
+void MainWidget::placePlane()
+{
+	float skinnedMeshFeet = 0.f;
+	if (m_athleteLoaded) {
+		skinnedMeshFeet = m_athlete->boneEndPosition(m_athlete->findBoneId("foot_l")).y();
+		skinnedMeshFeet += m_athlete->boneEndPosition(m_athlete->findBoneId("foot_r")).y();
+		skinnedMeshFeet /= 2;
+	}
+	QMatrix4x4 S = fromScaling(QVector3D(2.f, 1.f, 2.f));
+	QMatrix4x4 R = fromRotation(QQuaternion::fromEulerAngles(QVector3D(0.f, 45.f, 0.f)));
+	QMatrix4x4 T = fromTranslation(QVector3D(0, skinnedMeshFeet, 0));
+	m_shaderProgram->bind();
+	m_shaderProgram->setUniformValue(m_specificLocation, T * R * S);
+}
+void MainWidget::loadCharacter(bool athlete)
+{
+	unloadCharacter(athlete);
+
+	const SkinnedMesh* mesh = athlete ? m_athlete : m_trainer;
+	vector<QOpenGLTexture*>& textures = athlete ? m_athleteTextures : m_trainerTextures;
+	GLuint* VBOs = athlete ? m_athleteVBOs : m_trainerVBOs;
+	GLuint& VAO = athlete ? m_athleteVAO : m_trainerVAO;
 
-	glGenVertexArrays(1, &m_athleteVAO);
-	cout << "skinnedMeshVAO=" << m_athleteVAO << endl;
-	glBindVertexArray(m_athleteVAO);
+	glGenVertexArrays(1, &VAO);
+	cout << "skinnedMeshVAO=" << VAO << endl;
+	glBindVertexArray(VAO);
 
-	glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_athleteVBOs), m_athleteVBOs);
-	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(m_athleteVBOs); i++) {
-		cout << "skinnedMeshVBO=" << m_athleteVBOs[i] << endl;
+	glGenBuffers(NUM_VBs, VBOs);
+	for (uint i = 0; i < NUM_VBs; i++) {
+		cout << "skinnedMeshVBO=" << VBOs[i] << endl;
 	}
 
 #define POSITION_LOCATION    0
@@ -1204,159 +1339,150 @@ void MainWidget::loadAthlete()
 #define BONE_ID_LOCATION     3
 #define BONE_WEIGHT_LOCATION 4
 
-	const auto& positions = m_athlete->positions();
-	const auto& texCoords = m_athlete->texCoords();
-	const auto& normals = m_athlete->normals();
-	const auto& vertexBoneData = m_athlete->vertexBoneData();
-	const auto& indices = m_athlete->indices();
+	const auto& positions = mesh->positions();
+	const auto& texCoords = mesh->texCoords();
+	const auto& normals = mesh->normals();
+	const auto& vertexBoneData = mesh->vertexBoneData();
+	const auto& indices = mesh->indices();
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_athleteVBOs[POS_VB]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[POS_VB]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(positions[0]) * positions.size(), positions.constData(), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(POSITION_LOCATION);
 	glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_athleteVBOs[TEXCOORD_VB]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[TEXCOORD_VB]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords[0]) * texCoords.size(), texCoords.constData(), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(TEX_COORD_LOCATION);
 	glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_athleteVBOs[NORMAL_VB]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[NORMAL_VB]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), normals.constData(), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(NORMAL_LOCATION);
 	glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_athleteVBOs[BONE_VB]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[BONE_VB]);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexBoneData[0]) * vertexBoneData.size(), vertexBoneData.constData(), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(BONE_ID_LOCATION);
 	glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_INT, sizeof(VertexBoneData), (const GLvoid*)0);
 	glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
 	glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (const GLvoid*)16);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_athleteVBOs[INDEX_BUFFER]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOs[INDEX_BUFFER]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.constData(), GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
 
-	for (int i = 0; i < m_athlete->images().size(); i++) {
-		m_athleteTextures.push_back(new QOpenGLTexture(m_athlete->images()[i]));
+	const auto& imagePaths = mesh->imagePaths();
+	textures.assign(imagePaths.size(), nullptr);
+	for (uint i = 0; i < imagePaths.size(); i++) {
+		m_assetLoader->loadImage(textureId(athlete, i), QString::fromStdString(imagePaths[i]));
 	}
 
 	if (GLNoError()) {
-		cout << "Successfully loaded SkinnedMesh to GPU" << endl;
+		cout << "Successfully loaded " << (athlete ? "athlete" : "trainer") << " to GPU" << endl;
 	}
 	else {
-		cout << "Error loading SkinnedMesh to GPU" << endl;
+		cout << "Error loading " << (athlete ? "athlete" : "trainer") << " to GPU" << endl;
 		GLPrintError();
 	}
 }
-void MainWidget::drawAthlete()
+int MainWidget::textureId(bool athlete, uint index)
 {
-	glBindVertexArray(m_athleteVAO);
-
-	const auto& meshEntries = m_athlete->meshEntries();
-	for (uint i = 0; i < meshEntries.size(); i++) {
-		const uint materialIndex = meshEntries[i].materialIndex;
-		assert(materialIndex < m_athleteTextures.size());
-		m_athleteTextures[materialIndex]->bind();
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES									,
-			meshEntries[i].numIndices						,
-			GL_UNSIGNED_INT									,
-			(void*)(sizeof(uint) * meshEntries[i].baseIndex),
-			meshEntries[i].baseVertex
-		);
-	}
-
-	glBindVertexArray(0);
+	return 2 * index + (athlete ? 0 : 1);
 }
-void MainWidget::loadTrainer()
+// Runs on the GUI thread once an image of loadCharacter is decoded
+void MainWidget::uploadTexture(int id, const QImage& image)
 {
-	unloadTrainer();
-
-	glGenVertexArrays(1, &m_trainerVAO);
-	cout << "skinnedMeshVAO=" << m_trainerVAO << endl;
-	glBindVertexArray(m_trainerVAO);
-
-	glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_trainerVBOs), m_trainerVBOs);
-	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(m_trainerVBOs); i++) {
-		cout << "skinnedMeshVBO=" << m_trainerVBOs[i] << endl;
+	bool athlete = (id % 2 == 0);
+	uint index = id / 2;
+	vector<QOpenGLTexture*>& textures = athlete ? m_athleteTextures : m_trainerTextures;
+	if (index >= textures.size() || textures[index] || image.isNull()) {
+		return;
 	}
 
-#define POSITION_LOCATION    0
-#define TEX_COORD_LOCATION   1
-#define NORMAL_LOCATION      2
-#define BONE_ID_LOCATION     3
-#define BONE_WEIGHT_LOCATION 4
-
-	const auto& positions = m_trainer->positions();
-	const auto& texCoords = m_trainer->texCoords();
-	const auto& normals = m_trainer->normals();
-	const auto& vertexBoneData = m_trainer->vertexBoneData();
-	const auto& indices = m_trainer->indices();
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_trainerVBOs[POS_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions[0]) * positions.size(), positions.constData(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(POSITION_LOCATION);
-	glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_trainerVBOs[TEXCOORD_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords[0]) * texCoords.size(), texCoords.constData(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(TEX_COORD_LOCATION);
-	glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_trainerVBOs[NORMAL_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), normals.constData(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(NORMAL_LOCATION);
-	glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_trainerVBOs[BONE_VB]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexBoneData[0]) * vertexBoneData.size(), vertexBoneData.constData(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(BONE_ID_LOCATION);
-	glVertexAttribIPointer(BONE_ID_LOCATION, 4, GL_INT, sizeof(VertexBoneData), (const GLvoid*)0);
-	glEnableVertexAttribArray(BONE_WEIGHT_LOCATION);
-	glVertexAttribPointer(BONE_WEIGHT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData), (const GLvoid*)16);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_trainerVBOs[INDEX_BUFFER]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.constData(), GL_STATIC_DRAW);
-
-	glBindVertexArray(0);
+	makeCurrent();
 
-	for (int i = 0; i < m_trainer->images().size(); i++) {
-		m_trainerTextures.push_back(new QOpenGLTexture(m_trainer->images()[i]));
-	}
-
-	if (GLNoError()) {
-		cout << "Successfully loaded trainer to GPU" << endl;
+	// the copy from the pixel buffer to the texture does not block the GUI thread
+	// storage is allocated before the pixel buffer is bound, so that it is not filled from the buffer
+	QOpenGLTexture* texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+	texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+	texture->setSize(image.width(), image.height());
+	texture->setMipLevels(texture->maximumMipLevels());
+	texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+	const int size = image.byteCount();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_texturePBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (pixels) {
+		memcpy(pixels, image.constBits(), size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		texture->setData(0, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, (const void*)0); // offset in the pixel buffer
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 	else {
-		cout << "Error loading trainer to GPU" << endl;
-		GLPrintError();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		texture->setData(0, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, image.constBits());
 	}
+	texture->generateMipMaps();
+	textures[index] = texture;
+	cout << (athlete ? "Athlete" : "Trainer") << " texture " << index << " uploaded" << endl;
+
+	doneCurrent();
+	update();
 }
-void MainWidget::unloadTrainer()
+// Same as uploadTexture for a compressed mip chain, every level is copied as is
+void MainWidget::uploadCompressedTexture(int id, const CompressedTexture& compressed)
 {
-	for (uint i = 0; i < m_trainerTextures.size(); i++) {
-		SAFE_DELETE(m_trainerTextures[i]);
+	bool athlete = (id % 2 == 0);
+	uint index = id / 2;
+	vector<QOpenGLTexture*>& textures = athlete ? m_athleteTextures : m_trainerTextures;
+	if (index >= textures.size() || textures[index] || compressed.isNull()) {
+		return;
 	}
 
-	if (m_trainerVBOs[0] != 0) {
-		glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_trainerVBOs), m_trainerVBOs);
-	}
+	makeCurrent();
 
-	if (m_trainerVAO != 0) {
-		glDeleteVertexArrays(1, &m_trainerVAO);
-		m_trainerVAO = 0;
+	QOpenGLTexture* texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+	texture->setFormat(compressed.format == CompressedTexture::BC1 ? QOpenGLTexture::RGB_DXT1 : QOpenGLTexture::RGBA_DXT5);
+	texture->setSize(compressed.width, compressed.height);
+	texture->setMipLevels(compressed.levels());
+	texture->allocateStorage();
+	texture->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear, QOpenGLTexture::Linear);
+	const int size = compressed.data.size();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_texturePBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* blocks = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (blocks) {
+		memcpy(blocks, compressed.data.constData(), size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		for (int level = 0; level < compressed.levels(); level++) {
+			texture->setCompressedData(level, compressed.levelSizes[level], BUFFER_OFFSET(compressed.levelOffsets[level]));
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
+	else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		for (int level = 0; level < compressed.levels(); level++) {
+			texture->setCompressedData(level, compressed.levelSizes[level], compressed.data.constData() + compressed.levelOffsets[level]);
+		}
+	}
+	textures[index] = texture;
+	cout << (athlete ? "Athlete" : "Trainer") << " texture " << index << " uploaded compressed, " << compressed.levels() << " levels" << endl;
+
+	doneCurrent();
+	update();
 }
-void MainWidget::drawTrainer()
+void MainWidget::drawCharacter(bool athlete)
 {
-	glBindVertexArray(m_trainerVAO);
+	const vector<QOpenGLTexture*>& textures = athlete ? m_athleteTextures : m_trainerTextures;
+	glBindVertexArray(athlete ? m_athleteVAO : m_trainerVAO);
 
-	const auto& meshEntries = m_trainer->meshEntries();
+	const auto& meshEntries = (athlete ? m_athlete : m_trainer)->meshEntries();
 	for (uint i = 0; i < meshEntries.size(); i++) {
 		const uint materialIndex = meshEntries[i].materialIndex;
-		assert(materialIndex < m_trainerTextures.size());
-		m_trainerTextures[materialIndex]->bind();
+		assert(materialIndex < textures.size());
+		if (textures[materialIndex]) textures[materialIndex]->bind();
+		else glBindTexture(GL_TEXTURE_2D, 0);
 		glDrawElementsBaseVertex(
 			GL_TRIANGLES,
 			meshEntries[i].numIndices,
@@ -1480,6 +1606,31 @@ void MainWidget::drawAxes()
 
 	glBindVertexArray(0);
 }
+void MainWidget::loadJoints()
+{
+	glGenBuffers(1, &m_jointsVBO);
+	cout << "jointsVBO=" << m_jointsVBO << endl;
+	glBindBuffer(GL_ARRAY_BUFFER, m_jointsVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(m_joints), NULL, GL_STREAM_DRAW);
+}
+void MainWidget::updateJoints(const array<KJoint, JointType_Count>& joints, bool athlete)
+{
+	for (uint i = 0; i < JointType_Count; i++) {
+		JointInstance& instance = m_joints[i];
+		instance.position[0] = joints[i].position.x();
+		instance.position[1] = joints[i].position.y();
+		instance.position[2] = joints[i].position.z();
+		instance.color[0] = (athlete ? 1.f : 0.f);
+		instance.color[1] = (!athlete ? 1.f : 0.f);
+		instance.color[2] = 0.f;
+		instance.trackingState = (GLfloat)joints[i].trackingState;
+	}
+
+	// orphan the storage so the upload does not wait for the previous skeleton's draws
+	glBindBuffer(GL_ARRAY_BUFFER, m_jointsVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(m_joints), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(m_joints), m_joints.data());
+}
 void MainWidget::loadSkeleton()
 {
 	GLushort indices[] =
@@ -1517,40 +1668,74 @@ void MainWidget::loadSkeleton()
 	glBindVertexArray(m_skeletonVAO);
 	cout << "kinectSkeletonJointsVAO=" << m_skeletonVAO << endl;
 
-	GLuint kinectSkeletonJointsIBO;
-	glGenBuffers(1, &kinectSkeletonJointsIBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, kinectSkeletonJointsIBO);
-	cout << "kinectSkeletonJointsIBO=" << kinectSkeletonJointsIBO << endl;
+	glGenBuffers(1, &m_skeletonIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_skeletonIBO);
+	cout << "kinectSkeletonJointsIBO=" << m_skeletonIBO << endl;
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), &indices[0], GL_STATIC_DRAW);
 
-	glGenBuffers(1, &m_skeletonVBO);
-	cout << "kinectSkeletonJointsVBO=" << m_skeletonVBO << endl;
-	glBindBuffer(GL_ARRAY_BUFFER, m_skeletonVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * 3 * JointType_Count, NULL, GL_STREAM_DRAW);
+	// the joints are the line vertices
+	glBindBuffer(GL_ARRAY_BUFFER, m_jointsVBO);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6, 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(JointInstance), BUFFER_OFFSET(offsetof(JointInstance, position)));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6, BUFFER_OFFSET(sizeof(GLfloat) * 3));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(JointInstance), BUFFER_OFFSET(offsetof(JointInstance, color)));
 
 	glBindVertexArray(0);
 }
-void MainWidget::drawSkeleton(const array<KJoint, JointType_Count>& joints, bool athlete)
+// Draws the joints of the last updateJoints call
+void MainWidget::drawSkeleton()
 {
-	for (uint i = 0; i < JointType_Count; i++) {
-		m_skeleton[6 * i    ] = joints[i].position.x();
-		m_skeleton[6 * i + 1] = joints[i].position.y();
-		m_skeleton[6 * i + 2] = joints[i].position.z();
-		m_skeleton[6 * i + 3] = (athlete ? 255.f : 0.f);
-		m_skeleton[6 * i + 4] = (!athlete ? 255.f : 0.f);
-		m_skeleton[6 * i + 5] = 0.f;
+	glBindVertexArray(m_skeletonVAO);
+
+	glDrawElements(GL_LINES, 48, GL_UNSIGNED_SHORT, 0);
+
+	glBindVertexArray(0);
+}
+// The ghost shaders fetch the joints themselves, so only the skeleton indices are bound
+void MainWidget::loadGhosts()
+{
+	glGenVertexArrays(1, &m_ghostVAO);
+	glBindVertexArray(m_ghostVAO);
+	cout << "ghostVAO=" << m_ghostVAO << endl;
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_skeletonIBO);
+
+	glBindVertexArray(0);
+}
+void MainWidget::drawGhosts(uint slot, const MotionView& motion, quint64 motionId, const array<uint, NUM_PHASES>& phases, const QVector3D& color)
+{
+	if (motion.size() < 2) {
+		return;
+	}
+	int currentFrame = min((int)m_activeFrameIndex, motion.size() - 1);
+	int frameStep = m_ghostStep;
+	int firstFrame = 0;
+	if (m_ghostMode == GhostMode::TRAIL) {
+		firstFrame = currentFrame - min((int)m_ghostCount, currentFrame / frameStep) * frameStep;
+	}
+	else {
+		for (uint i = 0; i < NUM_PHASES; i++) {
+			if ((int)phases[i] <= currentFrame && (int)phases[i] > firstFrame) firstFrame = phases[i];
+		}
 	}
+	int ghostCount = (currentFrame - firstFrame) / frameStep;
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_skeletonVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(m_skeleton), m_skeleton);
+	m_ghostTechnique->setMotion(slot, motion, motionId);
+	m_ghostTechnique->bindMotion(slot);
+	m_ghostTechnique->setFrames(firstFrame, frameStep, currentFrame);
+	m_ghostTechnique->setColor(color);
 
-	glBindVertexArray(m_skeletonVAO);
+	glBindVertexArray(m_ghostVAO);
 
-	glDrawElements(GL_LINES, 48, GL_UNSIGNED_SHORT, 0);
+	// skeleton poses
+	if (ghostCount > 0) {
+		glDrawElementsInstanced(GL_LINES, 48, GL_UNSIGNED_SHORT, 0, ghostCount);
+	}
+
+	// barbell trajectory
+	m_ghostTechnique->setTrajectory(true);
+	glDrawArrays(GL_LINE_STRIP, firstFrame, currentFrame - firstFrame + 1);
+	m_ghostTechnique->setTrajectory(false);
 
 	glBindVertexArray(0);
 }
@@ -1603,15 +1788,7 @@ void MainWidget::loadCube(float r)
 		   +r,  -r,  -r, // 4
 		   +r,  +r,  -r, // 5
 		   -r,  +r,  -r, // 6
-		   -r,  -r,  -r, // 7
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f,
-		  0.f, 0.f, 0.f
+		   -r,  -r,  -r  // 7
 	};
 
 	GLushort indices[] =
@@ -1640,29 +1817,27 @@ void MainWidget::loadCube(float r)
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3, 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3, BUFFER_OFFSET(sizeof(vertices) / 2));
+
+	// one cube per joint
+	glBindBuffer(GL_ARRAY_BUFFER, m_jointsVBO);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(JointInstance), BUFFER_OFFSET(offsetof(JointInstance, position)));
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(JointInstance), BUFFER_OFFSET(offsetof(JointInstance, color)));
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(JointInstance), BUFFER_OFFSET(offsetof(JointInstance, trackingState)));
+	glVertexAttribDivisor(4, 1);
 
 	glBindVertexArray(0);
 }
-void MainWidget::drawCube(const KJoint& joint, bool athlete)
+// Draws the joints of the last updateJoints call
+void MainWidget::drawCubes()
 {
-	QVector3D color(0.f, 0.f, 0.f);
-	if (joint.trackingState == TrackingState_Inferred) color.setZ(255.f);
-	if (athlete) color.setX(255.f);
-	else color.setY(255.f);
-
-	for (uint j = 0; j < 8; j++) {
-		m_cubeColors[3 * j + 0] = color.x();
-		m_cubeColors[3 * j + 1] = color.y();
-		m_cubeColors[3 * j + 2] = color.z();
-	}
-
 	glBindVertexArray(m_cubeVAO);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_cubeVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, sizeof(m_cubeColors), sizeof(m_cubeColors), m_cubeColors);
-	glDrawElements(GL_TRIANGLE_STRIP, JointType_Count, GL_UNSIGNED_SHORT, 0);
+	glDrawElementsInstanced(GL_TRIANGLE_STRIP, 24, GL_UNSIGNED_SHORT, 0, JointType_Count);
 
 	glBindVertexArray(0);
 }
@@ -1726,756 +1901,20 @@ void MainWidget::drawPlane()
 
 	glBindVertexArray(0);
 }
-void MainWidget::loadBarbell()
-{
-	cout << "Loading barbell model" << endl;
-
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(
-		"models/barbell blendered.obj",
-		aiProcess_Triangulate
-	);
-
-	if (!scene) {
-		cout << "Could not import the barbell model." << endl;
-		return;
-	}
-
-	// Count vertices and indices and update mesh entries
-	uint numVertices = 0;
-	uint numIndices = 0;
-	m_barbellMeshEntries.resize(scene->mNumMeshes);
-	m_barbellMaterials.resize(scene->mNumMaterials);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		m_barbellMeshEntries[i].materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		m_barbellMeshEntries[i].numIndices = scene->mMeshes[i]->mNumFaces * 3;
-		m_barbellMeshEntries[i].baseVertex = numVertices;
-		m_barbellMeshEntries[i].baseIndex = numIndices;
-		numVertices += scene->mMeshes[i]->mNumVertices;
-		numIndices += scene->mMeshes[i]->mNumFaces * 3;
-		m_barbellMeshEntries[i].print();
-	}
-	cout << "Totals: NumVertices:" << numVertices << " NumIndices:" << numIndices << endl;
-
-	// Reserve appropriate container space and push back vertex attributes
-	QVector<QVector3D> positions;
-	QVector<QVector2D> texCoords;
-	QVector<QVector3D> normals;
-	QVector<uint> indices;
-	positions.reserve(numVertices);
-	texCoords.reserve(numVertices);
-	normals.reserve(numVertices);
-	indices.reserve(numIndices);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// Push back vertices
-		bool hasPositions = true;
-		bool hasTexCoords = true;
-		bool hasNormals = true;
-		if (!scene->mMeshes[i]->HasPositions()) {
-			cout << "Mesh " << i << " has no positions!" << endl;
-			hasPositions = false;
-		}
-		if (!scene->mMeshes[i]->HasTextureCoords(0)) {
-			cout << "Mesh " << i << " has no tex coords!" << endl;
-			hasTexCoords = false;
-		}
-		if (!scene->mMeshes[i]->HasNormals()) {
-			cout << "Mesh " << i << " has no normals!" << endl;
-			hasNormals = false;
-		}
-		for (uint j = 0; j < scene->mMeshes[i]->mNumVertices; j++) {
-			const aiVector3D* position = &(scene->mMeshes[i]->mVertices[j]);
-			const aiVector3D* texCoord = &(scene->mMeshes[i]->mTextureCoords[0][j]);
-			const aiVector3D* normal = &(scene->mMeshes[i]->mNormals[j]);
-			if (hasPositions) positions.push_back(QVector3D(position->x, position->y, position->z));
-			else positions.push_back(QVector3D(0.f, 0.f, 0.f));
-			if (hasTexCoords) texCoords.push_back(QVector2D(texCoord->x, texCoord->y));
-			else texCoords.push_back(QVector2D(0.f, 0.f));
-			if (hasNormals) normals.push_back(QVector3D(normal->x, normal->y, normal->z));
-			else normals.push_back(QVector3D(0.f, 1.f, 0.f));
-		}
-
-		// Push back indices
-		for (uint j = 0; j < scene->mMeshes[i]->mNumFaces; j++) {
-			const aiFace& face = scene->mMeshes[i]->mFaces[j];
-			assert(face.mNumIndices == 3);
-			indices.push_back(face.mIndices[0]);
-			indices.push_back(face.mIndices[1]);
-			indices.push_back(face.mIndices[2]);
-		}
-	}
-	cout << endl;
-
-	traverseSceneNodes(scene->mRootNode);
-
-	cout << "Vector lengths:";
-	cout << positions.length() << " ";
-	cout << texCoords.length() << " ";
-	cout << normals.length() << " ";
-	cout << indices.length() << endl;
-
-	cout << "Scene info:";
-	cout << " Meshes:" << setw(3) << scene->mNumMeshes;
-	cout << " Materials:" << setw(3) << scene->mNumMaterials;
-	cout << " Textures:" << setw(3) << scene->mNumTextures;
-	cout << " Lights:" << setw(3) << scene->mNumLights;
-	cout << " Animations:" << setw(3) << scene->mNumAnimations;
-	cout << endl;
-
-	cout << "Meshes:" << endl;
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		cout << "Id:" << i;
-		cout << " Name:" << setw(20) << scene->mMeshes[i]->mName.C_Str();
-		cout << " Vertices:" << setw(6) << scene->mMeshes[i]->mNumVertices;
-		cout << " Faces:" << setw(6) << scene->mMeshes[i]->mNumFaces;
-		cout << " Bones:" << setw(6) << scene->mMeshes[i]->mNumBones;
-		cout << " MaterialId:" << setw(6) << scene->mMeshes[i]->mMaterialIndex;
-		cout << endl;
-	}
-	cout << endl;
-
-	// Materials
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// General properties
-		const uint materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		const aiMaterial* material = scene->mMaterials[materialIndex];
-		aiString name;
-		int shadingMethod;
-		int blendFunction;
-		int twoSided;
-		float opacity;
-		float shininess;
-		float shininessStrength;
-		material->Get(AI_MATKEY_NAME, name);
-		material->Get(AI_MATKEY_SHADING_MODEL, shadingMethod);
-		material->Get(AI_MATKEY_BLEND_FUNC, blendFunction);
-		material->Get(AI_MATKEY_TWOSIDED, twoSided);
-		material->Get(AI_MATKEY_OPACITY, opacity);
-		material->Get(AI_MATKEY_SHININESS, shininess);
-		material->Get(AI_MATKEY_SHININESS_STRENGTH, shininessStrength);
-		cout << "Material:" << i;
-		cout << " Name:" << string(name.data);
-		cout << " ShadingMethod:" << hex << shadingMethod << dec;
-		cout << " BlendFunction:" << hex << blendFunction << dec;
-		cout << " TwoSided:" << twoSided;
-		cout << " Opacity:" << opacity;
-		cout << " Shininess:" << shininess;
-		cout << " ShininessStrength:" << shininessStrength;
-		cout << endl;
-
-		// Colors
-		aiColor3D diffuseColor;
-		aiColor3D specularColor;
-		aiColor3D ambientColor;
-		aiColor3D reflectiveColor;
-		aiColor3D emissiveColor;
-		aiColor3D transparentColor;
-		material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
-		material->Get(AI_MATKEY_COLOR_SPECULAR, specularColor);
-		material->Get(AI_MATKEY_COLOR_AMBIENT, ambientColor);
-		material->Get(AI_MATKEY_COLOR_REFLECTIVE, reflectiveColor);
-		material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
-		material->Get(AI_MATKEY_COLOR_TRANSPARENT, transparentColor);
-		cout << "Colors:";
-		cout << " Diffuse:" << diffuseColor.r << " " << diffuseColor.g << " " << diffuseColor.b;
-		cout << " Specular:" << specularColor.r << " " << specularColor.g << " " << specularColor.b;
-		cout << " Ambient:" << ambientColor.r << " " << ambientColor.g << " " << ambientColor.b;
-		cout << " Reflective:" << reflectiveColor.r << " " << reflectiveColor.g << " " << reflectiveColor.b;
-		cout << " Emissive:" << emissiveColor.r << " " << emissiveColor.g << " " << emissiveColor.b;
-		cout << " Transparent:" << transparentColor.r << " " << transparentColor.g << " " << transparentColor.b;
-		cout << endl;
-		// Texture types
-		cout << "Texture type-count:";
-		cout << " Diffuse" << "-" << material->GetTextureCount(aiTextureType_DIFFUSE);
-		cout << " Specular" << "-" << material->GetTextureCount(aiTextureType_SPECULAR);
-		cout << " Ambient" << "-" << material->GetTextureCount(aiTextureType_AMBIENT);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << " Emissive" << "-" << material->GetTextureCount(aiTextureType_EMISSIVE);
-		cout << " Opacity" << "-" << material->GetTextureCount(aiTextureType_OPACITY);
-		cout << " Shininess" << "-" << material->GetTextureCount(aiTextureType_SHININESS);
-		cout << " Normals" << "-" << material->GetTextureCount(aiTextureType_NORMALS);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << endl;
-
-		m_barbellMaterials[materialIndex] = Material(
-			QVector3D(diffuseColor.r, diffuseColor.g, diffuseColor.b),
-			QVector3D(specularColor.r, specularColor.g, specularColor.b),
-			QVector3D(ambientColor.r, ambientColor.g, ambientColor.b)
-		);
-	}
-
-	glGenVertexArrays(1, &m_barbellVAO);
-	glBindVertexArray(m_barbellVAO);
-	cout << "barbellVAO=" << m_barbellVAO << endl;
-
-	GLuint barbellIBO;
-	glGenBuffers(1, &barbellIBO);
-	cout << "barbellIBO=" << barbellIBO << endl;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, barbellIBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0])*indices.size(), indices.constData(), GL_STATIC_DRAW);
-
-	GLsizeiptr sizeInBytes = 
-		sizeof(positions[0])*positions.size() + 
-		sizeof(texCoords[0])*texCoords.size() + 
-		sizeof(normals[0])*normals.size();
-	cout << "Total size in bytes:" << sizeInBytes << endl;
-	GLuint barbellVBO;
-	glGenBuffers(1, &barbellVBO);
-	cout << "barbellVBO=" << barbellVBO << endl;
-	glBindBuffer(GL_ARRAY_BUFFER, barbellVBO);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		sizeInBytes,
-		NULL,
-		GL_STATIC_DRAW
-	);
-	
-	GLsizeiptr offset = 0;
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(positions[0]) * positions.size(), positions.constData());
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(0);
-
-	offset += sizeof(positions[0]) * positions.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(texCoords[0]) * texCoords.size(), texCoords.constData());
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(1);
-
-	offset += sizeof(texCoords[0]) * texCoords.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(normals[0]) * normals.size(), normals.constData());
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(2);
-
-	glBindVertexArray(0);
-}
-void MainWidget::drawBarbell()
-{
-	glBindVertexArray(m_barbellVAO);
-
-	for (uint i = 0; i < m_barbellMeshEntries.size(); i++) {
-		const uint materialIndex = m_barbellMeshEntries[i].materialIndex;
-		m_lighting->setUniformValue(m_diffuseLocation, 4*m_barbellMaterials[materialIndex].diffuseColor);
-		m_lighting->setUniformValue(m_specularLocation, 1*m_barbellMaterials[materialIndex].specularColor);
-		m_lighting->setUniformValue(m_ambientLocation, 0.1*m_barbellMaterials[materialIndex].ambientColor);
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			m_barbellMeshEntries[i].numIndices,
-			GL_UNSIGNED_INT,
-			(void*)(sizeof(uint) * m_barbellMeshEntries[i].baseIndex),
-			m_barbellMeshEntries[i].baseVertex
-		);
-	}
-
-	glBindVertexArray(0);
-}
-void MainWidget::loadBar()
+void MainWidget::drawProp(MeshHandle handle, bool materials)
 {
-	cout << "Loading bar model" << endl;
-
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(
-		"models/barbell empty blendered.obj",
-		aiProcess_Triangulate
-	);
-
-	if (!scene) {
-		cout << "Could not import the bar model." << endl;
+	if (handle == INVALID_MESH_HANDLE) {
 		return;
 	}
-
-	// Count vertices and indices and update mesh entries
-	uint numVertices = 0;
-	uint numIndices = 0;
-	m_barMeshEntries.resize(scene->mNumMeshes);
-	m_barMaterials.resize(scene->mNumMaterials);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		m_barMeshEntries[i].materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		m_barMeshEntries[i].numIndices = scene->mMeshes[i]->mNumFaces * 3;
-		m_barMeshEntries[i].baseVertex = numVertices;
-		m_barMeshEntries[i].baseIndex = numIndices;
-		numVertices += scene->mMeshes[i]->mNumVertices;
-		numIndices += scene->mMeshes[i]->mNumFaces * 3;
-		m_barMeshEntries[i].print();
-	}
-	cout << "Totals: NumVertices:" << numVertices << " NumIndices:" << numIndices << endl;
-
-	// Reserve appropriate container space and push back vertex attributes
-	QVector<QVector3D> positions;
-	QVector<QVector2D> texCoords;
-	QVector<QVector3D> normals;
-	QVector<uint> indices;
-	positions.reserve(numVertices);
-	texCoords.reserve(numVertices);
-	normals.reserve(numVertices);
-	indices.reserve(numIndices);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// Push back vertices
-		bool hasPositions = true;
-		bool hasTexCoords = true;
-		bool hasNormals = true;
-		if (!scene->mMeshes[i]->HasPositions()) {
-			cout << "Mesh " << i << " has no positions!" << endl;
-			hasPositions = false;
-		}
-		if (!scene->mMeshes[i]->HasTextureCoords(0)) {
-			cout << "Mesh " << i << " has no tex coords!" << endl;
-			hasTexCoords = false;
-		}
-		if (!scene->mMeshes[i]->HasNormals()) {
-			cout << "Mesh " << i << " has no normals!" << endl;
-			hasNormals = false;
-		}
-		for (uint j = 0; j < scene->mMeshes[i]->mNumVertices; j++) {
-			const aiVector3D* position = &(scene->mMeshes[i]->mVertices[j]);
-			const aiVector3D* texCoord = &(scene->mMeshes[i]->mTextureCoords[0][j]);
-			const aiVector3D* normal = &(scene->mMeshes[i]->mNormals[j]);
-			if (hasPositions) positions.push_back(QVector3D(position->x, position->y, position->z));
-			else positions.push_back(QVector3D(0.f, 0.f, 0.f));
-			if (hasTexCoords) texCoords.push_back(QVector2D(texCoord->x, texCoord->y));
-			else texCoords.push_back(QVector2D(0.f, 0.f));
-			if (hasNormals) normals.push_back(QVector3D(normal->x, normal->y, normal->z));
-			else normals.push_back(QVector3D(0.f, 1.f, 0.f));
-		}
-
-		// Push back indices
-		for (uint j = 0; j < scene->mMeshes[i]->mNumFaces; j++) {
-			const aiFace& face = scene->mMeshes[i]->mFaces[j];
-			assert(face.mNumIndices == 3);
-			indices.push_back(face.mIndices[0]);
-			indices.push_back(face.mIndices[1]);
-			indices.push_back(face.mIndices[2]);
-		}
-	}
-	cout << endl;
-
-	traverseSceneNodes(scene->mRootNode);
-
-	cout << "Vector lengths:";
-	cout << positions.length() << " ";
-	cout << texCoords.length() << " ";
-	cout << normals.length() << " ";
-	cout << indices.length() << endl;
-
-	cout << "Scene info:";
-	cout << " Meshes:" << setw(3) << scene->mNumMeshes;
-	cout << " Materials:" << setw(3) << scene->mNumMaterials;
-	cout << " Textures:" << setw(3) << scene->mNumTextures;
-	cout << " Lights:" << setw(3) << scene->mNumLights;
-	cout << " Animations:" << setw(3) << scene->mNumAnimations;
-	cout << endl;
-
-	cout << "Meshes:" << endl;
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		cout << "Id:" << i;
-		cout << " Name:" << setw(20) << scene->mMeshes[i]->mName.C_Str();
-		cout << " Vertices:" << setw(6) << scene->mMeshes[i]->mNumVertices;
-		cout << " Faces:" << setw(6) << scene->mMeshes[i]->mNumFaces;
-		cout << " Bones:" << setw(6) << scene->mMeshes[i]->mNumBones;
-		cout << " MaterialId:" << setw(6) << scene->mMeshes[i]->mMaterialIndex;
-		cout << endl;
-	}
-	cout << endl;
-
-	// Materials
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// General properties
-		const uint materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		const aiMaterial* material = scene->mMaterials[materialIndex];
-		aiString name;
-		int shadingMethod;
-		int blendFunction;
-		int twoSided;
-		float opacity;
-		float shininess;
-		float shininessStrength;
-		material->Get(AI_MATKEY_NAME, name);
-		material->Get(AI_MATKEY_SHADING_MODEL, shadingMethod);
-		material->Get(AI_MATKEY_BLEND_FUNC, blendFunction);
-		material->Get(AI_MATKEY_TWOSIDED, twoSided);
-		material->Get(AI_MATKEY_OPACITY, opacity);
-		material->Get(AI_MATKEY_SHININESS, shininess);
-		material->Get(AI_MATKEY_SHININESS_STRENGTH, shininessStrength);
-		cout << "Material:" << i;
-		cout << " Name:" << string(name.data);
-		cout << " ShadingMethod:" << hex << shadingMethod << dec;
-		cout << " BlendFunction:" << hex << blendFunction << dec;
-		cout << " TwoSided:" << twoSided;
-		cout << " Opacity:" << opacity;
-		cout << " Shininess:" << shininess;
-		cout << " ShininessStrength:" << shininessStrength;
-		cout << endl;
-
-		// Colors
-		aiColor3D diffuseColor;
-		aiColor3D specularColor;
-		aiColor3D ambientColor;
-		aiColor3D reflectiveColor;
-		aiColor3D emissiveColor;
-		aiColor3D transparentColor;
-		material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
-		material->Get(AI_MATKEY_COLOR_SPECULAR, specularColor);
-		material->Get(AI_MATKEY_COLOR_AMBIENT, ambientColor);
-		material->Get(AI_MATKEY_COLOR_REFLECTIVE, reflectiveColor);
-		material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
-		material->Get(AI_MATKEY_COLOR_TRANSPARENT, transparentColor);
-		cout << "Colors:";
-		cout << " Diffuse:" << diffuseColor.r << " " << diffuseColor.g << " " << diffuseColor.b;
-		cout << " Specular:" << specularColor.r << " " << specularColor.g << " " << specularColor.b;
-		cout << " Ambient:" << ambientColor.r << " " << ambientColor.g << " " << ambientColor.b;
-		cout << " Reflective:" << reflectiveColor.r << " " << reflectiveColor.g << " " << reflectiveColor.b;
-		cout << " Emissive:" << emissiveColor.r << " " << emissiveColor.g << " " << emissiveColor.b;
-		cout << " Transparent:" << transparentColor.r << " " << transparentColor.g << " " << transparentColor.b;
-		cout << endl;
-		// Texture types
-		cout << "Texture type-count:";
-		cout << " Diffuse" << "-" << material->GetTextureCount(aiTextureType_DIFFUSE);
-		cout << " Specular" << "-" << material->GetTextureCount(aiTextureType_SPECULAR);
-		cout << " Ambient" << "-" << material->GetTextureCount(aiTextureType_AMBIENT);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << " Emissive" << "-" << material->GetTextureCount(aiTextureType_EMISSIVE);
-		cout << " Opacity" << "-" << material->GetTextureCount(aiTextureType_OPACITY);
-		cout << " Shininess" << "-" << material->GetTextureCount(aiTextureType_SHININESS);
-		cout << " Normals" << "-" << material->GetTextureCount(aiTextureType_NORMALS);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << endl;
-
-		m_barMaterials[materialIndex] = Material(
-			QVector3D(diffuseColor.r, diffuseColor.g, diffuseColor.b),
-			QVector3D(specularColor.r, specularColor.g, specularColor.b),
-			QVector3D(ambientColor.r, ambientColor.g, ambientColor.b)
-		);
-	}
-
-	glGenVertexArrays(1, &m_barVAO);
-	glBindVertexArray(m_barVAO);
-	cout << "barVAO=" << m_barVAO << endl;
-
-	GLuint barIBO;
-	glGenBuffers(1, &barIBO);
-	cout << "barIBO=" << barIBO << endl;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, barIBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0])*indices.size(), indices.constData(), GL_STATIC_DRAW);
-
-	GLsizeiptr sizeInBytes =
-		sizeof(positions[0])*positions.size() +
-		sizeof(texCoords[0])*texCoords.size() +
-		sizeof(normals[0])*normals.size();
-	cout << "Total size in bytes:" << sizeInBytes << endl;
-	GLuint barVBO;
-	glGenBuffers(1, &barVBO);
-	cout << "barVBO=" << barVBO << endl;
-	glBindBuffer(GL_ARRAY_BUFFER, barVBO);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		sizeInBytes,
-		NULL,
-		GL_STATIC_DRAW
-	);
-
-	GLsizeiptr offset = 0;
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(positions[0]) * positions.size(), positions.constData());
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(0);
-
-	offset += sizeof(positions[0]) * positions.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(texCoords[0]) * texCoords.size(), texCoords.constData());
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(1);
-
-	offset += sizeof(texCoords[0]) * texCoords.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(normals[0]) * normals.size(), normals.constData());
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(2);
-
-	glBindVertexArray(0);
-}
-void MainWidget::drawBar()
-{
-	glBindVertexArray(m_barVAO);
-
-	for (uint i = 0; i < m_barMeshEntries.size(); i++) {
-		const uint materialIndex = m_barMeshEntries[i].materialIndex;
-		m_lighting->setUniformValue(m_diffuseLocation, 4 * m_barMaterials[materialIndex].diffuseColor);
-		m_lighting->setUniformValue(m_specularLocation, 1 * m_barMaterials[materialIndex].specularColor);
-		m_lighting->setUniformValue(m_ambientLocation, 0.1*m_barMaterials[materialIndex].ambientColor);
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			m_barMeshEntries[i].numIndices,
-			GL_UNSIGNED_INT,
-			(void*)(sizeof(uint) * m_barMeshEntries[i].baseIndex),
-			m_barMeshEntries[i].baseVertex
-		);
-	}
-
-	glBindVertexArray(0);
-}
-void MainWidget::loadPointer()
-{
-	cout << "Loading pointer model" << endl;
-
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(
-		"models/arrow blendered.obj",
-		aiProcess_Triangulate
-	);
-
-	if (!scene) {
-		cout << "Could not import the pointer model." << endl;
-		return;
-	}
-
-	// Count vertices and indices and update mesh entries
-	uint numVertices = 0;
-	uint numIndices = 0;
-	m_pointerMeshEntries.resize(scene->mNumMeshes);
-	m_pointerMaterials.resize(scene->mNumMaterials);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		m_pointerMeshEntries[i].materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		m_pointerMeshEntries[i].numIndices = scene->mMeshes[i]->mNumFaces * 3;
-		m_pointerMeshEntries[i].baseVertex = numVertices;
-		m_pointerMeshEntries[i].baseIndex = numIndices;
-		numVertices += scene->mMeshes[i]->mNumVertices;
-		numIndices += scene->mMeshes[i]->mNumFaces * 3;
-		m_pointerMeshEntries[i].print();
-	}
-	cout << "Totals: NumVertices:" << numVertices << " NumIndices:" << numIndices << endl;
-
-	// Reserve appropriate container space and push back vertex attributes
-	QVector<QVector3D> positions;
-	QVector<QVector2D> texCoords;
-	QVector<QVector3D> normals;
-	QVector<uint> indices;
-	positions.reserve(numVertices);
-	texCoords.reserve(numVertices);
-	normals.reserve(numVertices);
-	indices.reserve(numIndices);
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// Push back vertices
-		bool hasPositions = true;
-		bool hasTexCoords = true;
-		bool hasNormals = true;
-		if (!scene->mMeshes[i]->HasPositions()) {
-			cout << "Mesh " << i << " has no positions!" << endl;
-			hasPositions = false;
-		}
-		if (!scene->mMeshes[i]->HasTextureCoords(0)) {
-			cout << "Mesh " << i << " has no tex coords!" << endl;
-			hasTexCoords = false;
-		}
-		if (!scene->mMeshes[i]->HasNormals()) {
-			cout << "Mesh " << i << " has no normals!" << endl;
-			hasNormals = false;
-		}
-		for (uint j = 0; j < scene->mMeshes[i]->mNumVertices; j++) {
-			const aiVector3D* position = &(scene->mMeshes[i]->mVertices[j]);
-			const aiVector3D* texCoord = &(scene->mMeshes[i]->mTextureCoords[0][j]);
-			const aiVector3D* normal = &(scene->mMeshes[i]->mNormals[j]);
-			if (hasPositions) positions.push_back(QVector3D(position->x, position->y, position->z));
-			else positions.push_back(QVector3D(0.f, 0.f, 0.f));
-			if (hasTexCoords) texCoords.push_back(QVector2D(texCoord->x, texCoord->y));
-			else texCoords.push_back(QVector2D(0.f, 0.f));
-			if (hasNormals) normals.push_back(QVector3D(normal->x, normal->y, normal->z));
-			else normals.push_back(QVector3D(0.f, 1.f, 0.f));
-		}
-
-		// Push back indices
-		for (uint j = 0; j < scene->mMeshes[i]->mNumFaces; j++) {
-			const aiFace& face = scene->mMeshes[i]->mFaces[j];
-			assert(face.mNumIndices == 3);
-			indices.push_back(face.mIndices[0]);
-			indices.push_back(face.mIndices[1]);
-			indices.push_back(face.mIndices[2]);
+	const QVector<MeshEntry>& meshEntries = m_meshRegistry.meshEntries(handle);
+	const QVector<Material>& meshMaterials = m_meshRegistry.materials(handle);
+	for (uint i = 0; i < meshEntries.size(); i++) {
+		if (materials) {
+			const Material& material = meshMaterials[meshEntries[i].materialIndex];
+			m_lighting->setUniformValue(m_diffuseLocation, 4 * material.diffuseColor);
+			m_lighting->setUniformValue(m_specularLocation, 1 * material.specularColor);
+			m_lighting->setUniformValue(m_ambientLocation, 0.1 * material.ambientColor);
 		}
-	}
-	cout << endl;
-
-	traverseSceneNodes(scene->mRootNode);
-
-	cout << "Vector lengths:";
-	cout << positions.length() << " ";
-	cout << texCoords.length() << " ";
-	cout << normals.length() << " ";
-	cout << indices.length() << endl;
-
-	cout << "Scene info:";
-	cout << " Meshes:" << setw(3) << scene->mNumMeshes;
-	cout << " Materials:" << setw(3) << scene->mNumMaterials;
-	cout << " Textures:" << setw(3) << scene->mNumTextures;
-	cout << " Lights:" << setw(3) << scene->mNumLights;
-	cout << " Animations:" << setw(3) << scene->mNumAnimations;
-	cout << endl;
-
-	cout << "Meshes:" << endl;
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		cout << "Id:" << i;
-		cout << " Name:" << setw(20) << scene->mMeshes[i]->mName.C_Str();
-		cout << " Vertices:" << setw(6) << scene->mMeshes[i]->mNumVertices;
-		cout << " Faces:" << setw(6) << scene->mMeshes[i]->mNumFaces;
-		cout << " Bones:" << setw(6) << scene->mMeshes[i]->mNumBones;
-		cout << " MaterialId:" << setw(6) << scene->mMeshes[i]->mMaterialIndex;
-		cout << endl;
-	}
-	cout << endl;
-
-	// Materials
-	for (uint i = 0; i < scene->mNumMeshes; i++) {
-		// General properties
-		const uint materialIndex = scene->mMeshes[i]->mMaterialIndex;
-		const aiMaterial* material = scene->mMaterials[materialIndex];
-		aiString name;
-		int shadingMethod;
-		int blendFunction;
-		int twoSided;
-		float opacity;
-		float shininess;
-		float shininessStrength;
-		material->Get(AI_MATKEY_NAME, name);
-		material->Get(AI_MATKEY_SHADING_MODEL, shadingMethod);
-		material->Get(AI_MATKEY_BLEND_FUNC, blendFunction);
-		material->Get(AI_MATKEY_TWOSIDED, twoSided);
-		material->Get(AI_MATKEY_OPACITY, opacity);
-		material->Get(AI_MATKEY_SHININESS, shininess);
-		material->Get(AI_MATKEY_SHININESS_STRENGTH, shininessStrength);
-		cout << "Material:" << i;
-		cout << " Name:" << string(name.data);
-		cout << " ShadingMethod:" << hex << shadingMethod << dec;
-		cout << " BlendFunction:" << hex << blendFunction << dec;
-		cout << " TwoSided:" << twoSided;
-		cout << " Opacity:" << opacity;
-		cout << " Shininess:" << shininess;
-		cout << " ShininessStrength:" << shininessStrength;
-		cout << endl;
-
-		// Colors
-		aiColor3D diffuseColor;
-		aiColor3D specularColor;
-		aiColor3D ambientColor;
-		aiColor3D reflectiveColor;
-		aiColor3D emissiveColor;
-		aiColor3D transparentColor;
-		material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
-		material->Get(AI_MATKEY_COLOR_SPECULAR, specularColor);
-		material->Get(AI_MATKEY_COLOR_AMBIENT, ambientColor);
-		material->Get(AI_MATKEY_COLOR_REFLECTIVE, reflectiveColor);
-		material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
-		material->Get(AI_MATKEY_COLOR_TRANSPARENT, transparentColor);
-		cout << "Colors:";
-		cout << " Diffuse:" << diffuseColor.r << " " << diffuseColor.g << " " << diffuseColor.b;
-		cout << " Specular:" << specularColor.r << " " << specularColor.g << " " << specularColor.b;
-		cout << " Ambient:" << ambientColor.r << " " << ambientColor.g << " " << ambientColor.b;
-		cout << " Reflective:" << reflectiveColor.r << " " << reflectiveColor.g << " " << reflectiveColor.b;
-		cout << " Emissive:" << emissiveColor.r << " " << emissiveColor.g << " " << emissiveColor.b;
-		cout << " Transparent:" << transparentColor.r << " " << transparentColor.g << " " << transparentColor.b;
-		cout << endl;
-		// Texture types
-		cout << "Texture type-count:";
-		cout << " Diffuse" << "-" << material->GetTextureCount(aiTextureType_DIFFUSE);
-		cout << " Specular" << "-" << material->GetTextureCount(aiTextureType_SPECULAR);
-		cout << " Ambient" << "-" << material->GetTextureCount(aiTextureType_AMBIENT);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << " Emissive" << "-" << material->GetTextureCount(aiTextureType_EMISSIVE);
-		cout << " Opacity" << "-" << material->GetTextureCount(aiTextureType_OPACITY);
-		cout << " Shininess" << "-" << material->GetTextureCount(aiTextureType_SHININESS);
-		cout << " Normals" << "-" << material->GetTextureCount(aiTextureType_NORMALS);
-		cout << " Reflective" << "-" << material->GetTextureCount(aiTextureType_REFLECTION);
-		cout << endl;
-
-		m_pointerMaterials[materialIndex] = Material(
-			QVector3D(diffuseColor.r, diffuseColor.g, diffuseColor.b),
-			QVector3D(specularColor.r, specularColor.g, specularColor.b),
-			QVector3D(ambientColor.r, ambientColor.g, ambientColor.b)
-		);
-	}
-
-	glGenVertexArrays(1, &m_pointerVAO);
-	glBindVertexArray(m_pointerVAO);
-	cout << "pointerVAO=" << m_pointerVAO << endl;
-
-	GLuint pointerIBO;
-	glGenBuffers(1, &pointerIBO);
-	cout << "pointerIBO=" << pointerIBO << endl;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pointerIBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0])*indices.size(), indices.constData(), GL_STATIC_DRAW);
-
-	GLsizeiptr sizeInBytes = 
-		sizeof(positions[0])*positions.size() + 
-		sizeof(texCoords[0])*texCoords.size() + 
-		sizeof(normals[0])*normals.size();
-	cout << "Total size in bytes:" << sizeInBytes << endl;
-	GLuint pointerVBO;
-	glGenBuffers(1, &pointerVBO);
-	cout << "pointerVBO=" << pointerVBO << endl;
-	glBindBuffer(GL_ARRAY_BUFFER, pointerVBO);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		sizeInBytes,
-		NULL,
-		GL_STATIC_DRAW
-	);
-
-	GLsizeiptr offset = 0;
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(positions[0]) * positions.size(), positions.constData());
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(0);
-
-	offset += sizeof(positions[0]) * positions.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(texCoords[0]) * texCoords.size(), texCoords.constData());
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(1);
-
-	offset += sizeof(texCoords[0]) * texCoords.size();
-	cout << "Offset size in bytes:" << offset << endl;
-
-	glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(normals[0]) * normals.size(), normals.constData());
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(offset));
-	glEnableVertexAttribArray(2);
-
-	glBindVertexArray(0);
-}
-void MainWidget::drawPointer()
-{
-	glBindVertexArray(m_pointerVAO);
-
-	for (uint i = 0; i < m_pointerMeshEntries.size(); i++) {
-		const uint materialIndex = m_pointerMeshEntries[i].materialIndex;
-		glDrawElementsBaseVertex(
-			GL_TRIANGLES,
-			m_pointerMeshEntries[i].numIndices,
-			GL_UNSIGNED_INT,
-			(void*)(sizeof(uint) * m_pointerMeshEntries[i].baseIndex),
-			m_pointerMeshEntries[i].baseVertex
-		);
-	}
-
-	glBindVertexArray(0);
-}
-void MainWidget::traverseSceneNodes(aiNode * node)
-{
-	cout << "NodeName=" << node->mName.data;
-	cout << " NumMeshes=" << node->mNumMeshes << endl;
-	cout << "Children=";
-	for (uint i = 0; i < node->mNumChildren; i++) {
-		cout << node->mChildren[i]->mName.data << " ";
-	}
-	cout << endl;
-	const QMatrix4x4& local = toQMatrix(node->mTransformation);
-	cout << toString(local).toStdString() << endl;
-	for (uint i = 0; i < node->mNumChildren; i++) {
-		traverseSceneNodes(node->mChildren[i]);
+		m_meshRegistry.draw(handle, i);
 	}
 }
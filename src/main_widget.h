@@ -6,9 +6,14 @@ class KSensor;
 class Camera;
 class Technique;
 class SkinningTechnique;
+class GhostTechnique;
+class AssetLoader;
 class Pipeline;
 #include "util.h"
+#include "mesh_registry.h"
+#include "motion_view.h"
 #include "skinned_mesh.h"
+#include "texture_cache.h"
 
 // Kinect
 #include <Kinect.h>
@@ -27,24 +32,6 @@ QT_FORWARD_DECLARE_CLASS(QOpenGLTexture);
 // Standard C/C++
 //#include <vector>
 
-struct Material
-{
-	QVector3D diffuseColor;
-	QVector3D specularColor;
-	QVector3D ambientColor;
-
-	Material()
-	{
-	}
-
-	Material(QVector3D& difColor, QVector3D& specColor, QVector3D& ambColor)
-	{
-		diffuseColor = difColor;
-		specularColor = specColor;
-		ambientColor = ambColor;
-	}
-};
-
 class MainWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
 {
 	Q_OBJECT
@@ -59,8 +46,11 @@ public:
 	float m_barAngle;
 	QVector3D m_barSpeed;
 
-	QVector<KFrame>* m_activeAthleteMotion;
-	QVector<KFrame>* m_activeTrainerMotion;
+	// stages shown in playback, their frames are viewed through the skeleton without copying the motions
+	SessionStage m_activeAthleteStage = SESSION_RESCALED;
+	SessionStage m_activeTrainerStage = SESSION_ADJUSTED;
+	MotionView activeMotion(SessionPerson person) const;
+	quint64 activeMotionId(SessionPerson person) const; // see KSkeleton::motionId
 
 	uint m_activeFrameIndex = 0;
 
@@ -163,6 +153,12 @@ public slots:
 
 signals:
 	void frameChanged(int progressPercent);
+	void modelLoaded(); // the athlete's bones are known from now on
+
+private slots:
+	void uploadTexture(int id, const QImage& image);
+	void meshLoaded(int id);
+	void uploadCompressedTexture(int id, const CompressedTexture& compressed);
 
 protected:
 	void initializeGL();
@@ -179,8 +175,11 @@ private:
 	SkinnedMesh* m_trainer;
 	Camera* m_camera;
 	Technique* m_technique;
+	Technique* m_jointsTechnique;
+	GhostTechnique* m_ghostTechnique;
 	SkinningTechnique* m_skinningTechnique;
 	Pipeline* m_pipeline;
+	AssetLoader* m_assetLoader;
 
 	QStringList m_motionTypeList = { "Raw", "Interpolated", "Filtered", "Adjusted", "Resized" };
 
@@ -206,6 +205,24 @@ private:
 	bool m_kinectSkeletonJointsDrawing = true;
 	bool m_SkinnedMeshJointsDrawing = false;
 
+	// ghost trail of the kinect skeletons during playback
+	enum class GhostMode
+	{
+		OFF,
+		TRAIL,	// the previous m_ghostCount poses
+		PHASE	// every pose since the start of the current phase
+	};
+	GhostMode m_ghostMode = GhostMode::OFF;
+	uint m_ghostCount = 10;
+	uint m_ghostStep = 3; // frames between two ghosts
+	bool m_ghostMotionsChanged = false;
+
+	// the active frames are decoded only when the frame index or the motion changes
+	void updateActiveFrame(SessionPerson person);
+	void invalidateActiveFrames();
+	array<quint64, NUM_SESSION_PERSONS> m_activeFrameMotionIds = {{ 0, 0 }};
+	array<uint, NUM_SESSION_PERSONS> m_activeFrameIndices = {{ 0, 0 }};
+
 	QPoint m_lastMousePosition;
 	bool m_isPaused = true;	
 	QTimer m_timer;
@@ -222,20 +239,34 @@ private:
 	};
 	bool m_skinningEnabled = true;
 	bool m_defaultPose = true;
+	// the models are imported by m_assetLoader, the characters are set up once their model
+	// arrived and the OpenGL context is initialized, and are not drawn or posed until then
+	enum MeshId
+	{
+		ATHLETE_MESH,
+		TRAINER_MESH,
+		PROP_MESHES
+	};
+	bool m_athleteLoaded = false;
+	bool m_trainerLoaded = false;
+	bool m_glInitialized = false;
+	void setupCharacter(bool athlete); // with the context current
+	// textures are decoded by m_assetLoader and uploaded through m_texturePBO as they arrive,
+	// the meshes are drawn untextured until then. They are kept BC1/BC3 compressed (S3TC)
+	// when the context supports it, otherwise as RGBA8 with generated mipmaps.
+	GLuint m_texturePBO;
+	static int textureId(bool athlete, uint index);
 	// athlete
 	vector<QOpenGLTexture*> m_athleteTextures;
-	GLuint m_athleteVBOs[NUM_VBs];
-	GLuint m_athleteVAO;
-	void loadAthlete();
-	void unloadAthlete();
-	void drawAthlete();
+	GLuint m_athleteVBOs[NUM_VBs] = {};
+	GLuint m_athleteVAO = 0;
 	// trainer
 	vector<QOpenGLTexture*> m_trainerTextures;
-	GLuint m_trainerVBOs[NUM_VBs];
-	GLuint m_trainerVAO;
-	void loadTrainer();
-	void unloadTrainer();
-	void drawTrainer();
+	GLuint m_trainerVBOs[NUM_VBs] = {};
+	GLuint m_trainerVAO = 0;
+	void loadCharacter(bool athlete);
+	void unloadCharacter(bool athlete);
+	void drawCharacter(bool athlete);
 
 	// axes
 	GLuint m_axesVAO;
@@ -247,19 +278,34 @@ private:
 	void loadArrow();
 	void drawArrow();
 
-	// cube
+	// kinect joints, uploaded once per skeleton and read by both the skeleton lines and the joint cubes
+	struct JointInstance
+	{
+		GLfloat position[3];
+		GLfloat color[3];
+		GLfloat trackingState;
+	};
+	GLuint m_jointsVBO;
+	array<JointInstance, JointType_Count> m_joints;
+	void loadJoints();
+	void updateJoints(const array<KJoint, JointType_Count>& joints, bool athlete);
+
+	// cube (one instance per joint)
 	GLuint m_cubeVAO;
 	GLuint m_cubeVBO;
-	float m_cubeColors[3 * 8];
 	void loadCube(float r);
-	void drawCube(const KJoint& joint, bool athlete);
+	void drawCubes();
 
 	// kinect skeleton
 	GLuint m_skeletonVAO;
-	GLuint m_skeletonVBO;
-	float m_skeleton[2 * 3 * JointType_Count]; // 2 attributes x 3 components x JointType_Count joints
+	GLuint m_skeletonIBO;
 	void loadSkeleton();
-	void drawSkeleton(const array<KJoint, JointType_Count>& joints, bool athlete);
+	void drawSkeleton();
+
+	// ghost poses and barbell trajectory, read from the motion uploaded to m_ghostTechnique
+	GLuint m_ghostVAO;
+	void loadGhosts();
+	void drawGhosts(uint slot, const MotionView& motion, quint64 motionId, const array<uint, NUM_PHASES>& phases, const QVector3D& color);
 
 	// Skinned mesh joint dots
 #define NUM_BONES 52
@@ -274,24 +320,17 @@ private:
 	QOpenGLTexture* m_planeTexture;
 	GLuint m_planeVAO;
 	void loadPlane();
+	void placePlane(); // with the context current
 	void drawPlane();
 
-	// Meshes
-	void traverseSceneNodes(aiNode* node);
-
-	// bar (athlete's barbell)
-	QVector<MeshEntry> m_barMeshEntries;
-	QVector<Material> m_barMaterials;
-	GLuint m_barVAO;
-	void loadBar();
-	void drawBar();
-
-	// barbell (trainer's barbell)
-	QVector<MeshEntry> m_barbellMeshEntries;
-	QVector<Material> m_barbellMaterials;
-	GLuint m_barbellVAO;
-	void loadBarbell();
-	void drawBarbell();
+	// props, loaded once into the shared arena of m_meshRegistry and not drawn until it is uploaded
+	MeshRegistry m_meshRegistry;
+	bool m_propsLoaded = false;
+	void setupProps(); // with the context current
+	MeshHandle m_barMesh = INVALID_MESH_HANDLE;		// athlete's barbell
+	MeshHandle m_barbellMesh = INVALID_MESH_HANDLE;	// trainer's barbell
+	MeshHandle m_pointerMesh = INVALID_MESH_HANDLE;
+	void drawProp(MeshHandle handle, bool materials); // with m_lighting and m_meshRegistry bound
 	array<uint, 7> m_comparisonJoints = {
 		JointType_SpineBase, 
 		JointType_KneeLeft, JointType_KneeRight,
@@ -299,13 +338,6 @@ private:
 		JointType_HandLeft, JointType_HandRight
 	};
 
-	// pointer
-	QVector<MeshEntry> m_pointerMeshEntries;
-	QVector<Material> m_pointerMaterials;
-	GLuint m_pointerVAO;
-	void loadPointer();
-	void drawPointer();
-
 	// shaders for plane drawing
 	QOpenGLShaderProgram* m_shaderProgram;
 	int m_mvpLocation;
@@ -319,6 +351,14 @@ private:
 	uint m_specularLocation;
 	uint m_ambientLocation;
 
+	// shaders for instanced material lighting
+	QOpenGLShaderProgram* m_lightingInstanced;
+	uint m_instancedViewLocation;
+	uint m_instancedProjectionLocation;
+	uint m_instancedDiffuseLocation;
+	uint m_instancedSpecularLocation;
+	uint m_instancedAmbientLocation;
+
 	bool m_barbellFromMesh = true;
 };
 
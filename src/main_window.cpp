@@ -37,6 +37,13 @@ MainWindow::~MainWindow()
 {
 	delete ui;
 }
+// The bones are known once the model is loaded in the background
+void MainWindow::loadModelBones()
+{
+	ui->comboBox_activeBone->clear();
+	ui->comboBox_activeBone->addItems(ui->openGLWidget->modelBoneList());
+	loadActiveBoneInfo();
+}
 void MainWindow::loadActiveBoneInfo()
 {
 	const QString &boneName = ui->comboBox_activeBone->currentText();
@@ -175,8 +182,6 @@ void MainWindow::setupObjects()
 
 	// Model
 	ui->checkBox_modelSkinning->setChecked(ui->openGLWidget->modelSkinning());
-	ui->comboBox_activeBone->addItems(ui->openGLWidget->modelBoneList());
-	loadActiveBoneInfo();
 
 	// Render
 	ui->checkBox_axes->setChecked(ui->openGLWidget->axesDrawing());
@@ -208,6 +213,7 @@ void MainWindow::setupConnections()
 	connect(ui->comboBox_activeJoint, SIGNAL(currentIndexChanged(int)), ui->openGLWidget, SLOT(setActiveJointId(int)));
 
 	// Model
+	connect(ui->openGLWidget                    , SIGNAL(modelLoaded())               , SLOT(loadModelBones()));
 	connect(ui->checkBox_modelSkinning          , SIGNAL(toggled(bool))               , ui->openGLWidget, SLOT(setModelSkinning(bool)));
 	connect(ui->comboBox_activeBone             , SIGNAL(currentIndexChanged(QString)), SLOT(loadActiveBoneInfo()));
 	connect(ui->comboBox_activeBone             , SIGNAL(currentIndexChanged(QString)), ui->openGLWidget, SLOT(setActiveBone(QString)));
@@ -21,6 +21,7 @@ public:
 	~MainWindow();
 
 private slots:
+	void loadModelBones();
 	void loadActiveBoneInfo();
 	void setActiveBoneVisible(bool state);
 	void setActiveBoneFocused(bool state);
@@ -0,0 +1,222 @@
+// Own
+#include "mesh_registry.h"
+
+// Standard C/C++
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+MeshRegistry::MeshRegistry()
+{
+}
+MeshHandle MeshRegistry::load(const string& fileName)
+{
+	auto it = m_handles.find(fileName);
+	if (it != m_handles.end()) {
+		return it->second;
+	}
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(fileName.c_str(), aiProcess_Triangulate);
+	if (!scene) {
+		cout << "Could not import " << fileName << ": " << importer.GetErrorString() << endl;
+		return INVALID_MESH_HANDLE;
+	}
+
+	// mesh entries are relative to the whole arena, indices to their own entry
+	Mesh mesh;
+	mesh.fileName = fileName;
+	mesh.entries.resize(scene->mNumMeshes);
+	mesh.materials.resize(scene->mNumMaterials);
+	for (uint i = 0; i < scene->mNumMeshes; i++) {
+		const aiMesh* aimesh = scene->mMeshes[i];
+		MeshEntry& entry = mesh.entries[i];
+		entry.materialIndex = aimesh->mMaterialIndex;
+		entry.numIndices = aimesh->mNumFaces * 3;
+		entry.baseVertex = m_vertices.size();
+		entry.baseIndex = m_indices.size();
+
+		const bool hasTexCoords = aimesh->HasTextureCoords(0);
+		const bool hasNormals = aimesh->HasNormals();
+		for (uint j = 0; j < aimesh->mNumVertices; j++) {
+			const aiVector3D& position = aimesh->mVertices[j];
+			Vertex vertex = {
+				{ position.x, position.y, position.z },
+				{ 0.f, 0.f },
+				{ 0.f, 1.f, 0.f }
+			};
+			if (hasTexCoords) {
+				vertex.texCoord[0] = aimesh->mTextureCoords[0][j].x;
+				vertex.texCoord[1] = aimesh->mTextureCoords[0][j].y;
+			}
+			if (hasNormals) {
+				vertex.normal[0] = aimesh->mNormals[j].x;
+				vertex.normal[1] = aimesh->mNormals[j].y;
+				vertex.normal[2] = aimesh->mNormals[j].z;
+			}
+			m_vertices.push_back(vertex);
+		}
+		for (uint j = 0; j < aimesh->mNumFaces; j++) {
+			const aiFace& face = aimesh->mFaces[j];
+			assert(face.mNumIndices == 3);
+			m_indices.push_back(face.mIndices[0]);
+			m_indices.push_back(face.mIndices[1]);
+			m_indices.push_back(face.mIndices[2]);
+		}
+	}
+	for (uint i = 0; i < scene->mNumMaterials; i++) {
+		aiColor3D diffuseColor;
+		aiColor3D specularColor;
+		aiColor3D ambientColor;
+		scene->mMaterials[i]->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
+		scene->mMaterials[i]->Get(AI_MATKEY_COLOR_SPECULAR, specularColor);
+		scene->mMaterials[i]->Get(AI_MATKEY_COLOR_AMBIENT, ambientColor);
+		mesh.materials[i] = Material(
+			QVector3D(diffuseColor.r, diffuseColor.g, diffuseColor.b),
+			QVector3D(specularColor.r, specularColor.g, specularColor.b),
+			QVector3D(ambientColor.r, ambientColor.g, ambientColor.b)
+		);
+	}
+
+	cout << "Loaded " << fileName << ":";
+	cout << " Meshes:" << scene->mNumMeshes;
+	cout << " Materials:" << scene->mNumMaterials;
+	cout << " Arena vertices:" << m_vertices.size();
+	cout << " Arena indices:" << m_indices.size() << endl;
+
+	const MeshHandle handle = m_meshes.size();
+	m_meshes.push_back(mesh);
+	m_handles[fileName] = handle;
+	m_isUploaded = false;
+	return handle;
+}
+MeshHandle MeshRegistry::find(const string& fileName) const
+{
+	auto it = m_handles.find(fileName);
+	return it != m_handles.end() ? it->second : INVALID_MESH_HANDLE;
+}
+bool MeshRegistry::upload()
+{
+	if (m_VAO == 0) {
+		initializeOpenGLFunctions();
+		glGenVertexArrays(1, &m_VAO);
+		glGenBuffers(1, &m_VBO);
+		glGenBuffers(1, &m_IBO);
+		glGenBuffers(1, &m_instanceVBO);
+
+		glBindVertexArray(m_VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, position)));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, texCoord)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, normal)));
+		glEnableVertexAttribArray(2);
+
+		// model matrix columns for instanced drawing, ignored by the non instanced shaders
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 16, QMatrix4x4().constData(), GL_STREAM_DRAW);
+		for (uint c = 0; c < 4; c++) {
+			glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 16, BUFFER_OFFSET(sizeof(GLfloat) * 4 * c));
+			glVertexAttribDivisor(3 + c, 1);
+			glEnableVertexAttribArray(3 + c);
+		}
+		glBindVertexArray(0);
+	}
+
+	// the whole arena is uploaded again, so meshes can still be loaded after the first upload
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_vertices.size(), m_vertices.constData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * m_indices.size(), m_indices.constData(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	m_isUploaded = true;
+
+	cout << "MeshRegistry: " << m_meshes.size() << " meshes, " << m_vertices.size() << " vertices, " << m_indices.size() << " indices" << endl;
+	if (!GLNoError()) {
+		cout << "Error uploading the mesh arena" << endl;
+		GLPrintError();
+		return false;
+	}
+	return true;
+}
+void MeshRegistry::destroy()
+{
+	if (m_VAO == 0) {
+		return;
+	}
+	glDeleteVertexArrays(1, &m_VAO);
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteBuffers(1, &m_IBO);
+	glDeleteBuffers(1, &m_instanceVBO);
+	m_VAO = m_VBO = m_IBO = m_instanceVBO = 0;
+	m_isUploaded = false;
+}
+bool MeshRegistry::isUploaded() const
+{
+	return m_isUploaded;
+}
+const QVector<MeshEntry>& MeshRegistry::meshEntries(MeshHandle handle) const
+{
+	assert(handle >= 0 && handle < (int)m_meshes.size());
+	return m_meshes[handle].entries;
+}
+const QVector<Material>& MeshRegistry::materials(MeshHandle handle) const
+{
+	assert(handle >= 0 && handle < (int)m_meshes.size());
+	return m_meshes[handle].materials;
+}
+void MeshRegistry::bind()
+{
+	glBindVertexArray(m_VAO);
+}
+void MeshRegistry::release()
+{
+	glBindVertexArray(0);
+}
+void MeshRegistry::draw(MeshHandle handle, uint entry)
+{
+	if (handle == INVALID_MESH_HANDLE || !m_isUploaded) {
+		return;
+	}
+	const MeshEntry& meshEntry = m_meshes[handle].entries[entry];
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		meshEntry.numIndices,
+		GL_UNSIGNED_INT,
+		(void*)(sizeof(uint) * meshEntry.baseIndex),
+		meshEntry.baseVertex
+	);
+}
+void MeshRegistry::setInstanceModels(const QVector<QMatrix4x4>& models)
+{
+	if (models.isEmpty() || m_instanceVBO == 0) {
+		return;
+	}
+	m_instanceModels.resize(16 * models.size());
+	for (int i = 0; i < models.size(); i++) {
+		memcpy(m_instanceModels.data() + 16 * i, models[i].constData(), sizeof(GLfloat) * 16);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_instanceModels.size(), m_instanceModels.constData(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+void MeshRegistry::drawInstanced(MeshHandle handle, int count)
+{
+	if (handle == INVALID_MESH_HANDLE || !m_isUploaded || count <= 0) {
+		return;
+	}
+	const QVector<MeshEntry>& entries = m_meshes[handle].entries;
+	for (int i = 0; i < entries.size(); i++) {
+		glDrawElementsInstancedBaseVertex(
+			GL_TRIANGLES,
+			entries[i].numIndices,
+			GL_UNSIGNED_INT,
+			(void*)(sizeof(uint) * entries[i].baseIndex),
+			count,
+			entries[i].baseVertex
+		);
+	}
+}
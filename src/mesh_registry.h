@@ -0,0 +1,94 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+// Project
+#include "skinned_mesh.h"
+#include "util.h"
+
+// Qt
+#include <QtCore\QVector>
+#include <QtGui\QMatrix4x4>
+#include <QtGui\QVector3D>
+
+// Standard C/C++
+#include <map>
+#include <string>
+#include <vector>
+
+struct Material
+{
+	QVector3D diffuseColor;
+	QVector3D specularColor;
+	QVector3D ambientColor;
+
+	Material()
+	{
+	}
+
+	Material(const QVector3D& difColor, const QVector3D& specColor, const QVector3D& ambColor)
+	{
+		diffuseColor = difColor;
+		specularColor = specColor;
+		ambientColor = ambColor;
+	}
+};
+
+typedef int MeshHandle;
+#define INVALID_MESH_HANDLE -1
+
+// Static meshes (props) that share one vertex and one index buffer behind a single VAO.
+// Every file is imported once by load(), which returns the same handle for the same file.
+// upload() packs all of them into the shared buffers, after which the mesh entries of a
+// handle address the arena through their base vertex and base index. Between bind() and
+// release() any number of meshes can be drawn without further VAO changes.
+// Vertex attributes: 0 position, 1 texture coordinates, 2 normal, 3-6 per instance model matrix.
+class MeshRegistry : protected QOpenGLFunctions_3_3_Core
+{
+public:
+	MeshRegistry();
+
+	MeshHandle load(const string& fileName); // INVALID_MESH_HANDLE if the file cannot be imported
+	MeshHandle find(const string& fileName) const; // INVALID_MESH_HANDLE if the file was not loaded
+	bool upload(); // with the OpenGL context current, meshes loaded afterwards need another upload
+	void destroy(); // with the OpenGL context current
+	bool isUploaded() const;
+
+	const QVector<MeshEntry>& meshEntries(MeshHandle handle) const;
+	const QVector<Material>& materials(MeshHandle handle) const;
+
+	void bind();
+	void release();
+	void draw(MeshHandle handle, uint entry); // one mesh entry, between bind() and release()
+	void setInstanceModels(const QVector<QMatrix4x4>& models);
+	void drawInstanced(MeshHandle handle, int count); // every entry, once per instance model
+
+private:
+	struct Vertex
+	{
+		GLfloat position[3];
+		GLfloat texCoord[2];
+		GLfloat normal[3];
+	};
+	struct Mesh
+	{
+		string fileName;
+		QVector<MeshEntry> entries;
+		QVector<Material> materials;
+	};
+
+	vector<Mesh> m_meshes;
+	map<string, MeshHandle> m_handles;
+
+	// CPU copy of the arena
+	QVector<Vertex> m_vertices;
+	QVector<uint> m_indices;
+
+	bool m_isUploaded = false;
+	GLuint m_VAO = 0;
+	GLuint m_VBO = 0;
+	GLuint m_IBO = 0;
+	GLuint m_instanceVBO = 0;
+	QVector<GLfloat> m_instanceModels;
+};
+
+#endif
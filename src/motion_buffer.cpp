@@ -0,0 +1,215 @@
+// Own
+#include "motion_buffer.h"
+
+// Project
+#include "motion_view.h"
+
+// Standard C/C++
+#include <cstring>
+
+static const int floatsPerBlock = MotionBuffer::alignment / sizeof(float);
+
+MotionBuffer::MotionBuffer()
+{
+}
+MotionBuffer::MotionBuffer(int size)
+{
+	resize(size);
+}
+MotionBuffer::MotionBuffer(const QVector<KFrame>& motion)
+{
+	resize(motion.size());
+	for (int i = 0; i < motion.size(); i++) {
+		setFrame(i, motion[i]);
+	}
+}
+MotionBuffer::MotionBuffer(const MotionView& motion)
+{
+	resize(motion.size());
+	KFrame frame;
+	for (int i = 0; i < motion.size(); i++) {
+		motion.getFrame(i, frame);
+		setFrame(i, frame);
+	}
+}
+MotionBuffer::MotionBuffer(const MotionBuffer& other)
+{
+	*this = other;
+}
+MotionBuffer::MotionBuffer(MotionBuffer&& other)
+{
+	*this = std::move(other);
+}
+MotionBuffer::~MotionBuffer()
+{
+	qFreeAligned(m_channels);
+}
+MotionBuffer& MotionBuffer::operator=(const MotionBuffer& other)
+{
+	if (this == &other) {
+		return *this;
+	}
+	qFreeAligned(m_channels);
+	m_channels = nullptr;
+	m_size = other.m_size;
+	m_stride = other.m_stride;
+	if (m_stride > 0) {
+		size_t bytes = sizeof(float) * JointType_Count * NUM_CHANNELS * m_stride;
+		m_channels = (float*)qMallocAligned(bytes, alignment);
+		memcpy(m_channels, other.m_channels, bytes);
+	}
+	m_trackingStates = other.m_trackingStates;
+	m_timestamps = other.m_timestamps;
+	m_serials = other.m_serials;
+	return *this;
+}
+MotionBuffer& MotionBuffer::operator=(MotionBuffer&& other)
+{
+	if (this == &other) {
+		return *this;
+	}
+	qFreeAligned(m_channels);
+	m_channels = other.m_channels;
+	m_size = other.m_size;
+	m_stride = other.m_stride;
+	m_trackingStates = std::move(other.m_trackingStates);
+	m_timestamps = std::move(other.m_timestamps);
+	m_serials = std::move(other.m_serials);
+	other.m_channels = nullptr;
+	other.m_size = 0;
+	other.m_stride = 0;
+	return *this;
+}
+int MotionBuffer::size() const
+{
+	return m_size;
+}
+bool MotionBuffer::empty() const
+{
+	return m_size == 0;
+}
+int MotionBuffer::stride() const
+{
+	return m_stride;
+}
+void MotionBuffer::resize(int size)
+{
+	reserve(size);
+	m_size = size;
+	m_timestamps.resize(size);
+	m_serials.resize(size);
+}
+void MotionBuffer::reserve(int capacity)
+{
+	if (capacity <= m_stride) {
+		return;
+	}
+	int stride = (capacity + floatsPerBlock - 1) / floatsPerBlock * floatsPerBlock;
+
+	// padding is zeroed so that kernels may read whole blocks
+	size_t bytes = sizeof(float) * JointType_Count * NUM_CHANNELS * stride;
+	float* channels = (float*)qMallocAligned(bytes, alignment);
+	memset(channels, 0, bytes);
+	QVector<uchar> trackingStates(JointType_Count * stride, TrackingState_NotTracked);
+	for (int c = 0; c < JointType_Count * NUM_CHANNELS; c++) {
+		if (m_size > 0) memcpy(channels + c * stride, m_channels + c * m_stride, sizeof(float) * m_size);
+	}
+	for (int j = 0; j < JointType_Count; j++) {
+		if (m_size > 0) memcpy(trackingStates.data() + j * stride, m_trackingStates.constData() + j * m_stride, m_size);
+	}
+	qFreeAligned(m_channels);
+	m_channels = channels;
+	m_trackingStates = trackingStates;
+	m_stride = stride;
+	m_timestamps.reserve(capacity);
+	m_serials.reserve(capacity);
+}
+void MotionBuffer::clear()
+{
+	m_size = 0;
+	m_timestamps.clear();
+	m_serials.clear();
+}
+float* MotionBuffer::channel(uint joint, Channel channel)
+{
+	return m_channels + (joint * NUM_CHANNELS + channel) * m_stride;
+}
+const float* MotionBuffer::channel(uint joint, Channel channel) const
+{
+	return m_channels + (joint * NUM_CHANNELS + channel) * m_stride;
+}
+uchar* MotionBuffer::trackingStates(uint joint)
+{
+	return m_trackingStates.data() + joint * m_stride;
+}
+const uchar* MotionBuffer::trackingStates(uint joint) const
+{
+	return m_trackingStates.constData() + joint * m_stride;
+}
+double* MotionBuffer::timestamps()
+{
+	return m_timestamps.data();
+}
+const double* MotionBuffer::timestamps() const
+{
+	return m_timestamps.constData();
+}
+int* MotionBuffer::serials()
+{
+	return m_serials.data();
+}
+const int* MotionBuffer::serials() const
+{
+	return m_serials.constData();
+}
+void MotionBuffer::getFrame(int index, KFrame& frame) const
+{
+	frame.serial = m_serials[index];
+	frame.timestamp = m_timestamps[index];
+	for (uint j = 0; j < JointType_Count; j++) {
+		const float* c = m_channels + j * NUM_CHANNELS * m_stride + index;
+		KJoint& joint = frame.joints[j];
+		joint.position = QVector3D(c[PX * m_stride], c[PY * m_stride], c[PZ * m_stride]);
+		joint.orientation = QQuaternion(c[QW * m_stride], c[QX * m_stride], c[QY * m_stride], c[QZ * m_stride]);
+		joint.trackingState = m_trackingStates[j * m_stride + index];
+	}
+}
+KFrame MotionBuffer::frame(int index) const
+{
+	KFrame frame;
+	getFrame(index, frame);
+	return frame;
+}
+void MotionBuffer::setFrame(int index, const KFrame& frame)
+{
+	m_serials[index] = frame.serial;
+	m_timestamps[index] = frame.timestamp;
+	for (uint j = 0; j < JointType_Count; j++) {
+		float* c = m_channels + j * NUM_CHANNELS * m_stride + index;
+		const KJoint& joint = frame.joints[j];
+		c[PX * m_stride] = joint.position.x();
+		c[PY * m_stride] = joint.position.y();
+		c[PZ * m_stride] = joint.position.z();
+		c[QW * m_stride] = joint.orientation.scalar();
+		c[QX * m_stride] = joint.orientation.x();
+		c[QY * m_stride] = joint.orientation.y();
+		c[QZ * m_stride] = joint.orientation.z();
+		m_trackingStates[j * m_stride + index] = (uchar)joint.trackingState;
+	}
+}
+void MotionBuffer::append(const KFrame& frame)
+{
+	if (m_size == m_stride) {
+		reserve(m_stride < floatsPerBlock ? floatsPerBlock : 2 * m_stride);
+	}
+	resize(m_size + 1);
+	setFrame(m_size - 1, frame);
+}
+QVector<KFrame> MotionBuffer::toFrames() const
+{
+	QVector<KFrame> motion(m_size);
+	for (int i = 0; i < m_size; i++) {
+		getFrame(i, motion[i]);
+	}
+	return motion;
+}
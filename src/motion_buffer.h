@@ -0,0 +1,60 @@
+#ifndef MOTION_BUFFER_H
+#define MOTION_BUFFER_H
+
+// Project
+#include "kskeleton.h"
+
+// Qt
+#include <QtCore/QVector>
+
+// Motion stored as a structure of arrays. Every float channel of every joint is a contiguous
+// array over the frames, aligned to 32 bytes and padded to a multiple of 8 frames, so that
+// per joint temporal loops walk memory linearly and vectorise.
+class MotionBuffer
+{
+public:
+	enum Channel { PX, PY, PZ, QW, QX, QY, QZ, NUM_CHANNELS };
+	static const int alignment = 32; // bytes
+
+	MotionBuffer();
+	explicit MotionBuffer(int size);
+	explicit MotionBuffer(const QVector<KFrame>& motion);
+	explicit MotionBuffer(const MotionView& motion);
+	MotionBuffer(const MotionBuffer& other);
+	MotionBuffer(MotionBuffer&& other);
+	~MotionBuffer();
+	MotionBuffer& operator=(const MotionBuffer& other);
+	MotionBuffer& operator=(MotionBuffer&& other);
+
+	int size() const;
+	bool empty() const;
+	int stride() const; // distance in floats between the channels
+	void resize(int size);
+	void reserve(int capacity);
+	void clear();
+
+	float* channel(uint joint, Channel channel);
+	const float* channel(uint joint, Channel channel) const;
+	uchar* trackingStates(uint joint);
+	const uchar* trackingStates(uint joint) const;
+	double* timestamps();
+	const double* timestamps() const;
+	int* serials();
+	const int* serials() const;
+
+	// KFrame adapters
+	void getFrame(int index, KFrame& frame) const;
+	KFrame frame(int index) const;
+	void setFrame(int index, const KFrame& frame);
+	void append(const KFrame& frame);
+	QVector<KFrame> toFrames() const;
+private:
+	int m_size = 0;
+	int m_stride = 0;
+	float* m_channels = nullptr; // JointType_Count * NUM_CHANNELS arrays of m_stride floats
+	QVector<uchar> m_trackingStates; // JointType_Count arrays of m_stride states
+	QVector<double> m_timestamps;
+	QVector<int> m_serials;
+};
+
+#endif
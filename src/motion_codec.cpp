@@ -0,0 +1,392 @@
+// Own
+#include "motion_codec.h"
+
+// Standard C/C++
+#include <cmath>
+#include <cstring>
+
+static const int probabilityBits = 12;
+static const quint32 probabilityScale = 1u << probabilityBits;
+static const quint32 ransLow = 1u << 23; // the coder state stays in [ransLow, ransLow << 8)
+static const int numSymbols = 256;
+
+static quint64 zigzag(qint64 value)
+{
+	return ((quint64)value << 1) ^ (quint64)(value >> 63);
+}
+static qint64 unzigzag(quint64 value)
+{
+	return (qint64)(value >> 1) ^ -(qint64)(value & 1);
+}
+static void putVarint(vector<uchar>& out, quint64 value)
+{
+	while (value >= 0x80) {
+		out.push_back((uchar)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uchar)value);
+}
+static void putSigned(vector<uchar>& out, qint64 value)
+{
+	putVarint(out, zigzag(value));
+}
+template <typename T>
+static void putValue(vector<uchar>& out, T value)
+{
+	uchar bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Bounds checked reading, a read past the end clears ok and returns 0
+struct ByteReader
+{
+	const uchar* p;
+	const uchar* end;
+	bool ok = true;
+
+	ByteReader(const uchar* data, const uchar* dataEnd) : p(data), end(dataEnd) {}
+	quint64 varint()
+	{
+		quint64 value = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7) {
+			uchar byte = *p++;
+			value |= (quint64)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return value;
+		}
+		ok = false;
+		return 0;
+	}
+	qint64 signedVarint()
+	{
+		return unzigzag(varint());
+	}
+	uchar byte()
+	{
+		if (p >= end) {
+			ok = false;
+			return 0;
+		}
+		return *p++;
+	}
+	template <typename T>
+	T value()
+	{
+		T v = 0;
+		if (end - p < (ptrdiff_t)sizeof(T)) {
+			ok = false;
+			return v;
+		}
+		memcpy(&v, p, sizeof(T));
+		p += sizeof(T);
+		return v;
+	}
+};
+
+// Smallest three: the largest component is dropped and made positive, the other three are within +-1/sqrt(2)
+static void packOrientation(const QQuaternion& q, int& largest, qint32 components[3])
+{
+	float v[4] = { q.scalar(), q.x(), q.y(), q.z() };
+	float length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3]);
+	if (length < 1e-6f) {
+		v[0] = 1.f;
+		v[1] = v[2] = v[3] = 0.f;
+		length = 1.f;
+	}
+	largest = 0;
+	for (int i = 1; i < 4; i++) {
+		if (fabs(v[i]) > fabs(v[largest])) largest = i;
+	}
+	float scale = (v[largest] < 0.f ? -1.f : 1.f) * (float)M_SQRT2 * MOTION_CODEC_ORIENTATION_RANGE / length;
+	for (int i = 0, k = 0; i < 4; i++) {
+		if (i == largest) continue;
+		qint32 c = (qint32)lround(v[i] * scale);
+		components[k++] = c < -MOTION_CODEC_ORIENTATION_RANGE ? -MOTION_CODEC_ORIENTATION_RANGE :
+			(c > MOTION_CODEC_ORIENTATION_RANGE ? MOTION_CODEC_ORIENTATION_RANGE : c);
+	}
+}
+static QQuaternion unpackOrientation(int largest, const qint32 components[3])
+{
+	float v[4];
+	float sum = 0.f;
+	for (int i = 0, k = 0; i < 4; i++) {
+		if (i == largest) continue;
+		v[i] = components[k++] / ((float)M_SQRT2 * MOTION_CODEC_ORIENTATION_RANGE);
+		sum += v[i] * v[i];
+	}
+	v[largest] = sqrt(sum < 1.f ? 1.f - sum : 0.f);
+	return QQuaternion(v[0], v[1], v[2], v[3]);
+}
+static qint64 predictLinear(int frame, qint64 previous, qint64 beforePrevious)
+{
+	return frame >= 2 ? 2 * previous - beforePrevious : (frame == 1 ? previous : 0);
+}
+// Timestamps of a motion share their exponent most of the time, so their bits are nearly linear too.
+// The arithmetic wraps, every residual decodes to the exact double.
+static quint64 timestampBits(double timestamp)
+{
+	quint64 bits;
+	memcpy(&bits, &timestamp, sizeof(bits));
+	return bits;
+}
+static double timestampFromBits(quint64 bits)
+{
+	double timestamp;
+	memcpy(&timestamp, &bits, sizeof(timestamp));
+	return timestamp;
+}
+static quint64 predictTimestampBits(int frame, quint64 previous, quint64 beforePrevious)
+{
+	return frame >= 2 ? 2 * previous - beforePrevious : (frame == 1 ? previous : 0);
+}
+
+// Quantises and predicts the frames into residual varints
+static void encodeResiduals(const MotionView& motion, vector<uchar>& out)
+{
+	out.reserve(out.size() + motion.size() * (JointType_Count * 8 + 16));
+	qint32 previousSerial = 0;
+	quint64 times[2] = { 0, 0 }; // previous, before previous
+	qint64 positions[2][JointType_Count][3] = {};
+	qint64 orientations[2][JointType_Count][3] = {};
+	int largest[JointType_Count];
+	qint32 components[JointType_Count][3];
+	for (int i = 0; i < motion.size(); i++) {
+		qint32 serial = motion.serial(i);
+		putSigned(out, (qint64)serial - previousSerial);
+		previousSerial = serial;
+
+		quint64 time = timestampBits(motion.timestamp(i));
+		putSigned(out, (qint64)(time - predictTimestampBits(i, times[0], times[1])));
+		times[1] = times[0];
+		times[0] = time;
+
+		for (uint j = 0; j < JointType_Count; j++) {
+			packOrientation(motion.orientation(i, j), largest[j], components[j]);
+		}
+		for (uint j = 0; j < JointType_Count; j += 2) {
+			uchar states = (uchar)((largest[j] << 2) | (motion.trackingState(i, j) & 3));
+			if (j + 1 < JointType_Count) {
+				states |= (uchar)(((largest[j + 1] << 2) | (motion.trackingState(i, j + 1) & 3)) << 4);
+			}
+			out.push_back(states);
+		}
+
+		for (uint j = 0; j < JointType_Count; j++) {
+			QVector3D position = motion.position(i, j);
+			const float p[3] = { position.x(), position.y(), position.z() };
+			for (int c = 0; c < 3; c++) {
+				qint64 quantised = llround(p[c] / MOTION_CODEC_POSITION_STEP);
+				putSigned(out, quantised - predictLinear(i, positions[0][j][c], positions[1][j][c]));
+				positions[1][j][c] = positions[0][j][c];
+				positions[0][j][c] = quantised;
+			}
+			for (int c = 0; c < 3; c++) {
+				putSigned(out, components[j][c] - predictLinear(i, orientations[0][j][c], orientations[1][j][c]));
+				orientations[1][j][c] = orientations[0][j][c];
+				orientations[0][j][c] = components[j][c];
+			}
+		}
+	}
+}
+static bool decodeResiduals(ByteReader& in, int size, QVector<KFrame>& motion)
+{
+	motion.resize(size);
+	qint32 previousSerial = 0;
+	quint64 times[2] = { 0, 0 };
+	qint64 positions[2][JointType_Count][3] = {};
+	qint64 orientations[2][JointType_Count][3] = {};
+	int largest[JointType_Count];
+	qint32 components[3];
+	for (int i = 0; i < size && in.ok; i++) {
+		KFrame& frame = motion[i];
+		previousSerial += (qint32)in.signedVarint();
+		frame.serial = previousSerial;
+
+		const quint64 time = predictTimestampBits(i, times[0], times[1]) + (quint64)in.signedVarint();
+		frame.timestamp = timestampFromBits(time);
+		times[1] = times[0];
+		times[0] = time;
+
+		for (uint j = 0; j < JointType_Count; j += 2) {
+			uchar states = in.byte();
+			largest[j] = (states >> 2) & 3;
+			frame.joints[j].trackingState = states & 3;
+			if (j + 1 < JointType_Count) {
+				largest[j + 1] = (states >> 6) & 3;
+				frame.joints[j + 1].trackingState = (states >> 4) & 3;
+			}
+		}
+
+		for (uint j = 0; j < JointType_Count; j++) {
+			float p[3];
+			for (int c = 0; c < 3; c++) {
+				qint64 quantised = predictLinear(i, positions[0][j][c], positions[1][j][c]) + in.signedVarint();
+				positions[1][j][c] = positions[0][j][c];
+				positions[0][j][c] = quantised;
+				p[c] = quantised * MOTION_CODEC_POSITION_STEP;
+			}
+			frame.joints[j].position = QVector3D(p[0], p[1], p[2]);
+			for (int c = 0; c < 3; c++) {
+				qint64 component = predictLinear(i, orientations[0][j][c], orientations[1][j][c]) + in.signedVarint();
+				orientations[1][j][c] = orientations[0][j][c];
+				orientations[0][j][c] = component;
+				components[c] = (qint32)component;
+			}
+			frame.joints[j].orientation = unpackOrientation(largest[j], components);
+		}
+	}
+	return in.ok;
+}
+
+// Scales the counts to frequencies summing to probabilityScale, every symbol that occurs keeps at least 1
+static void normaliseFrequencies(const quint64 counts[numSymbols], quint64 total, quint32 frequencies[numSymbols])
+{
+	quint32 sum = 0;
+	for (int s = 0; s < numSymbols; s++) {
+		frequencies[s] = counts[s] == 0 ? 0 : (quint32)(counts[s] * probabilityScale / total);
+		if (counts[s] > 0 && frequencies[s] == 0) frequencies[s] = 1;
+		sum += frequencies[s];
+	}
+	while (sum != probabilityScale) {
+		int largest = 0;
+		for (int s = 1; s < numSymbols; s++) {
+			if (frequencies[s] > frequencies[largest]) largest = s;
+		}
+		if (sum < probabilityScale) {
+			frequencies[largest] += probabilityScale - sum;
+			sum = probabilityScale;
+		}
+		else {
+			frequencies[largest]--;
+			sum--;
+		}
+	}
+}
+// Block: raw size, symbol mask, 16 bit frequencies of the symbols in the mask, coded size, coded bytes
+static void encodeEntropy(const vector<uchar>& in, vector<uchar>& out)
+{
+	quint64 counts[numSymbols] = {};
+	for (size_t i = 0; i < in.size(); i++) {
+		counts[in[i]]++;
+	}
+	quint32 frequencies[numSymbols] = {};
+	if (!in.empty()) {
+		normaliseFrequencies(counts, in.size(), frequencies);
+	}
+	quint32 cumulative[numSymbols];
+	uchar mask[numSymbols / 8] = {};
+	for (int s = 0, sum = 0; s < numSymbols; s++) {
+		cumulative[s] = sum;
+		sum += frequencies[s];
+		if (frequencies[s] > 0) mask[s / 8] |= (uchar)(1 << (s % 8));
+	}
+	putValue<quint32>(out, (quint32)in.size());
+	out.insert(out.end(), mask, mask + sizeof(mask));
+	for (int s = 0; s < numSymbols; s++) {
+		if (frequencies[s] > 0) putValue<quint16>(out, (quint16)(frequencies[s] - 1));
+	}
+
+	// rANS codes backwards, so the decoder reads forwards
+	vector<uchar> coded(2 * in.size() + 8);
+	uchar* end = coded.data() + coded.size();
+	uchar* p = end;
+	quint32 x = ransLow;
+	for (size_t i = in.size(); i-- > 0;) {
+		quint32 frequency = frequencies[in[i]];
+		quint32 xMax = ((ransLow >> probabilityBits) << 8) * frequency;
+		while (x >= xMax) {
+			*--p = (uchar)(x & 0xff);
+			x >>= 8;
+		}
+		x = ((x / frequency) << probabilityBits) + (x % frequency) + cumulative[in[i]];
+	}
+	p -= 4;
+	p[0] = (uchar)(x >> 0);
+	p[1] = (uchar)(x >> 8);
+	p[2] = (uchar)(x >> 16);
+	p[3] = (uchar)(x >> 24);
+	putValue<quint32>(out, (quint32)(end - p));
+	out.insert(out.end(), p, end);
+}
+static bool decodeEntropy(ByteReader& in, vector<uchar>& out)
+{
+	quint32 size = in.value<quint32>();
+	quint32 frequencies[numSymbols] = {};
+	quint32 cumulative[numSymbols];
+	uchar mask[numSymbols / 8];
+	for (int i = 0; i < numSymbols / 8; i++) {
+		mask[i] = in.byte();
+	}
+	quint32 sum = 0;
+	for (int s = 0; s < numSymbols; s++) {
+		cumulative[s] = sum;
+		if (mask[s / 8] & (1 << (s % 8))) {
+			frequencies[s] = in.value<quint16>() + 1u;
+			sum += frequencies[s];
+		}
+	}
+	quint32 codedSize = in.value<quint32>();
+	if (!in.ok || (size > 0 && sum != probabilityScale) || codedSize > (quint64)(in.end - in.p)) {
+		return false;
+	}
+	const uchar* p = in.p;
+	const uchar* end = in.p + codedSize;
+	in.p = end;
+	if (codedSize < 4) {
+		return size == 0;
+	}
+	vector<uchar> symbols(probabilityScale);
+	for (int s = 0; s < numSymbols; s++) {
+		for (quint32 k = 0; k < frequencies[s]; k++) {
+			symbols[cumulative[s] + k] = (uchar)s;
+		}
+	}
+
+	out.resize(size);
+	quint32 x = p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32)p[3] << 24);
+	p += 4;
+	for (quint32 i = 0; i < size; i++) {
+		quint32 slot = x & (probabilityScale - 1);
+		uchar s = symbols[slot];
+		x = frequencies[s] * (x >> probabilityBits) + slot - cumulative[s];
+		while (x < ransLow) {
+			if (p >= end) return false;
+			x = (x << 8) | *p++;
+		}
+		out[i] = s;
+	}
+	return true;
+}
+
+QByteArray MotionCodec::encode(const MotionView& motion)
+{
+	vector<uchar> residuals;
+	encodeResiduals(motion, residuals);
+	vector<uchar> out;
+	out.reserve(residuals.size() / 2 + 1024);
+	putValue<quint32>(out, (quint32)motion.size());
+	putValue<quint32>(out, JointType_Count);
+	encodeEntropy(residuals, out);
+	return QByteArray((const char*)out.data(), (int)out.size());
+}
+bool MotionCodec::decode(const char* data, qint64 size, QVector<KFrame>& motion)
+{
+	motion.clear();
+	ByteReader in((const uchar*)data, (const uchar*)data + size);
+	quint32 frameCount = in.value<quint32>();
+	quint32 jointCount = in.value<quint32>();
+	vector<uchar> residuals;
+	if (!in.ok || jointCount != JointType_Count || !decodeEntropy(in, residuals)) {
+		return false;
+	}
+	// every frame takes at least 13 bytes of states and a byte per residual
+	if (frameCount > residuals.size() / 13) {
+		return false;
+	}
+	ByteReader residualReader(residuals.data(), residuals.data() + residuals.size());
+	if (!decodeResiduals(residualReader, frameCount, motion)) {
+		motion.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,29 @@
+#ifndef MOTION_CODEC_H
+#define MOTION_CODEC_H
+
+// Project
+#include "kskeleton.h"
+#include "motion_view.h"
+
+// Qt
+#include <QtCore/QByteArray>
+
+// Compression of motions for the session archive, about 10 times smaller than the frame records
+// for smooth motions. The joints are lossy, the timestamps, serials and tracking states exact.
+// Every frame is quantised and predicted from the previous ones, the residuals are zigzag varints
+// and the byte stream is entropy coded with a static order-0 rANS coder:
+// - positions: MOTION_CODEC_POSITION_STEP fixed point, predicted linearly from the two previous frames
+// - orientations: smallest three components, 12 bits and a sign each, predicted linearly
+// - tracking states and the index of the dropped quaternion component: 2 bits each
+// - timestamps: exact, the bits of the doubles predicted linearly; serials: predicted from the previous frame
+#define MOTION_CODEC_VERSION 1 // increase with SESSION_FILE_VERSION when the stream changes
+#define MOTION_CODEC_POSITION_STEP 0.0005f // metres, half a millimetre
+#define MOTION_CODEC_ORIENTATION_RANGE 4095 // steps of about 0.02 degrees
+
+namespace MotionCodec
+{
+	QByteArray encode(const MotionView& motion);
+	bool decode(const char* data, qint64 size, QVector<KFrame>& motion); // false if the data is corrupt
+}
+
+#endif
@@ -0,0 +1,103 @@
+// Own
+#include "motion_view.h"
+
+// Project
+#include "session_file.h"
+
+// Standard C/C++
+#include <cassert>
+
+MotionView::MotionView()
+{
+}
+MotionView::MotionView(const QVector<KFrame>& motion)
+	:
+	m_frames(motion.constData()),
+	m_size(motion.size())
+{
+}
+MotionView::MotionView(const QVector<KFrame>& motion, int first, int size)
+	:
+	m_frames(motion.constData() + first),
+	m_size(size)
+{
+	assert(first >= 0 && size >= 0 && first + size <= motion.size());
+}
+MotionView::MotionView(const SessionFrameRecord* records, int size)
+	:
+	m_records(records),
+	m_size(records ? size : 0)
+{
+}
+int MotionView::size() const
+{
+	return m_size;
+}
+bool MotionView::empty() const
+{
+	return m_size == 0;
+}
+int MotionView::serial(int index) const
+{
+	return m_frames ? m_frames[index].serial : m_records[index].serial;
+}
+double MotionView::timestamp(int index) const
+{
+	return m_frames ? m_frames[index].timestamp : m_records[index].timestamp;
+}
+QVector3D MotionView::position(int index, uint joint) const
+{
+	if (m_frames) {
+		return m_frames[index].joints[joint].position;
+	}
+	const float* p = m_records[index].joints[joint].position;
+	return QVector3D(p[0], p[1], p[2]);
+}
+QQuaternion MotionView::orientation(int index, uint joint) const
+{
+	if (m_frames) {
+		return m_frames[index].joints[joint].orientation;
+	}
+	const float* q = m_records[index].joints[joint].orientation;
+	return QQuaternion(q[0], q[1], q[2], q[3]);
+}
+uint MotionView::trackingState(int index, uint joint) const
+{
+	return m_frames ? m_frames[index].joints[joint].trackingState : m_records[index].joints[joint].trackingState;
+}
+void MotionView::getFrame(int index, KFrame& frame) const
+{
+	if (m_frames) {
+		frame = m_frames[index];
+	}
+	else {
+		fromSessionRecord(m_records[index], frame);
+	}
+}
+KFrame MotionView::frame(int index) const
+{
+	KFrame frame;
+	getFrame(index, frame);
+	return frame;
+}
+QVector<KFrame> MotionView::toFrames() const
+{
+	QVector<KFrame> frames(m_size);
+	for (int i = 0; i < m_size; i++) {
+		getFrame(i, frames[i]);
+	}
+	return frames;
+}
+MotionView MotionView::mid(int first, int size) const
+{
+	assert(first >= 0 && size >= 0 && first + size <= m_size);
+	MotionView view(*this);
+	if (m_frames) {
+		view.m_frames += first;
+	}
+	else if (m_records) {
+		view.m_records += first;
+	}
+	view.m_size = size;
+	return view;
+}
@@ -0,0 +1,38 @@
+#ifndef MOTION_VIEW_H
+#define MOTION_VIEW_H
+
+// Project
+#include "kskeleton.h"
+
+struct SessionFrameRecord;
+
+// Read only view of a motion, either of a QVector<KFrame> or of the frame records of a mapped
+// session file, which it neither copies nor owns: it is valid while its source is unchanged.
+// Views are cheap to construct and copy, frame() decodes only the frame it is asked for.
+class MotionView
+{
+public:
+	MotionView();
+	explicit MotionView(const QVector<KFrame>& motion);
+	MotionView(const QVector<KFrame>& motion, int first, int size); // size frames from first
+	MotionView(const SessionFrameRecord* records, int size);
+
+	int size() const;
+	bool empty() const;
+
+	int serial(int index) const;
+	double timestamp(int index) const;
+	QVector3D position(int index, uint joint) const;
+	QQuaternion orientation(int index, uint joint) const;
+	uint trackingState(int index, uint joint) const;
+	void getFrame(int index, KFrame& frame) const;
+	KFrame frame(int index) const;
+	QVector<KFrame> toFrames() const; // a copy of every frame
+	MotionView mid(int first, int size) const; // size frames from first, of the same source
+private:
+	const KFrame* m_frames = nullptr;
+	const SessionFrameRecord* m_records = nullptr;
+	int m_size = 0;
+};
+
+#endif
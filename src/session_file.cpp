@@ -0,0 +1,230 @@
+// Own
+#include "session_file.h"
+
+// Project
+#include "motion_codec.h"
+
+// Qt
+#include <QtCore/QSaveFile>
+
+// Standard C/C++
+#include <climits>
+#include <cstring>
+
+static const quint64 sectionAlignment = 16;
+static const int recordsPerWrite = 1024;
+
+static quint64 alignSection(quint64 offset)
+{
+	return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+void toSessionRecord(const KFrame& frame, SessionFrameRecord& record)
+{
+	record.serial = frame.serial;
+	record.reserved = 0;
+	record.timestamp = frame.timestamp;
+	for (uint j = 0; j < JointType_Count; j++) {
+		const KJoint& joint = frame.joints[j];
+		SessionJointRecord& jointRecord = record.joints[j];
+		jointRecord.position[0] = joint.position.x();
+		jointRecord.position[1] = joint.position.y();
+		jointRecord.position[2] = joint.position.z();
+		jointRecord.orientation[0] = joint.orientation.scalar();
+		jointRecord.orientation[1] = joint.orientation.x();
+		jointRecord.orientation[2] = joint.orientation.y();
+		jointRecord.orientation[3] = joint.orientation.z();
+		jointRecord.trackingState = joint.trackingState;
+	}
+}
+void fromSessionRecord(const SessionFrameRecord& record, KFrame& frame)
+{
+	frame.serial = record.serial;
+	frame.timestamp = record.timestamp;
+	for (uint j = 0; j < JointType_Count; j++) {
+		const SessionJointRecord& jointRecord = record.joints[j];
+		KJoint& joint = frame.joints[j];
+		joint.position = QVector3D(jointRecord.position[0], jointRecord.position[1], jointRecord.position[2]);
+		joint.orientation = QQuaternion(
+			jointRecord.orientation[0],
+			jointRecord.orientation[1],
+			jointRecord.orientation[2],
+			jointRecord.orientation[3]);
+		joint.trackingState = jointRecord.trackingState;
+	}
+}
+
+SessionFile::~SessionFile()
+{
+	close();
+}
+bool SessionFile::isSessionFile(const QString& fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	char magic[4];
+	return file.read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, SESSION_FILE_MAGIC, sizeof(magic)) == 0;
+}
+bool SessionFile::write(
+	const QString& fileName,
+	const SessionHeader& metadata,
+	const QVector<KFrame>* const motions[NUM_SESSION_PERSONS][NUM_SESSION_STAGES],
+	bool compress)
+{
+	SessionHeader header = metadata;
+	memcpy(header.magic, SESSION_FILE_MAGIC, sizeof(header.magic));
+	header.version = SESSION_FILE_VERSION;
+	header.frameRecordSize = sizeof(SessionFrameRecord);
+	header.jointCount = JointType_Count;
+	header.flags = (metadata.flags & ~SESSION_COMPRESSED) | (compress ? SESSION_COMPRESSED : 0);
+	header.reserved = 0;
+	QByteArray encoded[NUM_SESSION_PERSONS][NUM_SESSION_STAGES];
+	quint64 offset = alignSection(sizeof(SessionHeader));
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			header.sections[p][s].offset = offset;
+			header.sections[p][s].frameCount = motions[p][s] ? motions[p][s]->size() : 0;
+			if (compress) {
+				encoded[p][s] = MotionCodec::encode(motions[p][s] ? MotionView(*motions[p][s]) : MotionView());
+				header.sectionSizes[p][s] = encoded[p][s].size();
+			}
+			else {
+				header.sectionSizes[p][s] = header.sections[p][s].frameCount * sizeof(SessionFrameRecord);
+			}
+			offset = alignSection(offset + header.sectionSizes[p][s]);
+		}
+	}
+
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	QVector<SessionFrameRecord> records(recordsPerWrite);
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			static const char padding[sectionAlignment] = {};
+			file.write(padding, header.sections[p][s].offset - file.pos());
+			if (compress) {
+				file.write(encoded[p][s]);
+				continue;
+			}
+			if (!motions[p][s]) continue;
+			const QVector<KFrame>& motion = *motions[p][s];
+			for (int first = 0; first < motion.size(); first += recordsPerWrite) {
+				int count = qMin(recordsPerWrite, motion.size() - first);
+				for (int i = 0; i < count; i++) {
+					toSessionRecord(motion[first + i], records[i]);
+				}
+				file.write((const char*)records.constData(), count * sizeof(SessionFrameRecord));
+			}
+		}
+	}
+	return file.commit();
+}
+bool SessionFile::open(const QString& fileName)
+{
+	close();
+	m_file.setFileName(fileName);
+	if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < (qint64)sizeof(SessionHeader)) {
+		close();
+		return false;
+	}
+	m_data = m_file.map(0, m_file.size());
+	if (!m_data) {
+		close();
+		return false;
+	}
+	memcpy(&m_header, m_data, sizeof(m_header));
+	if (memcmp(m_header.magic, SESSION_FILE_MAGIC, sizeof(m_header.magic)) != 0 ||
+		m_header.version != SESSION_FILE_VERSION ||
+		m_header.frameRecordSize != sizeof(SessionFrameRecord) ||
+		m_header.jointCount != JointType_Count) {
+		cout << "Session file " << fileName.toStdString() << " has an unsupported version" << endl;
+		close();
+		return false;
+	}
+	if ((m_header.flags & (SESSION_DERIVED_ATHLETE | SESSION_DERIVED_TRAINER)) && !(m_header.interpolationInterval > 0.)) {
+		cout << "Session file " << fileName.toStdString() << " is corrupt" << endl;
+		close();
+		return false;
+	}
+	for (uint p = 0; p < NUM_SESSION_PERSONS; p++) {
+		for (uint s = 0; s < NUM_SESSION_STAGES; s++) {
+			const SessionSection& section = m_header.sections[p][s];
+			const quint64 size = m_header.sectionSizes[p][s];
+			if (section.offset % sectionAlignment != 0 ||
+				(isCompressed() ? section.frameCount > (quint64)INT_MAX :
+					section.frameCount > (quint64)m_file.size() / sizeof(SessionFrameRecord) ||
+					size != section.frameCount * sizeof(SessionFrameRecord)) ||
+				section.offset > (quint64)m_file.size() ||
+				size > (quint64)m_file.size() - section.offset) {
+				cout << "Session file " << fileName.toStdString() << " is corrupt" << endl;
+				close();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+void SessionFile::close()
+{
+	if (m_data) {
+		m_file.unmap(const_cast<uchar*>(m_data));
+		m_data = nullptr;
+	}
+	m_file.close();
+}
+bool SessionFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+bool SessionFile::isCompressed() const
+{
+	return (m_header.flags & SESSION_COMPRESSED) != 0;
+}
+const SessionHeader& SessionFile::header() const
+{
+	return m_header;
+}
+int SessionFile::frameCount(SessionPerson person, SessionStage stage) const
+{
+	return isOpen() ? (int)m_header.sections[person][stage].frameCount : 0;
+}
+const SessionFrameRecord* SessionFile::records(SessionPerson person, SessionStage stage) const
+{
+	if (!isOpen() || isCompressed()) {
+		return nullptr;
+	}
+	return (const SessionFrameRecord*)(m_data + m_header.sections[person][stage].offset);
+}
+MotionView SessionFile::view(SessionPerson person, SessionStage stage) const
+{
+	return MotionView(records(person, stage), frameCount(person, stage));
+}
+QVector<KFrame> SessionFile::readFrames(SessionPerson person, SessionStage stage, int first, int count) const
+{
+	QVector<KFrame> frames;
+	int size = frameCount(person, stage);
+	if (first < 0) first = 0;
+	if (count < 0 || first + count > size) count = size - first;
+	if (count <= 0) {
+		return frames;
+	}
+	if (isCompressed()) {
+		const char* data = (const char*)m_data + m_header.sections[person][stage].offset;
+		if (!MotionCodec::decode(data, m_header.sectionSizes[person][stage], frames) || frames.size() != size) {
+			cout << "Compressed section of " << m_file.fileName().toStdString() << " is corrupt" << endl;
+			return QVector<KFrame>();
+		}
+		return first == 0 && count == size ? frames : frames.mid(first, count);
+	}
+	frames.resize(count);
+	const SessionFrameRecord* sectionRecords = records(person, stage) + first;
+	for (int i = 0; i < count; i++) {
+		fromSessionRecord(sectionRecords[i], frames[i]);
+	}
+	return frames;
+}
@@ -0,0 +1,102 @@
+#ifndef SESSION_FILE_H
+#define SESSION_FILE_H
+
+// Project
+#include "kskeleton.h"
+#include "motion_view.h"
+
+// Qt
+#include <QtCore/QFile>
+#include <QtCore/QVector>
+
+// Session files hold both persons' motions at every processing stage:
+// header: magic, version, metadata (date, rates, phases, limb lengths) and the section table
+// sections: one per person and stage, SessionFrameRecord per frame
+// The records have a fixed size and every section starts 16 byte aligned, so a stage or a range
+// of frames is read or mapped on its own without parsing the rest of the file.
+// Archived sessions may be written with SESSION_COMPRESSED instead, every section is then a
+// motion_codec.h stream which is decoded whole when it is read.
+// A person with SESSION_DERIVED_ATHLETE or SESSION_DERIVED_TRAINER has only the raw motion stored,
+// the other stages are derived from it again when they are needed, with the header's parameters.
+#define SESSION_FILE_MAGIC "KSES"
+#define SESSION_FILE_VERSION 1 // increase when the layout of the header or the records changes
+// SessionHeader flags
+#define SESSION_COMPRESSED 0x1
+#define SESSION_DERIVED_ATHLETE 0x2
+#define SESSION_DERIVED_TRAINER 0x4
+
+struct SessionJointRecord
+{
+	float position[3];
+	float orientation[4]; // w, x, y, z
+	quint32 trackingState;
+};
+struct SessionFrameRecord
+{
+	qint32 serial;
+	quint32 reserved;
+	double timestamp;
+	SessionJointRecord joints[JointType_Count];
+};
+static_assert(sizeof(SessionFrameRecord) == 16 + 32 * JointType_Count, "SessionFrameRecord must not be padded");
+
+struct SessionSection
+{
+	quint64 offset; // from the start of the file
+	quint64 frameCount;
+};
+struct SessionHeader
+{
+	char magic[4];
+	quint32 version;
+	quint32 frameRecordSize; // guards against a different SessionFrameRecord layout
+	quint32 jointCount;
+	qint64 creationTime; // milliseconds since the epoch, UTC
+	double interpolationInterval; // seconds
+	double rawFrameRates[NUM_SESSION_PERSONS]; // average of the recording, 0 if there is none
+	quint32 phases[NUM_SESSION_PERSONS][NUM_PHASES]; // frames of the adjusted motion, INVALID_JOINT_ID if not found
+	float limbLengths[NUM_SESSION_PERSONS][NUM_LIMBS]; // desired lengths of the adjusted motion
+	SessionSection sections[NUM_SESSION_PERSONS][NUM_SESSION_STAGES];
+	quint64 sectionSizes[NUM_SESSION_PERSONS][NUM_SESSION_STAGES]; // bytes
+	quint32 flags;
+	quint32 reserved;
+	qint32 interpolationStarts[NUM_SESSION_PERSONS]; // of the derived stages
+	// with interpolationInterval, the processing parameters the derived stages are derived with
+	float adjustmentStrength;
+	float desiredLengths[NUM_LIMBS];
+};
+
+void toSessionRecord(const KFrame& frame, SessionFrameRecord& record);
+void fromSessionRecord(const SessionFrameRecord& record, KFrame& frame);
+
+// Read access to a session file, which stays mapped while it is open
+class SessionFile
+{
+public:
+	~SessionFile();
+	static bool isSessionFile(const QString& fileName); // checks the magic only
+	// motions are indexed by person and stage, null pointers are written as empty sections
+	static bool write(
+		const QString& fileName,
+		const SessionHeader& metadata,
+		const QVector<KFrame>* const motions[NUM_SESSION_PERSONS][NUM_SESSION_STAGES],
+		bool compress = false);
+
+	bool open(const QString& fileName); // validates the header and the section table
+	void close();
+	bool isOpen() const;
+	bool isCompressed() const;
+	const SessionHeader& header() const;
+	int frameCount(SessionPerson person, SessionStage stage) const;
+	// frameCount records, valid while the file is open, null if it is compressed
+	const SessionFrameRecord* records(SessionPerson person, SessionStage stage) const;
+	MotionView view(SessionPerson person, SessionStage stage) const; // of the mapped records, no copy
+	// count frames from first, clamped to the section, empty if a compressed section is corrupt
+	QVector<KFrame> readFrames(SessionPerson person, SessionStage stage, int first = 0, int count = -1) const;
+private:
+	QFile m_file;
+	const uchar* m_data = nullptr;
+	SessionHeader m_header;
+};
+
+#endif
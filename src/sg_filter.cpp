@@ -0,0 +1,169 @@
+// Own
+#include "sg_filter.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SG_FILTER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static void convolveScalar(const float* in, float* out, int size, const float* weights, int taps)
+{
+	for (int i = 0; i < size; i++) {
+		float sum = 0.f;
+		for (int k = 0; k < taps; k++) {
+			sum += in[i + k] * weights[k];
+		}
+		out[i] = sum;
+	}
+}
+
+#ifdef SG_FILTER_X86
+static void convolveSse2(const float* in, float* out, int size, const float* weights, int taps)
+{
+	int i = 0;
+	for (; i + 8 <= size; i += 8) {
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for (int k = 0; k < taps; k++) {
+			__m128 w = _mm_set1_ps(weights[k]);
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(in + i + k), w));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(in + i + k + 4), w));
+		}
+		_mm_storeu_ps(out + i, sum0);
+		_mm_storeu_ps(out + i + 4, sum1);
+	}
+	convolveScalar(in + i, out + i, size - i, weights, taps);
+}
+TARGET_AVX2 static void convolveAvx2(const float* in, float* out, int size, const float* weights, int taps)
+{
+	int i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for (int k = 0; k < taps; k++) {
+			__m256 w = _mm256_set1_ps(weights[k]);
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(in + i + k), w));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(in + i + k + 8), w));
+		}
+		_mm256_storeu_ps(out + i, sum0);
+		_mm256_storeu_ps(out + i + 8, sum1);
+	}
+	for (; i + 8 <= size; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < taps; k++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(in + i + k), _mm256_set1_ps(weights[k])));
+		}
+		_mm256_storeu_ps(out + i, sum);
+	}
+	convolveScalar(in + i, out + i, size - i, weights, taps);
+}
+static bool cpuSupportsSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & (1 << 26));
+#endif
+}
+static bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 6) != 6) return false; // xmm and ymm state saved by the os
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef void (*ConvolveFunction)(const float*, float*, int, const float*, int);
+
+static SavitzkyGolayFilter::InstructionSet supportedInstructionSet()
+{
+#ifdef SG_FILTER_X86
+	if (cpuSupportsAvx2()) return SavitzkyGolayFilter::InstructionSet::AVX2;
+	if (cpuSupportsSse2()) return SavitzkyGolayFilter::InstructionSet::SSE2;
+#endif
+	return SavitzkyGolayFilter::InstructionSet::SCALAR;
+}
+static SavitzkyGolayFilter::InstructionSet& selectedInstructionSet()
+{
+	static SavitzkyGolayFilter::InstructionSet instructionSet = supportedInstructionSet();
+	return instructionSet;
+}
+static ConvolveFunction convolveFunction()
+{
+	switch (selectedInstructionSet()) {
+#ifdef SG_FILTER_X86
+	case SavitzkyGolayFilter::InstructionSet::AVX2: return convolveAvx2;
+	case SavitzkyGolayFilter::InstructionSet::SSE2: return convolveSse2;
+#endif
+	default: return convolveScalar;
+	}
+}
+
+SavitzkyGolayFilter::SavitzkyGolayFilter(const float* coefficients, int taps, float scale)
+	:
+	m_weights(taps)
+{
+	for (int k = 0; k < taps; k++) {
+		m_weights[k] = coefficients[k] * scale;
+	}
+}
+int SavitzkyGolayFilter::taps() const
+{
+	return m_weights.size();
+}
+void SavitzkyGolayFilter::convolve(const float* in, float* out, int size) const
+{
+	if (size <= 0) return;
+	convolveFunction()(in, out, size, m_weights.constData(), m_weights.size());
+}
+void SavitzkyGolayFilter::convolve(const float* in, int inStride, float* out, int outStride, int channels, int size) const
+{
+	if (size <= 0) return;
+	ConvolveFunction function = convolveFunction();
+	for (int c = 0; c < channels; c++) {
+		function(in + c * inStride, out + c * outStride, size, m_weights.constData(), m_weights.size());
+	}
+}
+SavitzkyGolayFilter::InstructionSet SavitzkyGolayFilter::instructionSet()
+{
+	return selectedInstructionSet();
+}
+void SavitzkyGolayFilter::setInstructionSet(InstructionSet instructionSet)
+{
+	if ((int)instructionSet > (int)supportedInstructionSet()) {
+		instructionSet = supportedInstructionSet();
+	}
+	selectedInstructionSet() = instructionSet;
+}
+const char* SavitzkyGolayFilter::instructionSetName()
+{
+	switch (selectedInstructionSet()) {
+	case InstructionSet::AVX2: return "AVX2";
+	case InstructionSet::SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
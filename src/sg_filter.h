@@ -0,0 +1,31 @@
+#ifndef SG_FILTER_H
+#define SG_FILTER_H
+
+// Qt
+#include <QtCore/QVector>
+
+// Savitzky-Golay (or any FIR) filter over contiguous float channels:
+// out[i] = sum over k of in[i + k] * coefficients[k] * scale, for 0 <= i < size.
+// The kernel is selected at runtime (AVX2, SSE2 or scalar) and vectorises across frames.
+// Every kernel sums the taps in the same order without fused multiply-adds,
+// so all of them produce identical results.
+class SavitzkyGolayFilter
+{
+public:
+	enum class InstructionSet { SCALAR, SSE2, AVX2 };
+
+	SavitzkyGolayFilter(const float* coefficients, int taps, float scale);
+
+	int taps() const;
+	void convolve(const float* in, float* out, int size) const;
+	// channels are laid out inStride/outStride floats apart
+	void convolve(const float* in, int inStride, float* out, int outStride, int channels, int size) const;
+
+	static InstructionSet instructionSet();
+	static void setInstructionSet(InstructionSet instructionSet); // capped at what the cpu supports
+	static const char* instructionSetName();
+private:
+	QVector<float> m_weights;
+};
+
+#endif
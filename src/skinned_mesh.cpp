@@ -2,12 +2,17 @@
 #include "skinned_mesh.h"
 
 // Qt
+#include <QtCore\QCryptographicHash>
+#include <QtCore\QFile>
+#include <QtCore\QSaveFile>
+#include <QtCore\QTextStream>
 #include <QtGui\QVector2D>
 #include <QtGui\QImage>
 #include <QtGui\QMatrix4x4>
 
 // Standard C/C++
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 
@@ -77,8 +82,15 @@ void SkinnedMesh::clear()
 	m_texCoords.clear();
 	m_vertexBoneData.clear();
 	m_indices.clear();
-	m_images.clear();
+	m_imagePaths.clear();
 	m_boneInfo.clear();
+	m_boneMap.clear();
+	m_numBones = 0;
+	m_boneTransformRecords.clear();
+	m_nodes.clear();
+	m_nodeNames.clear();
+	m_nodeGlobals.clear();
+	m_boneTransforms.clear();
 }
 bool SkinnedMesh::loadFromFile(const string& fileName)
 {
@@ -86,6 +98,24 @@ bool SkinnedMesh::loadFromFile(const string& fileName)
 
     bool ret = false;
 	string filePath = "models/" + fileName;
+	string cachePath = filePath + ".cache";
+
+	QByteArray sourceHash;
+	QFile source(QString::fromStdString(filePath));
+	if (source.open(QIODevice::ReadOnly)) {
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(&source);
+		sourceHash = hash.result();
+		source.close();
+	}
+
+	if (!sourceHash.isEmpty() && readCache(cachePath, sourceHash)) {
+		m_successfullyLoaded = true;
+		cout << "Loaded SkinnedMesh from " << cachePath << endl;
+		return true;
+	}
+	clear();
+
     m_pScene = m_Importer.ReadFile(filePath.c_str(), ASSIMP_LOAD_FLAGS);    
     if (m_pScene) {  
         ret = initFromScene(m_pScene, filePath);
@@ -97,6 +127,9 @@ bool SkinnedMesh::loadFromFile(const string& fileName)
 	m_successfullyLoaded = ret;
 	if (m_successfullyLoaded) {
 		cout << "Loaded SkinnedMesh from " << filePath << endl;
+		if (!sourceHash.isEmpty() && !writeCache(cachePath, sourceHash)) {
+			cout << "Could not write mesh cache " << cachePath << endl;
+		}
 	}
     return ret;
 }
@@ -129,15 +162,272 @@ bool SkinnedMesh::initFromScene(const aiScene* pScene, const string& filename)
 		initMesh(i, paiMesh);
 	}
 
+	initDefaultLocalMatrices(m_pScene->mRootNode);
+	compileNodeHierarchy(m_pScene->mRootNode, -1);
+	initBones();
+	initImages(m_pScene, filename);
+
+	return true;
+}
+void SkinnedMesh::initBones()
+{
 	m_controlQuats.resize(m_numBones);
 	m_controlMats.resize(m_numBones);
 	m_boneInfo.resize(m_numBones);
-	m_boneTransformInfo.resize(m_numBones);
+	m_boneTransformRecords.assign(m_numBones, BoneTransformRecord());
 
-	initDefaultLocalMatrices(m_pScene->mRootNode);
+	for (int n = 0; n < m_nodes.size(); n++) {
+		if (m_nodes[n].bone >= 0) {
+			m_boneInfo[m_nodes[n].bone].defaultLocal = m_nodes[n].local;
+		}
+	}
 	correctLocalMatrices();
-	initImages(m_pScene, filename);
+	m_nodeGlobals.resize(m_nodes.size());
+	m_boneTransforms.resize(m_numBones);
+	resolveKinectJoints();
+}
+// Mesh cache file: header, then every section at a 16 byte aligned offset
+enum MeshCacheSection
+{
+	CACHE_POSITIONS,	// QVector3D per vertex
+	CACHE_NORMALS,		// QVector3D per vertex
+	CACHE_TEXCOORDS,	// QVector2D per vertex
+	CACHE_BONE_DATA,	// VertexBoneData per vertex
+	CACHE_INDICES,		// uint
+	CACHE_MESH_ENTRIES,	// MeshEntry
+	CACHE_BONE_OFFSETS,	// column major 4x4 floats per bone
+	CACHE_NODES,		// MeshCacheNode per node, parents first
+	CACHE_BONE_NAMES,	// '\0' terminated, in bone index order
+	CACHE_NODE_NAMES,	// '\0' terminated, in node order
+	CACHE_IMAGE_PATHS,	// '\0' terminated
+	NUM_CACHE_SECTIONS
+};
+struct MeshCacheHeader
+{
+	char magic[4];
+	quint32 version;
+	quint32 loadFlags;
+	quint32 sizeOfBoneData; // guards against a different VertexBoneData layout
+	char sourceHash[20];	// SHA-1 of the model file
+	quint32 numVertices;
+	quint32 numIndices;
+	quint32 numMeshEntries;
+	quint32 numBones;
+	quint32 numNodes;
+	quint32 numImages;
+	quint64 sectionOffsets[NUM_CACHE_SECTIONS];
+	quint64 sectionSizes[NUM_CACHE_SECTIONS];
+};
+struct MeshCacheNode
+{
+	qint32 parent;
+	qint32 bone;
+	qint32 pelvis;
+	float local[16]; // column major
+};
+static const char meshCacheMagic[4] = { 'D', 'M', 'S', 'H' };
+static QByteArray joinStrings(const vector<string>& strings)
+{
+	QByteArray joined;
+	for (uint i = 0; i < strings.size(); i++) {
+		joined.append(strings[i].c_str(), (int)strings[i].size() + 1);
+	}
+	return joined;
+}
+static bool splitStrings(const char* data, quint64 size, uint count, vector<string>& strings)
+{
+	strings.clear();
+	const char* end = data + size;
+	while (data < end && strings.size() < count) {
+		const char* terminator = (const char*)memchr(data, '\0', end - data);
+		if (!terminator) break;
+		strings.push_back(string(data, terminator));
+		data = terminator + 1;
+	}
+	return strings.size() == count;
+}
+bool SkinnedMesh::readCache(const string& cachePath, const QByteArray& sourceHash)
+{
+	QFile file(QString::fromStdString(cachePath));
+	if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(MeshCacheHeader)) {
+		return false;
+	}
+	const uchar* data = file.map(0, file.size());
+	if (!data) {
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, meshCacheMagic, sizeof(header.magic)) != 0 ||
+		header.version != MESH_CACHE_VERSION ||
+		header.loadFlags != (quint32)(ASSIMP_LOAD_FLAGS) ||
+		header.sizeOfBoneData != sizeof(VertexBoneData) ||
+		sourceHash.size() != sizeof(header.sourceHash) ||
+		memcmp(header.sourceHash, sourceHash.constData(), sizeof(header.sourceHash)) != 0) {
+		cout << "Mesh cache " << cachePath << " is out of date" << endl;
+		return false;
+	}
+	const quint64 expectedSizes[NUM_CACHE_SECTIONS] = {
+		sizeof(QVector3D) * header.numVertices,
+		sizeof(QVector3D) * header.numVertices,
+		sizeof(QVector2D) * header.numVertices,
+		sizeof(VertexBoneData) * header.numVertices,
+		sizeof(uint) * header.numIndices,
+		sizeof(MeshEntry) * header.numMeshEntries,
+		sizeof(float) * 16 * header.numBones,
+		sizeof(MeshCacheNode) * header.numNodes,
+		header.sectionSizes[CACHE_BONE_NAMES],
+		header.sectionSizes[CACHE_NODE_NAMES],
+		header.sectionSizes[CACHE_IMAGE_PATHS]
+	};
+	for (uint i = 0; i < NUM_CACHE_SECTIONS; i++) {
+		if (header.sectionSizes[i] != expectedSizes[i] ||
+			header.sectionOffsets[i] + header.sectionSizes[i] > (quint64)file.size()) {
+			cout << "Mesh cache " << cachePath << " is corrupt" << endl;
+			return false;
+		}
+	}
+	const uchar* sections[NUM_CACHE_SECTIONS];
+	for (uint i = 0; i < NUM_CACHE_SECTIONS; i++) {
+		sections[i] = data + header.sectionOffsets[i];
+	}
+
+	// names first, so that a corrupt file leaves nothing half loaded
+	vector<string> boneNames;
+	if (!splitStrings((const char*)sections[CACHE_BONE_NAMES], header.sectionSizes[CACHE_BONE_NAMES], header.numBones, boneNames) ||
+		!splitStrings((const char*)sections[CACHE_NODE_NAMES], header.sectionSizes[CACHE_NODE_NAMES], header.numNodes, m_nodeNames) ||
+		!splitStrings((const char*)sections[CACHE_IMAGE_PATHS], header.sectionSizes[CACHE_IMAGE_PATHS], header.numImages, m_imagePaths)) {
+		cout << "Mesh cache " << cachePath << " is corrupt" << endl;
+		return false;
+	}
+
+	// vertex data, copied as is
+	m_numVertices = header.numVertices;
+	m_positions.resize(header.numVertices);
+	memcpy(m_positions.data(), sections[CACHE_POSITIONS], header.sectionSizes[CACHE_POSITIONS]);
+	m_normals.resize(header.numVertices);
+	memcpy(m_normals.data(), sections[CACHE_NORMALS], header.sectionSizes[CACHE_NORMALS]);
+	m_texCoords.resize(header.numVertices);
+	memcpy(m_texCoords.data(), sections[CACHE_TEXCOORDS], header.sectionSizes[CACHE_TEXCOORDS]);
+	m_vertexBoneData.resize(header.numVertices);
+	memcpy(m_vertexBoneData.data(), sections[CACHE_BONE_DATA], header.sectionSizes[CACHE_BONE_DATA]);
+	m_indices.resize(header.numIndices);
+	memcpy(m_indices.data(), sections[CACHE_INDICES], header.sectionSizes[CACHE_INDICES]);
+	m_meshEntries.resize(header.numMeshEntries);
+	memcpy(m_meshEntries.data(), sections[CACHE_MESH_ENTRIES], header.sectionSizes[CACHE_MESH_ENTRIES]);
+
+	// bones
+	m_numBones = header.numBones;
+	m_boneInfo.resize(m_numBones);
+	const float* offsets = (const float*)sections[CACHE_BONE_OFFSETS];
+	for (uint i = 0; i < m_numBones; i++) {
+		m_boneMap[boneNames[i]] = i;
+		memcpy(m_boneInfo[i].offset.data(), offsets + 16 * i, sizeof(float) * 16);
+	}
+
+	// node hierarchy
+	m_nodes.resize(header.numNodes);
+	const MeshCacheNode* nodes = (const MeshCacheNode*)sections[CACHE_NODES];
+	for (uint n = 0; n < header.numNodes; n++) {
+		m_nodes[n].parent = nodes[n].parent;
+		m_nodes[n].bone = nodes[n].bone;
+		m_nodes[n].kinectJoint = -1;
+		m_nodes[n].pelvis = (nodes[n].pelvis != 0);
+		memcpy(m_nodes[n].local.data(), nodes[n].local, sizeof(float) * 16);
+	}
+
+	file.close();
 
+	initBones();
+	return true;
+}
+bool SkinnedMesh::writeCache(const string& cachePath, const QByteArray& sourceHash) const
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, meshCacheMagic, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.loadFlags = ASSIMP_LOAD_FLAGS;
+	header.sizeOfBoneData = sizeof(VertexBoneData);
+	if (sourceHash.size() != sizeof(header.sourceHash)) {
+		return false;
+	}
+	memcpy(header.sourceHash, sourceHash.constData(), sizeof(header.sourceHash));
+	header.numVertices = m_positions.size();
+	header.numIndices = m_indices.size();
+	header.numMeshEntries = m_meshEntries.size();
+	header.numBones = m_numBones;
+	header.numNodes = m_nodes.size();
+	header.numImages = m_imagePaths.size();
+
+	QVector<float> offsets(16 * m_numBones);
+	for (uint i = 0; i < m_numBones; i++) {
+		memcpy(offsets.data() + 16 * i, m_boneInfo[i].offset.constData(), sizeof(float) * 16);
+	}
+	QVector<MeshCacheNode> nodes(m_nodes.size());
+	for (int n = 0; n < m_nodes.size(); n++) {
+		nodes[n].parent = m_nodes[n].parent;
+		nodes[n].bone = m_nodes[n].bone;
+		nodes[n].pelvis = m_nodes[n].pelvis ? 1 : 0;
+		memcpy(nodes[n].local, m_nodes[n].local.constData(), sizeof(float) * 16);
+	}
+	vector<string> boneNames(m_numBones);
+	for (const auto& bone : m_boneMap) {
+		boneNames[bone.second] = bone.first;
+	}
+	QByteArray boneNamesData = joinStrings(boneNames);
+	QByteArray nodeNamesData = joinStrings(m_nodeNames);
+	QByteArray imagePathsData = joinStrings(m_imagePaths);
+
+	const void* sectionData[NUM_CACHE_SECTIONS] = {
+		m_positions.constData(),
+		m_normals.constData(),
+		m_texCoords.constData(),
+		m_vertexBoneData.constData(),
+		m_indices.constData(),
+		m_meshEntries.constData(),
+		offsets.constData(),
+		nodes.constData(),
+		boneNamesData.constData(),
+		nodeNamesData.constData(),
+		imagePathsData.constData()
+	};
+	header.sectionSizes[CACHE_POSITIONS] = sizeof(QVector3D) * m_positions.size();
+	header.sectionSizes[CACHE_NORMALS] = sizeof(QVector3D) * m_normals.size();
+	header.sectionSizes[CACHE_TEXCOORDS] = sizeof(QVector2D) * m_texCoords.size();
+	header.sectionSizes[CACHE_BONE_DATA] = sizeof(VertexBoneData) * m_vertexBoneData.size();
+	header.sectionSizes[CACHE_INDICES] = sizeof(uint) * m_indices.size();
+	header.sectionSizes[CACHE_MESH_ENTRIES] = sizeof(MeshEntry) * m_meshEntries.size();
+	header.sectionSizes[CACHE_BONE_OFFSETS] = sizeof(float) * offsets.size();
+	header.sectionSizes[CACHE_NODES] = sizeof(MeshCacheNode) * nodes.size();
+	header.sectionSizes[CACHE_BONE_NAMES] = boneNamesData.size();
+	header.sectionSizes[CACHE_NODE_NAMES] = nodeNamesData.size();
+	header.sectionSizes[CACHE_IMAGE_PATHS] = imagePathsData.size();
+	quint64 offset = (sizeof(header) + 15) & ~(quint64)15;
+	for (uint i = 0; i < NUM_CACHE_SECTIONS; i++) {
+		header.sectionOffsets[i] = offset;
+		offset = (offset + header.sectionSizes[i] + 15) & ~(quint64)15;
+	}
+
+	// the file replaces the previous cache only once it is complete
+	QSaveFile file(QString::fromStdString(cachePath));
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	const char padding[16] = { 0 };
+	quint64 position = 0;
+	file.write((const char*)&header, sizeof(header));
+	position += sizeof(header);
+	for (uint i = 0; i < NUM_CACHE_SECTIONS; i++) {
+		file.write(padding, header.sectionOffsets[i] - position);
+		file.write((const char*)sectionData[i], header.sectionSizes[i]);
+		position = header.sectionOffsets[i] + header.sectionSizes[i];
+	}
+	if (!file.commit()) {
+		return false;
+	}
+	cout << "Wrote mesh cache " << cachePath << endl;
 	return true;
 }
 void SkinnedMesh::initMesh(uint meshIndex, const aiMesh* paiMesh)
@@ -232,8 +522,7 @@ bool SkinnedMesh::initImages(const aiScene* pScene, const string& fileName)
 					p = p.substr(2, p.size() - 2);
 				}
 				string fullPath = string(directory + "\\" + p).c_str();
-				cout << "Loading image: " << fullPath << endl;
-				m_images.push_back(QImage(QString::fromStdString(fullPath)));
+				m_imagePaths.push_back(fullPath);
 				ret = true;
 			}
 		}
@@ -397,81 +686,87 @@ void SkinnedMesh::initKBoneMap()
 	m_kboneMap["calf_r"    ] = JointType_AnkleRight   ;
 	//m_kboneMap["foot_l"    ] = JointType_FootLeft     ;
 	//m_kboneMap["foot_r"    ] = JointType_FootRight    ;
+
+	resolveKinectJoints();
 }
-void SkinnedMesh::calculateBoneTransforms(const aiNode* pNode, const QMatrix4x4& P, const array<KJoint, JointType_Count>& joints)
+void SkinnedMesh::compileNodeHierarchy(const aiNode* pNode, int parent)
 {
-	QString nodeName(pNode->mName.data);
-	QMatrix4x4 L = toQMatrix(pNode->mTransformation);
-	QMatrix4x4 G;
-
-	const auto& it = m_boneMap.find(nodeName.toStdString());
-	if (it == m_boneMap.end()){ // is not a bone
-		G = P * L;
+	SkinnedMeshNode node;
+	node.parent = parent;
+	const auto& it = m_boneMap.find(pNode->mName.data);
+	node.bone = (it == m_boneMap.end()) ? -1 : (int)it->second;
+	node.kinectJoint = -1;
+	node.pelvis = (strcmp(pNode->mName.data, "pelvis") == 0);
+	node.local = toQMatrix(pNode->mTransformation);
+	int index = m_nodes.size();
+	m_nodes.push_back(node);
+	m_nodeNames.push_back(pNode->mName.data);
+	for (uint i = 0; i < pNode->mNumChildren; i++) {
+		compileNodeHierarchy(pNode->mChildren[i], index);
+	}
+}
+void SkinnedMesh::resolveKinectJoints()
+{
+	for (int n = 0; n < m_nodes.size(); n++) {
+		const auto& kit = m_kboneMap.find(m_nodeNames[n]);
+		m_nodes[n].kinectJoint = (kit == m_kboneMap.end()) ? -1 : (int)kit->second;
 	}
-	else { // is a bone
-		uint i = it->second;
-		QQuaternion q;
-		QString qs;
-		QTextStream qts(&qs);
+}
+void SkinnedMesh::calculateBoneTransforms(const array<KJoint, JointType_Count>& joints)
+{
+	static const QMatrix4x4 identity;
+	for (int n = 0; n < m_nodes.size(); n++) {
+		const SkinnedMeshNode& node = m_nodes[n];
+		const QMatrix4x4& P = (node.parent < 0) ? identity : m_nodeGlobals[node.parent];
+		const QMatrix4x4& L = node.local;
+		QMatrix4x4& G = m_nodeGlobals[n];
 
-		qts << "\nBoneName=" << nodeName << " Index=" << i << endl;
-		
-		q = extractQuaternion(L);
-		qts << "Default local quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
-		qts << "Default local transformation:\n" << toString(L);
+		if (node.bone < 0) { // is not a bone
+			G = P * L;
+			continue;
+		}
+
+		uint i = node.bone;
+		BoneTransformRecord& record = m_boneTransformRecords[i];
+		record.defaultLocal = L;
+		record.parentGlobal = P;
 
 		QMatrix4x4 localTransformation(L);
-		const auto& kit = m_kboneMap.find(nodeName.toStdString());
-		if (m_parameters[1] && kit != m_kboneMap.end()) {
-			uint k = kit->second;
+		record.kinect = m_parameters[1] && node.kinectJoint >= 0;
+		if (record.kinect) {
 			// calculate scaling from Kinect
 			QMatrix4x4 kinectScaling = QMatrix();
 			
 			// calculate rotation from Kinect
-			QQuaternion absQ = joints[k].orientation;
+			QQuaternion absQ = joints[node.kinectJoint].orientation;
 			QQuaternion parQ = extractQuaternion(P);
 			QQuaternion relQ = parQ.inverted() * absQ;
 			QMatrix4x4 kinectRotation = fromRotation(relQ);
-			qts << "Kinect rotation abs: " << toString(absQ) << toStringEulerAngles(absQ) << toStringAxisAngle(absQ) << endl;
-			qts << "Parent rotation abs: " << toString(parQ) << toStringEulerAngles(parQ) << toStringAxisAngle(parQ) << endl;
-			qts << "Parent rotation inv: " << toString(parQ.inverted()) << toStringEulerAngles(parQ.inverted()) << toStringAxisAngle(parQ.inverted()) << endl;
-			qts << "Kinect rotation rel: " << toString(relQ) << toStringEulerAngles(relQ) << toStringAxisAngle(relQ) << endl;
-			qts << "Kinect local orientation: " << toString(relQ) << toStringEulerAngles(relQ) << toStringAxisAngle(relQ) << endl;
+			record.kinectAbsolute = absQ;
 
 			// calculate translation from Kinect
 			QMatrix4x4 kinectTranslation = getTranslationPart(L);
-			if (nodeName == "pelvis") kinectTranslation = fromTranslation(QVector3D(0.f, 0.f, 0.f));
-			QVector3D v = QVector3D(kinectTranslation(0, 3), kinectTranslation(1, 3), kinectTranslation(2, 3));
-			qts << "Kinect local translation: " << toStringCartesian(v) << endl;
+			if (node.pelvis) kinectTranslation = fromTranslation(QVector3D(0.f, 0.f, 0.f));
 
 			localTransformation = kinectTranslation * kinectRotation * kinectScaling;
-			qts << "Kinect local transformation:\n" << toString(localTransformation);
+			record.kinectLocal = localTransformation;
 		}
 		
+		record.corrected = m_parameters[2];
 		if (m_parameters[2]) {
-			q = extractQuaternion(m_boneInfo[i].localCorrection);
-			qts << "Correction quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
-			qts << "Correction transformation:\n" << toString(m_boneInfo[i].localCorrection);
-			
-			if (m_parameters[1] && kit!=m_kboneMap.end()) {
+			if (record.kinect) {
 				localTransformation = localTransformation * m_boneInfo[i].localCorrection;
 			}
 			else {
 				localTransformation = m_boneInfo[i].correctedLocal;
 			}
 		}
-
-		q = extractQuaternion(localTransformation);
-		qts << "Local quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
-		qts << "Local transformation:\n" << toString(localTransformation);
+		record.local = localTransformation;
 
 		QMatrix4x4 controlRot; // initialized as identity matrix
+		record.controlled = m_parameters[3];
 		if (m_parameters[3]) {
 			controlRot = m_controlMats[i];
-
-			q = m_controlQuats[i];
-			qts << "Control quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
-			qts << "Control transformation:\n" << toString(m_controlMats[i]);
 		}
 		if (!m_parameters[4]) localTransformation = QMatrix4x4();
 
@@ -483,22 +778,22 @@ void SkinnedMesh::calculateBoneTransforms(const aiNode* pNode, const QMatrix4x4&
 		m_boneInfo[i].global = G;
 		m_boneInfo[i].combined = G * m_boneInfo[i].offset;
 		if (!m_parameters[0]) m_boneInfo[i].combined = m_boneInfo[i].offset;
-		
-		qts << "Parent's Global transformation:\n" << toString(P);
-		qts << "Global transformation:\n" << toString(G);
-		qts << "Offset transformation:\n" << toString(m_boneInfo[i].offset);
-		qts << "Combined transformation:\n" << toString(m_boneInfo[i].combined);
+		m_boneTransforms[i] = m_boneInfo[i].combined;
 
 		QVector3D positionGlobal = m_boneInfo[i].global * QVector3D(QVector4D(0.f, 0.f, 0.f, 1.f));
 		m_boneInfo[i].endPosition = positionGlobal;
-		qts << "Bone position (from global): " << toStringCartesian(positionGlobal);
-
-		qts << flush;
-		m_boneTransformInfo[findBoneId(nodeName)] = qs;
+		record.calculated = true;
 	}
-
-	for (uint i = 0; i < pNode->mNumChildren; i++) {
-		calculateBoneTransforms(pNode->mChildren[i], G, joints);
+}
+void SkinnedMesh::calculateBoneTransforms(const QVector<KFrame>& motion, QVector<QMatrix4x4>& combined)
+{
+	combined.resize(motion.size() * m_numBones);
+	for (int f = 0; f < motion.size(); f++) {
+		calculateBoneTransforms(motion[f].joints);
+		QMatrix4x4* frameCombined = combined.data() + f * m_numBones;
+		for (uint b = 0; b < m_numBones; b++) {
+			frameCombined[b] = m_boneInfo[b].combined;
+		}
 	}
 }
 float SkinnedMesh::boneRotationX(const QString &boneName) const
@@ -594,7 +889,64 @@ void SkinnedMesh::setBoneVisibility(const QString &boneName, bool state)
 }
 QString SkinnedMesh::boneTransformInfo(const QString& boneName) const
 {
-	return m_boneTransformInfo[findBoneId(boneName)];
+	uint i = findBoneId(boneName);
+	if (i >= m_boneTransformRecords.size()) {
+		return QString();
+	}
+	const BoneTransformRecord& record = m_boneTransformRecords[i];
+	const BoneInfo& bi = m_boneInfo[i];
+	QString qs;
+	QTextStream qts(&qs);
+	if (!record.calculated) {
+		qts << "\nBoneName=" << boneName << " Index=" << i << " has not been transformed yet." << flush;
+		return qs;
+	}
+
+	QQuaternion q;
+	qts << "\nBoneName=" << boneName << " Index=" << i << endl;
+	
+	q = extractQuaternion(record.defaultLocal);
+	qts << "Default local quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
+	qts << "Default local transformation:\n" << toString(record.defaultLocal);
+
+	if (record.kinect) {
+		QQuaternion absQ = record.kinectAbsolute;
+		QQuaternion parQ = extractQuaternion(record.parentGlobal);
+		QQuaternion relQ = parQ.inverted() * absQ;
+		qts << "Kinect rotation abs: " << toString(absQ) << toStringEulerAngles(absQ) << toStringAxisAngle(absQ) << endl;
+		qts << "Parent rotation abs: " << toString(parQ) << toStringEulerAngles(parQ) << toStringAxisAngle(parQ) << endl;
+		qts << "Parent rotation inv: " << toString(parQ.inverted()) << toStringEulerAngles(parQ.inverted()) << toStringAxisAngle(parQ.inverted()) << endl;
+		qts << "Kinect rotation rel: " << toString(relQ) << toStringEulerAngles(relQ) << toStringAxisAngle(relQ) << endl;
+		qts << "Kinect local orientation: " << toString(relQ) << toStringEulerAngles(relQ) << toStringAxisAngle(relQ) << endl;
+		QVector3D v = QVector3D(record.kinectLocal(0, 3), record.kinectLocal(1, 3), record.kinectLocal(2, 3));
+		qts << "Kinect local translation: " << toStringCartesian(v) << endl;
+		qts << "Kinect local transformation:\n" << toString(record.kinectLocal);
+	}
+
+	if (record.corrected) {
+		q = extractQuaternion(bi.localCorrection);
+		qts << "Correction quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
+		qts << "Correction transformation:\n" << toString(bi.localCorrection);
+	}
+
+	q = extractQuaternion(record.local);
+	qts << "Local quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
+	qts << "Local transformation:\n" << toString(record.local);
+
+	if (record.controlled) {
+		q = m_controlQuats[i];
+		qts << "Control quaternion: " << toString(q) << toStringEulerAngles(q) << toStringAxisAngle(q) << endl;
+		qts << "Control transformation:\n" << toString(m_controlMats[i]);
+	}
+
+	qts << "Parent's Global transformation:\n" << toString(record.parentGlobal);
+	qts << "Global transformation:\n" << toString(bi.global);
+	qts << "Offset transformation:\n" << toString(bi.offset);
+	qts << "Combined transformation:\n" << toString(bi.combined);
+	qts << "Bone position (from global): " << toStringCartesian(bi.endPosition);
+
+	qts << flush;
+	return qs;
 }
 QVector<QVector3D>& SkinnedMesh::positions()
 {
@@ -616,9 +968,9 @@ QVector<uint>& SkinnedMesh::indices()
 {
 	return m_indices;
 }
-QVector<QImage>& SkinnedMesh::images()
+const vector<string>& SkinnedMesh::imagePaths() const
 {
-	return m_images;
+	return m_imagePaths;
 }
 QVector<MeshEntry>& SkinnedMesh::meshEntries()
 {
@@ -628,6 +980,10 @@ uint SkinnedMesh::numBones() const
 {
 	return m_numBones;
 }
+const QVector<QMatrix4x4>& SkinnedMesh::boneTransforms() const
+{
+	return m_boneTransforms;
+}
 const map<string, uint>& SkinnedMesh::boneMap() const
 {
 	return m_boneMap;
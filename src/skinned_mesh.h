@@ -19,6 +19,7 @@
 #include <bitset>
 
 #define ASSIMP_LOAD_FLAGS aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices  | aiProcess_LimitBoneWeights 
+#define MESH_CACHE_VERSION 1 // increase when the layout of the mesh cache files changes
 #define NUM_PARAMETERS 10
 
 #define NUM_BONES_PER_VERTEX 4
@@ -90,6 +91,30 @@ struct BoneInfo
 	}
 };
 
+// Node of the flattened hierarchy, parents come before their children
+struct SkinnedMeshNode
+{
+	int parent;			// node index, -1 for the root
+	int bone;			// bone index, -1 if the node is not a bone
+	int kinectJoint;	// JointType driving the bone, -1 if none
+	bool pelvis;		// has no translation when driven by the Kinect
+	QMatrix4x4 local;	// node transformation
+};
+
+// Intermediate results of calculateBoneTransforms, formatted only when boneTransformInfo is requested
+struct BoneTransformRecord
+{
+	QMatrix4x4 defaultLocal;	// node transformation
+	QMatrix4x4 parentGlobal;
+	QQuaternion kinectAbsolute;
+	QMatrix4x4 kinectLocal;
+	QMatrix4x4 local;			// before the control rotation
+	bool kinect = false;
+	bool corrected = false;
+	bool controlled = false;
+	bool calculated = false;
+};
+
 class SkinnedMesh
 {
 public:
@@ -97,7 +122,9 @@ public:
 	~SkinnedMesh();	
 	bool loadFromFile(const string& basename);
 
-	void calculateBoneTransforms(const aiNode* pNode, const QMatrix4x4& P, const array<KJoint, JointType_Count>& joints);
+	void calculateBoneTransforms(const array<KJoint, JointType_Count>& joints);
+	// Combined transformations of every frame, numBones() per frame. The mesh is left in the last pose.
+	void calculateBoneTransforms(const QVector<KFrame>& motion, QVector<QMatrix4x4>& combined);
 	void correctLocalMatrices();
 	void printInfo() const;
 	void printNodeHierarchy(const aiNode* pNode) const;
@@ -118,6 +145,7 @@ public:
 	const QMatrix4x4& boneGlobal(uint boneIndex) const;
 	const QVector3D& boneEndPosition(uint boneIndex) const;
 	const BoneInfo& boneInfo(uint boneIndex) const;
+	const QVector<QMatrix4x4>& boneTransforms() const; // combined transformations, the skinning palette
 
 	uint findBoneId(const QString &boneName) const;
 	bool boneVisibility(uint boneIndex) const;
@@ -134,7 +162,7 @@ public:
 	QVector<QVector2D>& texCoords();
 	QVector<VertexBoneData>& vertexBoneData();
 	QVector<uint>& indices();
-	QVector<QImage>& images();
+	const vector<string>& imagePaths() const; // one per material, decoded by the caller
 
 	QVector3D getPelvisOffset();
 	bool parameter(uint i) const;
@@ -148,6 +176,12 @@ private:
 	void checkWeights(uint meshIndex, const aiMesh* pMesh);
 	bool initImages(const aiScene* pScene, const string& filename);
 	bool initFromScene(const aiScene* pScene, const string& filename);
+	void initBones(); // after the vertex data, bone offsets and node hierarchy are loaded
+
+	// Binary cache of everything read from the scene, next to the model file.
+	// It is valid while the hash of the model file, the load flags and the version match.
+	bool readCache(const string& cachePath, const QByteArray& sourceHash);
+	bool writeCache(const string& cachePath, const QByteArray& sourceHash) const;
 	
 	// Mesh entries
 	QVector<MeshEntry> m_meshEntries;
@@ -160,7 +194,7 @@ private:
 	// Bones
 	QVector<BoneInfo> m_boneInfo;
 	// Textures
-	QVector<QImage> m_images;
+	vector<string> m_imagePaths;
 
 	map<string, uint> m_boneMap; // maps a mesh's bone name to its index (key = bone name, value = index)
 	map<string, uint> m_kboneMap; // maps a mesh's bone name to its kinect JointType index
@@ -172,7 +206,15 @@ private:
 
 	void initDefaultLocalMatrices(const aiNode* node);
 
-	vector<QString> m_boneTransformInfo;
+	// Node hierarchy flattened at load time
+	QVector<SkinnedMeshNode> m_nodes;
+	vector<string> m_nodeNames; // used to resolve the kinect joints only
+	QVector<QMatrix4x4> m_nodeGlobals;
+	QVector<QMatrix4x4> m_boneTransforms;
+	void compileNodeHierarchy(const aiNode* pNode, int parent);
+	void resolveKinectJoints();
+
+	vector<BoneTransformRecord> m_boneTransformRecords;
 
 	uint m_numBones = 0; // crash if not 0
 	uint m_numVertices; // total number of vertices
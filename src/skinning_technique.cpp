@@ -3,7 +3,17 @@
 
 // Standard C/C++
 #include <cassert>
+#include <cstring>
 
+SkinningTechnique::SkinningTechnique()
+{
+	m_paletteBuffers[0] = m_paletteBuffers[1] = 0;
+}
+SkinningTechnique::~SkinningTechnique()
+{
+	if (m_paletteBuffers[0] != 0) glDeleteBuffers(2, m_paletteBuffers);
+	if (m_visibilityBuffer != 0) glDeleteBuffers(1, &m_visibilityBuffer);
+}
 bool SkinningTechnique::Init()
 {
     if (!Technique::Init()) {
@@ -137,20 +147,32 @@ bool SkinningTechnique::Init()
         }
     }
 
-    for (uint i = 0 ; i < ARRAY_SIZE_IN_ELEMENTS(m_boneLocation) ; i++) {
-        char Name[128];
-        memset(Name, 0, sizeof(Name));
-        SNPRINTF(Name, sizeof(Name), "gBones[%d]", i);
-        m_boneLocation[i] = GetUniformLocation(Name);
-    }
+	GLuint paletteIndex = glGetUniformBlockIndex(m_shaderProg, "BonePalette");
+	GLuint visibilityIndex = glGetUniformBlockIndex(m_shaderProg, "BoneVisibility");
+	if (paletteIndex == GL_INVALID_INDEX || visibilityIndex == GL_INVALID_INDEX) {
+		printf("Invalid uniform block index(bones)\n");
+		return false;
+	}
+	glUniformBlockBinding(m_shaderProg, paletteIndex, BONE_PALETTE_BINDING);
+	glUniformBlockBinding(m_shaderProg, visibilityIndex, BONE_VISIBILITY_BINDING);
 
-	for (uint i = 0; i < ARRAY_SIZE_IN_ELEMENTS(m_visibilityLocation); i++) {
-		char Name[128];
-		memset(Name, 0, sizeof(Name));
-		SNPRINTF(Name, sizeof(Name), "visible[%d]", i);
-		m_visibilityLocation[i] = GetUniformLocation(Name);
+	glGenBuffers(2, m_paletteBuffers);
+	for (uint i = 0; i < 2; i++) {
+		glBindBuffer(GL_UNIFORM_BUFFER, m_paletteBuffers[i]);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * 16 * sizeof(float), NULL, GL_STREAM_DRAW);
+	}
+	m_palette.fill(0.f, MAX_BONES * 16);
+	for (uint i = 0; i < MAX_BONES; i++) {
+		for (uint d = 0; d < 4; d++) m_palette[16 * i + 5 * d] = 1.f; // identity
 	}
 
+	glGenBuffers(1, &m_visibilityBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_visibilityBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(m_visibilityBits), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	m_visibilityBits.fill(0xFFFFFFFF);
+	uploadBoneVisibility();
+
     return true;
 }
 void SkinningTechnique::setWVP(const QMatrix4x4& WVP)
@@ -218,10 +240,27 @@ void SkinningTechnique::SetSpotLights(uint NumLights, const SpotLight* pLights)
         glUniform1f(m_spotLightsLocation[i].Atten.Exp,      pLights[i].Attenuation.Exp);
     }
 }
-void SkinningTechnique::setBoneTransform(uint index, const QMatrix4x4& transform)
+void SkinningTechnique::setBoneTransforms(const QVector<QMatrix4x4>& transforms)
 {
-    assert(index < MAX_BONES);
-    glUniformMatrix4fv(m_boneLocation[index], 1, GL_TRUE, transform.transposed().data());       
+	uint count = transforms.size();
+	if (count > MAX_BONES) {
+		printf("Bone palette of %u bones truncated to %u\n", count, MAX_BONES);
+		count = MAX_BONES;
+	}
+	for (uint i = 0; i < count; i++) {
+		memcpy(m_palette.data() + 16 * i, transforms[i].constData(), 16 * sizeof(float)); // column major like std140
+	}
+
+	m_activePaletteBuffer = 1 - m_activePaletteBuffer;
+	glBindBuffer(GL_UNIFORM_BUFFER, m_paletteBuffers[m_activePaletteBuffer]);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * 16 * sizeof(float), NULL, GL_STREAM_DRAW); // orphan
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, count * 16 * sizeof(float), m_palette.constData());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BONE_PALETTE_BINDING, m_paletteBuffers[m_activePaletteBuffer]);
+
+	if (m_visibilityChanged) {
+		uploadBoneVisibility();
+	}
 }
 void SkinningTechnique::setSkinning(int value) // use 0 value to switch off
 {
@@ -230,6 +269,16 @@ void SkinningTechnique::setSkinning(int value) // use 0 value to switch off
 void SkinningTechnique::setBoneVisibility(uint Index, const bool& Visibility)
 {
 	assert(Index < MAX_BONES);
-	//cout << "Setting variable at location " << m_visibilityLocation[Index] << " to " << Visibility << endl;
-	glUniform1i(m_visibilityLocation[Index], Visibility);
+	GLuint bit = 1u << (Index % 32);
+	if (Visibility) m_visibilityBits[Index / 32] |= bit;
+	else m_visibilityBits[Index / 32] &= ~bit;
+	m_visibilityChanged = true;
+}
+void SkinningTechnique::uploadBoneVisibility()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, m_visibilityBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(m_visibilityBits), m_visibilityBits.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BONE_VISIBILITY_BINDING, m_visibilityBuffer);
+	m_visibilityChanged = false;
 }
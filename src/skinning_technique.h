@@ -4,6 +4,12 @@
 // Project
 #include "technique.h"
 
+// Qt
+#include <QtCore\QVector>
+
+// Standard C/C++
+#include <array>
+
 struct BaseLight
 {
     QVector3D Color;
@@ -61,7 +67,12 @@ public:
 
     static const uint MAX_POINT_LIGHTS = 2;
     static const uint MAX_SPOT_LIGHTS = 2;
-    static const uint MAX_BONES = 100;
+    static const uint MAX_BONES = 256; // must match skinning.vert
+    static const uint BONE_PALETTE_BINDING = 0;
+    static const uint BONE_VISIBILITY_BINDING = 1;
+
+    SkinningTechnique();
+    ~SkinningTechnique();
 
     virtual bool Init();
 
@@ -74,9 +85,9 @@ public:
     void SetEyeWorldPos(const QVector3D& EyeWorldPos);
     void setMatSpecularIntensity(float Intensity);
     void setMatSpecularPower(float Power);
-    void setBoneTransform(uint index, const QMatrix4x4& transform);
+    void setBoneTransforms(const QVector<QMatrix4x4>& transforms); // uploads the whole palette in one call
 	void setSkinning(int value);
-	void setBoneVisibility(uint Index, const bool& Visibility);
+	void setBoneVisibility(uint Index, const bool& Visibility); // uploaded with the next palette
 
 private:   
     GLuint m_WVPLocation;
@@ -123,8 +134,16 @@ private:
         } Atten;
     } m_spotLightsLocation[MAX_SPOT_LIGHTS];
     
-    GLuint m_boneLocation[MAX_BONES];
-	GLuint m_visibilityLocation[MAX_BONES];
+    // bone palettes alternate between two orphaned uniform buffers, so that a palette
+    // is never overwritten while a previous draw may still read it
+    GLuint m_paletteBuffers[2];
+    uint m_activePaletteBuffer = 0;
+    QVector<float> m_palette; // std140 mat4 array
+
+    GLuint m_visibilityBuffer = 0;
+    array<GLuint, MAX_BONES / 32> m_visibilityBits; // std140 uvec4 array
+    bool m_visibilityChanged = true;
+    void uploadBoneVisibility();
 };
 
 #endif	/* SKINNING_TECHNIQUE_H */
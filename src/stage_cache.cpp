@@ -0,0 +1,226 @@
+// Own
+#include "stage_cache.h"
+
+// Project
+#include "session_file.h"
+
+// Qt
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+
+// Standard C/C++
+#include <cstring>
+
+#define STAGE_FILE_MAGIC "KSTG"
+
+static const quint64 fnvPrime = 1099511628211ull;
+static const int recordsPerAccess = 1024;
+
+// Disk tier file: the header, then frameCount SessionFrameRecord
+struct StageFileHeader
+{
+	char magic[4];
+	quint32 version; // STAGE_CACHE_VERSION
+	quint32 frameRecordSize;
+	quint32 reserved;
+	StageKey key;
+	quint64 frameCount;
+};
+
+quint64 hashData(const void* data, size_t size, quint64 hash)
+{
+	const uchar* bytes = (const uchar*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * fnvPrime;
+	}
+	return hash;
+}
+
+bool StageKey::operator==(const StageKey& other) const
+{
+	return inputs[0] == other.inputs[0] && inputs[1] == other.inputs[1] &&
+		interpolationStart == other.interpolationStart && stage == other.stage && parameters == other.parameters;
+}
+quint64 StageKey::hash() const
+{
+	quint64 hash = hashData(inputs, sizeof(inputs));
+	hash = hashData(&interpolationStart, sizeof(interpolationStart), hash);
+	hash = hashData(&stage, sizeof(stage), hash);
+	hash = hashData(&parameters, sizeof(parameters), hash);
+	return hash;
+}
+uint qHash(const StageKey& key, uint seed)
+{
+	quint64 hash = key.hash();
+	return (uint)(hash ^ (hash >> 32)) ^ seed;
+}
+quint64 hashMotion(const MotionView& motion)
+{
+	const int size = motion.size();
+	quint64 hash = hashData(&size, sizeof(size));
+	SessionFrameRecord record;
+	for (int i = 0; i < size; i++) {
+		// the record has no padding, unlike KFrame
+		KFrame frame;
+		motion.getFrame(i, frame);
+		toSessionRecord(frame, record);
+		hash = hashData(&record, sizeof(record), hash);
+	}
+	return hash;
+}
+
+StageCache::StageCache(int capacity)
+	:
+	m_capacity(capacity < 2 ? 2 : capacity)
+{
+}
+void StageCache::setCapacity(int capacity)
+{
+	m_capacity = capacity < 2 ? 2 : capacity;
+	evict();
+}
+int StageCache::capacity() const
+{
+	return m_capacity;
+}
+void StageCache::setDiskDirectory(const QString& directory)
+{
+	m_diskDirectory = directory;
+	if (!m_diskDirectory.isEmpty() && !QDir().mkpath(m_diskDirectory)) {
+		cout << "Could not create stage cache directory " << m_diskDirectory.toStdString() << endl;
+		m_diskDirectory.clear();
+	}
+}
+const QString& StageCache::diskDirectory() const
+{
+	return m_diskDirectory;
+}
+int StageCache::size() const
+{
+	return (int)m_entries.size();
+}
+void StageCache::setPinned(const QVector<StageKey>& keys)
+{
+	m_pinned.clear();
+	for (const StageKey& key : keys) {
+		m_pinned.insert(key);
+	}
+	evict();
+}
+QVector<KFrame>* StageCache::find(const StageKey& key)
+{
+	QHash<StageKey, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_entries.splice(m_entries.begin(), m_entries, it.value());
+		return &m_entries.front().motion;
+	}
+	QVector<KFrame> motion;
+	if (!m_diskDirectory.isEmpty() && readFromDisk(key, motion)) {
+		return &insertInMemory(key, motion);
+	}
+	return nullptr;
+}
+QVector<KFrame>& StageCache::insert(const StageKey& key, const QVector<KFrame>& motion)
+{
+	if (!m_diskDirectory.isEmpty() && !writeToDisk(key, motion)) {
+		cout << "Could not write " << diskFileName(key).toStdString() << " to the stage cache" << endl;
+	}
+	return insertInMemory(key, motion);
+}
+void StageCache::clear()
+{
+	m_entries.clear();
+	m_index.clear();
+}
+QVector<KFrame>& StageCache::insertInMemory(const StageKey& key, const QVector<KFrame>& motion)
+{
+	QHash<StageKey, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_entries.erase(it.value());
+		m_index.erase(it);
+	}
+	Entry entry;
+	entry.key = key;
+	entry.motion = motion;
+	m_entries.push_front(entry);
+	m_index.insert(key, m_entries.begin());
+	evict();
+	return m_entries.front().motion;
+}
+void StageCache::evict()
+{
+	// the most recently used motion stays even when everything else is pinned
+	std::list<Entry>::iterator it = m_entries.end();
+	while ((int)m_entries.size() > m_capacity && it != m_entries.begin()) {
+		--it;
+		if (it == m_entries.begin() || m_pinned.contains(it->key)) {
+			continue;
+		}
+		m_index.remove(it->key);
+		it = m_entries.erase(it);
+	}
+}
+QString StageCache::diskFileName(const StageKey& key) const
+{
+	return QDir(m_diskDirectory).filePath(QString("%1.kstage").arg(key.hash(), 16, 16, QChar('0')));
+}
+bool StageCache::readFromDisk(const StageKey& key, QVector<KFrame>& motion) const
+{
+	QFile file(diskFileName(key));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	StageFileHeader header;
+	if (file.read((char*)&header, sizeof(header)) != sizeof(header) ||
+		memcmp(header.magic, STAGE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != STAGE_CACHE_VERSION ||
+		header.frameRecordSize != sizeof(SessionFrameRecord) ||
+		!(header.key == key) ||
+		header.frameCount != (quint64)(file.size() - sizeof(header)) / sizeof(SessionFrameRecord)) {
+		return false;
+	}
+	motion.resize((int)header.frameCount);
+	QVector<SessionFrameRecord> records(recordsPerAccess);
+	for (int first = 0; first < motion.size(); first += recordsPerAccess) {
+		int count = qMin(recordsPerAccess, motion.size() - first);
+		qint64 bytes = count * sizeof(SessionFrameRecord);
+		if (file.read((char*)records.data(), bytes) != bytes) {
+			motion.clear();
+			return false;
+		}
+		for (int i = 0; i < count; i++) {
+			fromSessionRecord(records[i], motion[first + i]);
+		}
+	}
+	return true;
+}
+bool StageCache::writeToDisk(const StageKey& key, const QVector<KFrame>& motion) const
+{
+	const QString fileName = diskFileName(key);
+	if (QFile::exists(fileName)) {
+		return true; // the same key always holds the same motion
+	}
+	StageFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STAGE_FILE_MAGIC, sizeof(header.magic));
+	header.version = STAGE_CACHE_VERSION;
+	header.frameRecordSize = sizeof(SessionFrameRecord);
+	header.key = key;
+	header.frameCount = motion.size();
+
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	QVector<SessionFrameRecord> records(recordsPerAccess);
+	for (int first = 0; first < motion.size(); first += recordsPerAccess) {
+		int count = qMin(recordsPerAccess, motion.size() - first);
+		for (int i = 0; i < count; i++) {
+			toSessionRecord(motion[first + i], records[i]);
+		}
+		file.write((const char*)records.constData(), count * sizeof(SessionFrameRecord));
+	}
+	return file.commit();
+}
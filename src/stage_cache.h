@@ -0,0 +1,78 @@
+#ifndef STAGE_CACHE_H
+#define STAGE_CACHE_H
+
+// Project
+#include "kskeleton.h"
+#include "motion_view.h"
+
+// Qt
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+// Standard C/C++
+#include <list>
+
+#define STAGE_CACHE_VERSION 2 // increase when a processing stage changes its results, the disk tier is keyed by it
+
+// Identifies a derived motion by what it is computed from: the hashes of its input motions
+// (the raw motion, or the adjusted motion and its prototype for a rescale), the stage and its parameters
+struct StageKey
+{
+	quint64 inputs[2];
+	qint32 interpolationStart;
+	quint32 stage; // SessionStage, or a KSkeleton intermediate stage
+	quint64 parameters; // hash of the KProcessingParameters the stage reads
+
+	bool operator==(const StageKey& other) const;
+	quint64 hash() const;
+};
+uint qHash(const StageKey& key, uint seed = 0);
+
+// FNV-1a, a previous hash continues over more data
+quint64 hashData(const void* data, size_t size, quint64 hash = 14695981039346656037ull);
+quint64 hashMotion(const MotionView& motion); // of the frames' values
+
+// Derived motions kept by least recent use. The memory tier holds up to capacity motions, the pinned
+// ones included: those are never evicted, with more of them than the capacity only they and the most
+// recently used motion stay. The optional disk tier keeps every inserted motion as a file of session
+// records named after StageKey::hash, so sessions opened again skip the processing. Not thread safe.
+class StageCache
+{
+public:
+	explicit StageCache(int capacity = 4);
+	void setCapacity(int capacity); // at least 2, the least recently used motions beyond it are evicted
+	int capacity() const;
+	void setDiskDirectory(const QString& directory); // empty disables the disk tier
+	const QString& diskDirectory() const;
+	int size() const; // motions in memory
+	// Pinned motions are never evicted from memory, the pins replace the previous ones
+	void setPinned(const QVector<StageKey>& keys);
+
+	// Looks in memory, then on disk. Null if the motion is in neither, else valid until the next
+	// insert or clear. Changes to the motion are not written to the disk tier.
+	QVector<KFrame>* find(const StageKey& key);
+	QVector<KFrame>& insert(const StageKey& key, const QVector<KFrame>& motion);
+	void clear(); // the memory tier
+private:
+	struct Entry
+	{
+		StageKey key;
+		QVector<KFrame> motion;
+	};
+
+	QVector<KFrame>& insertInMemory(const StageKey& key, const QVector<KFrame>& motion);
+	void evict();
+	QString diskFileName(const StageKey& key) const;
+	bool readFromDisk(const StageKey& key, QVector<KFrame>& motion) const;
+	bool writeToDisk(const StageKey& key, const QVector<KFrame>& motion) const;
+
+	std::list<Entry> m_entries; // most recently used first
+	QHash<StageKey, std::list<Entry>::iterator> m_index;
+	QSet<StageKey> m_pinned;
+	int m_capacity;
+	QString m_diskDirectory;
+};
+
+#endif
@@ -0,0 +1,101 @@
+// Own
+#include "task_graph.h"
+
+// Qt
+#include <QtCore/QRunnable>
+
+// Runs one ready task of the graph, if the calling thread has not taken them all already
+class TaskGraphJob : public QRunnable
+{
+public:
+	explicit TaskGraphJob(TaskGraph* graph)
+		:
+		m_graph(graph)
+	{
+	}
+	void run() override
+	{
+		m_graph->runJob();
+	}
+private:
+	TaskGraph* m_graph;
+};
+
+TaskGraph::TaskId TaskGraph::addTask(std::function<void()> function, const std::vector<TaskId>& dependencies)
+{
+	TaskId id = (TaskId)m_tasks.size();
+	m_tasks.push_back(Task());
+	m_tasks.back().function = function;
+	for (size_t i = 0; i < dependencies.size(); i++) {
+		m_tasks[dependencies[i]].dependents.push_back(id);
+		m_tasks.back().dependencyCount++;
+	}
+	return id;
+}
+int TaskGraph::size() const
+{
+	return (int)m_tasks.size();
+}
+void TaskGraph::run(QThreadPool* pool)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished = 0;
+	m_pendingJobs = 0;
+	m_ready.clear();
+	m_pool = pool;
+	for (size_t i = 0; i < m_tasks.size(); i++) {
+		m_tasks[i].remainingDependencies = m_tasks[i].dependencyCount;
+		if (m_tasks[i].dependencyCount == 0) {
+			enqueue((TaskId)i);
+		}
+	}
+	while (m_finished < size() || m_pendingJobs > 0) {
+		if (!m_ready.empty()) {
+			lock.unlock();
+			runReadyTask();
+			lock.lock();
+		}
+		else {
+			m_condition.wait(lock);
+		}
+	}
+}
+bool TaskGraph::runReadyTask()
+{
+	TaskId id;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_ready.empty()) {
+			return false;
+		}
+		id = m_ready.front();
+		m_ready.pop_front();
+	}
+	m_tasks[id].function();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const std::vector<TaskId>& dependents = m_tasks[id].dependents;
+		for (size_t i = 0; i < dependents.size(); i++) {
+			if (--m_tasks[dependents[i]].remainingDependencies == 0) {
+				enqueue(dependents[i]);
+			}
+		}
+		m_finished++;
+		m_condition.notify_all();
+	}
+	return true;
+}
+void TaskGraph::enqueue(TaskId id)
+{
+	m_ready.push_back(id);
+	m_condition.notify_all();
+	m_pendingJobs++;
+	m_pool->start(new TaskGraphJob(this));
+}
+void TaskGraph::runJob()
+{
+	runReadyTask();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingJobs--;
+	m_condition.notify_all(); // notified under the lock, so run() cannot return and destroy it before
+}
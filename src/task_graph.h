@@ -0,0 +1,49 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+// Qt
+#include <QtCore/QThreadPool>
+
+// Standard C/C++
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Runs a set of functions on a thread pool in dependency order, each one as soon as the tasks it
+// depends on have finished. run() blocks until every task has run and the calling thread runs
+// ready tasks too, so a graph makes progress even when the pool has no free thread.
+class TaskGraph
+{
+public:
+	typedef int TaskId;
+
+	TaskId addTask(std::function<void()> function, const std::vector<TaskId>& dependencies = std::vector<TaskId>());
+	int size() const;
+	void run(QThreadPool* pool = QThreadPool::globalInstance());
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		std::vector<TaskId> dependents;
+		int dependencyCount = 0;
+		int remainingDependencies = 0;
+	};
+
+	friend class TaskGraphJob;
+
+	bool runReadyTask(); // false if no task was ready
+	void enqueue(TaskId id); // called with m_mutex locked, starts a job for the task
+	void runJob();
+
+	std::vector<Task> m_tasks;
+	std::deque<TaskId> m_ready;
+	int m_finished = 0;
+	int m_pendingJobs = 0; // started on the pool and not returned yet
+	QThreadPool* m_pool = nullptr;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+};
+
+#endif
@@ -153,6 +153,36 @@ bool Technique::initDefault()
 
 	return true;
 }
+// Same uniforms as the default technique, the vertices are drawn once per joint instance
+bool Technique::initJoints()
+{
+	if (!Technique::Init()) {
+		printf("Cannot initialize joints technique\n");
+		return false;
+	}
+
+	if (!AddShader(GL_VERTEX_SHADER, "shaders/joints.vert")) {
+		printf("Cannot add joints vertex shader\n");
+		return false;
+	}
+
+	if (!AddShader(GL_FRAGMENT_SHADER, "shaders/simple.frag")) {
+		printf("Cannot add simple fragment shader\n");
+		return false;
+	}
+
+	if (!Finalize()) {
+		printf("Cannot finalize joints shaders\n");
+		return false;
+	}
+
+	m_locationMVP = GetUniformLocation("gMVP");
+	cout << "Technique: gMVP location = " << m_locationMVP << endl;
+	m_locationSpecific = GetUniformLocation("gSpecific");
+	cout << "Technique: gSpecific location = " << m_locationSpecific << endl;
+
+	return true;
+}
 void Technique::setMVP(const QMatrix4x4& MVP)
 {
 	glUniformMatrix4fv(m_locationMVP, 1, GL_TRUE, MVP.transposed().data());
@@ -23,6 +23,7 @@ public:
     void enable();
 
 	bool initDefault();
+	bool initJoints(); // instanced joint markers
 	void setMVP(const QMatrix4x4& MVP);
 	void setSpecific(const QMatrix4x4& MVP);
 
@@ -0,0 +1,287 @@
+// Own
+#include "texture_cache.h"
+
+// Project
+#include "util.h"
+
+// Qt
+#include <QtCore\QCryptographicHash>
+#include <QtCore\QFile>
+#include <QtCore\QSaveFile>
+
+// Standard C/C++
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+struct TextureCacheHeader
+{
+	char magic[4];
+	quint32 version;
+	quint32 format;
+	quint32 width;
+	quint32 height;
+	quint32 levels;
+	char sourceHash[20]; // SHA-1 of the image file
+};
+static const char textureCacheMagic[4] = { 'D', 'T', 'E', 'X' };
+static const quint32 textureCacheMaxSize = 16384; // texels a side, keeps the level sizes within int
+
+static int blockSize(CompressedTexture::Format format)
+{
+	return format == CompressedTexture::BC1 ? 8 : 16;
+}
+static int levelSize(CompressedTexture::Format format, int width, int height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+// levels of a full mip chain, down to 1x1: floor(log2(max(width, height))) + 1
+static quint32 mipLevels(quint32 width, quint32 height)
+{
+	quint32 levels = 1;
+	for (quint32 size = max(width, height); size > 1; size /= 2) {
+		levels++;
+	}
+	return levels;
+}
+static quint16 toRGB565(int r, int g, int b)
+{
+	return (quint16)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+static void fromRGB565(quint16 c, int rgb[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+static void writeBits(uchar* out, quint64 bits, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		out[i] = (uchar)(bits >> (8 * i));
+	}
+}
+// 16 RGBA pixels to an 8 byte BC1 block in four color mode, with the endpoints on the inset bounding box
+static void compressColorBlock(const uchar* pixels, uchar* out)
+{
+	int minColor[3] = { 255, 255, 255 };
+	int maxColor[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			minColor[c] = min(minColor[c], (int)pixels[4 * i + c]);
+			maxColor[c] = max(maxColor[c], (int)pixels[4 * i + c]);
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		int inset = (maxColor[c] - minColor[c]) / 16;
+		minColor[c] += inset;
+		maxColor[c] -= inset;
+	}
+	quint16 color0 = toRGB565(maxColor[0], maxColor[1], maxColor[2]);
+	quint16 color1 = toRGB565(minColor[0], minColor[1], minColor[2]);
+	if (color0 < color1) swap(color0, color1);
+
+	quint32 indices = 0;
+	if (color0 != color1) { // otherwise every index is 0
+		int palette[4][3];
+		fromRGB565(color0, palette[0]);
+		fromRGB565(color1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestDistance = INT_MAX;
+			for (int p = 0; p < 4; p++) {
+				int distance = 0;
+				for (int c = 0; c < 3; c++) {
+					int d = (int)pixels[4 * i + c] - palette[p][c];
+					distance += d * d;
+				}
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (quint32)best << (2 * i);
+		}
+	}
+	writeBits(out, color0, 2);
+	writeBits(out + 2, color1, 2);
+	writeBits(out + 4, indices, 4);
+}
+// 16 RGBA pixels to the 8 byte alpha part of a BC3 block, in eight alpha mode
+static void compressAlphaBlock(const uchar* pixels, uchar* out)
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; i++) {
+		alpha0 = max(alpha0, (int)pixels[4 * i + 3]);
+		alpha1 = min(alpha1, (int)pixels[4 * i + 3]);
+	}
+	quint64 indices = 0;
+	if (alpha0 != alpha1) { // otherwise every index is 0
+		int palette[8] = { alpha0, alpha1 };
+		for (int p = 2; p < 8; p++) {
+			palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestDistance = INT_MAX;
+			for (int p = 0; p < 8; p++) {
+				int distance = abs((int)pixels[4 * i + 3] - palette[p]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (quint64)best << (3 * i);
+		}
+	}
+	out[0] = (uchar)alpha0;
+	out[1] = (uchar)alpha1;
+	writeBits(out + 2, indices, 6);
+}
+static void compressLevel(const QImage& image, CompressedTexture::Format format, uchar* out)
+{
+	const int width = image.width();
+	const int height = image.height();
+	uchar block[16 * 4];
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			// the edge pixels are repeated in blocks that cross the border
+			for (int y = 0; y < 4; y++) {
+				const uchar* line = image.constScanLine(min(by + y, height - 1));
+				for (int x = 0; x < 4; x++) {
+					memcpy(block + 4 * (4 * y + x), line + 4 * min(bx + x, width - 1), 4);
+				}
+			}
+			if (format == CompressedTexture::BC3) {
+				compressAlphaBlock(block, out);
+				out += 8;
+			}
+			compressColorBlock(block, out);
+			out += 8;
+		}
+	}
+}
+
+QString TextureCache::cachePath(const QString& imagePath)
+{
+	return imagePath + ".texcache";
+}
+QByteArray TextureCache::hashFile(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QByteArray();
+	}
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(&file);
+	return hash.result();
+}
+bool TextureCache::read(const QString& cachePath, const QByteArray& sourceHash, CompressedTexture& texture)
+{
+	QFile file(cachePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	TextureCacheHeader header;
+	if (file.read((char*)&header, sizeof(header)) != sizeof(header) ||
+		memcmp(header.magic, textureCacheMagic, sizeof(header.magic)) != 0 ||
+		header.version != TEXTURE_CACHE_VERSION ||
+		header.format > CompressedTexture::BC3 ||
+		sourceHash.size() != sizeof(header.sourceHash) ||
+		memcmp(header.sourceHash, sourceHash.constData(), sizeof(header.sourceHash)) != 0) {
+		return false;
+	}
+	// the sizes below are computed from the header, which must not be trusted
+	if (header.width == 0 || header.width > textureCacheMaxSize ||
+		header.height == 0 || header.height > textureCacheMaxSize ||
+		header.levels == 0 || header.levels > mipLevels(header.width, header.height)) {
+		return false;
+	}
+
+	texture = CompressedTexture();
+	texture.format = (CompressedTexture::Format)header.format;
+	texture.width = header.width;
+	texture.height = header.height;
+	int offset = 0;
+	int width = header.width, height = header.height;
+	for (quint32 i = 0; i < header.levels; i++) {
+		int size = levelSize(texture.format, width, height);
+		texture.levelOffsets.push_back(offset);
+		texture.levelSizes.push_back(size);
+		offset += size;
+		width = max(width / 2, 1);
+		height = max(height / 2, 1);
+	}
+	if (file.size() - file.pos() < offset) {
+		texture = CompressedTexture();
+		return false;
+	}
+	texture.data = file.read(offset);
+	if (texture.data.size() != offset) {
+		texture = CompressedTexture();
+		return false;
+	}
+	return true;
+}
+bool TextureCache::write(const QString& cachePath, const QByteArray& sourceHash, const CompressedTexture& texture)
+{
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, textureCacheMagic, sizeof(header.magic));
+	header.version = TEXTURE_CACHE_VERSION;
+	header.format = texture.format;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.levels = texture.levels();
+	if (sourceHash.size() != sizeof(header.sourceHash)) {
+		return false;
+	}
+	memcpy(header.sourceHash, sourceHash.constData(), sizeof(header.sourceHash));
+
+	// the file replaces the previous cache only once it is complete
+	QSaveFile file(cachePath);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(texture.data);
+	return file.commit();
+}
+CompressedTexture TextureCache::compress(const QImage& image)
+{
+	CompressedTexture texture;
+	if (image.isNull()) {
+		return texture;
+	}
+	QImage level = image.convertToFormat(QImage::Format_RGBA8888);
+	texture.format = CompressedTexture::BC1;
+	for (int y = 0; y < level.height() && texture.format == CompressedTexture::BC1; y++) {
+		const uchar* line = level.constScanLine(y);
+		for (int x = 0; x < level.width(); x++) {
+			if (line[4 * x + 3] != 255) {
+				texture.format = CompressedTexture::BC3;
+				break;
+			}
+		}
+	}
+	texture.width = level.width();
+	texture.height = level.height();
+
+	while (true) {
+		int size = levelSize(texture.format, level.width(), level.height());
+		texture.levelOffsets.push_back(texture.data.size());
+		texture.levelSizes.push_back(size);
+		texture.data.resize(texture.data.size() + size);
+		compressLevel(level, texture.format, (uchar*)texture.data.data() + texture.levelOffsets.last());
+		if (level.width() == 1 && level.height() == 1) {
+			break;
+		}
+		level = level.scaled(max(level.width() / 2, 1), max(level.height() / 2, 1), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+	return texture;
+}
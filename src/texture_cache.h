@@ -0,0 +1,48 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+// Qt
+#include <QtCore\QByteArray>
+#include <QtCore\QMetaType>
+#include <QtCore\QString>
+#include <QtCore\QVector>
+#include <QtGui\QImage>
+
+#define TEXTURE_CACHE_VERSION 1 // increase when the layout of the texture cache files changes
+
+// Block compressed texture with its whole mip chain, level 0 first
+struct CompressedTexture
+{
+	enum Format
+	{
+		BC1, // opaque, 8 bytes per 4x4 block (DXT1)
+		BC3  // with alpha, 16 bytes per 4x4 block (DXT5)
+	};
+
+	Format format = BC1;
+	int width = 0;
+	int height = 0;
+	QVector<int> levelOffsets; // in data
+	QVector<int> levelSizes;
+	QByteArray data;
+
+	bool isNull() const { return levelSizes.isEmpty(); }
+	int levels() const { return levelSizes.size(); }
+};
+Q_DECLARE_METATYPE(CompressedTexture)
+
+// Compresses images and keeps them in "<image file>.texcache" files,
+// which are valid while the hash of the image file and the version match.
+namespace TextureCache
+{
+	QString cachePath(const QString& imagePath);
+	QByteArray hashFile(const QString& path); // empty if the file cannot be read
+
+	bool read(const QString& cachePath, const QByteArray& sourceHash, CompressedTexture& texture);
+	bool write(const QString& cachePath, const QByteArray& sourceHash, const CompressedTexture& texture);
+
+	// BC3 if any pixel is not opaque, otherwise BC1. Every mip level is compressed from a smoothly downscaled image.
+	CompressedTexture compress(const QImage& image);
+}
+
+#endif